@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free hand-off of the latest state from a single producer to a single consumer.
+// Each side owns one slot and the third one is swapped between them through an atomic index,
+// so the producer never waits for the consumer and the consumer always gets the most recent complete state.
+template<typename T>
+class TripleBuffer
+{
+private:
+	static const uint32_t FRESH_BIT = 0b100; // Set while the shared slot holds a state the consumer has not taken yet
+
+	std::array<T, 3> _slots{};
+	std::atomic<uint32_t> _shared{ 1 };
+	uint32_t _back = 0; // Owned by the producer
+	uint32_t _front = 2; // Owned by the consumer
+
+public:
+	// Not thread-safe; call only while neither side is running
+	void Reset(const T &value)
+	{
+		_slots.fill(value);
+		_shared.store(1);
+		_back = 0;
+		_front = 2;
+	}
+
+	// Producer side
+	T &GetBack() { return _slots[_back]; }
+	bool IsTaken() const { return (_shared.load(std::memory_order_acquire) & FRESH_BIT) == 0; } // Whether the consumer has taken the last published state
+	void Publish()
+	{
+		_back = _shared.exchange(_back | FRESH_BIT, std::memory_order_acq_rel) & ~FRESH_BIT;
+	}
+
+	// Consumer side
+	// Returns true if a newer state has been published since the last call
+	bool Acquire()
+	{
+		if ((_shared.load(std::memory_order_relaxed) & FRESH_BIT) == 0) return false;
+
+		_front = _shared.exchange(_front, std::memory_order_acq_rel) & ~FRESH_BIT;
+		return true;
+	}
+	const T &GetFront() const { return _slots[_front]; }
+};
@@ -1,5 +1,13 @@
 #include "ComputeBase.h"
 
+ParticleDispatch ParticleDispatch::Create(uint32_t particleCount)
+{
+	ParticleDispatch particleDispatch{};
+	particleDispatch._groupCount = { std::max(DivisionCeil(particleCount, GROUP_SIZE), 1u), 1, 1 };
+	particleDispatch._particleCount = particleCount;
+	return particleDispatch;
+}
+
 void ComputeBase::Register()
 {
 	SetEnable(true);
@@ -7,9 +15,10 @@ void ComputeBase::Register()
 
 void ComputeBase::SetEnable(bool enable)
 {
+	auto &onCommand = _isAsync ? VulkanCore::Get()->OnAsyncComputeCommand() : VulkanCore::Get()->OnComputeCommand();
 	if (enable)
 	{
-		_commandRegisterID = VulkanCore::Get()->OnComputeCommand().AddListener
+		_commandRegisterID = onCommand.AddListener
 		(
 			weak_from_this(),
 			[this](VkCommandBuffer computeCommandBuffer, size_t currentFrame)
@@ -20,9 +29,25 @@ void ComputeBase::SetEnable(bool enable)
 			__FUNCTION__,
 			__LINE__
 		);
+
+		if (_isAsync)
+		{
+			_acquireRegisterID = VulkanCore::Get()->OnComputeCommand().AddListener
+			(
+				weak_from_this(),
+				[this](VkCommandBuffer computeCommandBuffer, size_t currentFrame)
+				{
+					RecordAcquireCommand(computeCommandBuffer, currentFrame);
+				},
+				PRIORITY_HIGHEST,
+				__FUNCTION__,
+				__LINE__
+			);
+		}
 	}
 	else
 	{
-		VulkanCore::Get()->OnComputeCommand().RemoveListener(_commandRegisterID);
+		onCommand.RemoveListener(_commandRegisterID);
+		if (_isAsync) VulkanCore::Get()->OnComputeCommand().RemoveListener(_acquireRegisterID);
 	}
 }
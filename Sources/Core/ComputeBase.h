@@ -7,11 +7,30 @@
 
 #include "VulkanCore.h"
 
+// Indirect dispatch of the passes over particles, followed by the count that the passes range-check against.
+// Engines whose particles come and go on the device write it there, so that the recorded commands stay valid for any count.
+struct ParticleDispatch
+{
+	VkDispatchIndirectCommand _groupCount{};
+	alignas(4) uint32_t _particleCount = 0;
+
+	static const uint32_t GROUP_SIZE = 1024; // Threads of a workgroup of the passes over particles
+
+	// At least one workgroup is dispatched, so that the first thread can keep the per-frame state of a pass even without particles
+
+	static ParticleDispatch Create(uint32_t particleCount);
+};
+
 class ComputeBase : public DelegateRegistrable
 {
 protected:
 	
 	size_t _commandRegisterID = 0;
+	size_t _acquireRegisterID = 0;
+
+	// Async computes are recorded on the async compute queue, if there is one, ahead of the other computes of the frame.
+	// Results that the other computes read pass to the compute queue in RecordCommand and RecordAcquireCommand.
+	bool _isAsync = false;
 
 public:
 	ComputeBase() = default;
@@ -27,5 +46,6 @@ public:
 
 protected:
 	virtual void RecordCommand(VkCommandBuffer computeCommandBuffer, size_t currentFrame) = 0;
+	virtual void RecordAcquireCommand(VkCommandBuffer computeCommandBuffer, size_t currentFrame) {} // Recorded first on the compute queue if the compute is async
 };
 
@@ -75,9 +75,11 @@ void MeshObject::Scale(glm::vec3 scale)
 
 void MeshObject::ApplyModelTransformation()
 {
+	_model = _translation * _rotation * _scale;
+
 	MVP mvp
 	{
-		._model = _translation * _rotation * _scale
+		._model = _model
 	};
 
 	auto copyOffset = 0;
@@ -87,7 +89,7 @@ void MeshObject::ApplyModelTransformation()
 		mvpBuffer->CopyFrom(&mvp, copyOffset, copySize);
 	}
 
-	UpdateWorldTriangles(mvp._model);
+	_onTransformChanged.Invoke(*this);
 }
 
 void MeshObject::SetCameraTransformation(const glm::mat4 &view, const glm::mat4 &projection)
@@ -105,26 +107,3 @@ void MeshObject::SetCameraTransformation(const glm::mat4 &view, const glm::mat4
 		mvpBuffer->CopyFrom(&mvp, copyOffset, copySize);
 	}
 }
-
-void MeshObject::UpdateWorldTriangles(const glm::mat4 &model)
-{
-	size_t triangleCount = _triangles->size();
-	_worldTriangles.resize(triangleCount);
-
-	auto modelInverse = glm::inverse(model);
-
-	#pragma omp parallel for
-	for (size_t i = 0; i < triangleCount; ++i)
-	{
-		const auto &triangle = _triangles->at(i);
-		auto &worldTriangle = _worldTriangles[i];
-
-		worldTriangle.A = model * triangle.A;
-		worldTriangle.B = model * triangle.B;
-		worldTriangle.C = model * triangle.C;
-
-		worldTriangle.normalA = triangle.normalA * modelInverse;
-		worldTriangle.normalB = triangle.normalB * modelInverse;
-		worldTriangle.normalC = triangle.normalC * modelInverse;
-	}
-}
@@ -40,10 +40,13 @@ private:
 	glm::mat4 _translation = glm::mat4(1.0f);
 	glm::mat4 _rotation = glm::mat4(1.0f);
 	glm::mat4 _scale = glm::mat4(1.0f);
+	glm::mat4 _model = glm::mat4(1.0f);
 
 	// ==================== Triangle ====================
-	std::shared_ptr<std::vector<Triangle>> _triangles; // Triangles in the model space
-	std::vector<Triangle> _worldTriangles; // Triangles in the world space
+	std::shared_ptr<std::vector<Triangle>> _triangles; // Triangles in the model space, shared by all objects of the same model
+
+	// ==================== Events ====================
+	Delegate<void(const MeshObject &)> _onTransformChanged;
 
 public:
 	explicit MeshObject(const std::shared_ptr<std::vector<Triangle>> &triangles);
@@ -58,12 +61,13 @@ public:
 	std::vector<Buffer> GetMVPBuffers();
 	void CleanUp();
 
-	const std::vector<Triangle> &GetWorldTriangles() const { return _worldTriangles; }
+	const auto &GetTriangles() const { return _triangles; }
+	const glm::mat4 &GetModelMatrix() const { return _model; }
 
 	void SetVisible(bool visible) { _isVisible = visible; }
-	bool IsVisible() { return _isVisible; }
+	bool IsVisible() const { return _isVisible; }
 	void SetCollidable(bool collidable) { _isCollidable = collidable; }
-	bool IsCollidable() { return _isCollidable; }
+	bool IsCollidable() const { return _isCollidable; }
 
 	void SetPosition(glm::vec3 position);
 	void SetRotation(glm::vec3 rotation);
@@ -73,8 +77,9 @@ public:
 	void Rotate(glm::vec3 axis, float angle);
 	void Scale(glm::vec3 scale);
 
+	auto &OnTransformChanged() { return _onTransformChanged; }
+
 private:
 	void ApplyModelTransformation();
 	void SetCameraTransformation(const glm::mat4 &view, const glm::mat4 &projection);
-	void UpdateWorldTriangles(const glm::mat4 &model);
 };
\ No newline at end of file
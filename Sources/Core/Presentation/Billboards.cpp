@@ -1,6 +1,6 @@
 #include "Billboards.h"
 
-Billboards::Billboards(const std::vector<Buffer> &inputBuffers, size_t particleCount)
+Billboards::Billboards(const std::vector<Buffer> &inputBuffers, size_t particleCount, const std::vector<Buffer> &particleDispatchBuffers)
 {
 	_particleCount = particleCount;
 
@@ -41,7 +41,7 @@ Billboards::Billboards(const std::vector<Buffer> &inputBuffers, size_t particleC
 	_indexBuffer->CopyFrom(_billboardIndices.data());
 	VkDrawIndexedIndirectCommand drawCommands
 	{
-		.indexCount = static_cast<uint32_t>(_billboardIndices.size()),
+		.indexCount = 0, // Will be set by the compute to the drawn particles
 		.instanceCount = 1,
 		.firstIndex = 0,
 		.vertexOffset = 0,
@@ -50,7 +50,7 @@ Billboards::Billboards(const std::vector<Buffer> &inputBuffers, size_t particleC
 	_drawArgumentBuffer->CopyFrom(&drawCommands);
 
 	// Cmpute
-	_compute = BillboardsCompute::Instantiate<BillboardsCompute>(inputBuffers, _particleCount, _vertexBuffer);
+	_compute = BillboardsCompute::Instantiate<BillboardsCompute>(inputBuffers, particleDispatchBuffers, _vertexBuffer, _drawArgumentBuffer);
 
 	// Presentation mesh
 	_meshModel = MeshModel::Instantiate<MeshModel>();
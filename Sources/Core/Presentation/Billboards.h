@@ -7,7 +7,7 @@
 class Billboards
 {
 private:
-	size_t _particleCount = 0;
+	size_t _particleCount = 0; // Capacity of the buffers
 
 	std::shared_ptr<BillboardsCompute> _compute = nullptr;
 
@@ -27,7 +27,7 @@ private:
 	const std::vector<uint32_t> INDICES_IN_PARTICLE{ 0, 1, 2, 0, 2, 3 };
 
 public:
-	Billboards(const std::vector<Buffer> &inputBuffers, size_t particleCount);
+	Billboards(const std::vector<Buffer> &inputBuffers, size_t particleCount, const std::vector<Buffer> &particleDispatchBuffers); // The compute draws the first particles of the input buffers, as many as the dispatch of the frame holds
 
 	void SetEnable(bool enable);
 
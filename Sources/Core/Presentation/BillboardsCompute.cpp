@@ -1,16 +1,11 @@
 #include "BillboardsCompute.h"
 
-BillboardsCompute::BillboardsCompute(const std::vector<Buffer> &inputBuffers, size_t particleCount, const Buffer &vertexOutputBuffer) :
-	_particlePositionInputBuffers(inputBuffers),
-	_particleCount(static_cast<uint32_t>(particleCount))
+BillboardsCompute::BillboardsCompute(const std::vector<Buffer> &inputBuffers, const std::vector<Buffer> &particleDispatchBuffers, const Buffer &vertexOutputBuffer, const Buffer &drawArgumentBuffer) :
+	_particleDispatchBuffers(particleDispatchBuffers),
+	_particlePositionInputBuffers(inputBuffers)
 {
-	Memory memory = CreateMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	_particleCountBuffer = CreateBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
-	memory->Bind({ _particleCountBuffer });
-	_particleCountBuffer->CopyFrom(&_particleCount, 0);
-
 	Shader computeShader = ShaderManager::Get()->GetShaderAsset("BillboardsPopulating");
-	_populatingDescriptor = CreateDescriptors(computeShader, particleCount, _particleCountBuffer, _particlePositionInputBuffers, vertexOutputBuffer);
+	_populatingDescriptor = CreateDescriptors(computeShader, _particleDispatchBuffers, _particlePositionInputBuffers, vertexOutputBuffer, drawArgumentBuffer);
 	_populatingPipeline = CreateComputePipeline(computeShader->GetShaderModule(), _populatingDescriptor->GetDescriptorSetLayout());
 }
 
@@ -23,16 +18,17 @@ void BillboardsCompute::RecordCommand(VkCommandBuffer computeCommandBuffer, size
 {
 	vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _populatingPipeline->GetPipeline());
 	vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _populatingPipeline->GetPipelineLayout(), 0, 1, &_populatingDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
-	vkCmdDispatch(computeCommandBuffer, DivisionCeil(_particleCount, 1024), 1, 1);
+	vkCmdDispatchIndirect(computeCommandBuffer, _particleDispatchBuffers[currentFrame]->GetBufferHandle(), 0);
 }
 
-Descriptor BillboardsCompute::CreateDescriptors(const Shader &shader, size_t particleCount, const Buffer &particleCountBuffer, const std::vector<Buffer> &particlePositionBuffers, const Buffer &vertexOutputBuffer)
+Descriptor BillboardsCompute::CreateDescriptors(const Shader &shader, const std::vector<Buffer> &particleDispatchBuffers, const std::vector<Buffer> &particlePositionBuffers, const Buffer &vertexOutputBuffer, const Buffer &drawArgumentBuffer)
 {
 	auto descriptor = CreateDescriptor(shader);
 
-	descriptor->BindBuffer("particleCount", particleCountBuffer);
-	descriptor->BindBuffer("positions", particlePositionBuffers[0]);
+	descriptor->BindBuffers("particleDispatch", particleDispatchBuffers);
+	descriptor->BindBuffers("positions", particlePositionBuffers);
 	descriptor->BindBuffer("vertices", vertexOutputBuffer);
+	descriptor->BindBuffer("drawArguments", drawArgumentBuffer);
 
 	auto descriptorSetLayout = descriptor->GetDescriptorSetLayout();
 	auto descriptorSets = descriptor->GetDescriptorSets();
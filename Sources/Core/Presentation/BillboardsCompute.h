@@ -9,16 +9,14 @@
 class BillboardsCompute : public ComputeBase
 {
 private:
-	uint32_t _particleCount = 0;
-
-	Buffer _particleCountBuffer{};
+	std::vector<Buffer> _particleDispatchBuffers; // Owned by the scene; hold the count of the particles to draw in each frame
 	std::vector<Buffer> _particlePositionInputBuffers;
 
 	Descriptor _populatingDescriptor = nullptr;
 	Pipeline _populatingPipeline = nullptr;
 
 public:
-	BillboardsCompute(const std::vector<Buffer> &inputBuffers, size_t particleCount, const Buffer &vertexOutputBuffer);
+	BillboardsCompute(const std::vector<Buffer> &inputBuffers, const std::vector<Buffer> &particleDispatchBuffers, const Buffer &vertexOutputBuffer, const Buffer &drawArgumentBuffer);
 	virtual ~BillboardsCompute();
 
 	const auto &GetParticlePositionBuffers() { return _particlePositionInputBuffers; }
@@ -27,6 +25,5 @@ protected:
 	virtual void RecordCommand(VkCommandBuffer computeCommandBuffer, size_t currentFrame) override;
 
 private:
-	Descriptor CreateDescriptors(const Shader &shader, size_t particleCount, const Buffer &particleCountBuffer, const std::vector<Buffer> &particlePositionBuffers, const Buffer &vertexOutputBuffer);
+	Descriptor CreateDescriptors(const Shader &shader, const std::vector<Buffer> &particleDispatchBuffers, const std::vector<Buffer> &particlePositionBuffers, const Buffer &vertexOutputBuffer, const Buffer &drawArgumentBuffer);
 };
-
@@ -1,8 +1,8 @@
 #include "MarchingCubes.h"
 
-MarchingCubes::MarchingCubes(const std::vector<Buffer> &inputBuffers, size_t particleCount, const MarchingCubesGrid &marchingCubesGrid)
+MarchingCubes::MarchingCubes(const std::vector<Buffer> &inputBuffers, const std::vector<Buffer> &particleDispatchBuffers, const MarchingCubesGrid &marchingCubesGrid)
 {
-	_compute = MarchingCubesCompute::Instantiate<MarchingCubesCompute>(inputBuffers, particleCount, marchingCubesGrid);
+	_compute = MarchingCubesCompute::Instantiate<MarchingCubesCompute>(inputBuffers, particleDispatchBuffers, marchingCubesGrid);
 
 	_meshModel = MeshModel::Instantiate<MeshModel>();
 	_meshModel->LoadMesh(_compute->GetVertexBuffer(), _compute->GetIndexBuffer(), _compute->GetDrawArgumentBuffer());
@@ -12,7 +12,7 @@ private:
 	std::shared_ptr<MeshObject> _meshObject = nullptr;
 
 public:
-	MarchingCubes(const std::vector<Buffer> &inputBuffers, size_t particleCount, const MarchingCubesGrid &marchingCubesGrid);
+	MarchingCubes(const std::vector<Buffer> &inputBuffers, const std::vector<Buffer> &particleDispatchBuffers, const MarchingCubesGrid &marchingCubesGrid);
 
 	void SetEnable(bool enable);
 	MarchingCubesCompute *GetCompute() { return _compute.get(); }
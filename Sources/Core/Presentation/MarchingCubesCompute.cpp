@@ -1,11 +1,10 @@
 #include "MarchingCubesCompute.h"
 #include "VulkanCore.h"
 
-MarchingCubesCompute::MarchingCubesCompute(const std::vector<Buffer> &inputBuffers, size_t particleCount, const MarchingCubesGrid &marchingCubesGrid) :
-	_particlePositionInputBuffers(inputBuffers)
+MarchingCubesCompute::MarchingCubesCompute(const std::vector<Buffer> &inputBuffers, const std::vector<Buffer> &particleDispatchBuffers, const MarchingCubesGrid &marchingCubesGrid) :
+	_particlePositionInputBuffers(inputBuffers),
+	_particleDispatchBuffers(particleDispatchBuffers)
 {
-	_particleProperty->_particleCount = static_cast<uint32_t>(particleCount); // Will be used for range check in the shader
-
 	// Create and populate buffers
 	CreateSetupBuffers();
 	InitializationGrid(marchingCubesGrid);
@@ -49,7 +48,7 @@ void MarchingCubesCompute::RecordCommand(VkCommandBuffer computeCommandBuffer, s
 	// 2. Accumulate particle kernel values into voxels
 	vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _accumulationPipeline->GetPipeline());
 	vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _accumulationPipeline->GetPipelineLayout(), 0, 1, &_accumulationDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
-	vkCmdDispatch(computeCommandBuffer, DivisionCeil(_particleProperty->_particleCount, 1024), 1, 1);
+	vkCmdDispatchIndirect(computeCommandBuffer, _particleDispatchBuffers[currentFrame]->GetBufferHandle(), 0);
 
 	// Synchronization - construction commences only after the accumulation finishes
 	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
@@ -106,9 +105,10 @@ Descriptor MarchingCubesCompute::CreateAccumulationDescriptors(const Shader &sha
 {
 	auto descriptor = CreateDescriptor(shader);
 
+	descriptor->BindBuffers("particleDispatch", _particleDispatchBuffers);
 	descriptor->BindBuffer("particleProperty", _particlePropertyBuffer);
 	descriptor->BindBuffer("setup", _setupBuffer);
-	descriptor->BindBuffer("positions", _particlePositionInputBuffers[0]);
+	descriptor->BindBuffers("positions", _particlePositionInputBuffers);
 	descriptor->BindBuffer("voxelDensities", _voxelBuffer);
 
 	return descriptor;
@@ -130,8 +130,6 @@ Descriptor MarchingCubesCompute::CreateConstructionDescriptors(const Shader &sha
 
 void MarchingCubesCompute::UpdateParticleProperty(const SimulationParameters &simulationParameters)
 {
-	// Particle count is not updatable once an object is instantiated.
-
 	float kernelRadius = simulationParameters._particleRadius * simulationParameters._kernelRadiusFactor;
 	_particleProperty->_r1 = kernelRadius;
 	_particleProperty->_r2 = kernelRadius * kernelRadius;
@@ -30,7 +30,6 @@ class MarchingCubesCompute : public ComputeBase
 private:
 	struct ParticleProperty
 	{
-		alignas(4) uint32_t _particleCount = 0;
 		alignas(4) float _r1 = 0.0f;
 		alignas(4) float _r2 = 0.0f;
 		alignas(4) float _r3 = 0.0f;
@@ -64,6 +63,7 @@ private:
 
 	// Mesh construction buffers
 	std::vector<Buffer> _particlePositionInputBuffers;
+	std::vector<Buffer> _particleDispatchBuffers; // Owned by the scene; hold the count of the particles to accumulate in each frame
 	Buffer _indexTableBuffer = nullptr;
 	Buffer _voxelBuffer = nullptr;
 	Buffer _indexBuffer = nullptr;
@@ -86,7 +86,7 @@ private:
 	static const std::vector<uint32_t> INDICES_TABLE;
 
 public:
-	MarchingCubesCompute(const std::vector<Buffer> &inputBuffers, size_t particleCount, const MarchingCubesGrid &marchingCubesGrid);
+	MarchingCubesCompute(const std::vector<Buffer> &inputBuffers, const std::vector<Buffer> &particleDispatchBuffers, const MarchingCubesGrid &marchingCubesGrid);
 	virtual ~MarchingCubesCompute();
 
 	void UpdateParticleProperty(const SimulationParameters &simulationParameters);
@@ -0,0 +1,103 @@
+#include "ActivityGrid.h"
+
+#include <cmath>
+#include <algorithm>
+
+void ActivityGrid::Update(const HashGrid &hashGrid, std::span<glm::vec3> velocities, std::span<const float> densities, size_t particleCount, const SimulationParameters &simulationParameters)
+{
+	const auto &buckets = hashGrid.GetBuckets();
+	size_t bucketCount = buckets.size();
+	if (_quietSteps.size() != bucketCount)
+	{
+		_activeBuckets.assign(bucketCount, 0);
+		_quietSteps.assign(bucketCount, 0);
+	}
+
+	// Particles that have just been added start awake
+	if (_sleepingParticles.size() != particleCount)
+	{
+		_sleepingParticles.resize(particleCount, 0);
+		_restDensities.resize(particleCount, 0.0f);
+	}
+
+	float energyThreshold = simulationParameters._sleepEnergyThreshold;
+	float densityThreshold = simulationParameters._sleepDensityThreshold * simulationParameters._targetDensity;
+	uint32_t sleepSteps = std::max(simulationParameters._sleepSteps, 1u);
+
+	// 1. Activity of each bucket
+	#pragma omp parallel for
+	for (size_t bucketIndex = 0; bucketIndex < bucketCount; ++bucketIndex)
+	{
+		uint8_t isActive = 0;
+		for (uint32_t particleIndex : buckets[bucketIndex])
+		{
+			if (particleIndex >= particleCount) continue;
+
+			float energy = 0.5f * glm::dot(velocities[particleIndex], velocities[particleIndex]);
+			float densityDrift = std::abs(densities[particleIndex] - _restDensities[particleIndex]);
+			if (energy > energyThreshold || densityDrift > densityThreshold)
+			{
+				isActive = 1;
+				break;
+			}
+		}
+
+		_activeBuckets[bucketIndex] = isActive;
+	}
+
+	// 2. Buckets count their quiet steps while neither they nor their neighbors are active
+	#pragma omp parallel for
+	for (size_t bucketIndex = 0; bucketIndex < bucketCount; ++bucketIndex)
+	{
+		const auto &bucket = buckets[bucketIndex];
+		if (bucket.empty() || IsDisturbed(hashGrid, bucket)) _quietSteps[bucketIndex] = 0;
+		else _quietSteps[bucketIndex] = std::min(_quietSteps[bucketIndex] + 1, sleepSteps);
+	}
+
+	// 3. Particles follow their buckets
+	size_t sleepingCount = 0;
+	#pragma omp parallel for reduction(+:sleepingCount)
+	for (size_t particleIndex = 0; particleIndex < particleCount; ++particleIndex)
+	{
+		size_t key = hashGrid.GetBucketKey(hashGrid.GetParticleCell(particleIndex));
+		bool isSleeping = (_quietSteps[key] >= sleepSteps);
+
+		if (isSleeping && !_sleepingParticles[particleIndex]) velocities[particleIndex] = glm::vec3{}; // Settle
+		if (!isSleeping) _restDensities[particleIndex] = densities[particleIndex];
+
+		_sleepingParticles[particleIndex] = isSleeping ? 1 : 0;
+		if (isSleeping) ++sleepingCount;
+	}
+
+	_sleepingCount = sleepingCount;
+}
+
+void ActivityGrid::WakeAll()
+{
+	std::fill(_quietSteps.begin(), _quietSteps.end(), 0);
+	std::fill(_sleepingParticles.begin(), _sleepingParticles.end(), 0);
+	_sleepingCount = 0;
+}
+
+// Whether any bucket around the cells of the particles in the bucket is active; cells that share the bucket are all checked
+bool ActivityGrid::IsDisturbed(const HashGrid &hashGrid, const std::vector<uint32_t> &bucket) const
+{
+	for (size_t order = 0; order < bucket.size(); ++order)
+	{
+		glm::ivec3 cell = hashGrid.GetParticleCell(bucket[order]);
+		if (order > 0 && cell == hashGrid.GetParticleCell(bucket[order - 1])) continue;
+
+		for (int z = -1; z <= 1; ++z)
+		{
+			for (int y = -1; y <= 1; ++y)
+			{
+				for (int x = -1; x <= 1; ++x)
+				{
+					if (_activeBuckets[hashGrid.GetBucketKey(cell + glm::ivec3(x, y, z))]) return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
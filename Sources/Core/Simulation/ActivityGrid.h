@@ -0,0 +1,40 @@
+#pragma once
+
+#include <omp.h>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+#include "HashGrid.h"
+#include "SimulationParameters.h"
+
+// Tracks the regions of the fluid that have come to rest, so that their particles can be left out of the step.
+// Activity is measured over the buckets of the hash grid: a bucket is active while any of its particles has more kinetic energy per unit mass than a threshold,
+// or a density that has drifted by more than a threshold from where it was at the last step the particle was awake.
+// A bucket falls asleep after it and its neighbors have been inactive for a number of steps, and wakes as soon as it or any neighbor becomes active.
+// Sleeping particles are frozen but stay in the neighbor search, so they keep lending their densities and pressures to the awake particles around them.
+class ActivityGrid
+{
+private:
+	std::vector<uint8_t> _activeBuckets;
+	std::vector<uint32_t> _quietSteps; // Steps that each bucket and its neighbors have been inactive for
+	std::vector<uint8_t> _sleepingParticles;
+	std::vector<float> _restDensities; // Density of each particle at the last step it was awake
+	size_t _sleepingCount = 0;
+
+public:
+	// Put particles to sleep or wake them from the velocities and densities of this step; the velocities of particles that fall asleep are cleared
+	void Update(const HashGrid &hashGrid, std::span<glm::vec3> velocities, std::span<const float> densities, size_t particleCount, const SimulationParameters &simulationParameters);
+	void WakeAll();
+
+	bool IsSleeping(size_t particleIndex) const { return _sleepingCount > 0 && particleIndex < _sleepingParticles.size() && _sleepingParticles[particleIndex] != 0; }
+	size_t GetSleepingCount() const { return _sleepingCount; }
+
+private:
+	bool IsDisturbed(const HashGrid &hashGrid, const std::vector<uint32_t> &bucket) const;
+};
@@ -9,6 +9,8 @@ void BVH::AddPropObject(const std::shared_ptr<MeshObject> &propObject)
 
 bool BVH::GetIntersection(glm::vec3 currentPosition, glm::vec3 nextPosition, Intersection *intersection)
 {
+	if (_nodes.empty()) return false;
+
 	bool isHit = false;
 	float minDistance = std::numeric_limits<float>::infinity();
 
@@ -19,8 +21,8 @@ bool BVH::GetIntersection(glm::vec3 currentPosition, glm::vec3 nextPosition, Int
 		uint32_t nodeIndex = nodeStack.top();
 		nodeStack.pop();
 
-		auto node = _nodes[nodeIndex];
-		if (!IsLeafNode(nodeIndex))
+		const auto &node = _nodes[nodeIndex];
+		if (!IsLeafNode(node))
 		{
 			uint32_t child1 = node._child1;
 			if (RayBoxIntersection(_nodes[child1]._boundingBox, currentPosition, nextPosition)) nodeStack.push(child1);
@@ -30,14 +32,23 @@ bool BVH::GetIntersection(glm::vec3 currentPosition, glm::vec3 nextPosition, Int
 		}
 		else
 		{
-			Intersection triangleIntersection{};
-			if (MollerTrumbore(node._boundingBox._triangle, currentPosition, nextPosition, &triangleIntersection))
+			// Bring the ray into the model space of the instance instead of bringing the mesh into the world space.
+			const auto &instance = _instances[node._primitive];
+			glm::vec3 modelStart = instance._worldToModel * glm::vec4(currentPosition, 1.0f);
+			glm::vec3 modelEnd = instance._worldToModel * glm::vec4(nextPosition, 1.0f);
+
+			Intersection meshIntersection{};
+			if (GetMeshIntersection(instance._rootNode, modelStart, modelEnd, &meshIntersection))
 			{
-				float distance = glm::distance(currentPosition, triangleIntersection._point);
+				meshIntersection._point = instance._modelToWorld * glm::vec4(meshIntersection._point, 1.0f);
+				meshIntersection._normal = glm::normalize(glm::vec3(glm::vec4(meshIntersection._normal, 0.0f) * instance._worldToModel));
+				meshIntersection._pointVelocity = instance._velocityTransform * glm::vec4(meshIntersection._point, 1.0f);
+
+				float distance = glm::distance(currentPosition, meshIntersection._point);
 				if (distance < minDistance)
 				{
 					minDistance = distance;
-					*intersection = std::move(triangleIntersection);
+					*intersection = std::move(meshIntersection);
 					isHit = true;
 				}
 			}
@@ -47,212 +58,628 @@ bool BVH::GetIntersection(glm::vec3 currentPosition, glm::vec3 nextPosition, Int
 	return isHit;
 }
 
-// Top-down BVH tree construction with the surface area heuristic (SAH) cost.
-bool BVH::Construct()
+// Batched version of GetIntersection for up to PACKET_SIZE segments.
+// The segments are traversed together as a packet, which pays off when they are close to each other.
+// Returns a bit mask of the segments that hit any surface, whose intersections are written at the same lanes.
+uint32_t BVH::GetIntersections(const glm::vec3 *currentPositions, const glm::vec3 *nextPositions, uint32_t count, Intersection *intersections)
 {
-	// Calculate bounding boxes for all triangles
-	std::vector<AABB> boundingBoxes;
-	std::unordered_set<glm::vec3> centroidSet;
-	for (const auto &propObject : _propObjects)
+	if (_nodes.empty()) return 0;
+
+	uint32_t hitMask = 0;
+	if (_levelNodes.size() >= TRAVERSAL_STACK_SIZE || _meshMaxLevel >= TRAVERSAL_STACK_SIZE)
 	{
-		if (propObject->IsCollidable())
+		for (uint32_t lane = 0; lane < count; ++lane)
 		{
-			const auto &worldTriangles = propObject->GetWorldTriangles();
-			for (const auto &triangle : worldTriangles)
-			{
-				// There should be no two bounding boxes with the same centroid.
-				AABB boundingBox = TriangleToAABB(triangle);
-				while (centroidSet.contains(Centroid(boundingBox)))
-				{
-					boundingBox._upperBound += OFFSET;
-				}
-				centroidSet.insert(Centroid(boundingBox));
-				boundingBoxes.push_back(std::move(boundingBox));
-			}
+			if (GetIntersection(currentPositions[lane], nextPositions[lane], &intersections[lane])) hitMask |= 1u << lane;
 		}
-	}
 
-	// Handle an edge case
-	if (boundingBoxes.empty())
-	{
-		return false;
+		return hitMask;
 	}
 
-	// Initialize the root range
-	AABB rootBB{};
-	uint32_t count = 0;
-	for (uint32_t i = 0; i < boundingBoxes.size(); ++i)
+	// Inactive lanes get a negative tMax so that they never hit anything.
+	Packet packet{};
+	packet._tMax.fill(-1.0f);
+	for (uint32_t lane = 0; lane < count; ++lane)
 	{
-		rootBB = Union(rootBB, boundingBoxes[i]);
+		glm::vec3 direction = nextPositions[lane] - currentPositions[lane];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			packet._origins[axis][lane] = currentPositions[lane][axis];
+			packet._directions[axis][lane] = direction[axis];
+			packet._inverseDirections[axis][lane] = 1.0f / direction[axis];
+		}
+		packet._tMax[lane] = 1.0f;
 	}
 
-	Range rootRange
+	// Each entry holds a node and the lanes that reached it.
+	// Boxes are tested when popped rather than when pushed so that hits found in the meantime can cull them.
+	std::array<std::pair<uint32_t, uint32_t>, TRAVERSAL_STACK_SIZE> nodeStack;
+	uint32_t stackSize = 0;
+	nodeStack[stackSize++] = { 0, (1u << count) - 1u };
+	while (stackSize > 0)
 	{
-		._start = 0,
-		._end = static_cast<uint32_t>(boundingBoxes.size()),
-		._parentIndex = NONE,
-		._boundingBox = rootBB
-	};
+		auto [nodeIndex, laneMask] = nodeStack[--stackSize];
 
-	// Contruct a hierarchy
-	std::stack<Range> ranges;
-	ranges.push(std::move(rootRange));
-	while (!ranges.empty())
-	{
-		Range range = ranges.top();
-		ranges.pop();
+		const auto &node = _nodes[nodeIndex];
+		laneMask = PacketBoxIntersection(node._boundingBox, packet, laneMask);
+		if (laneMask == 0) continue;
 
-		// If the range spans to only one element, this one becomes the leaf node.
-		if (range._end - range._start == 1)
+		if (!IsLeafNode(node))
 		{
-			uint32_t newLevel = range._parentIndex == NONE ? 1 : _nodes[range._parentIndex]._level + 1;
-			Node leafNode
-			{
-				._boundingBox = boundingBoxes[range._start],
-				._level = newLevel,
-				._parent = range._parentIndex
-			};
+			nodeStack[stackSize++] = { node._child2, laneMask };
+			nodeStack[stackSize++] = { node._child1, laneMask };
+		}
+		else
+		{
+			// The ray parameter is preserved by affine transforms, so closest hits can be compared across instances by tMax.
+			const auto &instance = _instances[node._primitive];
+			Packet modelPacket = TransformPacket(packet, instance._worldToModel, laneMask);
+			hitMask |= GetPacketMeshIntersections(instance, modelPacket, laneMask, intersections);
+			packet._tMax = modelPacket._tMax;
+		}
+	}
+
+	return hitMask;
+}
+
+// Packet traversal of a bottom-level tree whose packet is already in the model space of the instance
+uint32_t BVH::GetPacketMeshIntersections(const Instance &instance, Packet &packet, uint32_t activeMask, Intersection *intersections)
+{
+	uint32_t hitMask = 0;
+
+	std::array<std::pair<uint32_t, uint32_t>, TRAVERSAL_STACK_SIZE> nodeStack;
+	uint32_t stackSize = 0;
+	nodeStack[stackSize++] = { instance._rootNode, activeMask };
+	while (stackSize > 0)
+	{
+		auto [nodeIndex, laneMask] = nodeStack[--stackSize];
 
-			_nodes.push_back(std::move(leafNode));
+		const auto &node = _meshNodes[nodeIndex];
+		laneMask = PacketBoxIntersection(node._boundingBox, packet, laneMask);
+		if (laneMask == 0) continue;
 
-			uint32_t newNodeIndex = static_cast<uint32_t>(_nodes.size() - 1);
-			if (_nodes[range._parentIndex]._child1 == NONE)
+		if (IsLeafNode(node))
+		{
+			for (uint32_t lanes = laneMask; lanes != 0; lanes &= lanes - 1)
 			{
-				_nodes[range._parentIndex]._child1 = newNodeIndex;
+				uint32_t lane = std::countr_zero(lanes);
+				if (GetLaneTriangleIntersection(node, instance, packet, lane, intersections)) hitMask |= 1u << lane;
 			}
-			else
+		}
+		else if (std::popcount(laneMask) <= DIVERGENCE_THRESHOLD)
+		{
+			// The packet has diverged; testing boxes for the whole packet would waste most of the lanes.
+			for (uint32_t lanes = laneMask; lanes != 0; lanes &= lanes - 1)
 			{
-				_nodes[range._parentIndex]._child2 = newNodeIndex;
+				uint32_t lane = std::countr_zero(lanes);
+				if (GetLaneMeshIntersection(nodeIndex, instance, packet, lane, intersections)) hitMask |= 1u << lane;
 			}
-
-			continue;
 		}
+		else
+		{
+			nodeStack[stackSize++] = { node._child2, laneMask };
+			nodeStack[stackSize++] = { node._child1, laneMask };
+		}
+	}
 
-		// Find the axis with the largest centroid stretch.
-		AABB boundingBox = range._boundingBox;
-		auto [targetAxis, minCentroid, maxCentroid] = GetTargetAxisAndMinMaxCentroid(boundingBoxes, range._start, range._end);
+	return hitMask;
+}
 
-		// Decide a splitting plane that minimizes the SAH cost
-		// We have to classify elements into buckets.
-		static const uint32_t BUCKET_COUNT = 16;
-		std::vector<Bucket> buckets(BUCKET_COUNT, Bucket{});
-		float bucketInterval = (maxCentroid[targetAxis] - minCentroid[targetAxis]) / BUCKET_COUNT;
-		for (uint32_t i = range._start; i < range._end; ++i)
-		{
-			float offsetFromStart = Centroid(boundingBoxes[i])[targetAxis] - minCentroid[targetAxis];
-			uint32_t bucketIndex = static_cast<uint32_t>(offsetFromStart / bucketInterval);
-			if (bucketIndex == BUCKET_COUNT) --bucketIndex;
+// Single-ray traversal of the subtree rooted at rootIndex for one lane of a packet
+bool BVH::GetLaneMeshIntersection(uint32_t rootIndex, const Instance &instance, Packet &packet, uint32_t lane, Intersection *intersections)
+{
+	bool isHit = false;
 
-			++buckets[bucketIndex]._count;
-			buckets[bucketIndex]._bound = Union(buckets[bucketIndex]._bound, boundingBoxes[i]);
-		}
+	glm::vec3 origin(packet._origins[0][lane], packet._origins[1][lane], packet._origins[2][lane]);
+	glm::vec3 inverseDirection(packet._inverseDirections[0][lane], packet._inverseDirections[1][lane], packet._inverseDirections[2][lane]);
 
-		// Estimate costs for splitting into two groups
-		std::vector<float> costs(BUCKET_COUNT - 1);
-		std::vector<AABB> leftBBs(BUCKET_COUNT - 1); // Bounding boxes for the left child range
-		std::vector<AABB> rightBBs(BUCKET_COUNT - 1); // Bounding boxes for the right child range
-		for (uint32_t i = 0; i < BUCKET_COUNT - 1; ++i)
+	std::array<uint32_t, TRAVERSAL_STACK_SIZE> nodeStack;
+	uint32_t stackSize = 0;
+	nodeStack[stackSize++] = rootIndex;
+	while (stackSize > 0)
+	{
+		const auto &node = _meshNodes[nodeStack[--stackSize]];
+
+		const AABB &boundingBox = node._boundingBox;
+		glm::vec3 t1 = (glm::vec3(boundingBox._lowerBound) - origin) * inverseDirection;
+		glm::vec3 t2 = (glm::vec3(boundingBox._upperBound) - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t1, t2);
+		glm::vec3 tFar = glm::max(t1, t2);
+		float tMin = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		float tMax = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, packet._tMax[lane]));
+		if (tMin > tMax) continue;
+
+		if (IsLeafNode(node))
 		{
-			AABB leftBB{};
-			uint32_t leftCount = 0;
-			for (uint32_t j = 0; j <= i; ++j)
-			{
-				leftBB = Union(leftBB, buckets[j]._bound);
-				leftCount += buckets[j]._count;
-			}
+			isHit |= GetLaneTriangleIntersection(node, instance, packet, lane, intersections);
+		}
+		else
+		{
+			nodeStack[stackSize++] = node._child2;
+			nodeStack[stackSize++] = node._child1;
+		}
+	}
 
-			AABB rightBB{};
-			uint32_t rightCount = 0;
-			for (uint32_t j = i + 1; j < BUCKET_COUNT; ++j)
-			{
-				rightBB = Union(rightBB, buckets[j]._bound);
-				rightCount += buckets[j]._count;
-			}
+	return isHit;
+}
+
+// Test the triangle of a leaf against one lane and record the hit in the world space if it is the closest so far
+bool BVH::GetLaneTriangleIntersection(const Node &leaf, const Instance &instance, Packet &packet, uint32_t lane, Intersection *intersections)
+{
+	glm::vec3 start(packet._origins[0][lane], packet._origins[1][lane], packet._origins[2][lane]);
+	glm::vec3 ray(packet._directions[0][lane], packet._directions[1][lane], packet._directions[2][lane]);
+
+	Intersection triangleIntersection{};
+	if (!MollerTrumbore(leaf._boundingBox._triangle, start, start + ray, &triangleIntersection)) return false;
+
+	float t = glm::dot(triangleIntersection._point - start, ray) / glm::dot(ray, ray);
+	if (t >= packet._tMax[lane]) return false;
+
+	packet._tMax[lane] = t;
+
+	Intersection &intersection = intersections[lane];
+	intersection._point = instance._modelToWorld * glm::vec4(triangleIntersection._point, 1.0f);
+	intersection._normal = glm::normalize(glm::vec3(glm::vec4(triangleIntersection._normal, 0.0f) * instance._worldToModel));
+	intersection._pointVelocity = instance._velocityTransform * glm::vec4(intersection._point, 1.0f);
+
+	return true;
+}
+
+// Slab test of all lanes at once with precomputed inverse directions
+// The loop has no branches so that the compiler can turn it into SIMD instructions.
+uint32_t BVH::PacketBoxIntersection(const AABB &boundingBox, const Packet &packet, uint32_t activeMask)
+{
+	std::array<float, PACKET_SIZE> tMins{};
+	std::array<float, PACKET_SIZE> tMaxs{};
+	for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane)
+	{
+		float tx1 = (boundingBox._lowerBound.x - packet._origins[0][lane]) * packet._inverseDirections[0][lane];
+		float tx2 = (boundingBox._upperBound.x - packet._origins[0][lane]) * packet._inverseDirections[0][lane];
+		float ty1 = (boundingBox._lowerBound.y - packet._origins[1][lane]) * packet._inverseDirections[1][lane];
+		float ty2 = (boundingBox._upperBound.y - packet._origins[1][lane]) * packet._inverseDirections[1][lane];
+		float tz1 = (boundingBox._lowerBound.z - packet._origins[2][lane]) * packet._inverseDirections[2][lane];
+		float tz2 = (boundingBox._upperBound.z - packet._origins[2][lane]) * packet._inverseDirections[2][lane];
+
+		tMins[lane] = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), 0.0f));
+		tMaxs[lane] = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), packet._tMax[lane]));
+	}
+
+	uint32_t hitMask = 0;
+	for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane)
+	{
+		hitMask |= static_cast<uint32_t>(tMins[lane] <= tMaxs[lane]) << lane;
+	}
 
-			costs[i] = (leftCount * SurfaceArea(leftBB) + rightCount * SurfaceArea(rightBB)) / SurfaceArea(boundingBoxes[i]);
-			leftBBs[i] = std::move(leftBB);
-			rightBBs[i] = std::move(rightBB);
+	return hitMask & activeMask;
+}
+
+auto BVH::TransformPacket(const Packet &packet, const glm::mat4 &transform, uint32_t activeMask) -> Packet
+{
+	Packet transformed = packet;
+	for (uint32_t lanes = activeMask; lanes != 0; lanes &= lanes - 1)
+	{
+		uint32_t lane = std::countr_zero(lanes);
+
+		glm::vec3 origin = transform * glm::vec4(packet._origins[0][lane], packet._origins[1][lane], packet._origins[2][lane], 1.0f);
+		glm::vec3 direction = transform * glm::vec4(packet._directions[0][lane], packet._directions[1][lane], packet._directions[2][lane], 0.0f);
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			transformed._origins[axis][lane] = origin[axis];
+			transformed._directions[axis][lane] = direction[axis];
+			transformed._inverseDirections[axis][lane] = 1.0f / direction[axis];
 		}
+	}
 
-		// Find the minimum estimated cost
-		float minCost = std::numeric_limits<float>::max();
-		uint32_t minCostSplitBucket = -1;
-		for (uint32_t i = 0; i < BUCKET_COUNT - 1; ++i)
+	return transformed;
+}
+
+// Find the closest intersection within the bottom-level tree rooted at rootIndex, in the model space
+bool BVH::GetMeshIntersection(uint32_t rootIndex, glm::vec3 start, glm::vec3 end, Intersection *intersection)
+{
+	bool isHit = false;
+	float minDistance = std::numeric_limits<float>::infinity();
+
+	std::stack<uint32_t> nodeStack;
+	if (RayBoxIntersection(_meshNodes[rootIndex]._boundingBox, start, end)) nodeStack.push(rootIndex);
+	while (!nodeStack.empty())
+	{
+		uint32_t nodeIndex = nodeStack.top();
+		nodeStack.pop();
+
+		const auto &node = _meshNodes[nodeIndex];
+		if (!IsLeafNode(node))
+		{
+			uint32_t child1 = node._child1;
+			if (RayBoxIntersection(_meshNodes[child1]._boundingBox, start, end)) nodeStack.push(child1);
+
+			uint32_t child2 = node._child2;
+			if (RayBoxIntersection(_meshNodes[child2]._boundingBox, start, end)) nodeStack.push(child2);
+		}
+		else
 		{
-			if (costs[i] < minCost)
+			Intersection triangleIntersection{};
+			if (MollerTrumbore(node._boundingBox._triangle, start, end, &triangleIntersection))
 			{
-				minCost = costs[i];
-				minCostSplitBucket = i;
+				float distance = glm::distance(start, triangleIntersection._point);
+				if (distance < minDistance)
+				{
+					minDistance = distance;
+					*intersection = std::move(triangleIntersection);
+					isHit = true;
+				}
 			}
 		}
+	}
 
-		// Partition the range into two groups
-		// Partition the bounding boxes by the selected bucket
-		auto separatorIter = std::partition
-		(
-			boundingBoxes.begin() + range._start, 
-			boundingBoxes.begin() + range._end, 
-			[this, targetAxis, minCentroid, bucketInterval, minCostSplitBucket](const AABB &a) 
-			{ 
-				return (static_cast<uint32_t>((Centroid(a)[targetAxis] - minCentroid[targetAxis]) / bucketInterval)) <= minCostSplitBucket;
-			}
-		); 
+	return isHit;
+}
 
-		// Create a new node and register
-		uint32_t newLevel = range._parentIndex == NONE ? 1 : _nodes[range._parentIndex]._level + 1;
-		Node newNode
-		{
-			._boundingBox = range._boundingBox,
-			._level = newLevel,
-			._parent = range._parentIndex,
-			// child1 and child2 will later be set by children.
-		};
+// The level is a two-level hierarchy.
+// Each unique mesh gets a bottom-level tree over its model-space triangles, which is shared by all props that use the mesh.
+// A top-level tree is then built over the collidable props, whose leaves refer to the bottom-level trees through their transforms.
+// Memory and build time therefore scale with the unique geometry rather than with the number of props.
+bool BVH::Construct()
+{
+	_meshRoots.clear();
+	_meshNodes.clear();
+	_meshMaxLevel = 0;
 
-		_nodes.push_back(std::move(newNode));
-		uint32_t newNodeIndex = static_cast<uint32_t>(_nodes.size() - 1);
-		if (range._parentIndex != NONE)
+	return ConstructInstances();
+}
+
+// Update the top-level tree to match the current transforms of the props while keeping its topology.
+// Bottom-level trees are in the model space, so they never have to be refitted.
+// Refitting degrades the tree as props move, so the tree is rebuilt once its SAH cost exceeds REBUILD_COST_RATIO times the cost right after construction.
+// The velocities of the props are measured from their transforms before and after elapsedSecond.
+// Returns true if the tree has been rebuilt, in which case the number of levels may have changed.
+bool BVH::Refit(float elapsedSecond)
+{
+	if (_nodes.empty() || GetCollidableProps() != _instanceProps)
+	{
+		ConstructInstances();
+		return true;
+	}
+
+	size_t instanceCount = _instances.size();
+
+	#pragma omp parallel for
+	for (int64_t instanceIndex = 0; instanceIndex < static_cast<int64_t>(instanceCount); ++instanceIndex)
+	{
+		Instance previousInstance = _instances[instanceIndex];
+		_instances[instanceIndex] = GetInstance(*_propObjects[_instanceProps[instanceIndex]], previousInstance._rootNode);
+		_instances[instanceIndex]._velocityTransform = GetVelocityTransform(previousInstance._worldToModel, _instances[instanceIndex]._modelToWorld, elapsedSecond);
+	}
+
+	// Nodes on the same level do not depend on each other
+	for (auto levelIter = _levelNodes.rbegin(); levelIter != _levelNodes.rend(); ++levelIter)
+	{
+		const auto &levelNodes = *levelIter;
+		size_t levelNodeCount = levelNodes.size();
+
+		#pragma omp parallel for
+		for (size_t i = 0; i < levelNodeCount; ++i)
 		{
-			if (_nodes[range._parentIndex]._child1 == NONE)
+			Node &node = _nodes[levelNodes[i]];
+			if (IsLeafNode(node))
 			{
-				_nodes[range._parentIndex]._child1 = newNodeIndex;
+				const auto &instance = _instances[node._primitive];
+				node._boundingBox = Transform(_meshNodes[instance._rootNode]._boundingBox, instance._modelToWorld);
 			}
 			else
 			{
-				_nodes[range._parentIndex]._child2 = newNodeIndex;
+				node._boundingBox = Union(_nodes[node._child1]._boundingBox, _nodes[node._child2]._boundingBox);
 			}
 		}
-		
-		// Set and push the child nodes
-		uint32_t childStart = range._start;
-		uint32_t separator = static_cast<uint32_t>(separatorIter - boundingBoxes.begin());
-		uint32_t childEnd = range._end;
+	}
 
-		Range childRange1
-		{
-			._start = childStart,
-			._end = separator,
-			._parentIndex = newNodeIndex,
-			._boundingBox = leftBBs[minCostSplitBucket]
-		};
+	if (GetSAHCost() > REBUILD_COST_RATIO * _constructedSAHCost)
+	{
+		// The props are the same and are instanced in the same order, so they keep their velocities
+		std::vector<glm::mat4> velocityTransforms(instanceCount);
+		for (size_t instanceIndex = 0; instanceIndex < instanceCount; ++instanceIndex) velocityTransforms[instanceIndex] = _instances[instanceIndex]._velocityTransform;
+
+		ConstructInstances();
+		for (size_t instanceIndex = 0; instanceIndex < instanceCount; ++instanceIndex) _instances[instanceIndex]._velocityTransform = velocityTransforms[instanceIndex];
+
+		return true;
+	}
+
+	return false;
+}
+
+// Expected number of top-level nodes visited by a random ray that hits the root, which is a quality measure independent of the scene scale
+float BVH::GetSAHCost()
+{
+	if (_nodes.empty()) return 0.0f;
+
+	float areaSum = 0.0f;
+	int64_t nodeCount = static_cast<int64_t>(_nodes.size());
+
+	#pragma omp parallel for reduction(+:areaSum)
+	for (int64_t nodeIndex = 0; nodeIndex < nodeCount; ++nodeIndex)
+	{
+		areaSum += SurfaceArea(_nodes[nodeIndex]._boundingBox);
+	}
+
+	return areaSum / SurfaceArea(_nodes[0]._boundingBox);
+}
+
+// Build the top-level tree over the collidable props.
+// Bottom-level trees are built only for meshes that have not been seen yet, so props that share a mesh cost a single instance each.
+bool BVH::ConstructInstances()
+{
+	_instances.clear();
+	_instanceProps.clear();
+	_nodes.clear();
+	_levelNodes.clear();
 
-		Range childRange2
+	for (uint32_t propIndex : GetCollidableProps())
+	{
+		const auto &propObject = _propObjects[propIndex];
+		const auto &triangles = propObject->GetTriangles();
+
+		auto meshIter = _meshRoots.find(triangles.get());
+		if (meshIter == _meshRoots.end())
 		{
-			._start = separator,
-			._end = childEnd,
-			._parentIndex = newNodeIndex,
-			._boundingBox = rightBBs[minCostSplitBucket]
-		};
+			meshIter = _meshRoots.emplace(triangles.get(), ConstructMesh(*triangles)).first;
+		}
+
+		_instances.push_back(GetInstance(*propObject, meshIter->second));
+		_instanceProps.push_back(propIndex);
+	}
+
+	// Handle an edge case
+	size_t instanceCount = _instances.size();
+	if (instanceCount == 0)
+	{
+		return false;
+	}
+
+	std::vector<AABB> boundingBoxes(instanceCount);
+	for (size_t i = 0; i < instanceCount; ++i)
+	{
+		boundingBoxes[i] = Transform(_meshNodes[_instances[i]._rootNode]._boundingBox, _instances[i]._modelToWorld);
+	}
 
-		ranges.push(childRange1);
-		ranges.push(childRange2);
+	_nodes.resize(2 * instanceCount - 1);
+	BuildTree(_nodes, 0, boundingBoxes);
+
+	// Group nodes by level for bottom-up refitting
+	for (uint32_t nodeIndex = 0; nodeIndex < _nodes.size(); ++nodeIndex)
+	{
+		uint32_t level = _nodes[nodeIndex]._level;
+		if (_levelNodes.size() < level) _levelNodes.resize(level);
+		_levelNodes[level - 1].push_back(nodeIndex);
 	}
 
+	_constructedSAHCost = GetSAHCost();
+
 	return true;
 }
 
-inline bool BVH::IsLeafNode(uint32_t nodeIndex)
+// Append the bottom-level tree of a mesh to the mesh nodes and return the index of its root
+uint32_t BVH::ConstructMesh(const std::vector<Triangle> &triangles)
+{
+	// Calculate bounding boxes for all triangles
+	size_t triangleCount = triangles.size();
+	std::vector<AABB> boundingBoxes(triangleCount);
+
+	#pragma omp parallel for
+	for (int64_t i = 0; i < static_cast<int64_t>(triangleCount); ++i)
+	{
+		boundingBoxes[i] = TriangleToAABB(triangles[i]);
+	}
+
+	uint32_t rootIndex = static_cast<uint32_t>(_meshNodes.size());
+	_meshNodes.resize(_meshNodes.size() + 2 * triangleCount - 1);
+	BuildTree(_meshNodes, rootIndex, boundingBoxes);
+
+	for (size_t nodeIndex = rootIndex; nodeIndex < _meshNodes.size(); ++nodeIndex)
+	{
+		_meshMaxLevel = std::max(_meshMaxLevel, _meshNodes[nodeIndex]._level);
+	}
+
+	return rootIndex;
+}
+
+auto BVH::GetInstance(const MeshObject &propObject, uint32_t rootNode) -> Instance
+{
+	const glm::mat4 &model = propObject.GetModelMatrix();
+
+	Instance instance
+	{
+		._worldToModel = glm::inverse(model),
+		._modelToWorld = model,
+		._rootNode = rootNode
+	};
+
+	return instance;
+}
+
+// Props that take part in collision, which are the ones with a non-empty collidable mesh
+std::vector<uint32_t> BVH::GetCollidableProps()
+{
+	std::vector<uint32_t> collidableProps;
+	for (uint32_t propIndex = 0; propIndex < _propObjects.size(); ++propIndex)
+	{
+		const auto &propObject = _propObjects[propIndex];
+		if (propObject->IsCollidable() && !propObject->GetTriangles()->empty())
+		{
+			collidableProps.push_back(propIndex);
+		}
+	}
+
+	return collidableProps;
+}
+
+// Top-down BVH tree construction with the surface area heuristic (SAH) cost.
+// A binary tree over n leaves always has 2n - 1 nodes, so every subtree owns a contiguous block of nodes in depth-first order starting at rootIndex.
+// This lets subtrees be built in parallel without any synchronization on the node array.
+void BVH::BuildTree(std::vector<Node> &nodes, uint32_t rootIndex, const std::vector<AABB> &boundingBoxes)
+{
+	// The build partitions primitive indices rather than the bounding boxes themselves so that swaps stay cheap.
+	uint32_t primitiveCount = static_cast<uint32_t>(boundingBoxes.size());
+	std::vector<uint32_t> primitives(primitiveCount);
+	std::iota(primitives.begin(), primitives.end(), 0);
+
+	BuildSubtree(nodes, boundingBoxes, primitives, 0, primitiveCount, rootIndex, NONE, 1);
+}
+
+void BVH::BuildSubtree(std::vector<Node> &nodes, const std::vector<AABB> &boundingBoxes, std::vector<uint32_t> &primitives, uint32_t start, uint32_t end, uint32_t nodeIndex, uint32_t parentIndex, uint32_t level)
 {
-	return _nodes[nodeIndex]._child1 == NONE;
+	Node &node = nodes[nodeIndex];
+	node._level = level;
+	node._parent = parentIndex;
+	node._child1 = NONE;
+	node._child2 = NONE;
+	node._primitive = NONE;
+
+	// If the range spans to only one element, this one becomes the leaf node.
+	uint32_t count = end - start;
+	if (count == 1)
+	{
+		node._boundingBox = boundingBoxes[primitives[start]];
+		node._primitive = primitives[start];
+		return;
+	}
+
+	// Find the axis with the largest centroid stretch.
+	auto [rangeBound, minCentroid, maxCentroid] = GetRangeBounds(boundingBoxes, primitives, start, end);
+	node._boundingBox = rangeBound;
+
+	glm::vec3 centroidStretch = maxCentroid - minCentroid;
+	uint32_t targetAxis = 0;
+	if (centroidStretch.y > centroidStretch[targetAxis]) targetAxis = 1;
+	if (centroidStretch.z > centroidStretch[targetAxis]) targetAxis = 2;
+
+	// Small ranges are not worth binning, and coincident centroids cannot be binned at all.
+	uint32_t separator = NONE;
+	if (count > MEDIAN_SPLIT_THRESHOLD && centroidStretch[targetAxis] > 0.0f)
+	{
+		separator = SplitBySAH(boundingBoxes, primitives, start, end, rangeBound, targetAxis, minCentroid[targetAxis], maxCentroid[targetAxis]);
+	}
+
+	if (separator == NONE)
+	{
+		separator = SplitByMedian(boundingBoxes, primitives, start, end, targetAxis);
+	}
+
+	// The left subtree over k leaves occupies the 2k - 1 nodes right after this node.
+	uint32_t child1 = nodeIndex + 1;
+	uint32_t child2 = nodeIndex + 2 * (separator - start);
+	node._child1 = child1;
+	node._child2 = child2;
+
+	// Each level that forks doubles the threads, so forking stops once there are as many as the hardware runs at once.
+	static const uint32_t parallelLevelCount = std::bit_width(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+	if (count > PARALLEL_BUILD_THRESHOLD && level <= parallelLevelCount)
+	{
+		auto leftBuild = std::async(std::launch::async, [&, child1]() { BuildSubtree(nodes, boundingBoxes, primitives, start, separator, child1, nodeIndex, level + 1); });
+		BuildSubtree(nodes, boundingBoxes, primitives, separator, end, child2, nodeIndex, level + 1);
+		leftBuild.get();
+	}
+	else
+	{
+		BuildSubtree(nodes, boundingBoxes, primitives, start, separator, child1, nodeIndex, level + 1);
+		BuildSubtree(nodes, boundingBoxes, primitives, separator, end, child2, nodeIndex, level + 1);
+	}
+}
+
+// Decide a splitting plane that minimizes the SAH cost and partition the range by it.
+// Returns NONE if every candidate plane leaves one side empty.
+uint32_t BVH::SplitBySAH(const std::vector<AABB> &boundingBoxes, std::vector<uint32_t> &primitives, uint32_t start, uint32_t end, const AABB &rangeBound, uint32_t targetAxis, float minCentroid, float maxCentroid)
+{
+	// We have to classify elements into buckets.
+	float bucketScale = BUCKET_COUNT / (maxCentroid - minCentroid);
+	auto toBucketIndex = [this, &boundingBoxes, targetAxis, minCentroid, bucketScale](uint32_t primitive)
+	{
+		uint32_t bucketIndex = static_cast<uint32_t>((Centroid(boundingBoxes[primitive])[targetAxis] - minCentroid) * bucketScale);
+		return std::min(bucketIndex, BUCKET_COUNT - 1);
+	};
+
+	std::array<Bucket, BUCKET_COUNT> buckets{};
+	for (uint32_t i = start; i < end; ++i)
+	{
+		Bucket &bucket = buckets[toBucketIndex(primitives[i])];
+		++bucket._count;
+		bucket._bound = Union(bucket._bound, boundingBoxes[primitives[i]]);
+	}
+
+	// Sweep from the left and from the right so that each candidate split costs O(1) to evaluate.
+	// Split i puts buckets [0, i] on the left and [i + 1, BUCKET_COUNT) on the right.
+	std::array<float, BUCKET_COUNT - 1> leftCosts{};
+	std::array<uint32_t, BUCKET_COUNT - 1> leftCounts{};
+	AABB leftBB{};
+	uint32_t leftCount = 0;
+	for (uint32_t i = 0; i < BUCKET_COUNT - 1; ++i)
+	{
+		leftBB = Union(leftBB, buckets[i]._bound);
+		leftCount += buckets[i]._count;
+		leftCounts[i] = leftCount;
+		leftCosts[i] = leftCount > 0 ? leftCount * SurfaceArea(leftBB) : 0.0f;
+	}
+
+	std::array<float, BUCKET_COUNT - 1> rightCosts{};
+	std::array<uint32_t, BUCKET_COUNT - 1> rightCounts{};
+	AABB rightBB{};
+	uint32_t rightCount = 0;
+	for (uint32_t i = BUCKET_COUNT - 1; i > 0; --i)
+	{
+		rightBB = Union(rightBB, buckets[i]._bound);
+		rightCount += buckets[i]._count;
+		rightCounts[i - 1] = rightCount;
+		rightCosts[i - 1] = rightCount > 0 ? rightCount * SurfaceArea(rightBB) : 0.0f;
+	}
+
+	// Find the minimum estimated cost
+	float rangeArea = SurfaceArea(rangeBound);
+	float minCost = std::numeric_limits<float>::max();
+	uint32_t minCostSplitBucket = NONE;
+	for (uint32_t i = 0; i < BUCKET_COUNT - 1; ++i)
+	{
+		if (leftCounts[i] == 0 || rightCounts[i] == 0) continue;
+
+		float cost = (leftCosts[i] + rightCosts[i]) / rangeArea;
+		if (cost < minCost)
+		{
+			minCost = cost;
+			minCostSplitBucket = i;
+		}
+	}
+
+	if (minCostSplitBucket == NONE)
+	{
+		return NONE;
+	}
+
+	// Partition the primitives by the selected bucket
+	auto separatorIter = std::partition
+	(
+		primitives.begin() + start,
+		primitives.begin() + end,
+		[&toBucketIndex, minCostSplitBucket](uint32_t primitive) { return toBucketIndex(primitive) <= minCostSplitBucket; }
+	);
+
+	return static_cast<uint32_t>(separatorIter - primitives.begin());
+}
+
+uint32_t BVH::SplitByMedian(const std::vector<AABB> &boundingBoxes, std::vector<uint32_t> &primitives, uint32_t start, uint32_t end, uint32_t targetAxis)
+{
+	uint32_t separator = start + (end - start) / 2;
+	std::nth_element
+	(
+		primitives.begin() + start,
+		primitives.begin() + separator,
+		primitives.begin() + end,
+		[this, &boundingBoxes, targetAxis](uint32_t a, uint32_t b) { return Centroid(boundingBoxes[a])[targetAxis] < Centroid(boundingBoxes[b])[targetAxis]; }
+	);
+
+	return separator;
+}
+
+inline bool BVH::IsLeafNode(const Node &node)
+{
+	return node._child1 == NONE;
 }
 
 bool BVH::RayBoxIntersection(const AABB &boundingBox, glm::vec3 start, glm::vec3 end)
@@ -304,7 +731,7 @@ bool BVH::MollerTrumbore(const Triangle &triangle, glm::vec3 start, glm::vec3 en
 	{
 		intersection->_point = start + t * ray;
 		intersection->_normal = glm::normalize((1.0f - u - v) * triangle.normalA + u * triangle.normalB + v * triangle.normalC);
-		intersection->_pointVelocity = glm::vec3(); // Temp
+		intersection->_pointVelocity = glm::vec3(); // Meshes are at rest in the model space; the instance adds the motion of the prop
 
 		return true;
 	}
@@ -341,6 +768,28 @@ auto BVH::Union(const AABB &a, const AABB &b) -> AABB
 	return unioned;
 }
 
+// Bounding box of the transformed corners of a
+auto BVH::Transform(const AABB &a, const glm::mat4 &transform) -> AABB
+{
+	AABB transformed{};
+	for (uint32_t corner = 0; corner < 8; ++corner)
+	{
+		glm::vec4 point
+		(
+			(corner & 1) ? a._upperBound.x : a._lowerBound.x,
+			(corner & 2) ? a._upperBound.y : a._lowerBound.y,
+			(corner & 4) ? a._upperBound.z : a._lowerBound.z,
+			1.0f
+		);
+
+		glm::vec4 transformedPoint = transform * point;
+		transformed._lowerBound = glm::min(transformed._lowerBound, glm::vec4(transformedPoint.xyz, 0.0f));
+		transformed._upperBound = glm::max(transformed._upperBound, glm::vec4(transformedPoint.xyz, 0.0f));
+	}
+
+	return transformed;
+}
+
 glm::vec3 BVH::Centroid(const AABB &a)
 {
 	return (a._lowerBound + a._upperBound) / 2.0f;
@@ -352,39 +801,24 @@ float BVH::SurfaceArea(const AABB &a)
 	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
 }
 
-std::tuple<uint32_t, glm::vec3, glm::vec3> BVH::GetTargetAxisAndMinMaxCentroid(const std::vector<AABB> &boundingBoxes, uint32_t start, uint32_t end)
+// Returns the bounding box of the range along with the minimum and maximum of its centroids
+std::tuple<BVH::AABB, glm::vec3, glm::vec3> BVH::GetRangeBounds(const std::vector<AABB> &boundingBoxes, const std::vector<uint32_t> &primitives, uint32_t start, uint32_t end)
 {
-	// Get all the centroids in the range
-	std::vector<glm::vec3> centroids;
-	centroids.reserve(end - start);
-	for (uint32_t i = start; i < end; ++i)
-	{
-		centroids.push_back(Centroid(boundingBoxes[i]));
-	}
-
-	// Find the target axis with the maximum centroid range
-	uint32_t targetAxis = 0;
-	float maxCentroidStretch = std::numeric_limits<float>::lowest();
+	AABB rangeBound{};
 	glm::vec3 minCentroid = glm::vec3(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
 	glm::vec3 maxCentroid = glm::vec3(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
-	
-	const uint32_t NUM_AXES = 3;
-	for (uint32_t i = 0; i < NUM_AXES; ++i)
+
+	for (uint32_t i = start; i < end; ++i)
 	{
-		glm::vec3 minCentroidForAxis = *std::min_element(centroids.begin(), centroids.end(), [i](glm::vec3 c1, glm::vec3 c2) { return c1[i] < c2[i]; });
-		glm::vec3 maxCentroidForAxis = *std::max_element(centroids.begin(), centroids.end(), [i](glm::vec3 c1, glm::vec3 c2) { return c1[i] < c2[i]; });
+		const AABB &boundingBox = boundingBoxes[primitives[i]];
+		rangeBound = Union(rangeBound, boundingBox);
 
-		float centroidStretch = maxCentroidForAxis[i] - minCentroidForAxis[i];
-		if (centroidStretch > maxCentroidStretch)
-		{
-			maxCentroidStretch = centroidStretch;
-			targetAxis = i;
-			minCentroid = minCentroidForAxis;
-			maxCentroid = maxCentroidForAxis;
-		}
+		glm::vec3 centroid = Centroid(boundingBox);
+		minCentroid = glm::min(minCentroid, centroid);
+		maxCentroid = glm::max(maxCentroid, centroid);
 	}
 
-	return std::make_tuple(targetAxis, minCentroid, maxCentroid);
+	return std::make_tuple(rangeBound, minCentroid, maxCentroid);
 }
 
 void BVH::DrawBoundingBoxes(uint32_t nodeIndex, bool includeDescendants)
@@ -450,7 +884,7 @@ void BVH::DrawBoundingBoxes(uint32_t nodeIndex, bool includeDescendants)
 
 			AddBoundingBoxToModel(nodeIndex, _meshModel.get());
 
-			if (!IsLeafNode(nodeIndex))
+			if (!IsLeafNode(_nodes[nodeIndex]))
 			{
 				uint32_t child1 = _nodes[nodeIndex]._child1;
 				nodeStack.push(child1);
@@ -3,7 +3,12 @@
 #include <vector>
 #include <memory>
 #include <stack>
-#include <unordered_set>
+#include <array>
+#include <future>
+#include <thread>
+#include <unordered_map>
+#include <numeric>
+#include <bit>
 
 #define GLM_FORCE_SWIZZLE
 #define GLM_FORCE_RADIANS // Force glm to use radian as arguments
@@ -27,6 +32,7 @@ class BVH
 {
 public:
 	static const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+	static const uint32_t PACKET_SIZE = 8; // Number of segments traced together by GetIntersections
 
 	struct AABB
 	{
@@ -42,43 +48,88 @@ public:
 		alignas(4) uint32_t _parent = static_cast<uint32_t>(NONE);
 		alignas(4) uint32_t _child1 = static_cast<uint32_t>(NONE); // -1 if this node is a leaf
 		alignas(4) uint32_t _child2 = static_cast<uint32_t>(NONE);
+		alignas(4) uint32_t _primitive = static_cast<uint32_t>(NONE); // Triangle index in a bottom-level leaf, instance index in a top-level leaf
 	};
 
-private:
-	// Used for recursively building a tree
-	struct Range
+	// A collidable prop placed in the world that refers to the bottom-level tree of its mesh
+	struct Instance
 	{
-		uint32_t _start = NONE;
-		uint32_t _end = NONE; // Exclusive end
-		uint32_t _parentIndex = NONE;
-		AABB _boundingBox{};
+		alignas(16) glm::mat4 _worldToModel = glm::mat4(1.0f);
+		alignas(16) glm::mat4 _modelToWorld = glm::mat4(1.0f);
+		alignas(16) glm::mat4 _velocityTransform = glm::mat4(0.0f); // World-space point -> its velocity over the last refit
+		alignas(4) uint32_t _rootNode = 0; // Index of the root of the bottom-level tree in the mesh nodes
 	};
 
+private:
 	struct Bucket
 	{
 		uint32_t _count = 0;
 		AABB _bound{};
 	};
 
+	// Segments from t = 0 to t = 1 laid out as structure of arrays so that box tests over lanes can be vectorized
+	struct Packet
+	{
+		alignas(32) std::array<std::array<float, PACKET_SIZE>, 3> _origins{};
+		alignas(32) std::array<std::array<float, PACKET_SIZE>, 3> _directions{};
+		alignas(32) std::array<std::array<float, PACKET_SIZE>, 3> _inverseDirections{};
+		alignas(32) std::array<float, PACKET_SIZE> _tMax{}; // Parameter of the closest hit so far
+	};
+
 private:
 	std::vector<std::shared_ptr<MeshObject>> _propObjects;
+
+	// Bottom level: one tree per unique mesh in the model space, shared by every prop that uses the mesh
+	std::unordered_map<const std::vector<Triangle> *, uint32_t> _meshRoots; // Model-space triangles -> root node index
+	std::vector<Node> _meshNodes;
+	uint32_t _meshMaxLevel = 0;
+
+	// Top level: one tree over the collidable props in the world space
+	std::vector<Instance> _instances;
+	std::vector<uint32_t> _instanceProps; // Instance index -> prop index
 	std::vector<Node> _nodes;
 
+	// Used for refitting the top-level tree
+	std::vector<std::vector<uint32_t>> _levelNodes; // Level - 1 -> node indices
+	float _constructedSAHCost = 0.0f;
+
 	std::shared_ptr<MeshModel> _meshModel = nullptr;
 
 	static const glm::vec4 OFFSET;
 
+	static const uint32_t BUCKET_COUNT = 16;
+	static const uint32_t MEDIAN_SPLIT_THRESHOLD = 4; // Ranges this small are split at the median instead of being binned
+	static const uint32_t PARALLEL_BUILD_THRESHOLD = 4096; // Ranges larger than this build their left subtree asynchronously, down to a depth set by the hardware threads
+	static constexpr float REBUILD_COST_RATIO = 1.5f;
+
+	static const uint32_t TRAVERSAL_STACK_SIZE = 64; // Trees this deep are traced with GetIntersection
+	static const uint32_t DIVERGENCE_THRESHOLD = 2; // Packets with this few active lanes fall back to tracing lane by lane
+
 public:
 	void AddPropObject(const std::shared_ptr<MeshObject> &propObject);
 	bool Construct();
+	bool Refit(float elapsedSecond);
+	float GetSAHCost();
 	bool GetIntersection(glm::vec3 currentPosition, glm::vec3 nextPosition, Intersection *intersection);
+	uint32_t GetIntersections(const glm::vec3 *currentPositions, const glm::vec3 *nextPositions, uint32_t count, Intersection *intersections);
 
 	void DrawBoundingBoxes(uint32_t nodeIndex, bool includeDescendants);
 
-	auto &GetNodes() { return _nodes; }
+	const auto &GetNodes() const { return _nodes; }
+	const auto &GetInstances() const { return _instances; }
+	const auto &GetMeshNodes() const { return _meshNodes; }
+	uint32_t GetMaxLevel() const { return static_cast<uint32_t>(_levelNodes.size()) + _meshMaxLevel; } // The deepest path through both levels
 
 private:
+	bool GetMeshIntersection(uint32_t rootIndex, glm::vec3 start, glm::vec3 end, Intersection *intersection);
 	bool RayBoxIntersection(const AABB &boundingBox, glm::vec3 start, glm::vec3 end);
+
+	// Functions for packet traversal
+	uint32_t GetPacketMeshIntersections(const Instance &instance, Packet &packet, uint32_t activeMask, Intersection *intersections);
+	bool GetLaneMeshIntersection(uint32_t rootIndex, const Instance &instance, Packet &packet, uint32_t lane, Intersection *intersections);
+	bool GetLaneTriangleIntersection(const Node &leaf, const Instance &instance, Packet &packet, uint32_t lane, Intersection *intersections);
+	uint32_t PacketBoxIntersection(const AABB &boundingBox, const Packet &packet, uint32_t activeMask);
+	Packet TransformPacket(const Packet &packet, const glm::mat4 &transform, uint32_t activeMask);
 	bool MollerTrumbore(const Triangle &triangle, glm::vec3 start, glm::vec3 end, Intersection *intersection);
 
 	// Functions for building a tree
@@ -86,9 +137,17 @@ private:
 	auto Union(const AABB &a, const AABB &b)->AABB;
 	float SurfaceArea(const AABB &a);
 	glm::vec3 Centroid(const AABB &a);
-	uint32_t GetTargetAxis(const std::vector<AABB> &boundingBoxes, uint32_t start, uint32_t end);
-	bool IsLeafNode(uint32_t nodeIndex);
-	std::tuple<uint32_t, glm::vec3, glm::vec3> GetTargetAxisAndMinMaxCentroid(const std::vector<AABB> &boundingBoxes, uint32_t start, uint32_t end);
+	auto Transform(const AABB &a, const glm::mat4 &transform) -> AABB;
+	bool IsLeafNode(const Node &node);
+	bool ConstructInstances();
+	uint32_t ConstructMesh(const std::vector<Triangle> &triangles);
+	Instance GetInstance(const MeshObject &propObject, uint32_t rootNode);
+	std::vector<uint32_t> GetCollidableProps();
+	void BuildTree(std::vector<Node> &nodes, uint32_t rootIndex, const std::vector<AABB> &boundingBoxes);
+	void BuildSubtree(std::vector<Node> &nodes, const std::vector<AABB> &boundingBoxes, std::vector<uint32_t> &primitives, uint32_t start, uint32_t end, uint32_t nodeIndex, uint32_t parentIndex, uint32_t level);
+	std::tuple<AABB, glm::vec3, glm::vec3> GetRangeBounds(const std::vector<AABB> &boundingBoxes, const std::vector<uint32_t> &primitives, uint32_t start, uint32_t end);
+	uint32_t SplitBySAH(const std::vector<AABB> &boundingBoxes, std::vector<uint32_t> &primitives, uint32_t start, uint32_t end, const AABB &rangeBound, uint32_t targetAxis, float minCentroid, float maxCentroid);
+	uint32_t SplitByMedian(const std::vector<AABB> &boundingBoxes, std::vector<uint32_t> &primitives, uint32_t start, uint32_t end, uint32_t targetAxis);
 
 	// Functions for debugging a tree
 	void AddBoundingBoxToModel(uint32_t nodeIndex, MeshModel *meshModel);
@@ -1,45 +1,109 @@
 #include "CPUSimulatedScene.h"
 
+const std::string CPUSimulatedScene::ENGINE_NAME = "cpu";
+
+CPUSimulatedScene::~CPUSimulatedScene()
+{
+	StopSolver();
+}
+
 void CPUSimulatedScene::Register()
 {
-	VulkanCore::Get()->OnExecuteHost().AddListener
+	// Headless scenes run without Vulkan and are advanced by their owner
+	if (!_isHeadless) VulkanCore::Get()->OnExecuteHost().AddListener
 	(
 		weak_from_this(),
 		[this](float deltaSecond, uint32_t currentFrame)
 		{
-			Update();
+			if (!_solverThread.joinable()) return;
+
+			// Props are owned by this thread, so the solver is held at a step boundary while the colliders are refitted after a prop has moved.
+			// Changes of the parameters only reshape the occupancy grid, which the solver rebuilds from a copy of them without holding this thread.
+			// Fluid at rest against a moved prop may have lost its support, so everything wakes.
+			if (_isLevelDirty || _isLevelMoving)
+			{
+				Synchronize([this, deltaSecond]() { UpdateLevel(deltaSecond); _activityGrid.WakeAll(); });
+			}
+			else if (_isOccupancyDirty)
+			{
+				_isOccupancyDirty = false;
+				EnqueueMessage([this, simulationParameters = *_simulationParameters]() { _occupancyGrid->Construct(*_bvh, simulationParameters); _activityGrid.WakeAll(); });
+			}
+
+			// Take the state of this frame even without rendering it, since the fixed steps of the solver are paced by the frames
+			_snapshots.Acquire();
+			if (!_isSimulateOnly) Applypositions();
 		}
 	);
 
+	// The solver reads its own copies of the settings, which are replaced between steps.
 	_onUpdateSimulationParameters.AddListener
 	(
 		weak_from_this(),
 		[this](const SimulationParameters &simulationParameters)
 		{
-			_kernel = std::make_unique<Kernel>(simulationParameters._particleRadius * simulationParameters._kernelRadiusFactor);
+			EnqueueMessage([this, simulationParameters]() { ApplySimulationParameters(simulationParameters); });
+		}
+	);
+
+	_onSetColliderMode.AddListener
+	(
+		weak_from_this(),
+		[this](ColliderMode colliderMode)
+		{
+			EnqueueMessage([this, colliderMode]() { _stepColliderMode = colliderMode; });
+		}
+	);
+
+	_onSetSubstepCount.AddListener
+	(
+		weak_from_this(),
+		[this](uint32_t substepCount)
+		{
+			EnqueueMessage([this, substepCount]() { _stepSubstepCount = substepCount; });
+		}
+	);
+
+	_onUpdateParticleFlow.AddListener
+	(
+		weak_from_this(),
+		[this](const ParticleFlow &particleFlow)
+		{
+			EnqueueMessage([this, particleFlow]() { _stepFlow = particleFlow; });
 		}
 	);
 }
 
+void CPUSimulatedScene::InitializeLevel()
+{
+	StopSolver();
+	SimulatedSceneBase::InitializeLevel();
+}
+
 void CPUSimulatedScene::InitializeParticles(float particleDistance, glm::vec2 xRange, glm::vec2 yRange, glm::vec2 zRange)
 {
+	// Catch up with the settings while no solver is running
+	StopSolver();
+	ProcessMessages();
+
 	// Setup
 	size_t xCount = std::lround(std::ceil((xRange.g - xRange.r) / particleDistance));
 	size_t yCount = std::lround(std::ceil((yRange.g - yRange.r) / particleDistance));
 	size_t zCount = std::lround(std::ceil((zRange.g - zRange.r) / particleDistance));
 
 	_particleCount = xCount * yCount * zCount;
+	_particleDistance = particleDistance;
 	glm::vec3 startingPoint = glm::vec3(xRange.r, yRange.r, zRange.r);
 
-	// Prepare particles themselves
-	_positions = std::vector<glm::vec3>(_particleCount);
-	_velocities = std::vector<glm::vec3>(_particleCount);
-	_forces = std::vector<glm::vec3>(_particleCount);
-	_densities = std::vector<float>(_particleCount);
-	_pressures = std::vector<float>(_particleCount);
+	UpdateGridDimension(startingPoint, glm::vec3(xRange.g, yRange.g, zRange.g));
 
-	_nextPositions = std::vector<glm::vec3>(_particleCount);
-	_nextVelocities = std::vector<glm::vec3>(_particleCount);
+	// Prepare particles themselves
+	AllocateParticleArrays();
+	for (auto &averageStepTime : _averageStepTimes) averageStepTime.store(0.0f); // Timings are comparable only within the same placement
+	_activityGrid = ActivityGrid();
+	_sleepingParticleCount.store(0, std::memory_order_relaxed);
+	_resolutionStep = 0;
+	_mergedParticleCount.store(0, std::memory_order_relaxed);
 
 	// Place particles
 	#pragma omp parallel for
@@ -57,230 +121,1575 @@ void CPUSimulatedScene::InitializeParticles(float particleDistance, glm::vec2 xR
 
 	// Initialize hashed buckets
 	_hashGrid = std::make_unique<HashGrid>(_particleCount, _gridDimension);
-	_hashGrid->UpdateSpacing(2.0f * _simulationParameters->_particleRadius * _simulationParameters->_kernelRadiusFactor);
-	_onUpdateSimulationParameters.AddListener
-	(
-		weak_from_this(),
-		[this](const SimulationParameters &simulationParameters)
+	{
+		std::lock_guard<std::mutex> lock(_gridStatisticsMutex);
+		_gridStatistics = std::nullopt;
+	}
+	_hashGrid->UpdateSpacing(GetGridSpacing());
+
+	// Every rank places the whole block and keeps the particles of its own slab
+	if (_decomposition != nullptr)
+	{
+		size_t ownedCount = 0;
+		for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
 		{
-			_hashGrid->UpdateSpacing(2.0f * simulationParameters._particleRadius * simulationParameters._kernelRadiusFactor);
-		},
-		PRIORITY_LOWEST,
-		__FUNCTION__, 
-		__LINE__
-	);
+			if (_decomposition->IsOwned(*_hashGrid, _positions[particleIndex])) _positions[ownedCount++] = _positions[particleIndex];
+		}
+
+		_particleCount = ownedCount;
+		_ghostCount = 0;
+		ResizeParticleArrays(_particleCount);
+	}
+
+	// Each rank emits only the particles that enter its own slab
+	_stepFlow = _particleFlow;
+	_particleCapacity = GetParticleCapacity(_particleCount);
+	_particlePool.Reset(_particleCapacity, _particleCount);
+	_publishedParticleCount.store(_particleCount, std::memory_order_relaxed);
+
+	// The calling thread of a headless scene steps it, so its team is pinned like that of the solver thread
+	if (_isHeadless)
+	{
+		if (_isPlacementNUMAAware) PinTeamThreads();
+		return;
+	}
 
 	// Initialize renderers (marching cubes and billboards)
-	_particlePositionInputBuffers = CreateBuffers(sizeof(glm::vec3) * _particleCount, VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	InitializeRenderers(_particlePositionInputBuffers, _particleCount);
+	_snapshots.Reset(std::vector<glm::vec3>(_positions.cbegin(), _positions.cend()));
+	_particlePositionInputBuffers = CreateBuffers(sizeof(glm::vec3) * _particleCapacity, VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	InitializeRenderers(_particlePositionInputBuffers, _particleCapacity);
+	SetRenderedParticleCount(_particleCount);
 	
 	// Launch
-	_isPlaying = true;
+	_solverThread = std::jthread([this, isPinned = _isPlacementNUMAAware](std::stop_token stopToken) { Solve(stopToken, isPinned); });
 	ApplyRenderMode(_particleRenderingMode);
 }
 
-void CPUSimulatedScene::BeginTimeStep()
+// Without NUMA awareness, the arrays are value-initialized from the calling thread, which puts all of their pages on its node.
+// Otherwise, they are touched in parallel from a pinned team that is laid out like the team of the solver.
+// A separate thread hosts that team so as not to pin the calling thread.
+void CPUSimulatedScene::AllocateParticleArrays()
 {
-	_hashGrid->UpdateGrid(_positions);
-	UpdateDensities();
+	auto allocate = [this]()
+	{
+		FirstTouchResize(_positions, _particleCount, glm::vec3{});
+		FirstTouchResize(_velocities, _particleCount, glm::vec3{});
+		FirstTouchResize(_forces, _particleCount, glm::vec3{});
+		FirstTouchResize(_densities, _particleCount, 0.0f);
+		FirstTouchResize(_pressures, _particleCount, 0.0f);
+
+		FirstTouchResize(_nextPositions, _particleCount, glm::vec3{});
+		FirstTouchResize(_nextVelocities, _particleCount, glm::vec3{});
+
+		FirstTouchResize(_dfsphFactors, _particleCount, 0.0f);
+		FirstTouchResize(_densityErrors, _particleCount, 0.0f);
+		FirstTouchResize(_stiffnesses, _particleCount, 0.0f);
+		FirstTouchResize(_densityStiffnesses, _particleCount, 0.0f);
+		FirstTouchResize(_divergenceStiffnesses, _particleCount, 0.0f);
+
+		FirstTouchResize(_lambdas, _particleCount, 0.0f);
+		FirstTouchResize(_pbfCorrections, _particleCount, glm::vec3{});
+
+		FirstTouchResize(_viscosityDiagonals, _particleCount, 0.0f);
+		FirstTouchResize(_viscosityResiduals, _particleCount, glm::vec3{});
+		FirstTouchResize(_viscosityDirections, _particleCount, glm::vec3{});
+		FirstTouchResize(_viscosityProducts, _particleCount, glm::vec3{});
+		FirstTouchResize(_viscosityCorrections, _particleCount, glm::vec3{});
+
+		FirstTouchResize(_resolutionLevels, _particleCount, uint8_t{});
+		FirstTouchResize(_resolutionAges, _particleCount, 0u);
+	};
+
+	_isPlacementNUMAAware = _isNUMAAware;
+	if (_isPlacementNUMAAware)
+	{
+		std::jthread
+		(
+			[&allocate]()
+			{
+				PinTeamThreads();
+				allocate();
+			}
+		).join();
+	}
+	else
+	{
+		_positions = FirstTouchVector<glm::vec3>(_particleCount, glm::vec3{});
+		_velocities = FirstTouchVector<glm::vec3>(_particleCount, glm::vec3{});
+		_forces = FirstTouchVector<glm::vec3>(_particleCount, glm::vec3{});
+		_densities = FirstTouchVector<float>(_particleCount, 0.0f);
+		_pressures = FirstTouchVector<float>(_particleCount, 0.0f);
+
+		_nextPositions = FirstTouchVector<glm::vec3>(_particleCount, glm::vec3{});
+		_nextVelocities = FirstTouchVector<glm::vec3>(_particleCount, glm::vec3{});
+
+		_dfsphFactors = FirstTouchVector<float>(_particleCount, 0.0f);
+		_densityErrors = FirstTouchVector<float>(_particleCount, 0.0f);
+		_stiffnesses = FirstTouchVector<float>(_particleCount, 0.0f);
+		_densityStiffnesses = FirstTouchVector<float>(_particleCount, 0.0f);
+		_divergenceStiffnesses = FirstTouchVector<float>(_particleCount, 0.0f);
+
+		_lambdas = FirstTouchVector<float>(_particleCount, 0.0f);
+		_pbfCorrections = FirstTouchVector<glm::vec3>(_particleCount, glm::vec3{});
+
+		_viscosityDiagonals = FirstTouchVector<float>(_particleCount, 0.0f);
+		_viscosityResiduals = FirstTouchVector<glm::vec3>(_particleCount, glm::vec3{});
+		_viscosityDirections = FirstTouchVector<glm::vec3>(_particleCount, glm::vec3{});
+		_viscosityProducts = FirstTouchVector<glm::vec3>(_particleCount, glm::vec3{});
+		_viscosityCorrections = FirstTouchVector<glm::vec3>(_particleCount, glm::vec3{});
+
+		_resolutionLevels = FirstTouchVector<uint8_t>(_particleCount, uint8_t{});
+		_resolutionAges = FirstTouchVector<uint32_t>(_particleCount, 0u);
+	}
+
+	_previousTimeStep = 0.0f;
 }
 
-void CPUSimulatedScene::EndTimeStep()
+// Elements added by growing the arrays are zeroed, since particles that enter the slab accumulate their forces from zero.
+// With NUMA-aware placement, an array that outgrows its capacity is moved by the team, so that emission, splits and migration keep the placement.
+void CPUSimulatedScene::ResizeParticleArrays(size_t particleCount)
 {
-	// Apply velocities and positions are applied
-	std::copy(_nextPositions.cbegin(), _nextPositions.cend(), _positions.begin());
-	std::copy(_nextVelocities.cbegin(), _nextVelocities.cend(), _velocities.begin());
+	auto resize = [this, particleCount]<typename T>(FirstTouchVector<T> &array, const T &value)
+	{
+		if (_isPlacementNUMAAware) FirstTouchReserve(array, particleCount);
+		array.resize(particleCount, value);
+	};
 
-	// Set other components to zero
-	std::fill(_forces.begin(), _forces.end(), glm::vec3{});
-	std::fill(_densities.begin(), _densities.end(), 0.0f);
-	std::fill(_pressures.begin(), _pressures.end(), 0.0f);
+	resize(_positions, glm::vec3{});
+	resize(_velocities, glm::vec3{});
+	resize(_forces, glm::vec3{});
+	resize(_densities, 0.0f);
+	resize(_pressures, 0.0f);
+
+	resize(_nextPositions, glm::vec3{});
+	resize(_nextVelocities, glm::vec3{});
+
+	resize(_dfsphFactors, 0.0f);
+	resize(_densityErrors, 0.0f);
+	resize(_stiffnesses, 0.0f);
+	resize(_densityStiffnesses, 0.0f);
+	resize(_divergenceStiffnesses, 0.0f);
+
+	resize(_lambdas, 0.0f);
+	resize(_pbfCorrections, glm::vec3{});
+
+	resize(_viscosityDiagonals, 0.0f);
+	resize(_viscosityResiduals, glm::vec3{});
+	resize(_viscosityDirections, glm::vec3{});
+	resize(_viscosityProducts, glm::vec3{});
+	resize(_viscosityCorrections, glm::vec3{});
+
+	resize(_resolutionLevels, uint8_t{});
+	resize(_resolutionAges, 0u);
 }
 
-void CPUSimulatedScene::Update()
+std::optional<HashGrid::Statistics> CPUSimulatedScene::GetGridStatistics() const
 {
-	if (!_isPlaying) return;
-
-	// Conduct simulation
-	BeginTimeStep();
+	std::lock_guard<std::mutex> lock(_gridStatisticsMutex);
+	return _gridStatistics;
+}
 
-	AccumulateForces();
-	TimeIntegration(_simulationParameters->_timeStep);
-	ResolveCollision();
+SolverStatistics CPUSimulatedScene::GetSolverStatistics() const
+{
+	// The iterative solvers, sleeping and adaptive resolution always step on OpenMP loops, while a decomposed domain steps without any of them
+	bool isIterative = _decomposition == nullptr && ((static_cast<PressureSolver>(_simulationParameters->_pressureSolver) != PressureSolver::EOS) || (static_cast<ViscositySolver>(_simulationParameters->_viscositySolver) == ViscositySolver::Implicit) || _simulationParameters->_isSleepingEnabled || _simulationParameters->_isResolutionAdaptive);
+	SolverScheduler scheduler = isIterative ? SolverScheduler::OpenMP : _solverScheduler;
 
-	EndTimeStep();
+	return SolverStatistics
+	{
+		._particleCount = GetParticleCount(),
+		._averageStepTime = GetAverageStepTime(scheduler),
+		._divergenceIterations = GetSolverIterations(false),
+		._densityIterations = GetSolverIterations(true),
+		._viscosityIterations = GetViscosityIterations(),
+		._sleepingParticleCount = GetSleepingParticleCount(),
+		._mergedParticleCount = GetMergedParticleCount()
+	};
+}
 
-	// Reflect the particle status to the render system
-	Applypositions();
+void CPUSimulatedScene::SetSolverScheduler(SolverScheduler solverScheduler)
+{
+	_solverScheduler = solverScheduler;
+	EnqueueMessage([this, solverScheduler]() { _stepScheduler = solverScheduler; });
 }
 
-void CPUSimulatedScene::AccumulateForces()
+void CPUSimulatedScene::StopSolver()
 {
-	AccumulateExternalForce();
-	AccumulateViscosityForce();
-	AccumulatePressureForce();
+	if (!_solverThread.joinable()) return;
+
+	_solverThread.request_stop();
+	_solverThread.join();
 }
 
-void CPUSimulatedScene::AccumulateExternalForce()
+// Runs on the solver thread until stopped; the parallel regions within a step are spread over the OpenMP team of this thread.
+void CPUSimulatedScene::Solve(std::stop_token stopToken, bool isPinned)
 {
-	#pragma omp parallel for
-	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	if (isPinned) PinTeamThreads();
+
+	auto prevTime = std::chrono::high_resolution_clock::now();
+	while (!stopToken.stop_requested())
 	{
-		// Apply gravity
-		glm::vec3 externalForce = _simulationParameters->_particleMass * _simulationParameters->_gravitiy.xyz;
+		ProcessMessages();
+
+		// Fixed steps advance the simulated time by a frame for each frame, as they did on the render thread, rather than as fast as the solver can go.
+		// Adaptive steps cover the wall time since the last pass, so they keep pace with the frames by themselves.
+		if (!_stepParameters._isTimeStepAdaptive && !_snapshots.IsTaken())
+		{
+			std::this_thread::sleep_for(PACING_INTERVAL);
+			continue;
+		}
 
-		// Apply wind forces
-		glm::vec3 relativeVelocity = _velocities[particleIndex] - GetWindVelocityAt(_positions[particleIndex]);
-		externalForce += -_simulationParameters->_dragCoefficient * relativeVelocity;
+		auto currentTime = std::chrono::high_resolution_clock::now();
+		float deltaSecond = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - prevTime).count();
+		prevTime = currentTime;
 
-		_forces[particleIndex] += externalForce;
+		Update(deltaSecond);
+
+		// Publish the completed state; the count of particles changes as they split and merge, and as they enter and leave.
+		// A state that no frame has taken yet is left as it is rather than copied over again.
+		if (!_snapshots.IsTaken()) continue;
+
+		_snapshots.GetBack().assign(_positions.cbegin(), _positions.cend());
+		_snapshots.Publish();
 	}
 }
 
-void CPUSimulatedScene::AccumulateViscosityForce()
+// Step the scene on the calling thread, for headless scenes that have no solver thread
+void CPUSimulatedScene::Advance(float deltaSecond)
 {
-	#pragma omp parallel for
-	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	ProcessMessages();
+	Update(deltaSecond);
+}
+
+void CPUSimulatedScene::EnqueueMessage(std::function<void()> message)
+{
+	std::lock_guard<std::mutex> lock(_messageMutex);
+	_messages.emplace_back(std::move(message));
+}
+
+// Run the message on the solver thread at its next step boundary and wait until it is done
+void CPUSimulatedScene::Synchronize(std::function<void()> message)
+{
+	if (!_solverThread.joinable())
 	{
-		_hashGrid->ForEachNeighborParticle
-		(
-			_positions,
-			particleIndex,
-			[&](size_t neighborIndex)
-			{
-				float distance = glm::distance(_positions[particleIndex], _positions[neighborIndex]);
-				_forces[particleIndex] += _simulationParameters->_viscosityCoefficient * (_simulationParameters->_particleMass * _simulationParameters->_particleMass) * (_velocities[neighborIndex] - _velocities[particleIndex]) * _kernel->SecondDerivative(distance) / _densities[neighborIndex];
-			}
-		);
+		message();
+		return;
 	}
+
+	std::promise<void> promise;
+	std::future<void> future = promise.get_future();
+	EnqueueMessage
+	(
+		[&message, &promise]()
+		{
+			message();
+			promise.set_value();
+		}
+	);
+	future.wait();
 }
 
-void CPUSimulatedScene::AccumulatePressureForce()
+void CPUSimulatedScene::ProcessMessages()
+{
+	std::vector<std::function<void()>> messages;
+	{
+		std::lock_guard<std::mutex> lock(_messageMutex);
+		messages.swap(_messages);
+	}
+
+	for (auto &message : messages) message();
+}
+
+void CPUSimulatedScene::ApplySimulationParameters(const SimulationParameters &simulationParameters)
+{
+	_stepParameters = simulationParameters;
+	_kernel = std::make_unique<Kernel>(_stepParameters._particleRadius * _stepParameters._kernelRadiusFactor, IS_KERNEL_TABULATED);
+
+	// Particles coarser than the new settings allow are split back before the grid is fitted to the largest radius
+	RefineResolution(GetMaxResolutionLevel());
+	if (_hashGrid != nullptr) _hashGrid->UpdateSpacing(GetGridSpacing());
+}
+
+void CPUSimulatedScene::BeginTimeStep()
+{
+	if (_decomposition != nullptr) ExchangeParticles();
+
+	_hashGrid->UpdateGrid(_positions);
+	UpdateDensities();
+
+	if (_decomposition != nullptr) _decomposition->ExchangeHaloDensities(_densities, _particleCount);
+}
+
+// Sleeping is limited to the explicit step with the equation of state, where particles affect each other only through the forces of the step.
+bool CPUSimulatedScene::IsSleepingEnabled() const
+{
+	bool isExplicit = (static_cast<PressureSolver>(_stepParameters._pressureSolver) == PressureSolver::EOS) && !IsViscosityImplicit();
+	return _stepParameters._isSleepingEnabled && isExplicit && _decomposition == nullptr;
+}
+
+// Sleeping particles keep their densities up to date, so that they wake when the fluid around them is compressed
+void CPUSimulatedScene::UpdateActivity()
+{
+	_activityGrid.Update(*_hashGrid, _velocities, _densities, _particleCount, _stepParameters);
+	_sleepingParticleCount.store(_activityGrid.GetSleepingCount(), std::memory_order_relaxed);
+}
+
+// Adaptive resolution is limited to the explicit step with the equation of state as well; the other solvers take particles of the base mass.
+bool CPUSimulatedScene::IsResolutionAdaptive() const
+{
+	bool isExplicit = (static_cast<PressureSolver>(_stepParameters._pressureSolver) == PressureSolver::EOS) && !IsViscosityImplicit();
+	return _stepParameters._isResolutionAdaptive && isExplicit && _decomposition == nullptr;
+}
+
+uint32_t CPUSimulatedScene::GetMaxResolutionLevel() const
+{
+	return IsResolutionAdaptive() ? std::min(_stepParameters._maxResolutionLevel, MAX_RESOLUTION_LEVEL) : 0;
+}
+
+// Neighbors are listed up to twice the support radius of the largest particles
+float CPUSimulatedScene::GetGridSpacing() const
 {
-	// Compute pressures
+	return 2.0f * _stepParameters._particleRadius * _stepParameters._kernelRadiusFactor * RESOLUTION_SCALES[GetMaxResolutionLevel()];
+}
+
+// Particles merge where the fluid has no detail and split again where it does (Adams et al., 2007; Vacondio et al., 2013).
+// The free surface shows as densities well below the target density, where the kernels are cut off, and colliders are found through the occupancy grid.
+// Merges and splits act on the state after the step. A merged pair takes its center of mass and its mean velocity,
+// and the halves of a split particle are placed on either side of it with its velocity, so both conserve mass and momentum.
+// Only merged particles split, so the count of particles never exceeds the count they were initialized with.
+void CPUSimulatedScene::UpdateResolution()
+{
+	if (++_resolutionStep < RESOLUTION_INTERVAL) return;
+	_resolutionStep = 0;
+
+	uint32_t maxLevel = GetMaxResolutionLevel();
+	float splitDensity = _stepParameters._splitDensityRatio * _stepParameters._targetDensity;
+	float mergeDensity = _stepParameters._mergeDensityRatio * _stepParameters._targetDensity;
+
+	_resolutionChanges.assign(_particleCount, ResolutionChange::None);
+	_mergePartners.assign(_particleCount, NO_PARTNER);
+
+	// 1. Candidates; the gap between the two densities keeps particles from splitting and merging back and forth
 	#pragma omp parallel for
 	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
 	{
-		float eosScale = _simulationParameters->_targetDensity * (_simulationParameters->_soundSpeed * _simulationParameters->_soundSpeed) / _simulationParameters->_eosExponent;
-		_pressures[particleIndex] = ComputePressureFromEOS(_densities[particleIndex], _simulationParameters->_targetDensity, eosScale, _simulationParameters->_eosExponent);
+		_resolutionAges[particleIndex] = std::min(_resolutionAges[particleIndex] + 1, RESOLUTION_COOLDOWN);
+		if (_resolutionAges[particleIndex] < RESOLUTION_COOLDOWN) continue;
+
+		uint8_t level = _resolutionLevels[particleIndex];
+		bool isDetailed = (_densities[particleIndex] < splitDensity) || _occupancyGrid->IsNearCollider(_positions[particleIndex], _nextPositions[particleIndex]);
+		if (isDetailed && level > 0) _resolutionChanges[particleIndex] = ResolutionChange::Split;
+		else if (!isDetailed && _densities[particleIndex] > mergeDensity && level < maxLevel) _resolutionChanges[particleIndex] = ResolutionChange::Merge;
 	}
 
-	// Compute pressure forces from the pressures
+	// 2. Nearest candidate of the same level within the diameter of the level
 	#pragma omp parallel for
 	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
 	{
+		if (_resolutionChanges[particleIndex] != ResolutionChange::Merge) continue;
+
+		uint8_t level = _resolutionLevels[particleIndex];
+		float nearestDistance = 2.0f * _stepParameters._particleRadius * RESOLUTION_SCALES[level];
+		uint32_t partnerIndex = NO_PARTNER;
 		_hashGrid->ForEachNeighborParticle
 		(
 			_positions,
 			particleIndex,
 			[&](size_t neighborIndex)
 			{
-				float distance = glm::distance(_positions[particleIndex], _positions[neighborIndex]);
-				if (distance > 0.0f)
+				if (_resolutionChanges[neighborIndex] != ResolutionChange::Merge || _resolutionLevels[neighborIndex] != level) return;
+
+				float distance = glm::distance(_nextPositions[particleIndex], _nextPositions[neighborIndex]);
+				if (distance < nearestDistance)
 				{
-					glm::vec3 direction = (_positions[neighborIndex] - _positions[particleIndex]) / distance;
-					_forces[particleIndex] -=
-						(_simulationParameters->_particleMass * _simulationParameters->_particleMass) * 
-						_kernel->Gradient(distance, direction) * 
-						(_pressures[particleIndex] / (_densities[particleIndex] * _densities[particleIndex]) + _pressures[neighborIndex] / (_densities[neighborIndex] * _densities[neighborIndex]));
+					nearestDistance = distance;
+					partnerIndex = static_cast<uint32_t>(neighborIndex);
 				}
 			}
 		);
+
+		_mergePartners[particleIndex] = partnerIndex;
 	}
-}
 
-void CPUSimulatedScene::ResolveCollision()
-{
-	#pragma omp parallel for
+	// 3. Pairs that choose each other merge into the one with the lower index; each particle writes only itself, or itself and the partner it removes
+	size_t changeCount = 0;
+	#pragma omp parallel for reduction(+:changeCount)
 	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
 	{
-		// Check if the new position is penetrating any surface
-		Intersection intersection{};
-		if (_bvh->GetIntersection(_positions[particleIndex], _nextPositions[particleIndex], &intersection))
+		if (_resolutionChanges[particleIndex] == ResolutionChange::Split) ++changeCount;
+		if (_resolutionChanges[particleIndex] != ResolutionChange::Merge) continue;
+
+		uint32_t partnerIndex = _mergePartners[particleIndex];
+		if (partnerIndex == NO_PARTNER || _mergePartners[partnerIndex] != particleIndex)
+		{
+			_resolutionChanges[particleIndex] = ResolutionChange::None;
+			continue;
+		}
+
+		if (partnerIndex < particleIndex)
 		{
-			// Target point is the closest non-penetrating position from the current position.
-			glm::vec3 targetNormal = intersection._normal;
-			glm::vec3 targetPoint = intersection._point + _simulationParameters->_particleRadius * targetNormal * 0.5f;
-			glm::vec3 collisionPointVelocity = intersection._pointVelocity;
+			_resolutionChanges[particleIndex] = ResolutionChange::Remove;
+			continue;
+		}
 
-			// Get new candidate relative velocities from the target point
-			glm::vec3 relativeVelocity = _nextVelocities[particleIndex] - collisionPointVelocity;
-			float normalDotRelativeVelocity = glm::dot(targetNormal, relativeVelocity);
-			glm::vec3 relativeVelocityN = normalDotRelativeVelocity * targetNormal;
-			glm::vec3 relativeVelocityT = relativeVelocity - relativeVelocityN;
+		_nextPositions[particleIndex] = 0.5f * (_nextPositions[particleIndex] + _nextPositions[partnerIndex]);
+		_nextVelocities[particleIndex] = 0.5f * (_nextVelocities[particleIndex] + _nextVelocities[partnerIndex]);
+		++_resolutionLevels[particleIndex];
+		_resolutionAges[particleIndex] = 0;
+		_resolutionChanges[particleIndex] = ResolutionChange::None;
+		++changeCount;
+	}
 
-			// Check if the velocity is facing ooposite direction of the surface normal
-			if (normalDotRelativeVelocity < 0.0f)
-			{
-				// Apply restitution coefficient to the surface normal component of the velocity
-				glm::vec3 deltaRelativeVelocityN = (-_simulationParameters->_restitutionCoefficient - 1.0f) * relativeVelocityN;
-				relativeVelocityN *= -_simulationParameters->_restitutionCoefficient;
+	if (changeCount > 0) ApplyResolutionChanges();
+}
 
-				// Apply friction to the tangential component of the velocity
-				if (relativeVelocityT.length() > 0.0f)
-				{
-					float frictionScale = std::max(1.0f - _simulationParameters->_frictionCoefficient * deltaRelativeVelocityN.length() / relativeVelocityT.length(), 0.0f);
-					relativeVelocityT *= frictionScale;
-				}
+// Split the particles above the level until none is left, between steps
+void CPUSimulatedScene::RefineResolution(uint32_t maxLevel)
+{
+	auto isAboveLevel = [maxLevel](uint8_t level) { return level > maxLevel; };
+	if (std::none_of(_resolutionLevels.cbegin(), _resolutionLevels.cbegin() + _particleCount, isAboveLevel)) return;
 
-				// Apply the velocity
-				_nextVelocities[particleIndex] = relativeVelocityN + relativeVelocityT + collisionPointVelocity;
-			}
+	// Splits act on the state after a step, which the current state stands in for
+	std::copy(_positions.cbegin(), _positions.cend(), _nextPositions.begin());
+	std::copy(_velocities.cbegin(), _velocities.cend(), _nextVelocities.begin());
 
-			// Apply the position
-			_nextPositions[particleIndex] = targetPoint;
+	while (std::any_of(_resolutionLevels.cbegin(), _resolutionLevels.cbegin() + _particleCount, isAboveLevel))
+	{
+		_resolutionChanges.assign(_particleCount, ResolutionChange::None);
+		for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+		{
+			if (isAboveLevel(_resolutionLevels[particleIndex])) _resolutionChanges[particleIndex] = ResolutionChange::Split;
 		}
+
+		ApplyResolutionChanges();
 	}
+
+	std::copy(_nextPositions.cbegin(), _nextPositions.cend(), _positions.begin());
+	std::copy(_nextVelocities.cbegin(), _nextVelocities.cend(), _velocities.begin());
 }
 
-void CPUSimulatedScene::TimeIntegration(float deltaSecond)
+// Compact the particles that are kept into the front of the arrays, then append the second halves of the split ones.
+// Splits alternate between the axes by level, so that a particle split all the way down spreads into a block rather than a line.
+void CPUSimulatedScene::ApplyResolutionChanges()
 {
-	#pragma omp parallel for
+	std::vector<uint32_t> splitIndices;
+	size_t keptCount = 0;
 	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
 	{
-		// Integrate velocity
-		_nextVelocities[particleIndex] = _velocities[particleIndex] + deltaSecond * (_forces[particleIndex] / _simulationParameters->_particleMass);
+		ResolutionChange change = _resolutionChanges[particleIndex];
+		if (change == ResolutionChange::Remove) continue;
+		if (change == ResolutionChange::Split) splitIndices.push_back(static_cast<uint32_t>(keptCount));
 
-		// Integrate position
-		_nextPositions[particleIndex] = _positions[particleIndex] + deltaSecond * _nextVelocities[particleIndex];
+		_nextPositions[keptCount] = _nextPositions[particleIndex];
+		_nextVelocities[keptCount] = _nextVelocities[particleIndex];
+		_resolutionLevels[keptCount] = _resolutionLevels[particleIndex];
+		_resolutionAges[keptCount] = _resolutionAges[particleIndex];
+		++keptCount;
 	}
-}
 
-glm::vec3 CPUSimulatedScene::GetWindVelocityAt(glm::vec3 samplePosition)
-{
-	return glm::vec3{}; // Temp
-}
+	size_t splitCount = splitIndices.size();
+	_particleCount = keptCount + splitCount;
+	_publishedParticleCount.store(_particleCount, std::memory_order_relaxed);
+	ResizeParticleArrays(_particleCount);
 
-float CPUSimulatedScene::ComputePressureFromEOS(float density, float targetDensity, float eosScale, float eosExponent)
-{
-	float pressure = eosScale * (std::pow(density / targetDensity, eosExponent) - 1.0f) / eosExponent;
-	if (pressure < 0.0f) pressure = 0.0f;
-	return pressure;
+	_splitParticles.resize(2 * splitCount);
+	#pragma omp parallel for
+	for (size_t splitIndex = 0; splitIndex < splitCount; ++splitIndex)
+	{
+		size_t firstIndex = splitIndices[splitIndex];
+		size_t secondIndex = keptCount + splitIndex;
+
+		uint8_t level = static_cast<uint8_t>(_resolutionLevels[firstIndex] - 1);
+		glm::vec3 offset{};
+		offset[level % 3] = _stepParameters._particleRadius * RESOLUTION_SCALES[level];
+
+		// The halves are traced from the center of the parent, so that neither is left inside a collider
+		glm::vec3 center = _nextPositions[firstIndex];
+		_positions[firstIndex] = center;
+		_positions[secondIndex] = center;
+		_nextPositions[firstIndex] = center - offset;
+		_nextPositions[secondIndex] = center + offset;
+		_nextVelocities[secondIndex] = _nextVelocities[firstIndex];
+
+		_resolutionLevels[firstIndex] = level;
+		_resolutionLevels[secondIndex] = level;
+		_resolutionAges[firstIndex] = 0;
+		_resolutionAges[secondIndex] = 0;
+
+		_splitParticles[2 * splitIndex] = static_cast<uint32_t>(firstIndex);
+		_splitParticles[2 * splitIndex + 1] = static_cast<uint32_t>(secondIndex);
+	}
+
+	// Indices have moved, so the activity of the particles is measured anew
+	_activityGrid.WakeAll();
+	_sleepingParticleCount.store(0, std::memory_order_relaxed);
+
+	if (_stepColliderMode == ColliderMode::SDF)
+	{
+		#pragma omp parallel for
+		for (size_t order = 0; order < _splitParticles.size(); ++order)
+		{
+			ResolveSDFCollision(_splitParticles[order]);
+		}
+	}
+	else
+	{
+		size_t collisionCount = _splitParticles.size();
+		int64_t packetCount = static_cast<int64_t>(DivisionCeil(static_cast<uint32_t>(collisionCount), BVH::PACKET_SIZE));
+
+		#pragma omp parallel for
+		for (int64_t packetIndex = 0; packetIndex < packetCount; ++packetIndex)
+		{
+			size_t packetBegin = packetIndex * BVH::PACKET_SIZE;
+			uint32_t laneCount = static_cast<uint32_t>(std::min<size_t>(BVH::PACKET_SIZE, collisionCount - packetBegin));
+			ResolvePacketCollision(&_splitParticles[packetBegin], laneCount);
+		}
+	}
+
+	size_t mergedCount = 0;
+	#pragma omp parallel for reduction(+:mergedCount)
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		if (_resolutionLevels[particleIndex] > 0) ++mergedCount;
+	}
+	_mergedParticleCount.store(mergedCount, std::memory_order_relaxed);
 }
 
-void CPUSimulatedScene::UpdateDensities()
+// Sinks free the slots of the particles they have caught, emitted particles take the freed slots first and then the slots past the end,
+// and the particles at the end fill the holes that are left. The arrays are dense again before the next step, so no pass of a step sees a removed particle.
+// Only the state that outlives a step moves with a particle; the rest is rebuilt by the step.
+void CPUSimulatedScene::UpdateFlow(float timeStep)
 {
-	#pragma omp parallel for
+	// Splits, merges and migration change the count outside the pool
+	if (_particlePool.GetCount() != _particleCount) _particlePool.Reset(std::max(_particleCapacity, _particleCount), _particleCount);
+
+	size_t removedCount = 0;
 	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
 	{
-		float sum = _kernel->GetValue(0.0f);
-		_hashGrid->ForEachNeighborParticle
-		(
-			_positions,
-			particleIndex,
-			[&](size_t neighborIndex)
-			{
-				float distance = glm::distance(_positions[particleIndex], _positions[neighborIndex]);
-				sum += _kernel->GetValue(distance);
-			}
-		);
+		if (!_stepFlow.IsSunk(_positions[particleIndex])) continue;
+
+		_particlePool.Free(particleIndex);
+		++removedCount;
+	}
+
+	_emittedPositions.clear();
+	_emittedVelocities.clear();
+	_emittedSlots.clear();
+	_stepFlow.Emit(timeStep, _particleDistance, _emittedPositions, _emittedVelocities);
+
+	// Each rank keeps the particles that enter its own slab
+	if (_decomposition != nullptr)
+	{
+		size_t ownedCount = 0;
+		for (size_t emittedIndex = 0; emittedIndex < _emittedPositions.size(); ++emittedIndex)
+		{
+			if (!_decomposition->IsOwned(*_hashGrid, _emittedPositions[emittedIndex])) continue;
+
+			_emittedPositions[ownedCount] = _emittedPositions[emittedIndex];
+			_emittedVelocities[ownedCount] = _emittedVelocities[emittedIndex];
+			++ownedCount;
+		}
 
-		_densities[particleIndex] = sum * _simulationParameters->_particleMass;
+		_emittedPositions.resize(ownedCount);
+		_emittedVelocities.resize(ownedCount);
 	}
+
+	size_t slot = 0;
+	while (_emittedSlots.size() < _emittedPositions.size() && _particlePool.Allocate(slot))
+	{
+		_emittedSlots.push_back(slot);
+	}
+
+	if (removedCount == 0 && _emittedSlots.empty()) return;
+
+	ResizeParticleArrays(std::max(_particleCount, _particlePool.GetCount()));
+	for (size_t emittedIndex = 0; emittedIndex < _emittedSlots.size(); ++emittedIndex)
+	{
+		size_t slot = _emittedSlots[emittedIndex];
+		_positions[slot] = _emittedPositions[emittedIndex];
+		_velocities[slot] = _emittedVelocities[emittedIndex];
+		_densityStiffnesses[slot] = 0.0f;
+		_divergenceStiffnesses[slot] = 0.0f;
+		_viscosityCorrections[slot] = glm::vec3{};
+		_resolutionLevels[slot] = 0;
+		_resolutionAges[slot] = 0;
+	}
+
+	_particlePool.Compact
+	(
+		[this](size_t from, size_t to)
+		{
+			_positions[to] = _positions[from];
+			_velocities[to] = _velocities[from];
+			_densityStiffnesses[to] = _densityStiffnesses[from];
+			_divergenceStiffnesses[to] = _divergenceStiffnesses[from];
+			_viscosityCorrections[to] = _viscosityCorrections[from];
+			_resolutionLevels[to] = _resolutionLevels[from];
+			_resolutionAges[to] = _resolutionAges[from];
+		}
+	);
+
+	_particleCount = _particlePool.GetCount();
+	_publishedParticleCount.store(_particleCount, std::memory_order_relaxed);
+	ResizeParticleArrays(_particleCount);
+
+	// Indices have moved, so the activity of the particles is measured anew
+	_activityGrid.WakeAll();
+	_sleepingParticleCount.store(0, std::memory_order_relaxed);
+
+	if (IsResolutionAdaptive())
+	{
+		size_t mergedCount = static_cast<size_t>(std::count_if(_resolutionLevels.cbegin(), _resolutionLevels.cend(), [](uint8_t level) { return level > 0; }));
+		_mergedParticleCount.store(mergedCount, std::memory_order_relaxed);
+	}
+}
+
+// Settle which particles this rank owns after the last step, then borrow the ghosts that the owned particles see across the slab boundaries.
+// Ghosts take part in the neighbor search and in the pressures, but only owned particles are stepped.
+void CPUSimulatedScene::ExchangeParticles()
+{
+	_particleCount = _decomposition->Migrate(*_hashGrid, _positions, _velocities, _particleCount);
+	_publishedParticleCount.store(_particleCount, std::memory_order_relaxed);
+	_ghostCount = _decomposition->ExchangeHalo(*_hashGrid, _positions, _velocities, _particleCount);
+	ResizeParticleArrays(_particleCount + _ghostCount);
+}
+
+void CPUSimulatedScene::EndTimeStep()
+{
+	// Apply velocities and positions are applied
+	std::copy(_nextPositions.cbegin(), _nextPositions.cend(), _positions.begin());
+	std::copy(_nextVelocities.cbegin(), _nextVelocities.cend(), _velocities.begin());
+
+	// Set other components to zero
+	std::fill(_forces.begin(), _forces.end(), glm::vec3{});
+	std::fill(_densities.begin(), _densities.end(), 0.0f);
+	std::fill(_pressures.begin(), _pressures.end(), 0.0f);
+
+	// Ghosts are borrowed anew at the next step
+	if (_ghostCount > 0)
+	{
+		_ghostCount = 0;
+		ResizeParticleArrays(_particleCount);
+	}
+}
+
+void CPUSimulatedScene::Update(float deltaSecond)
+{
+	// With adaptive time steps, cover the wall time of the frame in as many substeps as the stability limits require.
+	// Otherwise, take fixed steps. Either way, the substep count multiplies the simulated time per frame.
+	float frameTime = _stepParameters._isTimeStepAdaptive ? std::min(deltaSecond, MAX_FRAME_TIME) : _stepParameters._timeStep;
+	float remainingTime = frameTime * _stepSubstepCount;
+	// Ghosts are handled by the OpenMP step alone, and with the equation of state. Ranks take the same time steps, so they run the same number of steps in lockstep.
+	// The iterative solvers, sleeping and adaptive resolution run on OpenMP loops as well.
+	PressureSolver pressureSolver = (_decomposition != nullptr) ? PressureSolver::EOS : static_cast<PressureSolver>(_stepParameters._pressureSolver);
+	SolverScheduler scheduler = (pressureSolver != PressureSolver::EOS || IsViscosityImplicit() || IsSleepingEnabled() || IsResolutionAdaptive()) ? SolverScheduler::OpenMP : _stepScheduler;
+
+	// Particles left asleep by an earlier setting would stay frozen in the other steps
+	if (!IsSleepingEnabled() && _activityGrid.GetSleepingCount() > 0)
+	{
+		_activityGrid.WakeAll();
+		_sleepingParticleCount.store(0, std::memory_order_relaxed);
+	}
+
+	for (uint32_t substep = 0; substep < MAX_SUBSTEPS * _stepSubstepCount && remainingTime >= MIN_TIME_STEP; ++substep)
+	{
+		auto stepBegin = std::chrono::high_resolution_clock::now();
+
+		float timeStep = 0.0f;
+		if (pressureSolver == PressureSolver::DFSPH) timeStep = DFSPHStep(remainingTime);
+		else if (pressureSolver == PressureSolver::PBF) timeStep = PBFStep(remainingTime);
+		else if (scheduler == SolverScheduler::TaskGraph) timeStep = TaskGraphStep(remainingTime);
+		else timeStep = OpenMPStep(remainingTime);
+		remainingTime -= timeStep;
+		if (!_stepFlow.IsEmpty()) UpdateFlow(timeStep);
+
+		// Keep a moving average of the wall time per step for each scheduler, so that they can be compared on the same scene
+		float stepTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - stepBegin).count();
+		auto &averageStepTime = _averageStepTimes[static_cast<size_t>(scheduler)];
+		float previousAverage = averageStepTime.load(std::memory_order_relaxed);
+		averageStepTime.store(previousAverage == 0.0f ? stepTime : glm::mix(previousAverage, stepTime, STEP_TIME_SMOOTHING), std::memory_order_relaxed);
+	}
+
+	std::lock_guard<std::mutex> lock(_gridStatisticsMutex);
+	_gridStatistics = _hashGrid->GetStatistics();
+}
+
+// Each phase is a parallel loop over all particles followed by an implicit barrier
+float CPUSimulatedScene::OpenMPStep(float remainingTime)
+{
+	BeginTimeStep();
+	if (IsSleepingEnabled()) UpdateActivity();
+
+	AccumulateForces();
+	float timeStep = ComputeTimeStep();
+	if (_decomposition != nullptr) timeStep = _decomposition->ReduceMin(timeStep);
+	timeStep = ClampToRemainingTime(timeStep, remainingTime);
+	TimeIntegration(timeStep);
+	if (IsViscosityImplicit()) _viscosityIterations.store(SolveViscosity(timeStep), std::memory_order_relaxed);
+	ResolveCollision();
+	if (IsResolutionAdaptive()) UpdateResolution();
+
+	EndTimeStep();
+
+	return timeStep;
+}
+
+// Divergence-free SPH (Bender and Koschier, 2015)
+// Pressure is solved for instead of being derived from the density, so the time step is bound by the speeds of particles rather than the speed of sound.
+// The divergence solve removes the compression rate that the last step has left, and the density solve removes the compression that the coming step would cause.
+float CPUSimulatedScene::DFSPHStep(float remainingTime)
+{
+	BeginTimeStep();
+
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		UpdateDFSPHFactor(particleIndex);
+	}
+
+	// The velocities have been produced by the last step, so they are corrected over that step
+	if (_previousTimeStep == 0.0f) _previousTimeStep = _stepParameters._timeStep;
+	_solverIterations[0].store(SolvePressure(_velocities, _divergenceStiffnesses, _previousTimeStep, false), std::memory_order_relaxed);
+
+	AccumulateExternalForce();
+	if (!IsViscosityImplicit()) AccumulateViscosityForce();
+	float timeStep = ClampToRemainingTime(ComputeTimeStep(), remainingTime);
+	TimeIntegration(timeStep);
+	if (IsViscosityImplicit()) _viscosityIterations.store(SolveViscosity(timeStep), std::memory_order_relaxed);
+
+	// Positions follow the corrected velocities
+	_solverIterations[1].store(SolvePressure(_nextVelocities, _densityStiffnesses, timeStep, true), std::memory_order_relaxed);
+
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		_nextPositions[particleIndex] = _positions[particleIndex] + timeStep * _nextVelocities[particleIndex];
+	}
+
+	ResolveCollision();
+	EndTimeStep();
+
+	_previousTimeStep = timeStep;
+	return timeStep;
+}
+
+// Position based fluids (Macklin and Müller, 2013)
+// Predicted positions are projected onto constraints that keep the density at rest, which stays stable at time steps as long as a frame.
+// XSPH takes the place of the viscosity force.
+float CPUSimulatedScene::PBFStep(float remainingTime)
+{
+	AccumulateExternalForce();
+	float timeStep = ClampToRemainingTime(ComputeTimeStep(), remainingTime);
+	TimeIntegration(timeStep);
+
+	// Neighbors are found once around the predicted positions
+	_hashGrid->UpdateGrid(_nextPositions);
+
+	uint32_t iterationCount = std::clamp(_stepParameters._constraintIterations, 1u, MAX_SOLVER_ITERATIONS);
+	for (uint32_t iteration = 0; iteration < iterationCount; ++iteration)
+	{
+		#pragma omp parallel for
+		for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+		{
+			UpdateConstraintLambda(particleIndex);
+		}
+
+		#pragma omp parallel for
+		for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+		{
+			UpdatePositionCorrection(particleIndex);
+		}
+
+		#pragma omp parallel for
+		for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+		{
+			_nextPositions[particleIndex] += _pbfCorrections[particleIndex];
+		}
+	}
+
+	// Velocities follow the projected positions
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		_nextVelocities[particleIndex] = (_nextPositions[particleIndex] - _positions[particleIndex]) / timeStep;
+	}
+
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		UpdateXSPHCorrection(particleIndex);
+	}
+
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		_nextVelocities[particleIndex] += _pbfCorrections[particleIndex];
+	}
+
+	ResolveCollision();
+	EndTimeStep();
+
+	return timeStep;
+}
+
+// Phases are split into tasks over blocks of particles, and each task waits only for the data it reads.
+// Densities and external forces do not depend on each other, and a block can integrate and collide
+// as soon as its own forces are done unless the time step has to be reduced over all particles first.
+float CPUSimulatedScene::TaskGraphStep(float remainingTime)
+{
+	if (_taskScheduler == nullptr) _taskScheduler = std::make_unique<TaskScheduler>();
+
+	_hashGrid->UpdateGrid(_positions);
+	UpdateBlocks();
+
+	size_t blockCount = _blockBounds.size() - 1;
+	_blockMaxima.assign(blockCount, glm::vec2(0.0f));
+	_blockTimeStep = ClampToRemainingTime(_stepParameters._timeStep, remainingTime);
+
+	_stepGraph.Clear();
+
+	// Densities and pressures, which are read from neighbors in other blocks
+	std::vector<TaskGraph::TaskID> densityTasks(blockCount);
+	for (size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+	{
+		densityTasks[blockIndex] = _stepGraph.AddTask
+		(
+			[this, blockIndex]()
+			{
+				ForEachParticleInBlock(blockIndex, [this](size_t particleIndex) { UpdateDensity(particleIndex); UpdatePressure(particleIndex); });
+			}
+		);
+	}
+	TaskGraph::TaskID densityJoin = _stepGraph.AddTask(nullptr, densityTasks);
+
+	// Forces accumulate into the particles of the block in a fixed order
+	std::vector<TaskGraph::TaskID> forceTasks(blockCount);
+	for (size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+	{
+		TaskGraph::TaskID externalForceTask = _stepGraph.AddTask
+		(
+			[this, blockIndex]()
+			{
+				ForEachParticleInBlock(blockIndex, [this](size_t particleIndex) { AccumulateExternalForce(particleIndex); });
+			}
+		);
+
+		TaskGraph::TaskID viscosityForceTask = _stepGraph.AddTask
+		(
+			[this, blockIndex]()
+			{
+				ForEachParticleInBlock(blockIndex, [this](size_t particleIndex) { AccumulateViscosityForce(particleIndex); });
+			},
+			{ externalForceTask, densityJoin }
+		);
+
+		forceTasks[blockIndex] = _stepGraph.AddTask
+		(
+			[this, blockIndex]()
+			{
+				glm::vec2 maxima(0.0f); // Squared speed and force
+				ForEachParticleInBlock
+				(
+					blockIndex,
+					[&](size_t particleIndex)
+					{
+						AccumulatePressureForce(particleIndex);
+						maxima = glm::max(maxima, glm::vec2(glm::dot(_velocities[particleIndex], _velocities[particleIndex]), glm::dot(_forces[particleIndex], _forces[particleIndex])));
+					}
+				);
+				_blockMaxima[blockIndex] = maxima;
+			},
+			{ viscosityForceTask }
+		);
+	}
+
+	// An adaptive time step joins all blocks
+	std::vector<TaskGraph::TaskID> timeStepTasks;
+	if (_stepParameters._isTimeStepAdaptive)
+	{
+		timeStepTasks.push_back
+		(
+			_stepGraph.AddTask
+			(
+				[this, remainingTime]()
+				{
+					glm::vec2 maxima(0.0f);
+					for (const auto &blockMaxima : _blockMaxima) maxima = glm::max(maxima, blockMaxima);
+
+					float maxSpeed = std::sqrt(maxima.x);
+					float maxAcceleration = std::sqrt(maxima.y) / _stepParameters._particleMass;
+					_blockTimeStep = ClampToRemainingTime(ComputeAdaptiveTimeStep(_stepParameters, maxSpeed, maxAcceleration), remainingTime);
+				},
+				forceTasks
+			)
+		);
+	}
+
+	for (size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+	{
+		TaskGraph::TaskID integrationTask = _stepGraph.AddTask
+		(
+			[this, blockIndex]()
+			{
+				ForEachParticleInBlock(blockIndex, [this](size_t particleIndex) { Integrate(particleIndex, _blockTimeStep); });
+			},
+			timeStepTasks.empty() ? std::vector<TaskGraph::TaskID>{ forceTasks[blockIndex] } : timeStepTasks
+		);
+
+		_stepGraph.AddTask([this, blockIndex]() { ResolveBlockCollision(blockIndex); }, { integrationTask });
+	}
+
+	_taskScheduler->Run(_stepGraph);
+	EndTimeStep();
+
+	return _blockTimeStep;
+}
+
+// Blocks are runs of whole buckets in the bucket order, so the particles of a block lie in a few compact cells.
+void CPUSimulatedScene::UpdateBlocks()
+{
+	_blockOrder.clear();
+	_blockBounds.assign(1, 0);
+	for (const auto &bucket : _hashGrid->GetBuckets())
+	{
+		if (bucket.empty()) continue;
+
+		_blockOrder.insert(_blockOrder.end(), bucket.begin(), bucket.end());
+		if (_blockOrder.size() - _blockBounds.back() >= BLOCK_SIZE) _blockBounds.push_back(_blockOrder.size());
+	}
+
+	if (_blockBounds.back() != _blockOrder.size()) _blockBounds.push_back(_blockOrder.size());
+}
+
+void CPUSimulatedScene::AccumulateForces()
+{
+	AccumulateExternalForce();
+	if (!IsViscosityImplicit()) AccumulateViscosityForce();
+	AccumulatePressureForce();
+}
+
+void CPUSimulatedScene::AccumulateExternalForce()
+{
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		AccumulateExternalForce(particleIndex);
+	}
+}
+
+void CPUSimulatedScene::AccumulateExternalForce(size_t particleIndex)
+{
+	if (_activityGrid.IsSleeping(particleIndex)) return;
+
+	// Apply gravity
+	glm::vec3 externalForce = _stepParameters._particleMass * _stepParameters._gravitiy.xyz;
+
+	// Apply wind forces
+	glm::vec3 relativeVelocity = _velocities[particleIndex] - GetWindVelocityAt(_positions[particleIndex]);
+	externalForce += -_stepParameters._dragCoefficient * relativeVelocity;
+
+	// A merged particle bears the forces of all the particles it stands for
+	_forces[particleIndex] += static_cast<float>(1u << _resolutionLevels[particleIndex]) * externalForce;
+}
+
+void CPUSimulatedScene::AccumulateViscosityForce()
+{
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		AccumulateViscosityForce(particleIndex);
+	}
+}
+
+void CPUSimulatedScene::AccumulateViscosityForce(size_t particleIndex)
+{
+	if (_activityGrid.IsSleeping(particleIndex)) return;
+
+	_hashGrid->ForEachNeighborParticle
+	(
+		_positions,
+		particleIndex,
+		[&](size_t neighborIndex)
+		{
+			float distance = glm::distance(_positions[particleIndex], _positions[neighborIndex]);
+			float kernelScale = GetKernelScale(particleIndex, neighborIndex);
+			_forces[particleIndex] += _stepParameters._viscosityCoefficient * (GetParticleMass(particleIndex) * GetParticleMass(neighborIndex)) * (_velocities[neighborIndex] - _velocities[particleIndex]) * _kernel->SecondDerivative(distance, kernelScale) / _densities[neighborIndex];
+		}
+	);
+}
+
+void CPUSimulatedScene::AccumulatePressureForce()
+{
+	// Compute pressures, including those of ghosts from their exchanged densities
+	size_t pressureCount = _particleCount + _ghostCount;
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < pressureCount; ++particleIndex)
+	{
+		UpdatePressure(particleIndex);
+	}
+
+	// Compute pressure forces from the pressures
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		AccumulatePressureForce(particleIndex);
+	}
+}
+
+void CPUSimulatedScene::UpdatePressure(size_t particleIndex)
+{
+	float eosScale = _stepParameters._targetDensity * (_stepParameters._soundSpeed * _stepParameters._soundSpeed) / _stepParameters._eosExponent;
+	_pressures[particleIndex] = ComputePressureFromEOS(_densities[particleIndex], _stepParameters._targetDensity, eosScale, _stepParameters._eosExponent);
+}
+
+void CPUSimulatedScene::AccumulatePressureForce(size_t particleIndex)
+{
+	if (_activityGrid.IsSleeping(particleIndex)) return;
+
+	_hashGrid->ForEachNeighborParticle
+	(
+		_positions,
+		particleIndex,
+		[&](size_t neighborIndex)
+		{
+			// The particle itself has no offset and thus no gradient
+			glm::vec3 offset = _positions[neighborIndex] - _positions[particleIndex];
+			_forces[particleIndex] -=
+				(GetParticleMass(particleIndex) * GetParticleMass(neighborIndex)) * 
+				_kernel->GradientFromOffset(offset, GetKernelScale(particleIndex, neighborIndex)) * 
+				(_pressures[particleIndex] / (_densities[particleIndex] * _densities[particleIndex]) + _pressures[neighborIndex] / (_densities[neighborIndex] * _densities[neighborIndex]));
+		}
+	);
+}
+
+bool CPUSimulatedScene::IsViscosityImplicit() const
+{
+	// Ghosts carry no velocities after the step and the warm start is not migrated, so slab boundaries would act as walls
+	bool isImplicit = static_cast<ViscositySolver>(_stepParameters._viscositySolver) == ViscositySolver::Implicit && _stepParameters._viscosityCoefficient > 0.0f;
+	return isImplicit && _decomposition == nullptr;
+}
+
+// Implicit viscosity solves for the velocities after the step, v = v* + dt * (viscous acceleration of v), instead of applying a force from the velocities before it.
+// Each row is scaled by the volume of its particle, which makes the system symmetric positive definite, so conjugate gradient applies:
+// (m / density_i) v_i + dt * mu * sum_j m^2 / (density_i * density_j) * L_ij * (v_i - v_j) = (m / density_i) v*_i
+// L_ij = 2 |W'(r_ij)| / r_ij is the Laplacian of Brookshaw (1985), which stays positive where the second derivative of the kernel does not.
+// The system is applied over the neighbors without being assembled, and the three components share one solve.
+// The solve starts from the velocity changes of the last one and stops when the residual falls below the tolerance relative to the right-hand side.
+// Returns the number of iterations taken.
+uint32_t CPUSimulatedScene::SolveViscosity(float timeStep)
+{
+	float viscosityScale = timeStep * _stepParameters._viscosityCoefficient * _stepParameters._particleMass * _stepParameters._particleMass;
+
+	// Warm start from the last changes, which are replaced by the velocities before the solve until it is done
+	double squaredRightHandSideNorm = 0.0;
+	#pragma omp parallel for reduction(+:squaredRightHandSideNorm)
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		float volume = _stepParameters._particleMass / _densities[particleIndex];
+		float diagonal = volume;
+		_hashGrid->ForEachNeighborParticle
+		(
+			_positions,
+			particleIndex,
+			[&](size_t neighborIndex)
+			{
+				float distance = glm::distance(_positions[particleIndex], _positions[neighborIndex]);
+				if (distance > 0.0f) diagonal += viscosityScale * 2.0f * std::abs(_kernel->FirstDerivative(distance)) / (distance * _densities[particleIndex] * _densities[neighborIndex]);
+			}
+		);
+		_viscosityDiagonals[particleIndex] = diagonal;
+
+		glm::vec3 rightHandSide = volume * _nextVelocities[particleIndex];
+		squaredRightHandSideNorm += glm::dot(rightHandSide, rightHandSide);
+
+		glm::vec3 lastCorrection = _viscosityCorrections[particleIndex];
+		_viscosityCorrections[particleIndex] = _nextVelocities[particleIndex];
+		_nextVelocities[particleIndex] += lastCorrection;
+	}
+
+	double residualDotPreconditioned = 0.0;
+	double squaredResidualNorm = 0.0;
+	#pragma omp parallel for reduction(+:residualDotPreconditioned, squaredResidualNorm)
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		glm::vec3 rightHandSide = (_stepParameters._particleMass / _densities[particleIndex]) * _viscosityCorrections[particleIndex];
+		glm::vec3 residual = rightHandSide - MultiplyViscositySystem(particleIndex, _nextVelocities, viscosityScale);
+		_viscosityResiduals[particleIndex] = residual;
+		_viscosityDirections[particleIndex] = residual / _viscosityDiagonals[particleIndex];
+
+		residualDotPreconditioned += glm::dot(residual, _viscosityDirections[particleIndex]);
+		squaredResidualNorm += glm::dot(residual, residual);
+	}
+
+	double squaredTolerance = static_cast<double>(_stepParameters._viscosityTolerance) * _stepParameters._viscosityTolerance * squaredRightHandSideNorm;
+	uint32_t maxIterations = std::clamp(_stepParameters._maxSolverIterations, MIN_SOLVER_ITERATIONS, MAX_SOLVER_ITERATIONS);
+
+	uint32_t iteration = 0;
+	for (; iteration < maxIterations && squaredResidualNorm > squaredTolerance; ++iteration)
+	{
+		double directionDotProduct = 0.0;
+		#pragma omp parallel for reduction(+:directionDotProduct)
+		for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+		{
+			_viscosityProducts[particleIndex] = MultiplyViscositySystem(particleIndex, _viscosityDirections, viscosityScale);
+			directionDotProduct += glm::dot(_viscosityDirections[particleIndex], _viscosityProducts[particleIndex]);
+		}
+
+		if (directionDotProduct <= 0.0) break;
+		float stepLength = static_cast<float>(residualDotPreconditioned / directionDotProduct);
+
+		double nextResidualDotPreconditioned = 0.0;
+		squaredResidualNorm = 0.0;
+		#pragma omp parallel for reduction(+:nextResidualDotPreconditioned, squaredResidualNorm)
+		for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+		{
+			_nextVelocities[particleIndex] += stepLength * _viscosityDirections[particleIndex];
+			_viscosityResiduals[particleIndex] -= stepLength * _viscosityProducts[particleIndex];
+
+			glm::vec3 residual = _viscosityResiduals[particleIndex];
+			nextResidualDotPreconditioned += glm::dot(residual, residual / _viscosityDiagonals[particleIndex]);
+			squaredResidualNorm += glm::dot(residual, residual);
+		}
+
+		float directionScale = static_cast<float>(nextResidualDotPreconditioned / residualDotPreconditioned);
+		residualDotPreconditioned = nextResidualDotPreconditioned;
+
+		#pragma omp parallel for
+		for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+		{
+			_viscosityDirections[particleIndex] = _viscosityResiduals[particleIndex] / _viscosityDiagonals[particleIndex] + directionScale * _viscosityDirections[particleIndex];
+		}
+	}
+
+	// Keep the changes for the next warm start, and move the particles with the solved velocities
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		_viscosityCorrections[particleIndex] = _nextVelocities[particleIndex] - _viscosityCorrections[particleIndex];
+		_nextPositions[particleIndex] = _positions[particleIndex] + timeStep * _nextVelocities[particleIndex];
+	}
+
+	return iteration;
+}
+
+glm::vec3 CPUSimulatedScene::MultiplyViscositySystem(size_t particleIndex, const FirstTouchVector<glm::vec3> &values, float viscosityScale)
+{
+	glm::vec3 laplacian{};
+	_hashGrid->ForEachNeighborParticle
+	(
+		_positions,
+		particleIndex,
+		[&](size_t neighborIndex)
+		{
+			float distance = glm::distance(_positions[particleIndex], _positions[neighborIndex]);
+			if (distance > 0.0f) laplacian += 2.0f * std::abs(_kernel->FirstDerivative(distance)) / (distance * _densities[neighborIndex]) * (values[particleIndex] - values[neighborIndex]);
+		}
+	);
+
+	return (_stepParameters._particleMass / _densities[particleIndex]) * values[particleIndex] + viscosityScale * laplacian / _densities[particleIndex];
+}
+
+void CPUSimulatedScene::ResolveCollision()
+{
+	if (_stepColliderMode == ColliderMode::SDF)
+	{
+		#pragma omp parallel for
+		for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+		{
+			ResolveSDFCollision(particleIndex);
+		}
+
+		return;
+	}
+
+	// Particles in the same bucket are close to each other, so their segments tend to visit the same BVH nodes.
+	// Trace them together as packets in the bucket order, leaving out particles that are too far from any collider to hit it.
+	_collisionOrder.clear();
+	for (const auto &bucket : _hashGrid->GetBuckets())
+	{
+		for (uint32_t particleIndex : bucket)
+		{
+			if (particleIndex >= _particleCount) continue; // Ghosts are resolved by their owners
+			if (_activityGrid.IsSleeping(particleIndex)) continue;
+
+			if (_occupancyGrid->IsNearCollider(_positions[particleIndex], _nextPositions[particleIndex])) _collisionOrder.push_back(particleIndex);
+		}
+	}
+
+	size_t collisionCount = _collisionOrder.size();
+	int64_t packetCount = static_cast<int64_t>(DivisionCeil(static_cast<uint32_t>(collisionCount), BVH::PACKET_SIZE));
+
+	#pragma omp parallel for
+	for (int64_t packetIndex = 0; packetIndex < packetCount; ++packetIndex)
+	{
+		size_t packetBegin = packetIndex * BVH::PACKET_SIZE;
+		uint32_t laneCount = static_cast<uint32_t>(std::min<size_t>(BVH::PACKET_SIZE, collisionCount - packetBegin));
+		ResolvePacketCollision(&_collisionOrder[packetBegin], laneCount);
+	}
+}
+
+// Collision of the particles in a block; blocks are made of whole buckets, so they make packets as coherent as the global order does.
+void CPUSimulatedScene::ResolveBlockCollision(size_t blockIndex)
+{
+	if (_stepColliderMode == ColliderMode::SDF)
+	{
+		ForEachParticleInBlock(blockIndex, [this](size_t particleIndex) { ResolveSDFCollision(particleIndex); });
+		return;
+	}
+
+	std::vector<uint32_t> collisionOrder;
+	ForEachParticleInBlock
+	(
+		blockIndex,
+		[&](size_t particleIndex)
+		{
+			if (_occupancyGrid->IsNearCollider(_positions[particleIndex], _nextPositions[particleIndex])) collisionOrder.push_back(static_cast<uint32_t>(particleIndex));
+		}
+	);
+
+	for (size_t packetBegin = 0; packetBegin < collisionOrder.size(); packetBegin += BVH::PACKET_SIZE)
+	{
+		uint32_t laneCount = static_cast<uint32_t>(std::min<size_t>(BVH::PACKET_SIZE, collisionOrder.size() - packetBegin));
+		ResolvePacketCollision(&collisionOrder[packetBegin], laneCount);
+	}
+}
+
+void CPUSimulatedScene::ResolveSDFCollision(size_t particleIndex)
+{
+	if (_activityGrid.IsSleeping(particleIndex)) return;
+
+	// Check if the new position is penetrating any surface
+	Intersection intersection{};
+	if (_sdf->GetIntersection(_nextPositions[particleIndex], &intersection))
+	{
+		ResolveContact(particleIndex, intersection);
+	}
+}
+
+void CPUSimulatedScene::ResolvePacketCollision(const uint32_t *particleIndices, uint32_t laneCount)
+{
+	std::array<glm::vec3, BVH::PACKET_SIZE> currentPositions{};
+	std::array<glm::vec3, BVH::PACKET_SIZE> nextPositions{};
+	for (uint32_t lane = 0; lane < laneCount; ++lane)
+	{
+		uint32_t particleIndex = particleIndices[lane];
+		currentPositions[lane] = _positions[particleIndex];
+		nextPositions[lane] = _nextPositions[particleIndex];
+	}
+
+	// Check if the new positions are penetrating any surface
+	std::array<Intersection, BVH::PACKET_SIZE> intersections{};
+	uint32_t hitMask = _bvh->GetIntersections(currentPositions.data(), nextPositions.data(), laneCount, intersections.data());
+	for (uint32_t lane = 0; lane < laneCount; ++lane)
+	{
+		if (hitMask & (1u << lane)) ResolveContact(particleIndices[lane], intersections[lane]);
+	}
+}
+
+void CPUSimulatedScene::ResolveContact(size_t particleIndex, const Intersection &intersection)
+{
+	SimulatedSceneBase::ResolveContact(_stepParameters, intersection, _nextPositions[particleIndex], _nextVelocities[particleIndex]);
+}
+
+// Ratio of the density of a particle to how fast its density changes under a unit stiffness of itself and its neighbors
+void CPUSimulatedScene::UpdateDFSPHFactor(size_t particleIndex)
+{
+	glm::vec3 gradientSum{};
+	float squaredGradientSum = 0.0f;
+	_hashGrid->ForEachNeighborParticle
+	(
+		_positions,
+		particleIndex,
+		[&](size_t neighborIndex)
+		{
+			float distance = glm::distance(_positions[particleIndex], _positions[neighborIndex]);
+			if (distance > 0.0f)
+			{
+				glm::vec3 direction = (_positions[neighborIndex] - _positions[particleIndex]) / distance;
+				glm::vec3 gradient = _stepParameters._particleMass * _kernel->Gradient(distance, direction);
+				gradientSum += gradient;
+				squaredGradientSum += glm::dot(gradient, gradient);
+			}
+		}
+	);
+
+	float denominator = glm::dot(gradientSum, gradientSum) + squaredGradientSum;
+	_dfsphFactors[particleIndex] = (denominator > DFSPH_EPSILON) ? _densities[particleIndex] / denominator : 0.0f;
+}
+
+// Jacobi iterations on the stiffnesses that cancel the compression predicted from the velocities, which are corrected in place.
+// The solve starts from a fraction of the stiffnesses of the last one and stops when the average error falls below the tolerance.
+// Returns the number of iterations taken.
+uint32_t CPUSimulatedScene::SolvePressure(FirstTouchVector<glm::vec3> &velocities, FirstTouchVector<float> &accumulatedStiffnesses, float timeStep, bool isDensitySolve)
+{
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		accumulatedStiffnesses[particleIndex] *= WARM_START_FACTOR;
+		_stiffnesses[particleIndex] = accumulatedStiffnesses[particleIndex];
+	}
+
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		CorrectVelocity(particleIndex, velocities, timeStep);
+	}
+
+	float maxError = _stepParameters._targetDensity * (isDensitySolve ? _stepParameters._maxDensityError : _stepParameters._maxDivergenceError * timeStep);
+	uint32_t maxIterations = std::clamp(_stepParameters._maxSolverIterations, MIN_SOLVER_ITERATIONS, MAX_SOLVER_ITERATIONS);
+
+	uint32_t iteration = 0;
+	for (; iteration < maxIterations; ++iteration)
+	{
+		float errorSum = 0.0f;
+		#pragma omp parallel for reduction(+:errorSum)
+		for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+		{
+			_densityErrors[particleIndex] = PredictDensityError(particleIndex, velocities, timeStep, isDensitySolve);
+			errorSum += _densityErrors[particleIndex];
+		}
+
+		if (iteration >= MIN_SOLVER_ITERATIONS && errorSum <= maxError * _particleCount) break;
+
+		#pragma omp parallel for
+		for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+		{
+			_stiffnesses[particleIndex] = _densityErrors[particleIndex] * _dfsphFactors[particleIndex];
+			accumulatedStiffnesses[particleIndex] += _stiffnesses[particleIndex];
+		}
+
+		#pragma omp parallel for
+		for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+		{
+			CorrectVelocity(particleIndex, velocities, timeStep);
+		}
+	}
+
+	return iteration;
+}
+
+// Compression over the time step: the density above the target after the step for the density solve, and the density gained in the step for the divergence solve.
+// Only compression is corrected, so that free surfaces are not pulled together.
+float CPUSimulatedScene::PredictDensityError(size_t particleIndex, const FirstTouchVector<glm::vec3> &velocities, float timeStep, bool isDensitySolve)
+{
+	float densityRate = 0.0f;
+	_hashGrid->ForEachNeighborParticle
+	(
+		_positions,
+		particleIndex,
+		[&](size_t neighborIndex)
+		{
+			float distance = glm::distance(_positions[particleIndex], _positions[neighborIndex]);
+			if (distance > 0.0f)
+			{
+				glm::vec3 direction = (_positions[neighborIndex] - _positions[particleIndex]) / distance;
+				densityRate += glm::dot(velocities[particleIndex] - velocities[neighborIndex], _kernel->Gradient(distance, direction));
+			}
+		}
+	);
+	densityRate *= _stepParameters._particleMass;
+
+	if (isDensitySolve) return std::max(_densities[particleIndex] + timeStep * densityRate - _stepParameters._targetDensity, 0.0f);
+	return std::max(timeStep * densityRate, 0.0f);
+}
+
+// Apply the pressure impulse of the stiffnesses of the particle and its neighbors
+void CPUSimulatedScene::CorrectVelocity(size_t particleIndex, FirstTouchVector<glm::vec3> &velocities, float timeStep)
+{
+	float stiffnessOverDensity = _stiffnesses[particleIndex] / _densities[particleIndex];
+
+	glm::vec3 correction{};
+	_hashGrid->ForEachNeighborParticle
+	(
+		_positions,
+		particleIndex,
+		[&](size_t neighborIndex)
+		{
+			float distance = glm::distance(_positions[particleIndex], _positions[neighborIndex]);
+			if (distance > 0.0f)
+			{
+				glm::vec3 direction = (_positions[neighborIndex] - _positions[particleIndex]) / distance;
+				correction += (stiffnessOverDensity + _stiffnesses[neighborIndex] / _densities[neighborIndex]) * _kernel->Gradient(distance, direction);
+			}
+		}
+	);
+
+	velocities[particleIndex] -= _stepParameters._particleMass * correction / timeStep;
+}
+
+// Density constraint C = density / target density - 1 at the predicted position, and its lambda = -C / (sum of squared gradients of C + relaxation).
+// Only compression is constrained, so that particles at free surfaces do not clump together.
+void CPUSimulatedScene::UpdateConstraintLambda(size_t particleIndex)
+{
+	float density = _kernel->GetValue(0.0f);
+	glm::vec3 gradientSum{};
+	float squaredGradientSum = 0.0f;
+	_hashGrid->ForEachNeighborParticle
+	(
+		_nextPositions,
+		particleIndex,
+		[&](size_t neighborIndex)
+		{
+			float distance = glm::distance(_nextPositions[particleIndex], _nextPositions[neighborIndex]);
+			density += _kernel->GetValue(distance);
+			if (distance > 0.0f)
+			{
+				glm::vec3 direction = (_nextPositions[neighborIndex] - _nextPositions[particleIndex]) / distance;
+				glm::vec3 gradient = _kernel->Gradient(distance, direction);
+				gradientSum += gradient;
+				squaredGradientSum += glm::dot(gradient, gradient);
+			}
+		}
+	);
+
+	float massOverTargetDensity = _stepParameters._particleMass / _stepParameters._targetDensity;
+	_densities[particleIndex] = density * _stepParameters._particleMass;
+
+	float constraint = std::max(_densities[particleIndex] / _stepParameters._targetDensity - 1.0f, 0.0f);
+	float squaredGradientNorm = massOverTargetDensity * massOverTargetDensity * (glm::dot(gradientSum, gradientSum) + squaredGradientSum);
+	_lambdas[particleIndex] = -constraint / (squaredGradientNorm + _stepParameters._constraintRelaxation);
+}
+
+void CPUSimulatedScene::UpdatePositionCorrection(size_t particleIndex)
+{
+	glm::vec3 correction{};
+	_hashGrid->ForEachNeighborParticle
+	(
+		_nextPositions,
+		particleIndex,
+		[&](size_t neighborIndex)
+		{
+			float distance = glm::distance(_nextPositions[particleIndex], _nextPositions[neighborIndex]);
+			if (distance > 0.0f)
+			{
+				glm::vec3 direction = (_nextPositions[neighborIndex] - _nextPositions[particleIndex]) / distance;
+				correction += (_lambdas[particleIndex] + _lambdas[neighborIndex]) * _kernel->Gradient(distance, direction);
+			}
+		}
+	);
+
+	_pbfCorrections[particleIndex] = (_stepParameters._particleMass / _stepParameters._targetDensity) * correction;
+}
+
+// Blend the velocity of a particle toward those of its neighbors
+void CPUSimulatedScene::UpdateXSPHCorrection(size_t particleIndex)
+{
+	glm::vec3 correction{};
+	_hashGrid->ForEachNeighborParticle
+	(
+		_nextPositions,
+		particleIndex,
+		[&](size_t neighborIndex)
+		{
+			float distance = glm::distance(_nextPositions[particleIndex], _nextPositions[neighborIndex]);
+			correction += (_nextVelocities[neighborIndex] - _nextVelocities[particleIndex]) * _kernel->GetValue(distance) / _densities[neighborIndex];
+		}
+	);
+
+	_pbfCorrections[particleIndex] = _stepParameters._xsphCoefficient * _stepParameters._particleMass * correction;
+}
+
+void CPUSimulatedScene::TimeIntegration(float deltaSecond)
+{
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		Integrate(particleIndex, deltaSecond);
+	}
+}
+
+void CPUSimulatedScene::Integrate(size_t particleIndex, float deltaSecond)
+{
+	// Sleeping particles stay where they are
+	if (_activityGrid.IsSleeping(particleIndex))
+	{
+		_nextVelocities[particleIndex] = glm::vec3{};
+		_nextPositions[particleIndex] = _positions[particleIndex];
+		return;
+	}
+
+	// Integrate velocity
+	_nextVelocities[particleIndex] = _velocities[particleIndex] + deltaSecond * (_forces[particleIndex] / GetParticleMass(particleIndex));
+
+	// Integrate position
+	_nextPositions[particleIndex] = _positions[particleIndex] + deltaSecond * _nextVelocities[particleIndex];
+}
+
+// Reduce the largest speed and acceleration over particles into the time step to take
+float CPUSimulatedScene::ComputeTimeStep()
+{
+	float maxSquaredSpeed = 0.0f;
+	float maxSquaredAcceleration = 0.0f;
+
+	#pragma omp parallel
+	{
+		float localMaxSquaredSpeed = 0.0f;
+		float localMaxSquaredAcceleration = 0.0f;
+
+		#pragma omp for
+		for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+		{
+			glm::vec3 acceleration = _forces[particleIndex] / GetParticleMass(particleIndex);
+			localMaxSquaredSpeed = std::max(localMaxSquaredSpeed, glm::dot(_velocities[particleIndex], _velocities[particleIndex]));
+			localMaxSquaredAcceleration = std::max(localMaxSquaredAcceleration, glm::dot(acceleration, acceleration));
+		}
+
+		#pragma omp critical
+		{
+			maxSquaredSpeed = std::max(maxSquaredSpeed, localMaxSquaredSpeed);
+			maxSquaredAcceleration = std::max(maxSquaredAcceleration, localMaxSquaredAcceleration);
+		}
+	}
+
+	float maxSpeed = std::sqrt(maxSquaredSpeed);
+	float maxAcceleration = std::sqrt(maxSquaredAcceleration);
+	return ComputeAdaptiveTimeStep(_stepParameters, maxSpeed, maxAcceleration);
+}
+
+glm::vec3 CPUSimulatedScene::GetWindVelocityAt(glm::vec3 samplePosition)
+{
+	return glm::vec3{}; // Temp
+}
+
+float CPUSimulatedScene::ComputePressureFromEOS(float density, float targetDensity, float eosScale, float eosExponent)
+{
+	float pressure = eosScale * (std::pow(density / targetDensity, eosExponent) - 1.0f) / eosExponent;
+	if (pressure < 0.0f) pressure = 0.0f;
+	return pressure;
+}
+
+void CPUSimulatedScene::UpdateDensities()
+{
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		UpdateDensity(particleIndex);
+	}
+}
+
+void CPUSimulatedScene::UpdateDensity(size_t particleIndex)
+{
+	float density = GetParticleMass(particleIndex) * _kernel->GetValue(0.0f, RESOLUTION_SCALES[_resolutionLevels[particleIndex]]);
+	_hashGrid->ForEachNeighborParticle
+	(
+		_positions,
+		particleIndex,
+		[&](size_t neighborIndex)
+		{
+			glm::vec3 offset = _positions[neighborIndex] - _positions[particleIndex];
+			density += GetParticleMass(neighborIndex) * _kernel->GetValueFromSquaredDistance(glm::dot(offset, offset), GetKernelScale(particleIndex, neighborIndex));
+		}
+	);
+
+	_densities[particleIndex] = density;
 }
 
-// Reflect the particle positions to the render system
+// Reflect the latest published positions to the render system
 void CPUSimulatedScene::Applypositions()
 {
-	_particlePositionInputBuffers[VulkanCore::Get()->GetCurrentFrame()]->CopyFrom(_positions.data());
+	// Splits can briefly take the count past the room that the emitters have filled
+	const auto &positions = _snapshots.GetFront();
+	size_t renderedCount = std::min(positions.size(), _particleCapacity);
+	_particlePositionInputBuffers[VulkanCore::Get()->GetCurrentFrame()]->CopyFrom(positions.data(), 0, sizeof(glm::vec3) * renderedCount);
+	SetRenderedParticleCount(renderedCount);
 }
\ No newline at end of file
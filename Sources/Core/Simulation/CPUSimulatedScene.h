@@ -1,60 +1,274 @@
 #pragma once
 
 #include <omp.h>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <chrono>
+#include <optional>
 
 #include "VulkanCore.h"
 #include "HashGrid.h"
 #include "BVH.h"
 #include "SimulationParameters.h"
 #include "Delegate.h"
+#include "TripleBuffer.h"
+#include "TaskGraph.h"
+#include "NUMAUtil.h"
+#include "DomainDecomposition.h"
+#include "ActivityGrid.h"
 
 #include "SimulatedSceneBase.h"
 
+// How the phases of a step are spread over threads
+enum class SolverScheduler
+{
+	OpenMP, // A parallel loop with a barrier per phase
+	TaskGraph // Tasks over blocks of particles that wait only for the data they read
+};
+
 class CPUSimulatedScene : public SimulatedSceneBase
 {
 private:
-	std::vector<glm::vec3> _positions;
-	std::vector<glm::vec3> _velocities;
-	std::vector<glm::vec3> _forces;
-	std::vector<float> _densities;
-	std::vector<float> _pressures;
+	FirstTouchVector<glm::vec3> _positions;
+	FirstTouchVector<glm::vec3> _velocities;
+	FirstTouchVector<glm::vec3> _forces;
+	FirstTouchVector<float> _densities;
+	FirstTouchVector<float> _pressures;
+
+	FirstTouchVector<glm::vec3> _nextPositions;
+	FirstTouchVector<glm::vec3> _nextVelocities;
+
+	// Divergence-free SPH
+	FirstTouchVector<float> _dfsphFactors; // Density change per unit of stiffness of each particle, from its neighborhood
+	FirstTouchVector<float> _densityErrors; // Compression predicted from the current velocities
+	FirstTouchVector<float> _stiffnesses; // Stiffnesses of the current iteration
+	FirstTouchVector<float> _densityStiffnesses; // Accumulated over the density solve to warm-start the next one
+	FirstTouchVector<float> _divergenceStiffnesses; // Accumulated over the divergence solve to warm-start the next one
+	float _previousTimeStep = 0.0f;
+	std::array<std::atomic<uint32_t>, 2> _solverIterations{}; // Iterations taken by the last divergence and density solves
+
+	// Position based fluids
+	FirstTouchVector<float> _lambdas; // Scale of the correction along the constraint gradient of each particle
+	FirstTouchVector<glm::vec3> _pbfCorrections; // Position corrections of a constraint iteration, then velocity corrections of XSPH
+
+	// Implicit viscosity
+	FirstTouchVector<float> _viscosityDiagonals; // Diagonal of the system of each particle, the Jacobi preconditioner
+	FirstTouchVector<glm::vec3> _viscosityResiduals;
+	FirstTouchVector<glm::vec3> _viscosityDirections; // Search directions of conjugate gradient
+	FirstTouchVector<glm::vec3> _viscosityProducts; // Products of the system with the search directions
+	FirstTouchVector<glm::vec3> _viscosityCorrections; // Velocity changes of the last solve to warm-start the next one
+	std::atomic<uint32_t> _viscosityIterations = 0; // Iterations taken by the last viscosity solve
+
+	// Sleeping
+	ActivityGrid _activityGrid;
+	std::atomic<size_t> _sleepingParticleCount = 0;
+
+	// Adaptive resolution
+	enum class ResolutionChange : uint8_t
+	{
+		None,
+		Split, // Into two particles of the level below
+		Merge, // With the nearest candidate of the same level, if it is the nearest of that candidate in turn
+		Remove // Merged into its partner
+	};
 
-	std::vector<glm::vec3> _nextPositions;
-	std::vector<glm::vec3> _nextVelocities;
+	FirstTouchVector<uint8_t> _resolutionLevels; // A particle of level k stands for 2^k particles of the base mass
+	FirstTouchVector<uint32_t> _resolutionAges; // Resolution passes since the particle was last split or merged
+	std::vector<ResolutionChange> _resolutionChanges;
+	std::vector<uint32_t> _mergePartners;
+	std::vector<uint32_t> _splitParticles; // Particles made by the last splits, which are traced from the center of their parents against the colliders
+	uint32_t _resolutionStep = 0;
+	std::atomic<size_t> _mergedParticleCount = 0;
+
+	// Radius of each level relative to the base radius; the volume of a particle grows with its mass, so that every level fills space at the same density
+	static constexpr std::array<float, MAX_RESOLUTION_LEVEL + 1> RESOLUTION_SCALES{ 1.0f, 1.259921f, 1.587401f, 2.0f };
+	static constexpr uint32_t RESOLUTION_INTERVAL = 10; // Steps between resolution passes, which amortizes the compaction of the arrays
+	static constexpr uint32_t RESOLUTION_COOLDOWN = 3; // Passes that a particle waits after it is split or merged, so that it settles before it changes again
+	static constexpr uint32_t NO_PARTNER = UINT32_MAX;
+
+	// Flow
+	ParticleFlow _stepFlow; // Copy of the emitters and sinks for the solver thread
+	ParticlePool _particlePool;
+	size_t _particleCapacity = 0; // Particles that the renderers have room for
+	float _particleDistance = 0.0f; // Spacing of the initial block, at which particles are emitted
+	std::vector<glm::vec3> _emittedPositions;
+	std::vector<glm::vec3> _emittedVelocities;
+	std::vector<size_t> _emittedSlots;
+
+	static constexpr float WARM_START_FACTOR = 0.5f; // Fraction of the last stiffnesses to start from, which decays stiffnesses that are no longer needed
+	static constexpr float DFSPH_EPSILON = 1e-6f;
+
+	std::vector<uint32_t> _collisionOrder; // Particle indices in the order they are traced against the BVH
 
 	std::unique_ptr<HashGrid> _hashGrid = nullptr;
 	std::unique_ptr<Kernel> _kernel = nullptr;
 
-	size_t _particleCount = 0;
+	size_t _particleCount = 0; // Owned particles, which come first in the arrays
+	std::atomic<size_t> _publishedParticleCount = 0; // Copy of the count for the other threads, stored whenever the solver changes the count
+	size_t _ghostCount = 0; // Particles of the adjacent slabs that follow the owned ones during a distributed step
+
+	static const bool IS_KERNEL_TABULATED = true; // Interpolate the kernel from a table instead of evaluating it
+
+	static const uint32_t MAX_SUBSTEPS = 16;
+	static constexpr float MAX_FRAME_TIME = 1.0f / 30.0f; // Frames longer than this are simulated in slow motion rather than spiraling
 
 	std::vector<Buffer> _particlePositionInputBuffers;
 
-	bool _isPlaying = false;
+	// Task graph
+	std::unique_ptr<TaskScheduler> _taskScheduler = nullptr; // Created on the solver thread when first used
+	TaskGraph _stepGraph;
+	std::vector<uint32_t> _blockOrder; // Particle indices in the bucket order
+	std::vector<size_t> _blockBounds; // Offsets into _blockOrder where each block begins, followed by the end
+	std::vector<glm::vec2> _blockMaxima; // Squared speed and force of each block for the adaptive time step
+	float _blockTimeStep = 0.0f;
+
+	static const size_t BLOCK_SIZE = 512; // Minimum number of particles in a block
+
+	// Moving average of the step time in milliseconds for each scheduler
+	SolverScheduler _solverScheduler = SolverScheduler::OpenMP; // Last selected on this thread; the solver switches at its next step
+	std::array<std::atomic<float>, 2> _averageStepTimes{};
+	static constexpr float STEP_TIME_SMOOTHING = 0.05f;
+
+	// The hash grid rewrites its statistics on every step, so other threads read a copy taken after each frame of steps
+	std::optional<HashGrid::Statistics> _gridStatistics = std::nullopt;
+	mutable std::mutex _gridStatisticsMutex;
+
+	// Placement
+	// With NUMA-aware placement, the pages of each particle array are first touched by the thread that steps that range of particles,
+	// and the threads are pinned so that a thread keeps its slab of the arrays and the node they live on.
+	bool _isNUMAAware = true; // Takes effect when particles are initialized
+	bool _isPlacementNUMAAware = true; // Placement of the arrays in use, kept by the solver when it grows them
+
+	// Distribution
+	// A headless scene has no renderers and no solver thread; the caller advances it frame by frame.
+	// Only headless scenes take part in a distributed run, where each process owns the particles of a slab of the domain.
+	bool _isHeadless = false;
+	std::unique_ptr<DomainDecomposition> _decomposition = nullptr;
+
+	// Solver thread
+	// Settings reach the solver only through messages, which are run between steps.
+	SimulationParameters _stepParameters{};
+	ColliderMode _stepColliderMode = ColliderMode::BVH;
+	uint32_t _stepSubstepCount = 1;
+	SolverScheduler _stepScheduler = SolverScheduler::OpenMP;
+
+	std::vector<std::function<void()>> _messages;
+	std::mutex _messageMutex;
+
+	TripleBuffer<std::vector<glm::vec3>> _snapshots; // Positions published by the solver for the renderers, taken once per frame
+	static constexpr std::chrono::microseconds PACING_INTERVAL{ 500 }; // Poll interval of the solver while it waits for a frame to take its state
+
+	std::jthread _solverThread; // Declared last to be stopped before the state it touches is destroyed
 
 public:
+	static const std::string ENGINE_NAME;
+
+	CPUSimulatedScene(bool isHeadless = false) : _isHeadless(isHeadless) {}
+	virtual ~CPUSimulatedScene();
 	virtual void Register() override;
 
+	virtual const std::string &GetEngineName() const override { return ENGINE_NAME; }
+	virtual void InitializeLevel() override;
 	virtual void InitializeParticles(float particleDistance, glm::vec2 xRange, glm::vec2 yRange, glm::vec2 zRange) override;
+	virtual size_t GetParticleCount() const override { return _publishedParticleCount.load(std::memory_order_relaxed); }
+	virtual SolverStatistics GetSolverStatistics() const override;
+	virtual std::optional<HashGrid::Statistics> GetGridStatistics() const override;
+
+	void SetSolverScheduler(SolverScheduler solverScheduler);
+	SolverScheduler GetSolverScheduler() const { return _solverScheduler; }
+	void SetNUMAAware(bool isNUMAAware) { _isNUMAAware = isNUMAAware; }
+	bool IsNUMAAware() const { return _isNUMAAware; }
+	float GetAverageStepTime(SolverScheduler solverScheduler) const { return _averageStepTimes[static_cast<size_t>(solverScheduler)].load(std::memory_order_relaxed); }
+	uint32_t GetSolverIterations(bool isDensitySolve) const { return _solverIterations[isDensitySolve ? 1 : 0].load(std::memory_order_relaxed); }
+	uint32_t GetViscosityIterations() const { return _viscosityIterations.load(std::memory_order_relaxed); }
+	size_t GetSleepingParticleCount() const { return _sleepingParticleCount.load(std::memory_order_relaxed); }
+	size_t GetMergedParticleCount() const { return _mergedParticleCount.load(std::memory_order_relaxed); }
+
+	// Headless
+	void SetDecomposition(std::unique_ptr<DomainDecomposition> decomposition) { _decomposition = std::move(decomposition); } // Before particles are initialized
+	void Advance(float deltaSecond);
 
 private:
-	void Update();
+	void StopSolver();
+	void Solve(std::stop_token stopToken, bool isPinned);
+	void AllocateParticleArrays();
+	void ResizeParticleArrays(size_t particleCount);
+	void ExchangeParticles();
+	void EnqueueMessage(std::function<void()> message);
+	void Synchronize(std::function<void()> message);
+	void ProcessMessages();
+	void ApplySimulationParameters(const SimulationParameters &simulationParameters);
+
+	void Update(float deltaSecond);
+	float OpenMPStep(float remainingTime);
+	float TaskGraphStep(float remainingTime);
+	float DFSPHStep(float remainingTime);
+	float PBFStep(float remainingTime);
+	void UpdateBlocks();
+
+	template<typename TFunc>
+	void ForEachParticleInBlock(size_t blockIndex, TFunc func)
+	{
+		for (size_t order = _blockBounds[blockIndex]; order < _blockBounds[blockIndex + 1]; ++order)
+		{
+			func(_blockOrder[order]);
+		}
+	}
 
 	void BeginTimeStep();
+	bool IsSleepingEnabled() const;
+	void UpdateActivity();
+	bool IsResolutionAdaptive() const;
+	uint32_t GetMaxResolutionLevel() const;
+	float GetGridSpacing() const;
+	void UpdateResolution();
+	void RefineResolution(uint32_t maxLevel);
+	void ApplyResolutionChanges();
+	void UpdateFlow(float timeStep);
+	float GetParticleMass(size_t particleIndex) const { return _stepParameters._particleMass * static_cast<float>(1u << _resolutionLevels[particleIndex]); }
+	float GetKernelScale(size_t particleIndex, size_t neighborIndex) const { return 0.5f * (RESOLUTION_SCALES[_resolutionLevels[particleIndex]] + RESOLUTION_SCALES[_resolutionLevels[neighborIndex]]); } // Mean radius of the pair
 	void EndTimeStep();
 
 	void AccumulateForces();
 	void AccumulateExternalForce();
+	void AccumulateExternalForce(size_t particleIndex);
 	void AccumulateViscosityForce();
+	void AccumulateViscosityForce(size_t particleIndex);
 	void AccumulatePressureForce();
+	void AccumulatePressureForce(size_t particleIndex);
+	bool IsViscosityImplicit() const;
+	uint32_t SolveViscosity(float timeStep);
+	glm::vec3 MultiplyViscositySystem(size_t particleIndex, const FirstTouchVector<glm::vec3> &values, float viscosityScale);
+	void UpdatePressure(size_t particleIndex);
 	void ResolveCollision();
+	void ResolveBlockCollision(size_t blockIndex);
+	void ResolveSDFCollision(size_t particleIndex);
+	void ResolvePacketCollision(const uint32_t *particleIndices, uint32_t laneCount);
+	void ResolveContact(size_t particleIndex, const Intersection &intersection);
+
+	void UpdateDFSPHFactor(size_t particleIndex);
+	uint32_t SolvePressure(FirstTouchVector<glm::vec3> &velocities, FirstTouchVector<float> &accumulatedStiffnesses, float timeStep, bool isDensitySolve);
+	float PredictDensityError(size_t particleIndex, const FirstTouchVector<glm::vec3> &velocities, float timeStep, bool isDensitySolve);
+	void CorrectVelocity(size_t particleIndex, FirstTouchVector<glm::vec3> &velocities, float timeStep);
+
+	void UpdateConstraintLambda(size_t particleIndex);
+	void UpdatePositionCorrection(size_t particleIndex);
+	void UpdateXSPHCorrection(size_t particleIndex);
 
 	void TimeIntegration(float deltaSecond);
+	void Integrate(size_t particleIndex, float deltaSecond);
+	float ComputeTimeStep();
 
 	glm::vec3 GetWindVelocityAt(glm::vec3 samplePosition);
 	// Compute the pressure from the equation-of-state
 	float ComputePressureFromEOS(float density, float targetDensity, float eosScale, float eosExponent);
 
 	void UpdateDensities();
+	void UpdateDensity(size_t particleIndex);
 
 	// Reflect the particle status to the render system
 	void Applypositions();
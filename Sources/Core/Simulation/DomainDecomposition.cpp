@@ -0,0 +1,180 @@
+#include "DomainDecomposition.h"
+
+DomainDecomposition::DomainDecomposition(std::unique_ptr<Transport> transport, glm::length_t axis, float domainLowerBound, float domainUpperBound) :
+	_transport(std::move(transport)),
+	_axis(axis),
+	_domainLowerBound(domainLowerBound),
+	_domainUpperBound(domainUpperBound)
+{
+}
+
+bool DomainDecomposition::IsOwned(const HashGrid &hashGrid, glm::vec3 position)
+{
+	UpdateSlab(hashGrid.GetSpacing());
+	return GetSide(hashGrid, position) == 0;
+}
+
+size_t DomainDecomposition::Migrate(const HashGrid &hashGrid, FirstTouchVector<glm::vec3> &positions, FirstTouchVector<glm::vec3> &velocities, size_t particleCount)
+{
+	UpdateSlab(hashGrid.GetSpacing());
+
+	// Take the leaving particles out by moving the last particle into their places
+	std::array<std::vector<glm::vec3>, 2> leavingParticles; // Position and velocity of each particle
+	for (size_t particleIndex = particleCount; particleIndex-- > 0;)
+	{
+		int side = GetSide(hashGrid, positions[particleIndex]);
+		if (side == 0) continue;
+
+		auto &leaving = leavingParticles[side < 0 ? 0 : 1];
+		leaving.push_back(positions[particleIndex]);
+		leaving.push_back(velocities[particleIndex]);
+
+		--particleCount;
+		positions[particleIndex] = positions[particleCount];
+		velocities[particleIndex] = velocities[particleCount];
+	}
+
+	positions.resize(particleCount);
+	velocities.resize(particleCount);
+
+	for (size_t side = 0; side < 2; ++side)
+	{
+		if (!HasPeer(side)) continue;
+
+		MessageWriter writer;
+		writer.Write(static_cast<uint64_t>(leavingParticles[side].size() / 2));
+		for (const glm::vec3 &value : leavingParticles[side]) writer.Write(value);
+
+		std::vector<std::byte> message = _transport->Exchange(GetPeer(side), writer.GetBytes());
+		MessageReader reader(message);
+		size_t enteringCount = static_cast<size_t>(reader.Read<uint64_t>());
+		FirstTouchReserve(positions, positions.size() + enteringCount); // Growing by push_back alone would move the arrays off the nodes of the team
+		FirstTouchReserve(velocities, velocities.size() + enteringCount);
+		for (size_t i = 0; i < enteringCount; ++i)
+		{
+			positions.push_back(reader.Read<glm::vec3>());
+			velocities.push_back(reader.Read<glm::vec3>());
+		}
+	}
+
+	return positions.size();
+}
+
+size_t DomainDecomposition::ExchangeHalo(const HashGrid &hashGrid, FirstTouchVector<glm::vec3> &positions, FirstTouchVector<glm::vec3> &velocities, size_t particleCount)
+{
+	UpdateSlab(hashGrid.GetSpacing());
+
+	positions.resize(particleCount);
+	velocities.resize(particleCount);
+
+	for (size_t side = 0; side < 2; ++side)
+	{
+		_haloIndices[side].clear();
+		_ghostCounts[side] = 0;
+		if (!HasPeer(side)) continue;
+
+		// The cell layer along the boundary with the peer
+		int boundaryCell = (side == 0) ? _lowerCell : _upperCell - 1;
+		for (size_t particleIndex = 0; particleIndex < particleCount; ++particleIndex)
+		{
+			if (hashGrid.GetCell(positions[particleIndex])[_axis] == boundaryCell) _haloIndices[side].push_back(static_cast<uint32_t>(particleIndex));
+		}
+
+		MessageWriter writer;
+		writer.Write(static_cast<uint64_t>(_haloIndices[side].size()));
+		for (uint32_t particleIndex : _haloIndices[side])
+		{
+			writer.Write(positions[particleIndex]);
+			writer.Write(velocities[particleIndex]);
+		}
+
+		std::vector<std::byte> message = _transport->Exchange(GetPeer(side), writer.GetBytes());
+		MessageReader reader(message);
+		_ghostCounts[side] = static_cast<size_t>(reader.Read<uint64_t>());
+		FirstTouchReserve(positions, positions.size() + _ghostCounts[side]);
+		FirstTouchReserve(velocities, velocities.size() + _ghostCounts[side]);
+		for (size_t i = 0; i < _ghostCounts[side]; ++i)
+		{
+			positions.push_back(reader.Read<glm::vec3>());
+			velocities.push_back(reader.Read<glm::vec3>());
+		}
+	}
+
+	return _ghostCounts[0] + _ghostCounts[1];
+}
+
+void DomainDecomposition::ExchangeHaloDensities(FirstTouchVector<float> &densities, size_t particleCount)
+{
+	// Ghosts of the lower peer come first
+	size_t ghostOffset = particleCount;
+	for (size_t side = 0; side < 2; ++side)
+	{
+		if (!HasPeer(side)) continue;
+
+		MessageWriter writer;
+		writer.Write(static_cast<uint64_t>(_haloIndices[side].size()));
+		for (uint32_t particleIndex : _haloIndices[side]) writer.Write(densities[particleIndex]);
+
+		std::vector<std::byte> message = _transport->Exchange(GetPeer(side), writer.GetBytes());
+		MessageReader reader(message);
+		if (reader.Read<uint64_t>() != _ghostCounts[side]) throw std::runtime_error("Densities do not match the ghosts of the halo.");
+
+		for (size_t i = 0; i < _ghostCounts[side]; ++i) densities[ghostOffset + i] = reader.Read<float>();
+		ghostOffset += _ghostCounts[side];
+	}
+}
+
+// The value travels up the chain of ranks while being reduced, and the result travels back down
+float DomainDecomposition::ReduceMin(float value)
+{
+	uint32_t rank = _transport->GetRank();
+
+	if (_transport->HasLowerPeer())
+	{
+		std::vector<std::byte> message = _transport->Receive(rank - 1);
+		value = std::min(value, MessageReader(message).Read<float>());
+	}
+
+	if (_transport->HasUpperPeer())
+	{
+		MessageWriter writer;
+		writer.Write(value);
+		_transport->Send(rank + 1, writer.GetBytes());
+
+		std::vector<std::byte> message = _transport->Receive(rank + 1);
+		value = MessageReader(message).Read<float>();
+	}
+
+	if (_transport->HasLowerPeer())
+	{
+		MessageWriter writer;
+		writer.Write(value);
+		_transport->Send(rank - 1, writer.GetBytes());
+	}
+
+	return value;
+}
+
+// Adjacent ranks compute their shared bound in the same way, so they agree on the cell that divides them
+void DomainDecomposition::UpdateSlab(float cellSpacing)
+{
+	if (cellSpacing == _cellSpacing) return;
+
+	_cellSpacing = cellSpacing;
+	uint32_t rank = _transport->GetRank();
+	_lowerCell = _transport->HasLowerPeer() ? static_cast<int>(std::floor(GetSlabBound(rank) / _cellSpacing)) : std::numeric_limits<int>::min();
+	_upperCell = _transport->HasUpperPeer() ? static_cast<int>(std::floor(GetSlabBound(rank + 1) / _cellSpacing)) : std::numeric_limits<int>::max();
+}
+
+float DomainDecomposition::GetSlabBound(uint32_t rank) const
+{
+	return _domainLowerBound + (_domainUpperBound - _domainLowerBound) * rank / _transport->GetRankCount();
+}
+
+int DomainDecomposition::GetSide(const HashGrid &hashGrid, glm::vec3 position) const
+{
+	int cell = hashGrid.GetCell(position)[_axis];
+	if (cell < _lowerCell) return -1;
+	if (cell >= _upperCell) return 1;
+	return 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <limits>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+#include "HashGrid.h"
+#include "Transport.h"
+#include "NUMAUtil.h"
+
+// Split of the domain into slabs along an axis, one slab for each process of a distributed run.
+// Slab bounds are snapped to the cells of the hash grid, and a particle belongs to the rank whose slab holds its cell.
+// Neighbors lie at most one cell away, so the owned particles in the outermost cell layer of a slab are all that the adjacent rank needs as ghosts.
+// The lowest and the highest slabs are open-ended, so that no particle leaves the run.
+class DomainDecomposition
+{
+private:
+	std::unique_ptr<Transport> _transport;
+	glm::length_t _axis = 0;
+	float _domainLowerBound = 0.0f;
+	float _domainUpperBound = 0.0f;
+
+	// Slab of this rank in cells, recomputed whenever the grid spacing changes
+	float _cellSpacing = 0.0f;
+	int _lowerCell = std::numeric_limits<int>::min();
+	int _upperCell = std::numeric_limits<int>::max();
+
+	// Ghosts of the last halo exchange, for the lower and the upper peer
+	std::array<std::vector<uint32_t>, 2> _haloIndices; // Owned particles sent to each peer in the order they are sent
+	std::array<size_t, 2> _ghostCounts{}; // Ghosts received from each peer
+
+public:
+	DomainDecomposition(std::unique_ptr<Transport> transport, glm::length_t axis, float domainLowerBound, float domainUpperBound);
+
+	// Whether a position falls into the slab of this rank
+	bool IsOwned(const HashGrid &hashGrid, glm::vec3 position);
+
+	// Hand over the owned particles that have left the slab and take in those that have entered it; returns the new number of owned particles.
+	// Particles are passed only to the adjacent ranks, so a particle that skips a slab in a step reaches its owner over the following steps.
+	size_t Migrate(const HashGrid &hashGrid, FirstTouchVector<glm::vec3> &positions, FirstTouchVector<glm::vec3> &velocities, size_t particleCount);
+
+	// Append the ghosts of the adjacent slabs after the owned particles; returns the number of ghosts
+	size_t ExchangeHalo(const HashGrid &hashGrid, FirstTouchVector<glm::vec3> &positions, FirstTouchVector<glm::vec3> &velocities, size_t particleCount);
+
+	// Densities of ghosts need the neighbors on the other side, so they are computed by their owners and sent after the halo
+	void ExchangeHaloDensities(FirstTouchVector<float> &densities, size_t particleCount);
+
+	// Minimum over all ranks, such as the time step that every rank must take
+	float ReduceMin(float value);
+
+	const Transport &GetTransport() const { return *_transport; }
+
+private:
+	void UpdateSlab(float cellSpacing);
+	float GetSlabBound(uint32_t rank) const;
+	int GetSide(const HashGrid &hashGrid, glm::vec3 position) const; // -1 below the slab, 1 above it, 0 within it
+	uint32_t GetPeer(size_t side) const { return side == 0 ? _transport->GetRank() - 1 : _transport->GetRank() + 1; }
+	bool HasPeer(size_t side) const { return side == 0 ? _transport->HasLowerPeer() : _transport->HasUpperPeer(); }
+};
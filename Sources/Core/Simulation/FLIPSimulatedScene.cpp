@@ -0,0 +1,329 @@
+#include "FLIPSimulatedScene.h"
+
+const std::string FLIPSimulatedScene::ENGINE_NAME = "flip";
+
+void FLIPSimulatedScene::Register()
+{
+	VulkanCore::Get()->OnExecuteHost().AddListener
+	(
+		weak_from_this(),
+		[this](float deltaSecond, uint32_t currentFrame)
+		{
+			if (_grid == nullptr) return;
+
+			if (UpdateLevel(deltaSecond) != LevelUpdate::None) _grid->UpdateSolids(*_sdf);
+			Update(deltaSecond);
+
+			if (!_isSimulateOnly) ApplyPositions();
+		}
+	);
+}
+
+void FLIPSimulatedScene::InitializeLevel()
+{
+	SimulatedSceneBase::InitializeLevel();
+	if (_grid != nullptr) _grid->UpdateSolids(*_sdf);
+}
+
+void FLIPSimulatedScene::InitializeParticles(float particleDistance, glm::vec2 xRange, glm::vec2 yRange, glm::vec2 zRange)
+{
+	// Setup
+	size_t xCount = std::lround(std::ceil((xRange.g - xRange.r) / particleDistance));
+	size_t yCount = std::lround(std::ceil((yRange.g - yRange.r) / particleDistance));
+	size_t zCount = std::lround(std::ceil((zRange.g - zRange.r) / particleDistance));
+
+	_particleCount = xCount * yCount * zCount;
+	glm::vec3 startingPoint = glm::vec3(xRange.r, yRange.r, zRange.r);
+	glm::vec3 endingPoint = glm::vec3(xRange.g, yRange.g, zRange.g);
+
+	// The occupancy grid culls the particles that cannot reach a collider in a step
+	UpdateGridDimension(startingPoint, endingPoint);
+
+	// The grid walls in the level and the initial block of particles
+	auto [lowerBound, upperBound] = GetDomainBounds(startingPoint, endingPoint);
+	float cellSpacing = CELL_SPACING_FACTOR * particleDistance;
+	glm::vec3 cellCounts = glm::ceil((upperBound - lowerBound) / cellSpacing) + 2.0f;
+	float cellCount = cellCounts.x * cellCounts.y * cellCounts.z;
+	if (cellCount > MAX_CELL_COUNT) cellSpacing *= std::cbrt(cellCount / MAX_CELL_COUNT);
+
+	_grid = std::make_unique<MACGrid>(lowerBound, upperBound, cellSpacing);
+	_grid->UpdateSolids(*_sdf);
+
+	// Prepare particles themselves
+	_positions.resize(_particleCount);
+	_velocities.assign(_particleCount, glm::vec3());
+	for (auto &affineVelocities : _affineVelocities) affineVelocities.assign(_particleCount, glm::vec3());
+	_particleCells.resize(_particleCount);
+	_sortedOrder.resize(_particleCount);
+	_sortScratch.resize(_particleCount);
+	_cellBounds.assign(_grid->GetCellCount() + 1, 0);
+	_averageStepTime = 0.0f;
+	_projectionIterations = 0;
+
+	// Place particles
+	#pragma omp parallel for
+	for (size_t z = 0; z < zCount; ++z)
+	{
+		for (size_t y = 0; y < yCount; ++y)
+		{
+			for (size_t x = 0; x < xCount; ++x)
+			{
+				size_t particleIndex = z * (xCount * yCount) + y * xCount + x;
+				_positions[particleIndex] = startingPoint + glm::vec3(x, y, z) * particleDistance;
+			}
+		}
+	}
+
+	// Initialize renderers (marching cubes and billboards)
+	_particlePositionInputBuffers = CreateBuffers(sizeof(glm::vec3) * _particleCount, VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	InitializeRenderers(_particlePositionInputBuffers, _particleCount);
+	ApplyRenderMode(_particleRenderingMode);
+}
+
+SolverStatistics FLIPSimulatedScene::GetSolverStatistics() const
+{
+	return SolverStatistics
+	{
+		._particleCount = _particleCount,
+		._averageStepTime = _averageStepTime,
+		._divergenceIterations = _projectionIterations
+	};
+}
+
+void FLIPSimulatedScene::Update(float deltaSecond)
+{
+	// Same stepping as the particle solvers, so that the engines cover the same simulated time per frame
+	float frameTime = _simulationParameters->_isTimeStepAdaptive ? std::min(deltaSecond, MAX_FRAME_TIME) : _simulationParameters->_timeStep;
+	float remainingTime = frameTime * _substepCount;
+	for (uint32_t substep = 0; substep < MAX_SUBSTEPS * _substepCount && remainingTime >= MIN_TIME_STEP; ++substep)
+	{
+		auto stepBegin = std::chrono::high_resolution_clock::now();
+
+		remainingTime -= Step(remainingTime);
+
+		float stepTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - stepBegin).count();
+		_averageStepTime = (_averageStepTime == 0.0f) ? stepTime : glm::mix(_averageStepTime, stepTime, STEP_TIME_SMOOTHING);
+	}
+}
+
+float FLIPSimulatedScene::Step(float remainingTime)
+{
+	float timeStep = ClampToRemainingTime(ComputeTimeStep(), remainingTime);
+
+	SortParticles();
+	_grid->UpdateLabels(_cellBounds);
+
+	TransferToGrid();
+	_grid->AddAcceleration(glm::vec3(_simulationParameters->_gravitiy), timeStep);
+	_projectionIterations = _grid->Project(_simulationParameters->_maxSolverIterations, _simulationParameters->_maxDivergenceError);
+	TransferToParticles();
+
+	Advect(timeStep);
+
+	return timeStep;
+}
+
+// The CFL condition on the grid, with the speed that gravity adds over a cell (Bridson, 2015)
+float FLIPSimulatedScene::ComputeTimeStep()
+{
+	if (!_simulationParameters->_isTimeStepAdaptive) return _simulationParameters->_timeStep;
+
+	float maxSquaredSpeed = 0.0f;
+
+	#pragma omp parallel
+	{
+		float localMaxSquaredSpeed = 0.0f;
+
+		#pragma omp for
+		for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+		{
+			localMaxSquaredSpeed = std::max(localMaxSquaredSpeed, glm::dot(_velocities[particleIndex], _velocities[particleIndex]));
+		}
+
+		#pragma omp critical
+		{
+			maxSquaredSpeed = std::max(maxSquaredSpeed, localMaxSquaredSpeed);
+		}
+	}
+
+	float cellSpacing = _grid->GetSpacing();
+	float speed = std::sqrt(maxSquaredSpeed) + std::sqrt(5.0f * cellSpacing * glm::length(glm::vec3(_simulationParameters->_gravitiy)));
+	float timeStep = _simulationParameters->_timeStep;
+	if (speed > 0.0f) timeStep = std::min(timeStep, _simulationParameters->_courantFactor * cellSpacing / speed);
+
+	return std::max(timeStep, MIN_TIME_STEP);
+}
+
+// Counting sort of the particles by cell
+void FLIPSimulatedScene::SortParticles()
+{
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		_particleCells[particleIndex] = static_cast<uint32_t>(_grid->GetCellIndex(_grid->GetCell(_positions[particleIndex])));
+	}
+
+	std::fill(_cellBounds.begin(), _cellBounds.end(), 0);
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex) ++_cellBounds[_particleCells[particleIndex] + 1];
+	for (size_t cellIndex = 1; cellIndex < _cellBounds.size(); ++cellIndex) _cellBounds[cellIndex] += _cellBounds[cellIndex - 1];
+
+	std::vector<uint32_t> cellOffsets(_cellBounds.begin(), _cellBounds.end() - 1);
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		_sortedOrder[cellOffsets[_particleCells[particleIndex]]++] = static_cast<uint32_t>(particleIndex);
+	}
+
+	auto permute = [this](std::vector<glm::vec3> &values)
+	{
+		#pragma omp parallel for
+		for (size_t sortedIndex = 0; sortedIndex < _particleCount; ++sortedIndex)
+		{
+			_sortScratch[sortedIndex] = values[_sortedOrder[sortedIndex]];
+		}
+
+		values.swap(_sortScratch);
+	};
+
+	permute(_positions);
+	permute(_velocities);
+	for (auto &affineVelocities : _affineVelocities) permute(affineVelocities);
+}
+
+// Each face gathers from the particles within a cell of it with trilinear weights, so blocks of faces are transferred in parallel without conflicts.
+// Along its axis, a face is reached by the particles of the two cells it separates, and along the other axes by those of three layers of cells.
+void FLIPSimulatedScene::TransferToGrid()
+{
+	bool isAPIC = (_simulationParameters->_gridTransfer == static_cast<uint32_t>(GridTransfer::APIC));
+	float inverseSpacing = 1.0f / _grid->GetSpacing();
+	glm::ivec3 dimension = _grid->GetDimension();
+
+	for (glm::length_t axis = 0; axis < 3; ++axis)
+	{
+		auto &momenta = _grid->GetVelocities(axis);
+		auto &weights = _grid->GetWeights(axis);
+		const auto &affineVelocities = _affineVelocities[axis];
+
+		MACGrid::ForEachBlock
+		(
+			_grid->GetFaceDimension(axis),
+			[&](glm::ivec3 face)
+			{
+				glm::vec3 facePosition = _grid->GetFacePosition(axis, face);
+
+				glm::ivec3 lowerCell = face - 1;
+				glm::ivec3 upperCell = face + 1;
+				upperCell[axis] = face[axis];
+				lowerCell = glm::max(lowerCell, glm::ivec3(0));
+				upperCell = glm::min(upperCell, dimension - 1);
+
+				float momentum = 0.0f;
+				float weightSum = 0.0f;
+				for (int z = lowerCell.z; z <= upperCell.z; ++z)
+				{
+					for (int y = lowerCell.y; y <= upperCell.y; ++y)
+					{
+						for (int x = lowerCell.x; x <= upperCell.x; ++x)
+						{
+							size_t cellIndex = _grid->GetCellIndex(glm::ivec3(x, y, z));
+							for (uint32_t particleIndex = _cellBounds[cellIndex]; particleIndex < _cellBounds[cellIndex + 1]; ++particleIndex)
+							{
+								glm::vec3 axisWeights = 1.0f - glm::abs(_positions[particleIndex] - facePosition) * inverseSpacing;
+								if (glm::any(glm::lessThanEqual(axisWeights, glm::vec3(0.0f)))) continue;
+
+								float weight = axisWeights.x * axisWeights.y * axisWeights.z;
+								float velocity = _velocities[particleIndex][axis];
+								if (isAPIC) velocity += glm::dot(affineVelocities[particleIndex], facePosition - _positions[particleIndex]);
+
+								momentum += weight * velocity;
+								weightSum += weight;
+							}
+						}
+					}
+				}
+
+				size_t faceIndex = _grid->GetFaceIndex(axis, face);
+				momenta[faceIndex] = momentum;
+				weights[faceIndex] = weightSum;
+			}
+		);
+	}
+
+	_grid->NormalizeTransfer();
+}
+
+// FLIP adds the change of the grid velocity to each particle, which keeps detail but is noisy, and PIC takes the grid velocity, which is smooth but dissipative.
+// APIC takes the grid velocity as well, but keeps the local velocity gradient to give back in the next transfer to the grid.
+void FLIPSimulatedScene::TransferToParticles()
+{
+	bool isAPIC = (_simulationParameters->_gridTransfer == static_cast<uint32_t>(GridTransfer::APIC));
+	float flipRatio = _simulationParameters->_flipRatio;
+
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		glm::vec3 position = _positions[particleIndex];
+		glm::vec3 &velocity = _velocities[particleIndex];
+
+		for (glm::length_t axis = 0; axis < 3; ++axis)
+		{
+			if (isAPIC)
+			{
+				velocity[axis] = _grid->Sample(axis, position, false, &_affineVelocities[axis][particleIndex]);
+			}
+			else
+			{
+				float gridVelocity = _grid->Sample(axis, position, false);
+				float savedGridVelocity = _grid->Sample(axis, position, true);
+				velocity[axis] = flipRatio * (velocity[axis] + gridVelocity - savedGridVelocity) + (1.0f - flipRatio) * gridVelocity;
+			}
+		}
+	}
+}
+
+// Move the particles and push those that hit a collider or the walls of the grid back inside
+void FLIPSimulatedScene::Advect(float timeStep)
+{
+	// Within the cells inside the wall layer
+	float cellSpacing = _grid->GetSpacing();
+	float margin = WALL_MARGIN * cellSpacing;
+	glm::vec3 lowerBound = _grid->GetOrigin() + cellSpacing + margin;
+	glm::vec3 upperBound = _grid->GetOrigin() + glm::vec3(_grid->GetDimension() - 1) * cellSpacing - margin;
+
+	#pragma omp parallel for
+	for (size_t particleIndex = 0; particleIndex < _particleCount; ++particleIndex)
+	{
+		glm::vec3 &velocity = _velocities[particleIndex];
+		glm::vec3 nextPosition = _positions[particleIndex] + timeStep * velocity;
+
+		Intersection intersection{};
+		if (_colliderMode == ColliderMode::SDF)
+		{
+			if (_sdf->GetIntersection(nextPosition, &intersection)) ResolveContact(*_simulationParameters, intersection, nextPosition, velocity);
+		}
+		else if (_occupancyGrid->IsNearCollider(_positions[particleIndex], nextPosition) && _bvh->GetIntersection(_positions[particleIndex], nextPosition, &intersection))
+		{
+			ResolveContact(*_simulationParameters, intersection, nextPosition, velocity);
+		}
+
+		for (glm::length_t axis = 0; axis < 3; ++axis)
+		{
+			if (nextPosition[axis] < lowerBound[axis])
+			{
+				nextPosition[axis] = lowerBound[axis];
+				velocity[axis] = std::max(velocity[axis], 0.0f);
+			}
+			else if (nextPosition[axis] > upperBound[axis])
+			{
+				nextPosition[axis] = upperBound[axis];
+				velocity[axis] = std::min(velocity[axis], 0.0f);
+			}
+		}
+
+		_positions[particleIndex] = nextPosition;
+	}
+}
+
+void FLIPSimulatedScene::ApplyPositions()
+{
+	_particlePositionInputBuffers[VulkanCore::Get()->GetCurrentFrame()]->CopyFrom(_positions.data());
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <omp.h>
+#include <array>
+#include <vector>
+#include <chrono>
+
+#include "VulkanCore.h"
+#include "MACGrid.h"
+#include "SimulationParameters.h"
+
+#include "SimulatedSceneBase.h"
+
+// Hybrid particle-grid engine for particle counts beyond the reach of the neighbor loops of SPH.
+// Particles carry the fluid, while forces and the pressure are applied on a MAC grid: each step transfers the velocities of the particles to the faces,
+// projects the grid velocities to be divergence-free and transfers them back with FLIP/PIC blending or APIC.
+// The cost of a step grows with the particles and the cells rather than with the neighbors of each particle.
+// Steps are taken on the main thread when the frame executes its host tasks.
+class FLIPSimulatedScene : public SimulatedSceneBase
+{
+private:
+	std::vector<glm::vec3> _positions;
+	std::vector<glm::vec3> _velocities;
+	std::array<std::vector<glm::vec3>, 3> _affineVelocities; // Gradient of each velocity component around each particle for APIC
+
+	// Particles are kept sorted by cell, so that a face gathers from the contiguous ranges of the cells around it
+	std::vector<uint32_t> _particleCells;
+	std::vector<uint32_t> _cellBounds; // Offset of the first particle of each cell, followed by the end
+	std::vector<uint32_t> _sortedOrder; // Previous index of each particle in the sorted order
+	std::vector<glm::vec3> _sortScratch;
+
+	std::unique_ptr<MACGrid> _grid = nullptr;
+	size_t _particleCount = 0;
+
+	std::vector<Buffer> _particlePositionInputBuffers;
+
+	// Statistics
+	float _averageStepTime = 0.0f;
+	uint32_t _projectionIterations = 0;
+
+	static const uint32_t MAX_SUBSTEPS = 16;
+	static constexpr float MAX_FRAME_TIME = 1.0f / 30.0f; // Frames longer than this are simulated in slow motion rather than spiraling
+	static constexpr float STEP_TIME_SMOOTHING = 0.05f;
+	static const size_t MAX_CELL_COUNT = 1 << 24; // Cells are coarsened uniformly beyond this
+	static constexpr float CELL_SPACING_FACTOR = 2.0f; // Cell spacing over the particle spacing, which seeds eight particles in a cell
+	static constexpr float WALL_MARGIN = 0.001f; // Distance in cells that particles are kept from the walls
+
+public:
+	static const std::string ENGINE_NAME;
+
+	virtual void Register() override;
+
+	virtual const std::string &GetEngineName() const override { return ENGINE_NAME; }
+	virtual void InitializeLevel() override;
+	virtual void InitializeParticles(float particleDistance, glm::vec2 xRange, glm::vec2 yRange, glm::vec2 zRange) override;
+	virtual size_t GetParticleCount() const override { return _particleCount; }
+	virtual SolverStatistics GetSolverStatistics() const override;
+
+private:
+	void Update(float deltaSecond);
+	float Step(float remainingTime);
+	float ComputeTimeStep();
+
+	void SortParticles();
+	void TransferToGrid();
+	void TransferToParticles();
+	void Advect(float timeStep);
+
+	// Reflect the particle status to the render system
+	void ApplyPositions();
+};
@@ -1,5 +1,7 @@
 #include "GPUSimulatedScene.h"
 
+const std::string GPUSimulatedScene::ENGINE_NAME = "gpu";
+
 GPUSimulatedScene::GPUSimulatedScene()
 {
 	_simulationCompute = SimulationCompute::Instantiate<SimulationCompute>(_gridDimension);
@@ -7,6 +9,47 @@ GPUSimulatedScene::GPUSimulatedScene()
 
 void GPUSimulatedScene::Register()
 {
+	VulkanCore::Get()->OnExecuteHost().AddListener
+	(
+		weak_from_this(),
+		[this](float deltaSecond, uint32_t currentFrame)
+		{
+			LevelUpdate levelUpdate = _isLevelInitialized ? UpdateLevel(deltaSecond) : LevelUpdate::None;
+			if (levelUpdate != LevelUpdate::None)
+			{
+				_simulationCompute->UpdateLevel(*_bvh, *_sdf, *_occupancyGrid, levelUpdate == LevelUpdate::Rebuilt);
+			}
+
+			// The count is read back from the device a few frames late; the renderers take it from the device
+			_particleCount = _simulationCompute->GetParticleCount();
+			_simulationCompute->SetDeltaSecond(deltaSecond);
+		}
+	);
+
+	_onSetColliderMode.AddListener
+	(
+		weak_from_this(),
+		[this](ColliderMode colliderMode)
+		{
+			_simulationCompute->SetColliderMode(colliderMode);
+		},
+		PRIORITY_LOWEST,
+		__FUNCTION__,
+		__LINE__
+	);
+
+	_onSetSubstepCount.AddListener
+	(
+		weak_from_this(),
+		[this](uint32_t substepCount)
+		{
+			_simulationCompute->SetSubstepCount(substepCount);
+		},
+		PRIORITY_LOWEST,
+		__FUNCTION__,
+		__LINE__
+	);
+
 	_onUpdateSimulationParameters.AddListener
 	(
 		weak_from_this(),
@@ -18,13 +61,26 @@ void GPUSimulatedScene::Register()
 		__FUNCTION__,
 		__LINE__
 	);
+
+	_onUpdateParticleFlow.AddListener
+	(
+		weak_from_this(),
+		[this](const ParticleFlow &particleFlow)
+		{
+			_simulationCompute->UpdateParticleFlow(particleFlow, _particleDistance);
+		},
+		PRIORITY_LOWEST,
+		__FUNCTION__,
+		__LINE__
+	);
 }
 
 void GPUSimulatedScene::InitializeLevel()
 {
 	SimulatedSceneBase::InitializeLevel();
 
-	_simulationCompute->InitializeLevel(_bvh->GetNodes());
+	_simulationCompute->InitializeLevel(*_bvh, *_sdf, *_occupancyGrid);
+	_isLevelInitialized = true;
 }
 
 void GPUSimulatedScene::InitializeParticles(float particleDistance, glm::vec2 xRange, glm::vec2 yRange, glm::vec2 zRange)
@@ -34,9 +90,15 @@ void GPUSimulatedScene::InitializeParticles(float particleDistance, glm::vec2 xR
 	size_t yCount = static_cast<size_t>(std::ceil((yRange.g - yRange.r) / particleDistance));
 	size_t zCount = static_cast<size_t>(std::ceil((zRange.g - zRange.r) / particleDistance));
 	size_t particleCount = xCount * yCount * zCount;
+	size_t particleCapacity = GetParticleCapacity(particleCount);
+	_particleCount = particleCount;
+	_particleDistance = particleDistance;
 
 	glm::vec3 startingPoint = glm::vec3(xRange.r, yRange.r, zRange.r);
 
+	UpdateGridDimension(startingPoint, glm::vec3(xRange.g, yRange.g, zRange.g));
+	_simulationCompute->InitializeGrid(_gridDimension, *_occupancyGrid);
+
 	// Place particles
 	std::vector<glm::vec3> positions(particleCount);
 	for (size_t z = 0; z < zCount; ++z)
@@ -50,14 +112,12 @@ void GPUSimulatedScene::InitializeParticles(float particleDistance, glm::vec2 xR
 			}
 		}
 	}
-	_simulationCompute->InitializeParticles(positions);
+	_simulationCompute->InitializeParticles(positions, particleCapacity);
+	_simulationCompute->UpdateParticleFlow(_particleFlow, _particleDistance);
 
 	// Initialize renderers (marching cubes and billboards)
-	// We don't have to create multiple particle position buffers for frames in flight since those buffers will be only written and read by the GPU.
-	// We just reuse one buffer multiple times.
-	Buffer positionBuffer = _simulationCompute->GetPositionInputBuffer();
-	std::vector<Buffer> _particlePositionInputBuffers(VulkanCore::Get()->GetMaxFramesInFlight(), positionBuffer);
-	InitializeRenderers(_particlePositionInputBuffers, particleCount);
+	// They read the snapshots of each frame in flight, since the solver of the next frame may already be running on the async compute queue.
+	InitializeRenderers(_simulationCompute->GetPositionSnapshotBuffers(), particleCapacity, _simulationCompute->GetParticleDispatchSnapshotBuffers());
 
 	// Launch
 	_simulationCompute->SetEnable(true);
@@ -8,10 +8,20 @@ class GPUSimulatedScene : public SimulatedSceneBase
 private:
 	std::shared_ptr<SimulationCompute> _simulationCompute = nullptr;
 	Buffer _particlePositionInputBuffer = nullptr;
+	bool _isLevelInitialized = false;
+	size_t _particleCount = 0;
+	float _particleDistance = 0.0f; // Spacing of the initial block, at which particles are emitted
 
 public:
+	static const std::string ENGINE_NAME;
+
 	GPUSimulatedScene();
 	virtual void Register() override;
+	virtual const std::string &GetEngineName() const override { return ENGINE_NAME; }
 	virtual void InitializeLevel() override;
 	virtual void InitializeParticles(float particleDistance, glm::vec2 xRange, glm::vec2 yRange, glm::vec2 zRange) override;
+	virtual size_t GetParticleCount() const override { return _particleCount; }
+
+	// Steps are recorded into the compute submission of each frame and are not timed on the host
+	virtual SolverStatistics GetSolverStatistics() const override { return SolverStatistics{ ._particleCount = _particleCount }; }
 };
\ No newline at end of file
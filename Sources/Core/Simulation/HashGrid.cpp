@@ -8,12 +8,21 @@ HashGrid::HashGrid(size_t particleCount, glm::ivec3 resolution) :
 
 	_neighbors.clear();
 	_neighbors.resize(particleCount);
+
+	_cells.resize(particleCount);
 }
 
-void HashGrid::UpdateGrid(const std::vector<glm::vec3> &positions)
+void HashGrid::UpdateGrid(std::span<const glm::vec3> positions)
 {
 	// 1. Update the grids
 	size_t particleCount = positions.size();
+	if (_neighbors.size() != particleCount)
+	{
+		// The number of particles changes as they migrate between the processes of a distributed run
+		_neighbors.resize(particleCount);
+		FirstTouchReserve(_cells, particleCount);
+		_cells.resize(particleCount);
+	}
 
 	size_t bucketCount = _buckets.size();
 	#pragma omp parallel for
@@ -25,35 +34,56 @@ void HashGrid::UpdateGrid(const std::vector<glm::vec3> &positions)
 	#pragma omp parallel for num_threads(4)
 	for (size_t particleIndex = 0; particleIndex < particleCount; ++particleIndex)
 	{
-		size_t key = PositionToHashKey(positions[particleIndex]);
+		glm::ivec3 cell = PositionToBucketIndex(positions[particleIndex]);
+		size_t key = BucketIndexToHashKey(cell);
+		_cells[particleIndex] = cell;
 
 		#pragma omp critical
 		_buckets[key].push_back(static_cast<uint32_t>(particleIndex)); // Store the index of the particle
 	}
 
 	// 2. Update the neighbor list
-	#pragma omp parallel for
+	size_t scannedCount = 0;
+	size_t falseNeighborCount = 0;
+	#pragma omp parallel for reduction(+:scannedCount, falseNeighborCount)
 	for (size_t particleIndex = 0; particleIndex < particleCount; ++particleIndex)
 	{
 		_neighbors[particleIndex].clear();
 
-		// For each adjacent overlapping grid key
-		std::vector<size_t> adjacentKeys = GetAdjacentKeys(positions[particleIndex]);
+		// For each adjacent overlapping cell
+		std::vector<glm::ivec3> adjacentBucketIndices = GetAdjacentBucketIndices(positions[particleIndex]);
 		for (size_t i = 0; i < OVERLAPPING_BUCKETS; ++i)
 		{
-			const auto &bucket = _buckets[adjacentKeys[i]];
-			for (size_t neighborIndex : bucket)
+			const auto &bucket = _buckets[BucketIndexToHashKey(adjacentBucketIndices[i])];
+			scannedCount += bucket.size();
+			for (uint32_t neighborIndex : bucket)
 			{
+				// Other cells hashed into the same bucket; this also keeps a bucket shared by two adjacent cells from being visited twice.
+				if (_cells[neighborIndex] != adjacentBucketIndices[i])
+				{
+					++falseNeighborCount;
+					continue;
+				}
+
 				if (particleIndex != neighborIndex)
 				{
 					if (glm::distance(positions[particleIndex], positions[neighborIndex]) <= _gridSpacing)
 					{
-						_neighbors[particleIndex].push_back(static_cast<uint32_t>(neighborIndex));
+						_neighbors[particleIndex].push_back(neighborIndex);
 					}
 				}
 			}
 		}
 	}
+
+	// 3. Update the statistics
+	_statistics._scannedCount = scannedCount;
+	_statistics._falseNeighborCount = falseNeighborCount;
+	_statistics._maxBucketSize = 0;
+	for (const auto &bucket : _buckets)
+	{
+		_statistics._maxBucketSize = std::max(_statistics._maxBucketSize, bucket.size());
+	}
 }
 
 void HashGrid::UpdateSpacing(float gridSpacing)
@@ -65,25 +95,22 @@ glm::ivec3 HashGrid::PositionToBucketIndex(glm::vec3 position) const
 {
 	glm::ivec3 bucketIndex
 	{
-		static_cast<uint32_t>(std::floor(position.x / _gridSpacing)),
-		static_cast<uint32_t>(std::floor(position.y / _gridSpacing)),
-		static_cast<uint32_t>(std::floor(position.z / _gridSpacing))
+		static_cast<int>(std::floor(position.x / _gridSpacing)),
+		static_cast<int>(std::floor(position.y / _gridSpacing)),
+		static_cast<int>(std::floor(position.z / _gridSpacing))
 	};
 
 	return bucketIndex;
 }
 
+// Hash of unbounded cell coordinates with large primes (Teschner et al., 2003)
+// Must be kept identical to BucketIndexToHashKey in SimulationModule.slang.
 size_t HashGrid::BucketIndexToHashKey(glm::ivec3 bucketIndex) const
 {
-	auto wrappedIndex = bucketIndex;
-	wrappedIndex.x = bucketIndex.x % _resolution.x;
-	wrappedIndex.y = bucketIndex.y % _resolution.y;
-	wrappedIndex.z = bucketIndex.z % _resolution.z;
-	if (wrappedIndex.x < 0) wrappedIndex.x += _resolution.x;
-	if (wrappedIndex.y < 0) wrappedIndex.y += _resolution.y;
-	if (wrappedIndex.z < 0) wrappedIndex.z += _resolution.z;
-
-	return static_cast<size_t>((wrappedIndex.z * _resolution.y + wrappedIndex.y) * _resolution.x + wrappedIndex.x);
+	uint32_t hash = (static_cast<uint32_t>(bucketIndex.x) * 73856093u) ^ (static_cast<uint32_t>(bucketIndex.y) * 19349663u) ^ (static_cast<uint32_t>(bucketIndex.z) * 83492791u);
+	uint32_t tableSize = static_cast<uint32_t>(_resolution.x * _resolution.y * _resolution.z);
+
+	return static_cast<size_t>(hash % tableSize);
 }
 
 size_t HashGrid::PositionToHashKey(glm::vec3 position) const
@@ -92,7 +119,7 @@ size_t HashGrid::PositionToHashKey(glm::vec3 position) const
 	return BucketIndexToHashKey(bucketIndex);
 }
 
-void HashGrid::ForEachNeighborParticle(const std::vector<glm::vec3> &positions, size_t particleIndex, const std::function<void(size_t)> &callback) const
+void HashGrid::ForEachNeighborParticle(std::span<const glm::vec3> positions, size_t particleIndex, const std::function<void(size_t)> &callback) const
 {
 	for (size_t neighborIndex : _neighbors[particleIndex])
 	{
@@ -100,7 +127,7 @@ void HashGrid::ForEachNeighborParticle(const std::vector<glm::vec3> &positions,
 	}
 }
 
-std::vector<size_t> HashGrid::GetAdjacentKeys(glm::vec3 position) const
+std::vector<glm::ivec3> HashGrid::GetAdjacentBucketIndices(glm::vec3 position) const
 {
 	glm::ivec3 originIndex = PositionToBucketIndex(position);
 	std::vector<glm::ivec3> adjacentBucketIndices(OVERLAPPING_BUCKETS);
@@ -165,11 +192,5 @@ std::vector<size_t> HashGrid::GetAdjacentKeys(glm::vec3 position) const
 		adjacentBucketIndices[7].z -= 1;
 	}
 
-	std::vector<size_t> adjacentKeys(OVERLAPPING_BUCKETS);
-	for (size_t i = 0; i < OVERLAPPING_BUCKETS; ++i)
-	{
-		adjacentKeys[i] = BucketIndexToHashKey(adjacentBucketIndices[i]);
-	}
-
-	return adjacentKeys;
+	return adjacentBucketIndices;
 }
\ No newline at end of file
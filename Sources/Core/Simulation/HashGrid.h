@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <span>
 #include <functional>
 
 #define GLM_FORCE_RADIANS
@@ -10,22 +11,45 @@
 #include "glm/gtc/matrix_transform.hpp"
 
 #include "Kernel.h"
+#include "NUMAUtil.h"
 
+// Sparse spatial hash of particles.
+// Unbounded cell coordinates are hashed into a table of _resolution.x * _resolution.y * _resolution.z buckets,
+// so cells that share a bucket are scattered over the domain rather than repeating with the period of the table.
 class HashGrid
 {
+public:
+	struct Statistics
+	{
+		size_t _scannedCount = 0; // Particles visited in the adjacent buckets while building the neighbor lists
+		size_t _falseNeighborCount = 0; // Visited particles that are in a different cell hashed into the same bucket
+		size_t _maxBucketSize = 0;
+
+		float GetFalseNeighborRate() const { return _scannedCount == 0 ? 0.0f : static_cast<float>(_falseNeighborCount) / _scannedCount; }
+	};
+
 private:
 	float _gridSpacing;
 	glm::ivec3 _resolution = glm::vec3(1.0f, 1.0f, 1.0f);
 	std::vector<std::vector<uint32_t>> _buckets;
 	std::vector<std::vector<uint32_t>> _neighbors;
+	FirstTouchVector<glm::ivec3> _cells; // Cell of each particle, used to tell apart the cells that share a bucket
+	Statistics _statistics{};
 
 	static const size_t OVERLAPPING_BUCKETS = 8;
 
 public:
 	HashGrid(size_t particleCount, glm::ivec3 resolution);
-	void UpdateGrid(const std::vector<glm::vec3> &positions);
+	void UpdateGrid(std::span<const glm::vec3> positions);
 	void UpdateSpacing(float gridSpacing);
-	void ForEachNeighborParticle(const std::vector<glm::vec3> &positions, size_t particleIndex, const std::function<void(size_t)> &callback) const;
+	void ForEachNeighborParticle(std::span<const glm::vec3> positions, size_t particleIndex, const std::function<void(size_t)> &callback) const;
+
+	const auto &GetBuckets() const { return _buckets; }
+	float GetSpacing() const { return _gridSpacing; }
+	glm::ivec3 GetCell(glm::vec3 position) const { return PositionToBucketIndex(position); }
+	glm::ivec3 GetParticleCell(size_t particleIndex) const { return _cells[particleIndex]; } // As of the last update
+	size_t GetBucketKey(glm::ivec3 cell) const { return BucketIndexToHashKey(cell); }
+	const auto &GetStatistics() const { return _statistics; }
 
 private:
 	// Position -> Bucket index -> Hash key
@@ -34,6 +58,6 @@ private:
 	size_t BucketIndexToHashKey(glm::ivec3 bucketIndex) const;
 	size_t PositionToHashKey(glm::vec3 position) const;
 
-	std::vector<size_t> GetAdjacentKeys(glm::vec3 position) const;
+	std::vector<glm::ivec3> GetAdjacentBucketIndices(glm::vec3 position) const;
 };
 
@@ -1,45 +1,134 @@
 #include "Kernel.h"
 
-float Kernel::GetValue(float distance) const
+template <typename Family>
+BasicKernel<Family>::BasicKernel(float radius, bool isTabulated) :
+	_r1(radius),
+	_r2(radius * radius),
+	_valueScale(Family::VALUE_NORMALIZATION / (radius * radius * radius)),
+	_firstDerivativeScale(Family::FIRST_DERIVATIVE_NORMALIZATION / (radius * radius * radius * radius)),
+	_secondDerivativeScale(Family::SECOND_DERIVATIVE_NORMALIZATION / (radius * radius * radius * radius * radius)),
+	_isTabulated(isTabulated)
 {
-    if (distance >= _r1)
-    {
-        return 0.0f;
-    }
-    else
-    {
-        float x = 1.0f - distance * distance / _r2;
-        return static_cast<float>((315.0f * x * x * x) / (64.0f * M_PI * _r3));
-    }
+	if (!_isTabulated) return;
+
+	_table.resize(TABLE_SIZE);
+	for (uint32_t i = 0; i < TABLE_SIZE; ++i)
+	{
+		float squaredDistance = _r2 * i / (TABLE_SIZE - 1);
+		_table[i] = Evaluate(std::sqrt(squaredDistance));
+	}
+
+	// The first derivative over the distance has no value at the center, so the first entry takes that of the next one
+	_table[0].w = _table[1].w;
+}
+
+template <typename Family>
+float BasicKernel<Family>::GetValue(float distance) const
+{
+	return _isTabulated ? Sample(distance).x : Evaluate(distance).x;
+}
+
+template <typename Family>
+float BasicKernel<Family>::FirstDerivative(float distance) const
+{
+	return _isTabulated ? Sample(distance).y : Evaluate(distance).y;
+}
+
+template <typename Family>
+float BasicKernel<Family>::SecondDerivative(float distance) const
+{
+	return _isTabulated ? Sample(distance).z : Evaluate(distance).z;
 }
 
-float Kernel::FirstDerivative(float distance) const
+template <typename Family>
+glm::vec3 BasicKernel<Family>::Gradient(float distance, glm::vec3 directionToCenter) const
 {
-    if (distance >= _r1)
-    {
-        return 0.0f;
-    }
-    else
-    {
-        float x = 1.0f - distance / _r1;
-        return static_cast<float>(-45.0f * x * x / (M_PI * _r4));
-    }
+	return -FirstDerivative(distance) * directionToCenter;
 }
 
-float Kernel::SecondDerivative(float distance) const
+// W_sh(r) = W_h(r / s) / s^3, and each derivative divides by s once more
+template <typename Family>
+float BasicKernel<Family>::GetValue(float distance, float radiusScale) const
 {
-    if (distance >= _r1)
-    {
-        return 0.0f;
-    }
-    else
-    {
-        float x = 1.0f - distance / _r1;
-        return static_cast<float>(90.0f * x / (M_PI * _r5));
-    }
+	return GetValue(distance / radiusScale) / (radiusScale * radiusScale * radiusScale);
 }
 
-glm::vec3 Kernel::Gradient(float distance, glm::vec3 directionToCenter) const
+template <typename Family>
+float BasicKernel<Family>::FirstDerivative(float distance, float radiusScale) const
 {
-    return -FirstDerivative(distance) * directionToCenter;
+	float squaredScale = radiusScale * radiusScale;
+	return FirstDerivative(distance / radiusScale) / (squaredScale * squaredScale);
 }
+
+template <typename Family>
+float BasicKernel<Family>::SecondDerivative(float distance, float radiusScale) const
+{
+	float squaredScale = radiusScale * radiusScale;
+	return SecondDerivative(distance / radiusScale) / (squaredScale * squaredScale * radiusScale);
+}
+
+template <typename Family>
+glm::vec3 BasicKernel<Family>::Gradient(float distance, glm::vec3 directionToCenter, float radiusScale) const
+{
+	return -FirstDerivative(distance, radiusScale) * directionToCenter;
+}
+
+template <typename Family>
+float BasicKernel<Family>::GetValueFromSquaredDistance(float squaredDistance) const
+{
+	return EvaluateSquared(squaredDistance).x;
+}
+
+// -W'(r) * (offset / r), where the table holds W'(r) / r
+template <typename Family>
+glm::vec3 BasicKernel<Family>::GradientFromOffset(glm::vec3 offsetToCenter) const
+{
+	return -EvaluateSquared(glm::dot(offsetToCenter, offsetToCenter)).w * offsetToCenter;
+}
+
+template <typename Family>
+float BasicKernel<Family>::GetValueFromSquaredDistance(float squaredDistance, float radiusScale) const
+{
+	float squaredScale = radiusScale * radiusScale;
+	return GetValueFromSquaredDistance(squaredDistance / squaredScale) / (squaredScale * radiusScale);
+}
+
+// W'_sh(r) / r = (W'_h(r / s) / (r / s)) / s^5
+template <typename Family>
+glm::vec3 BasicKernel<Family>::GradientFromOffset(glm::vec3 offsetToCenter, float radiusScale) const
+{
+	float squaredScale = radiusScale * radiusScale;
+	float firstDerivativeOverDistance = EvaluateSquared(glm::dot(offsetToCenter, offsetToCenter) / squaredScale).w / (squaredScale * squaredScale * radiusScale);
+	return -firstDerivativeOverDistance * offsetToCenter;
+}
+
+template <typename Family>
+glm::vec4 BasicKernel<Family>::Evaluate(float distance) const
+{
+	if (distance >= _r1) return glm::vec4(0.0f);
+
+	float q = distance / _r1;
+	float firstDerivative = _firstDerivativeScale * Family::FirstDerivative(q);
+	return glm::vec4(_valueScale * Family::Value(q), firstDerivative, _secondDerivativeScale * Family::SecondDerivative(q), distance > 0.0f ? firstDerivative / distance : 0.0f);
+}
+
+template <typename Family>
+glm::vec4 BasicKernel<Family>::Sample(float distance) const
+{
+	return SampleSquared(distance * distance);
+}
+
+// Must be kept identical to SampleKernelSquared in SimulationModule.slang
+template <typename Family>
+glm::vec4 BasicKernel<Family>::SampleSquared(float squaredDistance) const
+{
+	if (squaredDistance >= _r2) return glm::vec4(0.0f);
+
+	float position = squaredDistance / _r2 * (TABLE_SIZE - 1);
+	uint32_t index = std::min(static_cast<uint32_t>(position), TABLE_SIZE - 2);
+	return glm::mix(_table[index], _table[index + 1], position - index);
+}
+
+template class BasicKernel<KernelFamily::Poly6Spiky>;
+template class BasicKernel<KernelFamily::CubicSpline>;
+template class BasicKernel<KernelFamily::WendlandC2>;
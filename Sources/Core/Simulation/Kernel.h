@@ -1,5 +1,9 @@
 #pragma once
 
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
 #define _USE_MATH_DEFINES
 #include <math.h>
 
@@ -9,29 +13,99 @@
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 
-class Kernel
+// Families of SPH kernels with the support radius h.
+// Each family gives the shape of the kernel and its derivatives over q = r / h in [0, 1],
+// and constant factors that turn them into the normalized kernel in 3D once divided by h^3, h^4 and h^5 respectively.
+namespace KernelFamily
+{
+	// Poly6 for values and spiky for derivatives (Muller et al., 2003)
+	struct Poly6Spiky
+	{
+		static constexpr float VALUE_NORMALIZATION = static_cast<float>(315.0 / (64.0 * M_PI));
+		static constexpr float FIRST_DERIVATIVE_NORMALIZATION = static_cast<float>(45.0 / M_PI);
+		static constexpr float SECOND_DERIVATIVE_NORMALIZATION = static_cast<float>(90.0 / M_PI);
+
+		static float Value(float q) { float x = 1.0f - q * q; return x * x * x; }
+		static float FirstDerivative(float q) { float x = 1.0f - q; return -x * x; }
+		static float SecondDerivative(float q) { return 1.0f - q; }
+	};
+
+	// Cubic B-spline (Monaghan, 1992)
+	struct CubicSpline
+	{
+		static constexpr float VALUE_NORMALIZATION = static_cast<float>(8.0 / M_PI);
+		static constexpr float FIRST_DERIVATIVE_NORMALIZATION = static_cast<float>(48.0 / M_PI);
+		static constexpr float SECOND_DERIVATIVE_NORMALIZATION = static_cast<float>(48.0 / M_PI);
+
+		static float Value(float q) { float x = 1.0f - q; return q <= 0.5f ? 6.0f * (q * q * q - q * q) + 1.0f : 2.0f * x * x * x; }
+		static float FirstDerivative(float q) { float x = 1.0f - q; return q <= 0.5f ? 3.0f * q * q - 2.0f * q : -x * x; }
+		static float SecondDerivative(float q) { return q <= 0.5f ? 6.0f * q - 2.0f : 2.0f * (1.0f - q); }
+	};
+
+	// Wendland C2 (Dehnen and Aly, 2012), which does not suffer from pairing with many neighbors
+	struct WendlandC2
+	{
+		static constexpr float VALUE_NORMALIZATION = static_cast<float>(21.0 / (2.0 * M_PI));
+		static constexpr float FIRST_DERIVATIVE_NORMALIZATION = static_cast<float>(210.0 / M_PI);
+		static constexpr float SECOND_DERIVATIVE_NORMALIZATION = static_cast<float>(210.0 / M_PI);
+
+		static float Value(float q) { float x = 1.0f - q; return x * x * x * x * (1.0f + 4.0f * q); }
+		static float FirstDerivative(float q) { float x = 1.0f - q; return -q * x * x * x; }
+		static float SecondDerivative(float q) { float x = 1.0f - q; return x * x * (4.0f * q - 1.0f); }
+	};
+}
+
+// Kernel of a family with a fixed support radius.
+// In the tabulated mode, the kernel and its derivatives are interpolated from a table indexed by the squared distance, which avoids powers and divisions.
+// Loops that pass the squared distance or the offset to the neighbor skip the square root as well.
+template <typename Family>
+class BasicKernel
 {
+public:
+	static const uint32_t TABLE_SIZE = 1024;
+
 private:
 	float _r1;
 	float _r2;
-	float _r3;
-	float _r4;
-	float _r5;
+	float _valueScale;
+	float _firstDerivativeScale;
+	float _secondDerivativeScale;
 
-public:
-	explicit Kernel(float radius) :
-		_r1(radius),
-		_r2(radius * _r1),
-		_r3(radius * _r2),
-		_r4(radius * _r3),
-		_r5(radius * _r4)
+	bool _isTabulated = false;
+	std::vector<glm::vec4> _table; // (Value, first derivative, second derivative, first derivative / distance) at squared distances evenly spaced over [0, r^2]
 
-	{
-	}
+public:
+	explicit BasicKernel(float radius, bool isTabulated = false);
 
-	float GetValue(float distance) const; // Smooth kernel
-	float FirstDerivative(float distance) const; // Spiky kernel
-	float SecondDerivative(float distance) const; // Spiky kernel
+	float GetValue(float distance) const;
+	float FirstDerivative(float distance) const;
+	float SecondDerivative(float distance) const;
 	glm::vec3 Gradient(float distance, glm::vec3 directionToCenter) const;
+
+	// The same shape with the support radius scaled by radiusScale, for particles of other sizes
+	float GetValue(float distance, float radiusScale) const;
+	float FirstDerivative(float distance, float radiusScale) const;
+	float SecondDerivative(float distance, float radiusScale) const;
+	glm::vec3 Gradient(float distance, glm::vec3 directionToCenter, float radiusScale) const;
+
+	// The same values from the squared distance and the offset to the center
+	float GetValueFromSquaredDistance(float squaredDistance) const;
+	glm::vec3 GradientFromOffset(glm::vec3 offsetToCenter) const;
+	float GetValueFromSquaredDistance(float squaredDistance, float radiusScale) const;
+	glm::vec3 GradientFromOffset(glm::vec3 offsetToCenter, float radiusScale) const;
+
+	const auto &GetTable() const { return _table; }
+
+private:
+	glm::vec4 Evaluate(float distance) const;
+	glm::vec4 Sample(float distance) const;
+	glm::vec4 SampleSquared(float squaredDistance) const;
+	glm::vec4 EvaluateSquared(float squaredDistance) const { return _isTabulated ? SampleSquared(squaredDistance) : Evaluate(std::sqrt(squaredDistance)); }
 };
 
+// Selected at compile time with SPH_KERNEL_FAMILY, which the shaders follow through the uploaded table
+#ifndef SPH_KERNEL_FAMILY
+#define SPH_KERNEL_FAMILY Poly6Spiky
+#endif
+
+using Kernel = BasicKernel<KernelFamily::SPH_KERNEL_FAMILY>;
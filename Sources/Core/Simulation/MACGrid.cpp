@@ -0,0 +1,309 @@
+#include "MACGrid.h"
+
+#include <cmath>
+#include <algorithm>
+
+MACGrid::MACGrid(glm::vec3 lowerBound, glm::vec3 upperBound, float spacing) :
+	_spacing(spacing)
+{
+	// A layer of wall cells on each side
+	_dimension = glm::max(glm::ivec3(glm::ceil((upperBound - lowerBound) / _spacing)), glm::ivec3(1)) + 2;
+	_origin = lowerBound - _spacing;
+
+	size_t cellCount = static_cast<size_t>(_dimension.x) * _dimension.y * _dimension.z;
+	_labels.assign(cellCount, CellLabel::Air);
+	_solidCells.assign(cellCount, 0);
+	_solidVelocities.assign(cellCount, glm::vec3());
+	_divergences.assign(cellCount, 0.0f);
+	_pressures.assign(cellCount, 0.0f);
+
+	for (glm::length_t axis = 0; axis < 3; ++axis)
+	{
+		glm::ivec3 faceDimension = GetFaceDimension(axis);
+		size_t faceCount = static_cast<size_t>(faceDimension.x) * faceDimension.y * faceDimension.z;
+
+		_velocities[axis].assign(faceCount, 0.0f);
+		_savedVelocities[axis].assign(faceCount, 0.0f);
+		_weights[axis].assign(faceCount, 0.0f);
+		_validFaces[axis].assign(faceCount, 0);
+	}
+}
+
+size_t MACGrid::GetFaceIndex(glm::length_t axis, glm::ivec3 face) const
+{
+	glm::ivec3 faceDimension = GetFaceDimension(axis);
+	return static_cast<size_t>(face.x) + static_cast<size_t>(faceDimension.x) * (static_cast<size_t>(face.y) + static_cast<size_t>(faceDimension.y) * face.z);
+}
+
+glm::ivec3 MACGrid::GetCell(glm::vec3 position) const
+{
+	return glm::clamp(glm::ivec3(glm::floor((position - _origin) / _spacing)), glm::ivec3(0), _dimension - 1);
+}
+
+glm::vec3 MACGrid::GetFacePosition(glm::length_t axis, glm::ivec3 face) const
+{
+	glm::vec3 offset(0.5f);
+	offset[axis] = 0.0f;
+	return _origin + (glm::vec3(face) + offset) * _spacing;
+}
+
+void MACGrid::UpdateSolids(SDF &sdf)
+{
+	ForEachBlock
+	(
+		_dimension,
+		[&](glm::ivec3 cell)
+		{
+			size_t cellIndex = GetCellIndex(cell);
+			_solidVelocities[cellIndex] = glm::vec3();
+
+			bool isWall = glm::any(glm::equal(cell, glm::ivec3(0))) || glm::any(glm::equal(cell, _dimension - 1));
+			if (isWall)
+			{
+				_solidCells[cellIndex] = 1;
+				return;
+			}
+
+			Intersection intersection{};
+			glm::vec3 center = _origin + (glm::vec3(cell) + 0.5f) * _spacing;
+			_solidCells[cellIndex] = sdf.GetIntersection(center, &intersection) ? 1 : 0;
+			if (_solidCells[cellIndex]) _solidVelocities[cellIndex] = intersection._pointVelocity;
+		}
+	);
+}
+
+void MACGrid::UpdateLabels(const std::vector<uint32_t> &cellBounds)
+{
+	ForEachBlock
+	(
+		_dimension,
+		[&](glm::ivec3 cell)
+		{
+			size_t cellIndex = GetCellIndex(cell);
+			if (_solidCells[cellIndex]) _labels[cellIndex] = CellLabel::Solid;
+			else if (cellBounds[cellIndex + 1] > cellBounds[cellIndex]) _labels[cellIndex] = CellLabel::Fluid;
+			else _labels[cellIndex] = CellLabel::Air;
+		}
+	);
+}
+
+void MACGrid::NormalizeTransfer()
+{
+	for (glm::length_t axis = 0; axis < 3; ++axis)
+	{
+		ForEachBlock
+		(
+			GetFaceDimension(axis),
+			[&](glm::ivec3 face)
+			{
+				size_t faceIndex = GetFaceIndex(axis, face);
+				float weight = _weights[axis][faceIndex];
+
+				_velocities[axis][faceIndex] = (weight > 0.0f) ? _velocities[axis][faceIndex] / weight : 0.0f;
+				_validFaces[axis][faceIndex] = (weight > 0.0f) ? 1 : 0;
+			}
+		);
+	}
+
+	Extrapolate();
+	_savedVelocities = _velocities;
+}
+
+void MACGrid::AddAcceleration(glm::vec3 acceleration, float timeStep)
+{
+	for (glm::length_t axis = 0; axis < 3; ++axis)
+	{
+		float deltaVelocity = acceleration[axis] * timeStep;
+		if (deltaVelocity == 0.0f) continue;
+
+		auto &velocities = _velocities[axis];
+
+		#pragma omp parallel for
+		for (size_t faceIndex = 0; faceIndex < velocities.size(); ++faceIndex)
+		{
+			velocities[faceIndex] += deltaVelocity;
+		}
+	}
+}
+
+// The pressure gradient that removes the divergence is the solution of a Poisson equation over the fluid cells.
+// Its residual is the divergence left in each cell, in the same units as the divergence error of the particle solvers.
+uint32_t MACGrid::Project(uint32_t maxIterations, float tolerance)
+{
+	EnforceBoundaries();
+
+	ForEachBlock
+	(
+		_dimension,
+		[&](glm::ivec3 cell)
+		{
+			size_t cellIndex = GetCellIndex(cell);
+			if (_labels[cellIndex] != CellLabel::Fluid)
+			{
+				_divergences[cellIndex] = 0.0f;
+				return;
+			}
+
+			float divergence = 0.0f;
+			for (glm::length_t axis = 0; axis < 3; ++axis)
+			{
+				glm::ivec3 upperFace = cell;
+				++upperFace[axis];
+				divergence += _velocities[axis][GetFaceIndex(axis, upperFace)] - _velocities[axis][GetFaceIndex(axis, cell)];
+			}
+
+			_divergences[cellIndex] = -divergence / _spacing;
+		}
+	);
+
+	_solver.Construct(_dimension, _spacing, _labels);
+	uint32_t iterationCount = _solver.Solve(_divergences, _pressures, maxIterations, tolerance);
+
+	// Subtract the gradient on the faces between fluid and fluid or air; air holds zero pressure
+	for (glm::length_t axis = 0; axis < 3; ++axis)
+	{
+		ForEachBlock
+		(
+			GetFaceDimension(axis),
+			[&](glm::ivec3 face)
+			{
+				size_t faceIndex = GetFaceIndex(axis, face);
+				_validFaces[axis][faceIndex] = 0;
+
+				glm::ivec3 lowerCell = face;
+				--lowerCell[axis];
+				if (face[axis] == 0 || face[axis] == _dimension[axis]) return;
+
+				CellLabel lowerLabel = _labels[GetCellIndex(lowerCell)];
+				CellLabel upperLabel = _labels[GetCellIndex(face)];
+				if (lowerLabel == CellLabel::Solid || upperLabel == CellLabel::Solid)
+				{
+					_validFaces[axis][faceIndex] = 1;
+					return;
+				}
+				if (lowerLabel != CellLabel::Fluid && upperLabel != CellLabel::Fluid) return;
+
+				_velocities[axis][faceIndex] -= (_pressures[GetCellIndex(face)] - _pressures[GetCellIndex(lowerCell)]) / _spacing;
+				_validFaces[axis][faceIndex] = 1;
+			}
+		);
+	}
+
+	Extrapolate();
+	return iterationCount;
+}
+
+float MACGrid::Sample(glm::length_t axis, glm::vec3 position, bool isSaved, glm::vec3 *gradient) const
+{
+	const auto &velocities = isSaved ? _savedVelocities[axis] : _velocities[axis];
+
+	glm::vec3 offset(0.5f);
+	offset[axis] = 0.0f;
+	glm::vec3 gridPosition = (position - _origin) / _spacing - offset;
+
+	glm::ivec3 faceDimension = GetFaceDimension(axis);
+	glm::ivec3 baseFace = glm::clamp(glm::ivec3(glm::floor(gridPosition)), glm::ivec3(0), faceDimension - 2);
+	glm::vec3 fraction = glm::clamp(gridPosition - glm::vec3(baseFace), glm::vec3(0.0f), glm::vec3(1.0f));
+
+	float value = 0.0f;
+	glm::vec3 valueGradient{};
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		glm::ivec3 cornerOffset(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+		glm::vec3 axisWeights = glm::mix(1.0f - fraction, fraction, glm::vec3(cornerOffset));
+		glm::vec3 axisSlopes = glm::mix(glm::vec3(-1.0f), glm::vec3(1.0f), glm::vec3(cornerOffset)) / _spacing;
+
+		float faceVelocity = velocities[GetFaceIndex(axis, baseFace + cornerOffset)];
+		value += axisWeights.x * axisWeights.y * axisWeights.z * faceVelocity;
+		valueGradient += glm::vec3
+		(
+			axisSlopes.x * axisWeights.y * axisWeights.z,
+			axisWeights.x * axisSlopes.y * axisWeights.z,
+			axisWeights.x * axisWeights.y * axisSlopes.z
+		) * faceVelocity;
+	}
+
+	if (gradient != nullptr) *gradient = valueGradient;
+	return value;
+}
+
+bool MACGrid::IsSolid(glm::ivec3 cell) const
+{
+	if (glm::any(glm::lessThan(cell, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(cell, _dimension))) return true;
+	return _solidCells[GetCellIndex(cell)] != 0;
+}
+
+// Faces of solid cells move with their colliders, and the faces on the boundary of the grid are closed
+void MACGrid::EnforceBoundaries()
+{
+	for (glm::length_t axis = 0; axis < 3; ++axis)
+	{
+		ForEachBlock
+		(
+			GetFaceDimension(axis),
+			[&](glm::ivec3 face)
+			{
+				size_t faceIndex = GetFaceIndex(axis, face);
+				if (face[axis] == 0 || face[axis] == _dimension[axis])
+				{
+					_velocities[axis][faceIndex] = 0.0f;
+					return;
+				}
+
+				glm::ivec3 lowerCell = face;
+				--lowerCell[axis];
+				if (IsSolid(lowerCell)) _velocities[axis][faceIndex] = _solidVelocities[GetCellIndex(lowerCell)][axis];
+				else if (IsSolid(face)) _velocities[axis][faceIndex] = _solidVelocities[GetCellIndex(face)][axis];
+			}
+		);
+	}
+}
+
+// Fill the unknown faces next to known ones with the average of their known neighbors, one layer at a time
+void MACGrid::Extrapolate()
+{
+	for (glm::length_t axis = 0; axis < 3; ++axis)
+	{
+		glm::ivec3 faceDimension = GetFaceDimension(axis);
+		auto &velocities = _velocities[axis];
+		auto &validFaces = _validFaces[axis];
+
+		for (uint32_t layer = 0; layer < EXTRAPOLATION_LAYERS; ++layer)
+		{
+			std::vector<uint8_t> previousValidFaces = validFaces;
+			ForEachBlock
+			(
+				faceDimension,
+				[&](glm::ivec3 face)
+				{
+					size_t faceIndex = GetFaceIndex(axis, face);
+					if (previousValidFaces[faceIndex]) return;
+
+					float sum = 0.0f;
+					uint32_t count = 0;
+					for (glm::length_t neighborAxis = 0; neighborAxis < 3; ++neighborAxis)
+					{
+						for (int direction = -1; direction <= 1; direction += 2)
+						{
+							glm::ivec3 neighbor = face;
+							neighbor[neighborAxis] += direction;
+							if (neighbor[neighborAxis] < 0 || neighbor[neighborAxis] >= faceDimension[neighborAxis]) continue;
+
+							size_t neighborIndex = GetFaceIndex(axis, neighbor);
+							if (!previousValidFaces[neighborIndex]) continue;
+
+							sum += velocities[neighborIndex];
+							++count;
+						}
+					}
+
+					if (count > 0)
+					{
+						velocities[faceIndex] = sum / count;
+						validFaces[faceIndex] = 1;
+					}
+				}
+			);
+		}
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <omp.h>
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+#include "SDF.h"
+#include "MultigridSolver.h"
+
+// Staggered grid of the hybrid engine; pressures live at cell centers and each velocity component on the faces normal to its axis.
+// The face (x, y, z) of an axis lies on the lower side of the cell (x, y, z) along that axis, so the faces of an axis have one more layer than the cells.
+// The outermost layer of cells is solid, which walls the fluid in the domain.
+class MACGrid
+{
+public:
+	static const int BLOCK_SIZE = 8; // Cells along each axis of the blocks that parallel loops are split into
+
+private:
+	glm::ivec3 _dimension{};
+	glm::vec3 _origin{}; // Lower corner of the first cell
+	float _spacing = 1.0f;
+
+	std::array<std::vector<float>, 3> _velocities;
+	std::array<std::vector<float>, 3> _savedVelocities; // Before the forces and the projection, for the FLIP update
+	std::array<std::vector<float>, 3> _weights; // Sums of the transfer weights of the particles around each face
+	std::array<std::vector<uint8_t>, 3> _validFaces; // Faces whose velocities are known, which are extrapolated into the others
+
+	std::vector<CellLabel> _labels;
+	std::vector<uint8_t> _solidCells; // Cells inside colliders, refreshed when the level changes
+	std::vector<glm::vec3> _solidVelocities; // Velocities of the colliders at solid cells
+	std::vector<float> _divergences; // Negated divergences of fluid cells, the right-hand side of the projection
+	std::vector<float> _pressures; // Pressures scaled by the time step over the density
+
+	MultigridSolver _solver;
+
+	static const uint32_t EXTRAPOLATION_LAYERS = 2; // Particles sample faces at most a cell away from the fluid
+
+public:
+	MACGrid(glm::vec3 lowerBound, glm::vec3 upperBound, float spacing);
+
+	glm::ivec3 GetDimension() const { return _dimension; }
+	glm::ivec3 GetFaceDimension(glm::length_t axis) const { glm::ivec3 faceDimension = _dimension; ++faceDimension[axis]; return faceDimension; }
+	float GetSpacing() const { return _spacing; }
+	glm::vec3 GetOrigin() const { return _origin; }
+	size_t GetCellCount() const { return _labels.size(); }
+
+	size_t GetCellIndex(glm::ivec3 cell) const { return static_cast<size_t>(cell.x) + static_cast<size_t>(_dimension.x) * (static_cast<size_t>(cell.y) + static_cast<size_t>(_dimension.y) * cell.z); }
+	size_t GetFaceIndex(glm::length_t axis, glm::ivec3 face) const;
+	glm::ivec3 GetCell(glm::vec3 position) const; // Clamped into the grid
+	glm::vec3 GetFacePosition(glm::length_t axis, glm::ivec3 face) const;
+
+	auto &GetVelocities(glm::length_t axis) { return _velocities[axis]; }
+	auto &GetWeights(glm::length_t axis) { return _weights[axis]; }
+
+	// Mark the cells inside the colliders
+	void UpdateSolids(SDF &sdf);
+
+	// Label the cells that hold particles as fluid; cellBounds holds the offset of the first particle of each cell, followed by the end
+	void UpdateLabels(const std::vector<uint32_t> &cellBounds);
+
+	// Turn the transferred momenta into velocities, extrapolate them and keep a copy for the FLIP update
+	void NormalizeTransfer();
+	void AddAcceleration(glm::vec3 acceleration, float timeStep);
+
+	// Make the velocity field divergence-free on the fluid cells; returns the number of iterations taken
+	uint32_t Project(uint32_t maxIterations, float tolerance);
+
+	// Velocity component at a position, interpolated trilinearly from the faces of the axis, with its gradient if requested
+	float Sample(glm::length_t axis, glm::vec3 position, bool isSaved, glm::vec3 *gradient = nullptr) const;
+
+	// Visit the cells of a grid in parallel, block by block, so that each thread sweeps a compact region
+	template<typename TFunc>
+	static void ForEachBlock(glm::ivec3 dimension, TFunc func)
+	{
+		glm::ivec3 blockCounts = (dimension + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		size_t blockCount = static_cast<size_t>(blockCounts.x) * blockCounts.y * blockCounts.z;
+
+		#pragma omp parallel for schedule(dynamic)
+		for (size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+		{
+			glm::ivec3 block
+			(
+				static_cast<int>(blockIndex % blockCounts.x),
+				static_cast<int>((blockIndex / blockCounts.x) % blockCounts.y),
+				static_cast<int>(blockIndex / (static_cast<size_t>(blockCounts.x) * blockCounts.y))
+			);
+			glm::ivec3 lowerCell = block * BLOCK_SIZE;
+			glm::ivec3 upperCell = glm::min(lowerCell + BLOCK_SIZE, dimension);
+
+			for (int z = lowerCell.z; z < upperCell.z; ++z)
+			{
+				for (int y = lowerCell.y; y < upperCell.y; ++y)
+				{
+					for (int x = lowerCell.x; x < upperCell.x; ++x)
+					{
+						func(glm::ivec3(x, y, z));
+					}
+				}
+			}
+		}
+	}
+
+private:
+	bool IsSolid(glm::ivec3 cell) const;
+	void EnforceBoundaries();
+	void Extrapolate();
+};
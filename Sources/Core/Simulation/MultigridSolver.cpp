@@ -0,0 +1,310 @@
+#include "MultigridSolver.h"
+
+#include <omp.h>
+#include <array>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+	const std::array<glm::ivec3, 6> NEIGHBOR_OFFSETS =
+	{
+		glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0),
+		glm::ivec3(0, -1, 0), glm::ivec3(0, 1, 0),
+		glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1)
+	};
+
+	bool IsInside(glm::ivec3 dimension, glm::ivec3 cell)
+	{
+		return glm::all(glm::greaterThanEqual(cell, glm::ivec3(0))) && glm::all(glm::lessThan(cell, dimension));
+	}
+}
+
+void MultigridSolver::Construct(glm::ivec3 dimension, float spacing, const std::vector<CellLabel> &labels)
+{
+	_levels.clear();
+
+	Level finestLevel{ ._dimension = dimension, ._inverseSquaredSpacing = 1.0f / (spacing * spacing), ._labels = labels };
+	_levels.push_back(std::move(finestLevel));
+
+	while (glm::all(glm::greaterThan(_levels.back()._dimension, glm::ivec3(MIN_COARSE_DIMENSION))))
+	{
+		const Level &fineLevel = _levels.back();
+
+		Level coarseLevel{ ._dimension = (fineLevel._dimension + 1) / 2, ._inverseSquaredSpacing = fineLevel._inverseSquaredSpacing * 0.25f };
+		coarseLevel._labels.resize(static_cast<size_t>(coarseLevel._dimension.x) * coarseLevel._dimension.y * coarseLevel._dimension.z);
+
+		#pragma omp parallel for
+		for (int z = 0; z < coarseLevel._dimension.z; ++z)
+		{
+			for (int y = 0; y < coarseLevel._dimension.y; ++y)
+			{
+				for (int x = 0; x < coarseLevel._dimension.x; ++x)
+				{
+					bool hasAir = false;
+					bool hasFluid = false;
+					for (int child = 0; child < 8; ++child)
+					{
+						glm::ivec3 fineCell = glm::ivec3(x, y, z) * 2 + glm::ivec3(child & 1, (child >> 1) & 1, (child >> 2) & 1);
+						if (!IsInside(fineLevel._dimension, fineCell)) continue;
+
+						CellLabel label = fineLevel._labels[GetCellIndex(fineLevel._dimension, fineCell.x, fineCell.y, fineCell.z)];
+						hasAir |= (label == CellLabel::Air);
+						hasFluid |= (label == CellLabel::Fluid);
+					}
+
+					coarseLevel._labels[GetCellIndex(coarseLevel._dimension, x, y, z)] = hasAir ? CellLabel::Air : (hasFluid ? CellLabel::Fluid : CellLabel::Solid);
+				}
+			}
+		}
+
+		_levels.push_back(std::move(coarseLevel));
+	}
+
+	// The diagonal of a fluid cell counts the faces that are open to fluid or air
+	for (Level &level : _levels)
+	{
+		size_t cellCount = level._labels.size();
+		level._inverseDiagonals.assign(cellCount, 0.0f);
+		level._solution.assign(cellCount, 0.0f);
+		level._rightHandSide.assign(cellCount, 0.0f);
+		level._product.assign(cellCount, 0.0f);
+
+		#pragma omp parallel for
+		for (int z = 0; z < level._dimension.z; ++z)
+		{
+			for (int y = 0; y < level._dimension.y; ++y)
+			{
+				for (int x = 0; x < level._dimension.x; ++x)
+				{
+					size_t cellIndex = GetCellIndex(level._dimension, x, y, z);
+					if (level._labels[cellIndex] != CellLabel::Fluid) continue;
+
+					uint32_t openFaceCount = 0;
+					for (glm::ivec3 offset : NEIGHBOR_OFFSETS)
+					{
+						glm::ivec3 neighbor = glm::ivec3(x, y, z) + offset;
+						if (IsInside(level._dimension, neighbor) && level._labels[GetCellIndex(level._dimension, neighbor.x, neighbor.y, neighbor.z)] != CellLabel::Solid) ++openFaceCount;
+					}
+
+					if (openFaceCount > 0) level._inverseDiagonals[cellIndex] = 1.0f / (openFaceCount * level._inverseSquaredSpacing);
+				}
+			}
+		}
+	}
+
+	size_t fineCellCount = labels.size();
+	_residual.assign(fineCellCount, 0.0f);
+	_direction.assign(fineCellCount, 0.0f);
+	_directionProduct.assign(fineCellCount, 0.0f);
+}
+
+uint32_t MultigridSolver::Solve(const std::vector<float> &rightHandSide, std::vector<float> &solution, uint32_t maxIterations, float tolerance)
+{
+	Level &finestLevel = _levels.front();
+
+	solution.assign(rightHandSide.size(), 0.0f);
+	_residual = rightHandSide;
+	if (MaxAbs(_residual) <= tolerance) return 0;
+
+	// The preconditioned residual is the solution of the V-cycle on the finest level
+	finestLevel._rightHandSide = _residual;
+	VCycle(0);
+	_direction = finestLevel._solution;
+	double residualDotPreconditioned = Dot(_residual, finestLevel._solution);
+
+	for (uint32_t iteration = 1; iteration <= maxIterations; ++iteration)
+	{
+		Apply(finestLevel, _direction, _directionProduct);
+		double directionDotProduct = Dot(_direction, _directionProduct);
+		if (directionDotProduct <= 0.0) return iteration;
+
+		float stepLength = static_cast<float>(residualDotPreconditioned / directionDotProduct);
+
+		#pragma omp parallel for
+		for (size_t cellIndex = 0; cellIndex < solution.size(); ++cellIndex)
+		{
+			solution[cellIndex] += stepLength * _direction[cellIndex];
+			_residual[cellIndex] -= stepLength * _directionProduct[cellIndex];
+		}
+
+		if (MaxAbs(_residual) <= tolerance || iteration == maxIterations) return iteration;
+
+		finestLevel._rightHandSide = _residual;
+		VCycle(0);
+		double nextResidualDotPreconditioned = Dot(_residual, finestLevel._solution);
+		float directionScale = static_cast<float>(nextResidualDotPreconditioned / residualDotPreconditioned);
+		residualDotPreconditioned = nextResidualDotPreconditioned;
+
+		#pragma omp parallel for
+		for (size_t cellIndex = 0; cellIndex < solution.size(); ++cellIndex)
+		{
+			_direction[cellIndex] = finestLevel._solution[cellIndex] + directionScale * _direction[cellIndex];
+		}
+	}
+
+	return maxIterations;
+}
+
+// Negative Laplacian over the fluid cells; air neighbors contribute zero pressure
+void MultigridSolver::Apply(const Level &level, const std::vector<float> &values, std::vector<float> &result) const
+{
+	#pragma omp parallel for
+	for (int z = 0; z < level._dimension.z; ++z)
+	{
+		for (int y = 0; y < level._dimension.y; ++y)
+		{
+			for (int x = 0; x < level._dimension.x; ++x)
+			{
+				size_t cellIndex = GetCellIndex(level._dimension, x, y, z);
+				if (level._labels[cellIndex] != CellLabel::Fluid)
+				{
+					result[cellIndex] = 0.0f;
+					continue;
+				}
+
+				float sum = 0.0f;
+				uint32_t openFaceCount = 0;
+				for (glm::ivec3 offset : NEIGHBOR_OFFSETS)
+				{
+					glm::ivec3 neighbor = glm::ivec3(x, y, z) + offset;
+					if (!IsInside(level._dimension, neighbor)) continue;
+
+					size_t neighborIndex = GetCellIndex(level._dimension, neighbor.x, neighbor.y, neighbor.z);
+					CellLabel neighborLabel = level._labels[neighborIndex];
+					if (neighborLabel == CellLabel::Solid) continue;
+
+					++openFaceCount;
+					if (neighborLabel == CellLabel::Fluid) sum += values[neighborIndex];
+				}
+
+				result[cellIndex] = (openFaceCount * values[cellIndex] - sum) * level._inverseSquaredSpacing;
+			}
+		}
+	}
+}
+
+void MultigridSolver::Smooth(Level &level, uint32_t sweepCount)
+{
+	for (uint32_t sweep = 0; sweep < sweepCount; ++sweep)
+	{
+		Apply(level, level._solution, level._product);
+
+		#pragma omp parallel for
+		for (size_t cellIndex = 0; cellIndex < level._solution.size(); ++cellIndex)
+		{
+			level._solution[cellIndex] += JACOBI_WEIGHT * (level._rightHandSide[cellIndex] - level._product[cellIndex]) * level._inverseDiagonals[cellIndex];
+		}
+	}
+}
+
+void MultigridSolver::VCycle(size_t levelIndex)
+{
+	Level &level = _levels[levelIndex];
+	std::fill(level._solution.begin(), level._solution.end(), 0.0f);
+
+	if (levelIndex + 1 == _levels.size())
+	{
+		Smooth(level, COARSEST_SWEEPS);
+		return;
+	}
+
+	Smooth(level, SMOOTHING_SWEEPS);
+
+	// Correct with the coarse solution for the residual
+	Level &coarseLevel = _levels[levelIndex + 1];
+	Apply(level, level._solution, level._product);
+	Restrict(level, coarseLevel);
+	VCycle(levelIndex + 1);
+	Prolongate(coarseLevel, level);
+
+	Smooth(level, SMOOTHING_SWEEPS);
+}
+
+// Average of the residuals of the fluid children; the residual is taken from the right-hand side and the last product
+void MultigridSolver::Restrict(const Level &fineLevel, Level &coarseLevel) const
+{
+	#pragma omp parallel for
+	for (int z = 0; z < coarseLevel._dimension.z; ++z)
+	{
+		for (int y = 0; y < coarseLevel._dimension.y; ++y)
+		{
+			for (int x = 0; x < coarseLevel._dimension.x; ++x)
+			{
+				size_t coarseIndex = GetCellIndex(coarseLevel._dimension, x, y, z);
+				if (coarseLevel._labels[coarseIndex] != CellLabel::Fluid)
+				{
+					coarseLevel._rightHandSide[coarseIndex] = 0.0f;
+					continue;
+				}
+
+				float sum = 0.0f;
+				for (int child = 0; child < 8; ++child)
+				{
+					glm::ivec3 fineCell = glm::ivec3(x, y, z) * 2 + glm::ivec3(child & 1, (child >> 1) & 1, (child >> 2) & 1);
+					if (!IsInside(fineLevel._dimension, fineCell)) continue;
+
+					size_t fineIndex = GetCellIndex(fineLevel._dimension, fineCell.x, fineCell.y, fineCell.z);
+					if (fineLevel._labels[fineIndex] == CellLabel::Fluid) sum += fineLevel._rightHandSide[fineIndex] - fineLevel._product[fineIndex];
+				}
+
+				coarseLevel._rightHandSide[coarseIndex] = sum * 0.125f;
+			}
+		}
+	}
+}
+
+// Each fluid child takes the correction of its parent
+void MultigridSolver::Prolongate(const Level &coarseLevel, Level &fineLevel) const
+{
+	#pragma omp parallel for
+	for (int z = 0; z < fineLevel._dimension.z; ++z)
+	{
+		for (int y = 0; y < fineLevel._dimension.y; ++y)
+		{
+			for (int x = 0; x < fineLevel._dimension.x; ++x)
+			{
+				size_t fineIndex = GetCellIndex(fineLevel._dimension, x, y, z);
+				if (fineLevel._labels[fineIndex] != CellLabel::Fluid) continue;
+
+				fineLevel._solution[fineIndex] += coarseLevel._solution[GetCellIndex(coarseLevel._dimension, x / 2, y / 2, z / 2)];
+			}
+		}
+	}
+}
+
+double MultigridSolver::Dot(const std::vector<float> &lhs, const std::vector<float> &rhs)
+{
+	double sum = 0.0;
+
+	#pragma omp parallel for reduction(+:sum)
+	for (size_t index = 0; index < lhs.size(); ++index)
+	{
+		sum += static_cast<double>(lhs[index]) * rhs[index];
+	}
+
+	return sum;
+}
+
+float MultigridSolver::MaxAbs(const std::vector<float> &values)
+{
+	float maxValue = 0.0f;
+
+	#pragma omp parallel
+	{
+		float localMaxValue = 0.0f;
+
+		#pragma omp for
+		for (size_t index = 0; index < values.size(); ++index)
+		{
+			localMaxValue = std::max(localMaxValue, std::abs(values[index]));
+		}
+
+		#pragma omp critical
+		{
+			maxValue = std::max(maxValue, localMaxValue);
+		}
+	}
+
+	return maxValue;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+enum class CellLabel : uint8_t
+{
+	Solid,
+	Fluid,
+	Air
+};
+
+// Conjugate gradients on the pressure Poisson equation of a MAC grid, preconditioned by a multigrid V-cycle (McAdams et al., 2010).
+// The unknowns are the pressures of fluid cells; air cells hold zero pressure, and faces toward solid cells carry no pressure flux.
+// Each coarser level halves the resolution and rediscretizes the operator; a coarse cell is air if any of its children is, so that the free surface is kept.
+// The V-cycle smooths with weighted Jacobi the same number of times before and after the correction, which keeps the preconditioner symmetric.
+class MultigridSolver
+{
+private:
+	struct Level
+	{
+		glm::ivec3 _dimension{};
+		float _inverseSquaredSpacing = 1.0f;
+		std::vector<CellLabel> _labels;
+		std::vector<float> _inverseDiagonals; // Zero for cells that are not fluid
+		std::vector<float> _solution;
+		std::vector<float> _rightHandSide;
+		std::vector<float> _product; // Operator applied to the solution
+	};
+
+	std::vector<Level> _levels;
+
+	// Vectors of the conjugate gradients on the finest level
+	std::vector<float> _residual;
+	std::vector<float> _direction;
+	std::vector<float> _directionProduct;
+
+	static const int MIN_COARSE_DIMENSION = 4; // Coarsening stops once any axis has this few cells
+	static const uint32_t SMOOTHING_SWEEPS = 2;
+	static const uint32_t COARSEST_SWEEPS = 32; // The coarsest level is solved approximately by smoothing alone
+	static constexpr float JACOBI_WEIGHT = 2.0f / 3.0f;
+
+public:
+	// Build the hierarchy for the labels of the finest grid
+	void Construct(glm::ivec3 dimension, float spacing, const std::vector<CellLabel> &labels);
+
+	// Solve for the pressures until the largest residual falls to the tolerance; returns the number of iterations taken
+	uint32_t Solve(const std::vector<float> &rightHandSide, std::vector<float> &solution, uint32_t maxIterations, float tolerance);
+
+private:
+	void Apply(const Level &level, const std::vector<float> &values, std::vector<float> &result) const;
+	void Smooth(Level &level, uint32_t sweepCount);
+	void VCycle(size_t levelIndex);
+	void Restrict(const Level &fineLevel, Level &coarseLevel) const;
+	void Prolongate(const Level &coarseLevel, Level &fineLevel) const;
+
+	static double Dot(const std::vector<float> &lhs, const std::vector<float> &rhs);
+	static float MaxAbs(const std::vector<float> &values);
+	static size_t GetCellIndex(glm::ivec3 dimension, int x, int y, int z) { return static_cast<size_t>(x) + static_cast<size_t>(dimension.x) * (static_cast<size_t>(y) + static_cast<size_t>(dimension.y) * z); }
+};
@@ -0,0 +1,92 @@
+#include "OccupancyGrid.h"
+
+OccupancyGrid::OccupancyGrid(glm::ivec3 resolution) :
+	_resolution(resolution)
+{
+	size_t cellCount = static_cast<size_t>(_resolution.x) * _resolution.y * _resolution.z;
+	_cells.resize((cellCount + 31) / 32);
+}
+
+// Mark the cells around every collidable triangle of the props.
+// This only has to be redone when props move or the parameters that decide the spacing and the reach change.
+void OccupancyGrid::Construct(const BVH &bvh, const SimulationParameters &simulationParameters)
+{
+	_gridSpacing = 2.0f * simulationParameters._particleRadius * simulationParameters._kernelRadiusFactor;
+	_maxDisplacement = MAX_SPEED * simulationParameters._timeStep;
+	std::fill(_cells.begin(), _cells.end(), 0);
+
+	// A particle starting from an unmarked cell cannot reach any triangle within a step of _maxDisplacement
+	float margin = _maxDisplacement + simulationParameters._particleRadius;
+
+	const auto &meshNodes = bvh.GetMeshNodes();
+	for (const auto &instance : bvh.GetInstances())
+	{
+		std::stack<uint32_t> nodeStack;
+		nodeStack.push(instance._rootNode);
+		while (!nodeStack.empty())
+		{
+			const auto &node = meshNodes[nodeStack.top()];
+			nodeStack.pop();
+
+			if (node._child1 != BVH::NONE)
+			{
+				nodeStack.push(node._child1);
+				nodeStack.push(node._child2);
+				continue;
+			}
+
+			const Triangle &triangle = node._boundingBox._triangle;
+			glm::vec3 A = instance._modelToWorld * glm::vec4(glm::vec3(triangle.A), 1.0f);
+			glm::vec3 B = instance._modelToWorld * glm::vec4(glm::vec3(triangle.B), 1.0f);
+			glm::vec3 C = instance._modelToWorld * glm::vec4(glm::vec3(triangle.C), 1.0f);
+
+			glm::vec3 lowerBound = glm::min(glm::min(A, B), C) - margin;
+			glm::vec3 upperBound = glm::max(glm::max(A, B), C) + margin;
+			MarkCells(lowerBound, upperBound);
+		}
+	}
+}
+
+bool OccupancyGrid::IsNearCollider(glm::vec3 currentPosition, glm::vec3 nextPosition) const
+{
+	if (glm::distance(currentPosition, nextPosition) > _maxDisplacement) return true;
+
+	return IsMarked(BucketIndexToHashKey(PositionToBucketIndex(currentPosition)));
+}
+
+void OccupancyGrid::MarkCells(glm::vec3 lowerBound, glm::vec3 upperBound)
+{
+	glm::ivec3 lowerIndex = PositionToBucketIndex(lowerBound);
+	glm::ivec3 upperIndex = PositionToBucketIndex(upperBound);
+
+	for (int z = lowerIndex.z; z <= upperIndex.z; ++z)
+	{
+		for (int y = lowerIndex.y; y <= upperIndex.y; ++y)
+		{
+			for (int x = lowerIndex.x; x <= upperIndex.x; ++x)
+			{
+				MarkCell(BucketIndexToHashKey(glm::ivec3(x, y, z)));
+			}
+		}
+	}
+}
+
+glm::ivec3 OccupancyGrid::PositionToBucketIndex(glm::vec3 position) const
+{
+	glm::ivec3 bucketIndex
+	{
+		static_cast<int>(std::floor(position.x / _gridSpacing)),
+		static_cast<int>(std::floor(position.y / _gridSpacing)),
+		static_cast<int>(std::floor(position.z / _gridSpacing))
+	};
+
+	return bucketIndex;
+}
+
+size_t OccupancyGrid::BucketIndexToHashKey(glm::ivec3 bucketIndex) const
+{
+	uint32_t hash = (static_cast<uint32_t>(bucketIndex.x) * 73856093u) ^ (static_cast<uint32_t>(bucketIndex.y) * 19349663u) ^ (static_cast<uint32_t>(bucketIndex.z) * 83492791u);
+	uint32_t tableSize = static_cast<uint32_t>(_resolution.x * _resolution.y * _resolution.z);
+
+	return static_cast<size_t>(hash % tableSize);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <stack>
+#include <algorithm>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "BVH.h"
+#include "SimulationParameters.h"
+
+// Conservative broad phase for collisions with props.
+// A cell is marked if any collidable triangle is within the reach of a particle step from it.
+// Cells are aligned with the buckets of the hash grid and hashed in the same way, so a marked bucket may also cover far cells that share it.
+class OccupancyGrid
+{
+public:
+	// Particles moving faster than this within a time step are always tested against the colliders
+	static constexpr float MAX_SPEED = 10.0f;
+
+private:
+	glm::ivec3 _resolution = glm::ivec3(1, 1, 1);
+	float _gridSpacing = 1.0f;
+	float _maxDisplacement = 0.0f;
+	std::vector<uint32_t> _cells; // One bit per cell
+
+public:
+	OccupancyGrid(glm::ivec3 resolution);
+	void Construct(const BVH &bvh, const SimulationParameters &simulationParameters);
+
+	// Whether the step from currentPosition to nextPosition may hit any collider
+	bool IsNearCollider(glm::vec3 currentPosition, glm::vec3 nextPosition) const;
+
+	const auto &GetCells() const { return _cells; }
+
+private:
+	void MarkCells(glm::vec3 lowerBound, glm::vec3 upperBound);
+	void MarkCell(size_t key) { _cells[key >> 5] |= (1u << (key & 31)); }
+	bool IsMarked(size_t key) const { return (_cells[key >> 5] & (1u << (key & 31))) != 0; }
+
+	// Same as the mapping of HashGrid
+	glm::ivec3 PositionToBucketIndex(glm::vec3 position) const;
+	size_t BucketIndexToHashKey(glm::ivec3 bucketIndex) const;
+};
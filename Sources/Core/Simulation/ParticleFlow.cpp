@@ -0,0 +1,136 @@
+#include "ParticleFlow.h"
+
+#include <cmath>
+
+Sink Sink::CreatePlane(glm::vec3 point, glm::vec3 normal)
+{
+	glm::vec3 unitNormal = glm::normalize(normal);
+
+	Sink sink{};
+	sink._plane = glm::vec4(unitNormal, glm::dot(unitNormal, point));
+	sink._shape = SinkShape::Plane;
+	return sink;
+}
+
+Sink Sink::CreateBox(glm::vec3 lowerBound, glm::vec3 upperBound)
+{
+	Sink sink{};
+	sink._lowerBound = glm::vec4(glm::min(lowerBound, upperBound), 0.0f);
+	sink._upperBound = glm::vec4(glm::max(lowerBound, upperBound), 0.0f);
+	sink._shape = SinkShape::Box;
+	return sink;
+}
+
+bool Sink::Contains(glm::vec3 position) const
+{
+	if (_shape == SinkShape::Plane) return glm::dot(glm::vec3(_plane), position) > _plane.w;
+	return glm::all(glm::greaterThanEqual(position, glm::vec3(_lowerBound))) && glm::all(glm::lessThanEqual(position, glm::vec3(_upperBound)));
+}
+
+void ParticleFlow::AddEmitter(const Emitter &emitter)
+{
+	_emitters.push_back(emitter);
+	_pendingDistances.push_back(0.0f);
+}
+
+void ParticleFlow::AddSink(const Sink &sink)
+{
+	_sinks.push_back(sink);
+}
+
+void ParticleFlow::Clear()
+{
+	_emitters.clear();
+	_sinks.clear();
+	_pendingDistances.clear();
+}
+
+bool ParticleFlow::IsSunk(glm::vec3 position) const
+{
+	return std::any_of(_sinks.cbegin(), _sinks.cend(), [position](const Sink &sink) { return sink.Contains(position); });
+}
+
+void ParticleFlow::Emit(float timeStep, float spacing, std::vector<glm::vec3> &positions, std::vector<glm::vec3> &velocities)
+{
+	if (spacing <= 0.0f) return;
+
+	for (size_t emitterIndex = 0; emitterIndex < _emitters.size(); ++emitterIndex)
+	{
+		const Emitter &emitter = _emitters[emitterIndex];
+		float speed = glm::length(emitter._velocity);
+		if (speed <= 0.0f) continue;
+
+		float &pendingDistance = _pendingDistances[emitterIndex];
+		pendingDistance += speed * timeStep;
+
+		uint32_t layerCount = static_cast<uint32_t>(pendingDistance / spacing);
+		if (layerCount == 0) continue;
+		if (layerCount > MAX_LAYERS_PER_STEP)
+		{
+			pendingDistance = MAX_LAYERS_PER_STEP * spacing;
+			layerCount = MAX_LAYERS_PER_STEP;
+		}
+
+		// Axes across the flow
+		glm::vec3 direction = emitter._velocity / speed;
+		glm::vec3 reference = (std::abs(direction.y) < 0.99f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+		glm::vec3 uAxis = glm::normalize(glm::cross(direction, reference));
+		glm::vec3 vAxis = glm::cross(direction, uAxis);
+
+		int uCount = std::max(static_cast<int>(std::floor(2.0f * emitter._extent.x / spacing)) + 1, 1);
+		int vCount = std::max(static_cast<int>(std::floor(2.0f * emitter._extent.y / spacing)) + 1, 1);
+		glm::vec3 corner = emitter._center - 0.5f * spacing * (static_cast<float>(uCount - 1) * uAxis + static_cast<float>(vCount - 1) * vAxis);
+
+		for (uint32_t layer = 0; layer < layerCount; ++layer)
+		{
+			pendingDistance -= spacing;
+			glm::vec3 layerCorner = corner + pendingDistance * direction; // The flow has advanced this far since the layer crossed the opening
+
+			for (int v = 0; v < vCount; ++v)
+			{
+				for (int u = 0; u < uCount; ++u)
+				{
+					positions.push_back(layerCorner + spacing * (static_cast<float>(u) * uAxis + static_cast<float>(v) * vAxis));
+					velocities.push_back(emitter._velocity);
+				}
+			}
+		}
+	}
+}
+
+void ParticlePool::Reset(size_t capacity, size_t count)
+{
+	_capacity = capacity;
+	_count = std::min(count, capacity);
+	_aliveMask.assign(_capacity, 0);
+	std::fill(_aliveMask.begin(), _aliveMask.begin() + _count, 1);
+	_freeSlots.clear();
+}
+
+void ParticlePool::Free(size_t slot)
+{
+	if (!_aliveMask[slot]) return;
+
+	_aliveMask[slot] = 0;
+	_freeSlots.push_back(static_cast<uint32_t>(slot));
+}
+
+bool ParticlePool::Allocate(size_t &slot)
+{
+	if (!_freeSlots.empty())
+	{
+		slot = _freeSlots.back();
+		_freeSlots.pop_back();
+	}
+	else if (_count < _capacity)
+	{
+		slot = _count++;
+	}
+	else
+	{
+		return false;
+	}
+
+	_aliveMask[slot] = 1;
+	return true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+// Opening that particles flow in through, such as an inflow face or a nozzle.
+// Particles are placed in layers on a square lattice of the particle spacing, a layer each time the flow has advanced by the spacing.
+struct Emitter
+{
+	glm::vec3 _center{};
+	glm::vec3 _velocity{}; // Normal to the opening; its speed sets the rate of the flow
+	glm::vec2 _extent{}; // Half sizes of the opening across the flow
+};
+
+enum class SinkShape : uint32_t
+{
+	Plane, // Outflow; particles past the plane are removed
+	Box // Kill volume; particles inside the box are removed
+};
+
+// Region where particles leave the scene; laid out to be read by the shaders as is
+struct Sink
+{
+	alignas(16) glm::vec4 _plane{}; // Normal and offset of the plane; particles with dot(normal, position) > offset are past it
+	alignas(16) glm::vec4 _lowerBound{};
+	alignas(16) glm::vec4 _upperBound{};
+	alignas(4) SinkShape _shape = SinkShape::Plane;
+
+	static Sink CreatePlane(glm::vec3 point, glm::vec3 normal);
+	static Sink CreateBox(glm::vec3 lowerBound, glm::vec3 upperBound);
+
+	bool Contains(glm::vec3 position) const;
+};
+
+// Emitters and sinks of a scene
+class ParticleFlow
+{
+private:
+	std::vector<Emitter> _emitters;
+	std::vector<Sink> _sinks;
+	std::vector<float> _pendingDistances; // Distance the flow of each emitter has advanced since its last layer
+
+	static const uint32_t MAX_LAYERS_PER_STEP = 4; // Flow beyond this after a long step is dropped rather than emitted as a burst
+
+public:
+	void AddEmitter(const Emitter &emitter);
+	void AddSink(const Sink &sink);
+	void Clear();
+
+	const auto &GetEmitters() const { return _emitters; }
+	const auto &GetSinks() const { return _sinks; }
+	bool HasEmitters() const { return !_emitters.empty(); }
+	bool IsEmpty() const { return _emitters.empty() && _sinks.empty(); }
+
+	bool IsSunk(glm::vec3 position) const;
+
+	// Append the particles that the emitters let in over the time step.
+	// Layers emitted earlier in the step have moved further along the flow by its end.
+	void Emit(float timeStep, float spacing, std::vector<glm::vec3> &positions, std::vector<glm::vec3> &velocities);
+};
+
+// Slots of a fixed capacity for particles that come and go.
+// Removed particles leave holes that new ones take first, and Compact fills the holes that are left with the live particles at the end,
+// so that the live particles are dense again for the passes over them.
+class ParticlePool
+{
+private:
+	size_t _capacity = 0;
+	size_t _count = 0; // Slots in use, live or not; all of them are live after compaction
+	std::vector<uint8_t> _aliveMask;
+	std::vector<uint32_t> _freeSlots; // Holes below the count
+
+public:
+	void Reset(size_t capacity, size_t count);
+
+	size_t GetCapacity() const { return _capacity; }
+	size_t GetCount() const { return _count; }
+	bool IsAlive(size_t slot) const { return _aliveMask[slot] != 0; }
+
+	void Free(size_t slot);
+
+	// Returns false when the pool is full
+	bool Allocate(size_t &slot);
+
+	// Move the live particles at the end into the holes; move(from, to) carries the attributes of a particle
+	template<typename TMove>
+	void Compact(TMove move)
+	{
+		std::sort(_freeSlots.begin(), _freeSlots.end());
+		for (uint32_t hole : _freeSlots)
+		{
+			TrimDeadTail();
+			if (hole >= _count) break;
+
+			move(_count - 1, static_cast<size_t>(hole));
+			_aliveMask[hole] = 1;
+			_aliveMask[_count - 1] = 0;
+			--_count;
+		}
+
+		_freeSlots.clear();
+		TrimDeadTail();
+	}
+
+private:
+	void TrimDeadTail() { while (_count > 0 && !_aliveMask[_count - 1]) --_count; }
+};
@@ -0,0 +1,384 @@
+#include "SDF.h"
+
+void SDF::AddPropObject(const std::shared_ptr<MeshObject> &propObject)
+{
+	_propObjects.push_back(propObject);
+}
+
+// Bake a signed distance field for each unique mesh of the collidable props.
+// Baked fields are cached on the disk by the hash of the mesh, so only the first run with a mesh pays for baking.
+bool SDF::Construct()
+{
+	_meshGrids.clear();
+	_grids.clear();
+	_samples.clear();
+
+	ConstructInstances();
+
+	return !_instances.empty();
+}
+
+// Follow the current transforms of the props.
+// Fields are in the model space, so they stay valid as props move.
+// The velocities of the props are measured from their transforms before and after elapsedSecond.
+// Returns true if the instances have been rebuilt because the set of collidable props has changed.
+bool SDF::Refit(float elapsedSecond)
+{
+	if (GetCollidableProps() != _instanceProps)
+	{
+		ConstructInstances();
+		return true;
+	}
+
+	for (size_t instanceIndex = 0; instanceIndex < _instances.size(); ++instanceIndex)
+	{
+		Instance previousInstance = _instances[instanceIndex];
+		_instances[instanceIndex] = GetInstance(*_propObjects[_instanceProps[instanceIndex]], previousInstance._grid);
+		_instances[instanceIndex]._velocityTransform = GetVelocityTransform(previousInstance._worldToModel, _instances[instanceIndex]._modelToWorld, elapsedSecond);
+	}
+
+	return false;
+}
+
+// A particle collides if its next position has a negative distance in any of the fields.
+// The contact point is the projection of the position onto the zero level set along the gradient.
+bool SDF::GetIntersection(glm::vec3 position, Intersection *intersection)
+{
+	bool isHit = false;
+	float minDistance = 0.0f;
+
+	for (const auto &instance : _instances)
+	{
+		glm::vec3 modelPosition = instance._worldToModel * glm::vec4(position, 1.0f);
+
+		glm::vec3 gradient{};
+		float distance = Sample(_grids[instance._grid], modelPosition, &gradient);
+		if (distance < minDistance && glm::length(gradient) > 0.0f)
+		{
+			glm::vec3 normal = glm::normalize(gradient);
+			glm::vec3 modelPoint = modelPosition - distance * normal;
+
+			intersection->_point = instance._modelToWorld * glm::vec4(modelPoint, 1.0f);
+			intersection->_normal = glm::normalize(glm::vec3(glm::vec4(normal, 0.0f) * instance._worldToModel));
+			intersection->_pointVelocity = instance._velocityTransform * glm::vec4(intersection->_point, 1.0f);
+
+			minDistance = distance;
+			isHit = true;
+		}
+	}
+
+	return isHit;
+}
+
+void SDF::ConstructInstances()
+{
+	_instances.clear();
+	_instanceProps.clear();
+
+	for (uint32_t propIndex : GetCollidableProps())
+	{
+		const auto &propObject = _propObjects[propIndex];
+		const auto &triangles = propObject->GetTriangles();
+
+		auto meshIter = _meshGrids.find(triangles.get());
+		if (meshIter == _meshGrids.end())
+		{
+			meshIter = _meshGrids.emplace(triangles.get(), ConstructMesh(*triangles)).first;
+		}
+
+		_instances.push_back(GetInstance(*propObject, meshIter->second));
+		_instanceProps.push_back(propIndex);
+	}
+}
+
+// Append the field of a mesh to the grids and return its index
+uint32_t SDF::ConstructMesh(const std::vector<Triangle> &triangles)
+{
+	auto cachePath = GetCachePath(Hash(triangles));
+
+	Grid grid{};
+	std::vector<float> samples;
+	if (!LoadCache(cachePath, &grid, samples))
+	{
+		grid = Bake(triangles, samples);
+		SaveCache(cachePath, grid, samples);
+	}
+
+	grid._offset = static_cast<uint32_t>(_samples.size());
+	_samples.insert(_samples.end(), samples.cbegin(), samples.cend());
+	_grids.push_back(grid);
+
+	return static_cast<uint32_t>(_grids.size() - 1);
+}
+
+// Compute exact distances only within BAND_CELLS cells from each triangle.
+// The sign comes from the interpolated vertex normal at the closest point, which also works for open meshes such as floors.
+auto SDF::Bake(const std::vector<Triangle> &triangles, std::vector<float> &samples) -> Grid
+{
+	glm::vec3 lowerBound = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 upperBound = glm::vec3(std::numeric_limits<float>::lowest());
+	for (const auto &triangle : triangles)
+	{
+		lowerBound = glm::min(lowerBound, glm::min(glm::min(glm::vec3(triangle.A), glm::vec3(triangle.B)), glm::vec3(triangle.C)));
+		upperBound = glm::max(upperBound, glm::max(glm::max(glm::vec3(triangle.A), glm::vec3(triangle.B)), glm::vec3(triangle.C)));
+	}
+
+	glm::vec3 stretch = upperBound - lowerBound;
+	float cellSize = std::max(std::max(stretch.x, stretch.y), stretch.z) / RESOLUTION;
+	if (cellSize <= 0.0f) cellSize = 1e-3f; // Degenerate mesh
+
+	float bandWidth = BAND_CELLS * cellSize;
+	lowerBound -= bandWidth;
+	upperBound += bandWidth;
+
+	glm::uvec3 dimension = glm::uvec3(glm::ceil((upperBound - lowerBound) / cellSize)) + 1u;
+	samples.assign(static_cast<size_t>(dimension.x) * dimension.y * dimension.z, bandWidth);
+
+	// Each thread owns a z slice so that no two threads write the same sample.
+	#pragma omp parallel for
+	for (int64_t z = 0; z < static_cast<int64_t>(dimension.z); ++z)
+	{
+		float sliceZ = lowerBound.z + z * cellSize;
+		for (const auto &triangle : triangles)
+		{
+			glm::vec3 triangleLowerBound = glm::min(glm::min(glm::vec3(triangle.A), glm::vec3(triangle.B)), glm::vec3(triangle.C)) - bandWidth;
+			glm::vec3 triangleUpperBound = glm::max(glm::max(glm::vec3(triangle.A), glm::vec3(triangle.B)), glm::vec3(triangle.C)) + bandWidth;
+			if (sliceZ < triangleLowerBound.z || sliceZ > triangleUpperBound.z) continue;
+
+			glm::uvec3 minCell = glm::uvec3(glm::max((triangleLowerBound - lowerBound) / cellSize, glm::vec3(0.0f)));
+			glm::uvec3 maxCell = glm::min(glm::uvec3(glm::ceil((triangleUpperBound - lowerBound) / cellSize)), dimension - 1u);
+
+			for (uint32_t y = minCell.y; y <= maxCell.y; ++y)
+			{
+				for (uint32_t x = minCell.x; x <= maxCell.x; ++x)
+				{
+					glm::vec3 point = lowerBound + glm::vec3(x, y, z) * cellSize;
+
+					glm::vec3 barycentric{};
+					glm::vec3 closestPoint = ClosestPoint(triangle, point, &barycentric);
+
+					float distance = glm::distance(point, closestPoint);
+					float &sample = samples[(z * dimension.y + y) * dimension.x + x];
+					if (distance >= std::abs(sample)) continue;
+
+					glm::vec3 normal = barycentric.x * glm::vec3(triangle.normalA) + barycentric.y * glm::vec3(triangle.normalB) + barycentric.z * glm::vec3(triangle.normalC);
+					sample = (glm::dot(point - closestPoint, normal) < 0.0f) ? -distance : distance;
+				}
+			}
+		}
+	}
+
+	Grid grid
+	{
+		._lowerBound = glm::vec4(lowerBound, 0.0f),
+		._dimension = glm::uvec4(dimension, 0),
+		._cellSize = cellSize
+	};
+
+	return grid;
+}
+
+auto SDF::GetInstance(const MeshObject &propObject, uint32_t grid) -> Instance
+{
+	const glm::mat4 &model = propObject.GetModelMatrix();
+
+	Instance instance
+	{
+		._worldToModel = glm::inverse(model),
+		._modelToWorld = model,
+		._grid = grid
+	};
+
+	return instance;
+}
+
+std::vector<uint32_t> SDF::GetCollidableProps()
+{
+	std::vector<uint32_t> collidableProps;
+	for (uint32_t propIndex = 0; propIndex < _propObjects.size(); ++propIndex)
+	{
+		const auto &propObject = _propObjects[propIndex];
+		if (propObject->IsCollidable() && !propObject->GetTriangles()->empty())
+		{
+			collidableProps.push_back(propIndex);
+		}
+	}
+
+	return collidableProps;
+}
+
+// Trilinear interpolation of the distance along with its analytic gradient
+// Points outside of the grid are regarded as being far from the surface.
+float SDF::Sample(const Grid &grid, glm::vec3 point, glm::vec3 *gradient)
+{
+	glm::uvec3 dimension = grid._dimension;
+	glm::vec3 coordinate = (point - glm::vec3(grid._lowerBound)) / grid._cellSize;
+	if (glm::any(glm::lessThan(coordinate, glm::vec3(0.0f))) || glm::any(glm::greaterThanEqual(coordinate, glm::vec3(dimension - 1u))))
+	{
+		*gradient = glm::vec3();
+		return BAND_CELLS * grid._cellSize;
+	}
+
+	glm::uvec3 cell = glm::uvec3(coordinate);
+	glm::vec3 t = coordinate - glm::vec3(cell);
+
+	auto at = [this, &grid, dimension](uint32_t x, uint32_t y, uint32_t z) { return _samples[grid._offset + (z * dimension.y + y) * dimension.x + x]; };
+	float c000 = at(cell.x, cell.y, cell.z);
+	float c100 = at(cell.x + 1, cell.y, cell.z);
+	float c010 = at(cell.x, cell.y + 1, cell.z);
+	float c110 = at(cell.x + 1, cell.y + 1, cell.z);
+	float c001 = at(cell.x, cell.y, cell.z + 1);
+	float c101 = at(cell.x + 1, cell.y, cell.z + 1);
+	float c011 = at(cell.x, cell.y + 1, cell.z + 1);
+	float c111 = at(cell.x + 1, cell.y + 1, cell.z + 1);
+
+	float c0 = glm::mix(glm::mix(c000, c100, t.x), glm::mix(c010, c110, t.x), t.y);
+	float c1 = glm::mix(glm::mix(c001, c101, t.x), glm::mix(c011, c111, t.x), t.y);
+
+	gradient->x = glm::mix(glm::mix(c100 - c000, c110 - c010, t.y), glm::mix(c101 - c001, c111 - c011, t.y), t.z);
+	gradient->y = glm::mix(glm::mix(c010 - c000, c110 - c100, t.x), glm::mix(c011 - c001, c111 - c101, t.x), t.z);
+	gradient->z = c1 - c0;
+	*gradient /= grid._cellSize;
+
+	return glm::mix(c0, c1, t.z);
+}
+
+// Closest point on a triangle from Real-Time Collision Detection by Christer Ericson
+glm::vec3 SDF::ClosestPoint(const Triangle &triangle, glm::vec3 point, glm::vec3 *barycentric)
+{
+	glm::vec3 a = triangle.A;
+	glm::vec3 b = triangle.B;
+	glm::vec3 c = triangle.C;
+
+	glm::vec3 ab = b - a;
+	glm::vec3 ac = c - a;
+
+	// Vertex region of A
+	glm::vec3 ap = point - a;
+	float d1 = glm::dot(ab, ap);
+	float d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f)
+	{
+		*barycentric = glm::vec3(1.0f, 0.0f, 0.0f);
+		return a;
+	}
+
+	// Vertex region of B
+	glm::vec3 bp = point - b;
+	float d3 = glm::dot(ab, bp);
+	float d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3)
+	{
+		*barycentric = glm::vec3(0.0f, 1.0f, 0.0f);
+		return b;
+	}
+
+	// Edge region of AB
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+	{
+		float v = d1 / (d1 - d3);
+		*barycentric = glm::vec3(1.0f - v, v, 0.0f);
+		return a + v * ab;
+	}
+
+	// Vertex region of C
+	glm::vec3 cp = point - c;
+	float d5 = glm::dot(ab, cp);
+	float d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6)
+	{
+		*barycentric = glm::vec3(0.0f, 0.0f, 1.0f);
+		return c;
+	}
+
+	// Edge region of AC
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+	{
+		float w = d2 / (d2 - d6);
+		*barycentric = glm::vec3(1.0f - w, 0.0f, w);
+		return a + w * ac;
+	}
+
+	// Edge region of BC
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+	{
+		float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		*barycentric = glm::vec3(0.0f, 1.0f - w, w);
+		return b + w * (c - b);
+	}
+
+	// Face region
+	float denominator = 1.0f / (va + vb + vc);
+	float v = vb * denominator;
+	float w = vc * denominator;
+	*barycentric = glm::vec3(1.0f - v - w, v, w);
+	return a + ab * v + ac * w;
+}
+
+// FNV-1a over the triangles and the baking settings
+uint64_t SDF::Hash(const std::vector<Triangle> &triangles)
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto accumulate = [&hash](const void *data, size_t size)
+	{
+		const auto *bytes = static_cast<const uint8_t *>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	};
+
+	uint32_t settings[] = { CACHE_VERSION, RESOLUTION, BAND_CELLS };
+	accumulate(settings, sizeof(settings));
+	accumulate(triangles.data(), sizeof(Triangle) * triangles.size());
+
+	return hash;
+}
+
+std::filesystem::path SDF::GetCachePath(uint64_t hash)
+{
+	return std::filesystem::path(CACHE_DIR) / "SDF" / std::format("{:016x}.sdf", hash);
+}
+
+bool SDF::LoadCache(const std::filesystem::path &cachePath, Grid *grid, std::vector<float> &samples)
+{
+	std::ifstream file(cachePath, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	uint32_t version = 0;
+	uint64_t sampleCount = 0;
+	file.read(reinterpret_cast<char *>(&version), sizeof(version));
+	file.read(reinterpret_cast<char *>(grid), sizeof(Grid));
+	file.read(reinterpret_cast<char *>(&sampleCount), sizeof(sampleCount));
+	if (!file || version != CACHE_VERSION || sampleCount != static_cast<uint64_t>(grid->_dimension.x) * grid->_dimension.y * grid->_dimension.z) return false;
+
+	samples.resize(sampleCount);
+	file.read(reinterpret_cast<char *>(samples.data()), sizeof(float) * sampleCount);
+
+	return static_cast<bool>(file);
+}
+
+// Failing to write the cache is not fatal; the field is just baked again next time.
+void SDF::SaveCache(const std::filesystem::path &cachePath, const Grid &grid, const std::vector<float> &samples)
+{
+	std::error_code errorCode;
+	std::filesystem::create_directories(cachePath.parent_path(), errorCode);
+
+	std::ofstream file(cachePath, std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cout << std::format("Failed to write the SDF cache: {}", cachePath.string()) << std::endl;
+		return;
+	}
+
+	uint32_t version = CACHE_VERSION;
+	uint64_t sampleCount = samples.size();
+	file.write(reinterpret_cast<const char *>(&version), sizeof(version));
+	file.write(reinterpret_cast<const char *>(&grid), sizeof(Grid));
+	file.write(reinterpret_cast<const char *>(&sampleCount), sizeof(sampleCount));
+	file.write(reinterpret_cast<const char *>(samples.data()), sizeof(float) * sampleCount);
+}
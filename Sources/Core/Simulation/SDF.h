@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <filesystem>
+#include <fstream>
+#include <format>
+#include <iostream>
+
+#define GLM_FORCE_SWIZZLE
+#define GLM_FORCE_RADIANS // Force glm to use radian as arguments
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE // Force glm to project z into the range [0.0, 1.0]
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "MeshObject.h"
+#include "Triangle.h"
+#include "BVH.h"
+
+// Which structure particles are tested against for collisions with props
+enum class ColliderMode
+{
+	BVH, // Ray-cast the step of each particle through the BVH
+	SDF // Look up the signed distance at the next position of each particle
+};
+
+// Narrow-band signed distance fields of collidable props.
+// Like the bottom level of the BVH, each unique mesh is baked once in its model space and shared by all props that use it.
+class SDF
+{
+public:
+	// Sampling grid of a mesh
+	struct Grid
+	{
+		alignas(16) glm::vec4 _lowerBound{}; // Position of the first sample in the model space
+		alignas(16) glm::uvec4 _dimension{}; // Number of samples along each axis
+		alignas(4) float _cellSize = 0.0f;
+		alignas(4) uint32_t _offset = 0; // Index of the first sample in the samples
+	};
+
+	struct Instance
+	{
+		alignas(16) glm::mat4 _worldToModel = glm::mat4(1.0f);
+		alignas(16) glm::mat4 _modelToWorld = glm::mat4(1.0f);
+		alignas(16) glm::mat4 _velocityTransform = glm::mat4(0.0f); // World-space point -> its velocity over the last refit
+		alignas(4) uint32_t _grid = 0;
+	};
+
+private:
+	std::vector<std::shared_ptr<MeshObject>> _propObjects;
+
+	std::unordered_map<const std::vector<Triangle> *, uint32_t> _meshGrids; // Model-space triangles -> grid index
+	std::vector<Grid> _grids;
+	std::vector<float> _samples; // Signed distances of all grids, x-major
+
+	std::vector<Instance> _instances;
+	std::vector<uint32_t> _instanceProps; // Instance index -> prop index
+
+	static const uint32_t RESOLUTION = 128; // Number of cells along the longest axis of a mesh
+	static const uint32_t BAND_CELLS = 4; // Half width of the narrow band in cells; distances beyond it are clamped
+	static const uint32_t CACHE_VERSION = 1;
+
+public:
+	void AddPropObject(const std::shared_ptr<MeshObject> &propObject);
+	bool Construct();
+	bool Refit(float elapsedSecond);
+	bool GetIntersection(glm::vec3 position, Intersection *intersection);
+
+	const auto &GetGrids() const { return _grids; }
+	const auto &GetSamples() const { return _samples; }
+	const auto &GetInstances() const { return _instances; }
+
+private:
+	void ConstructInstances();
+	uint32_t ConstructMesh(const std::vector<Triangle> &triangles);
+	Grid Bake(const std::vector<Triangle> &triangles, std::vector<float> &samples);
+	Instance GetInstance(const MeshObject &propObject, uint32_t grid);
+	std::vector<uint32_t> GetCollidableProps();
+
+	float Sample(const Grid &grid, glm::vec3 point, glm::vec3 *gradient);
+	glm::vec3 ClosestPoint(const Triangle &triangle, glm::vec3 point, glm::vec3 *barycentric);
+
+	// Functions for the disk cache
+	uint64_t Hash(const std::vector<Triangle> &triangles);
+	std::filesystem::path GetCachePath(uint64_t hash);
+	bool LoadCache(const std::filesystem::path &cachePath, Grid *grid, std::vector<float> &samples);
+	void SaveCache(const std::filesystem::path &cachePath, const Grid &grid, const std::vector<float> &samples);
+};
@@ -13,8 +13,149 @@ void SimulatedSceneBase::AddProp(const std::string &OBJPath, const std::string &
 	propObject->SetVisible(isVisible);
 	propObject->SetCollidable(isCollidable);
 
+	propObject->OnTransformChanged().AddListener
+	(
+		weak_from_this(),
+		[this](const MeshObject &meshObject)
+		{
+			if (meshObject.IsCollidable()) _isLevelDirty = true;
+		}
+	);
+
 	_propModels.emplace_back(std::move(propModel));
 	_bvh->AddPropObject(propObject);
+	_sdf->AddPropObject(propObject);
+}
+
+void SimulatedSceneBase::AddEmitter(const Emitter &emitter)
+{
+	_particleFlow.AddEmitter(emitter);
+	_onUpdateParticleFlow.Invoke(_particleFlow);
+}
+
+void SimulatedSceneBase::AddSink(const Sink &sink)
+{
+	_particleFlow.AddSink(sink);
+	_onUpdateParticleFlow.Invoke(_particleFlow);
+}
+
+void SimulatedSceneBase::ClearParticleFlow()
+{
+	_particleFlow.Clear();
+	_onUpdateParticleFlow.Invoke(_particleFlow);
+}
+
+void SimulatedSceneBase::SetParticleFlow(const ParticleFlow &particleFlow)
+{
+	_particleFlow = particleFlow;
+	_onUpdateParticleFlow.Invoke(_particleFlow);
+}
+
+void SimulatedSceneBase::InitializeLevel()
+{
+	_bvh->Construct();
+	_sdf->Construct();
+	_occupancyGrid->Construct(*_bvh, *_simulationParameters);
+	_isLevelDirty = false;
+	_isLevelMoving = false;
+	_isOccupancyDirty = false;
+}
+
+// Reports whether the colliders have been refitted or rebuilt
+// Props that have stopped are refitted once more, which measures them at rest.
+LevelUpdate SimulatedSceneBase::UpdateLevel(float elapsedSecond)
+{
+	if (!_isLevelDirty && !_isLevelMoving && !_isOccupancyDirty) return LevelUpdate::None;
+
+	bool isRebuilt = false;
+	if (_isLevelDirty || _isLevelMoving)
+	{
+		isRebuilt |= _bvh->Refit(elapsedSecond);
+		isRebuilt |= _sdf->Refit(elapsedSecond);
+	}
+	_occupancyGrid->Construct(*_bvh, *_simulationParameters);
+
+	_isLevelMoving = _isLevelDirty;
+	_isLevelDirty = false;
+	_isOccupancyDirty = false;
+	return isRebuilt ? LevelUpdate::Rebuilt : LevelUpdate::Refitted;
+}
+
+// The domain is the union of the level and the initial block of particles, padded by a cell on each side.
+// Buckets more than the cells of the domain only waste the scan over buckets, while fewer buckets make distant cells share buckets.
+void SimulatedSceneBase::UpdateGridDimension(glm::vec3 particleLowerBound, glm::vec3 particleUpperBound)
+{
+	auto [lowerBound, upperBound] = GetDomainBounds(particleLowerBound, particleUpperBound);
+
+	float gridSpacing = 2.0f * _simulationParameters->_particleRadius * _simulationParameters->_kernelRadiusFactor;
+	glm::vec3 cellCounts = glm::ceil((upperBound - lowerBound) / gridSpacing) + 2.0f;
+
+	// Shrink uniformly if the domain has too many cells
+	float bucketCount = cellCounts.x * cellCounts.y * cellCounts.z;
+	if (bucketCount > MAX_BUCKET_COUNT)
+	{
+		cellCounts = glm::floor(cellCounts * std::cbrt(MAX_BUCKET_COUNT / bucketCount));
+	}
+
+	glm::uvec3 gridDimension = glm::max(glm::uvec3(cellCounts), glm::uvec3(MIN_GRID_DIMENSION));
+	if (gridDimension != _gridDimension)
+	{
+		_gridDimension = gridDimension;
+		_occupancyGrid = std::make_unique<OccupancyGrid>(_gridDimension);
+	}
+
+	_occupancyGrid->Construct(*_bvh, *_simulationParameters);
+	_isOccupancyDirty = false;
+}
+
+std::pair<glm::vec3, glm::vec3> SimulatedSceneBase::GetDomainBounds(glm::vec3 particleLowerBound, glm::vec3 particleUpperBound) const
+{
+	glm::vec3 lowerBound = particleLowerBound;
+	glm::vec3 upperBound = particleUpperBound;
+
+	const auto &nodes = _bvh->GetNodes();
+	if (!nodes.empty())
+	{
+		lowerBound = glm::min(lowerBound, glm::vec3(nodes[0]._boundingBox._lowerBound));
+		upperBound = glm::max(upperBound, glm::vec3(nodes[0]._boundingBox._upperBound));
+	}
+
+	return { lowerBound, upperBound };
+}
+
+void SimulatedSceneBase::ResolveContact(const SimulationParameters &simulationParameters, const Intersection &intersection, glm::vec3 &nextPosition, glm::vec3 &nextVelocity)
+{
+	// Target point is the closest non-penetrating position from the current position.
+	glm::vec3 targetNormal = intersection._normal;
+	glm::vec3 targetPoint = intersection._point + simulationParameters._particleRadius * targetNormal * 0.5f;
+	glm::vec3 collisionPointVelocity = intersection._pointVelocity;
+
+	// Get new candidate relative velocities from the target point
+	glm::vec3 relativeVelocity = nextVelocity - collisionPointVelocity;
+	float normalDotRelativeVelocity = glm::dot(targetNormal, relativeVelocity);
+	glm::vec3 relativeVelocityN = normalDotRelativeVelocity * targetNormal;
+	glm::vec3 relativeVelocityT = relativeVelocity - relativeVelocityN;
+
+	// Check if the velocity is facing ooposite direction of the surface normal
+	if (normalDotRelativeVelocity < 0.0f)
+	{
+		// Apply restitution coefficient to the surface normal component of the velocity
+		glm::vec3 deltaRelativeVelocityN = (-simulationParameters._restitutionCoefficient - 1.0f) * relativeVelocityN;
+		relativeVelocityN *= -simulationParameters._restitutionCoefficient;
+
+		// Apply friction to the tangential component of the velocity
+		if (relativeVelocityT.length() > 0.0f)
+		{
+			float frictionScale = std::max(1.0f - simulationParameters._frictionCoefficient * deltaRelativeVelocityN.length() / relativeVelocityT.length(), 0.0f);
+			relativeVelocityT *= frictionScale;
+		}
+
+		// Apply the velocity
+		nextVelocity = relativeVelocityN + relativeVelocityT + collisionPointVelocity;
+	}
+
+	// Apply the position
+	nextPosition = targetPoint;
 }
 
 void SimulatedSceneBase::SetParticleRenderingMode(ParticleRenderingMode particleRenderingMode)
@@ -23,10 +164,46 @@ void SimulatedSceneBase::SetParticleRenderingMode(ParticleRenderingMode particle
 	_onSetParticleRenderingMode.Invoke(particleRenderingMode);
 }
 
-void SimulatedSceneBase::InitializeRenderers(const std::vector<Buffer> &inputBuffers, size_t particleCount)
+void SimulatedSceneBase::SetColliderMode(ColliderMode colliderMode)
 {
+	_colliderMode = colliderMode;
+	_onSetColliderMode.Invoke(colliderMode);
+}
+
+void SimulatedSceneBase::SetSubstepCount(uint32_t substepCount)
+{
+	_substepCount = std::max(substepCount, 1u);
+	_onSetSubstepCount.Invoke(_substepCount);
+}
+
+void SimulatedSceneBase::SetSimulateOnly(bool isSimulateOnly)
+{
+	if (_isSimulateOnly == isSimulateOnly) return;
+
+	_isSimulateOnly = isSimulateOnly;
+	VulkanCore::Get()->SetPresentationEnabled(!_isSimulateOnly);
+
+	// Renderers exist only after particles have been initialized
+	if (_marchingCubes != nullptr && _billboards != nullptr) ApplyRenderMode(_particleRenderingMode);
+}
+
+void SimulatedSceneBase::InitializeRenderers(const std::vector<Buffer> &inputBuffers, size_t particleCount, const std::vector<Buffer> &particleDispatchBuffers)
+{
+	// Every particle of the input buffers is drawn until the engine sets the count
+	_renderedParticleCapacity = particleCount;
+	_renderedParticleCount = particleCount;
+	_particleDispatchBuffers = particleDispatchBuffers;
+	if (_particleDispatchBuffers.empty())
+	{
+		// Host-visible, so that the count of a frame is a plain write into its own buffer rather than a transfer
+		_particleDispatchBuffers = CreateBuffers(sizeof(ParticleDispatch), VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		ParticleDispatch particleDispatch = ParticleDispatch::Create(static_cast<uint32_t>(particleCount));
+		for (const auto &buffer : _particleDispatchBuffers) buffer->CopyFrom(&particleDispatch);
+	}
+
 	// Initialize renderers
-	_billboards = std::make_unique<Billboards>(inputBuffers, particleCount);
+	_billboards = std::make_unique<Billboards>(inputBuffers, particleCount, _particleDispatchBuffers);
 	_billboards->UpdateRadius(_simulationParameters->_particleRadius);
 
 	MarchingCubesGrid marchingCubesGrid // Temp
@@ -37,7 +214,7 @@ void SimulatedSceneBase::InitializeRenderers(const std::vector<Buffer> &inputBuf
 		._voxelInterval = 0.05f
 	};
 
-	_marchingCubes = std::make_unique<MarchingCubes>(inputBuffers, particleCount, marchingCubesGrid);
+	_marchingCubes = std::make_unique<MarchingCubes>(inputBuffers, _particleDispatchBuffers, marchingCubesGrid);
 	_marchingCubes->GetCompute()->UpdateParticleProperty(*_simulationParameters);
 	_marchingCubes->SetEnable(false);
 	
@@ -68,9 +245,19 @@ void SimulatedSceneBase::InitializeRenderers(const std::vector<Buffer> &inputBuf
 	);
 }
 
+// Only the buffer of the current frame is written, since the buffers of the other frames may still be read by their passes in flight.
+// Each frame writes its own buffer again before it records its passes, so every buffer catches up with the count within a round of frames.
+void SimulatedSceneBase::SetRenderedParticleCount(size_t particleCount)
+{
+	_renderedParticleCount = std::min(particleCount, _renderedParticleCapacity);
+	ParticleDispatch particleDispatch = ParticleDispatch::Create(static_cast<uint32_t>(_renderedParticleCount));
+	_particleDispatchBuffers[VulkanCore::Get()->GetCurrentFrame()]->CopyFrom(&particleDispatch);
+}
+
 void SimulatedSceneBase::UpdateSimulationParameters(const SimulationParameters &simulationParameters)
 {
 	*_simulationParameters = simulationParameters;
+	_isOccupancyDirty = true; // The spacing and the reach of a step may have changed
 	_onUpdateSimulationParameters.Invoke(*_simulationParameters);
 }
 
@@ -78,6 +265,6 @@ void SimulatedSceneBase::ApplyRenderMode(ParticleRenderingMode particleRendering
 {
 	bool isMarchingCubes = (particleRenderingMode == ParticleRenderingMode::MarchingCubes);
 
-	_marchingCubes->SetEnable(isMarchingCubes);
-	_billboards->SetEnable(!isMarchingCubes);
+	_marchingCubes->SetEnable(!_isSimulateOnly && isMarchingCubes);
+	_billboards->SetEnable(!_isSimulateOnly && !isMarchingCubes);
 }
\ No newline at end of file
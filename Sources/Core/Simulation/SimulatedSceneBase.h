@@ -1,10 +1,15 @@
 #pragma once
 
 #include <omp.h>
+#include <optional>
 
 #include "VulkanCore.h"
 #include "BVH.h"
+#include "SDF.h"
+#include "OccupancyGrid.h"
+#include "HashGrid.h"
 #include "SimulationParameters.h"
+#include "ParticleFlow.h"
 #include "Delegate.h"
 
 #include "MeshModel.h"
@@ -24,11 +29,49 @@ enum class ParticleRenderingMode
 	MarchingCubes
 };
 
+enum class LevelUpdate
+{
+	None,
+	Refitted, // The trees keep their topology, so only the transforms and bounds have changed
+	Rebuilt // The trees have been constructed anew, even if they have as many nodes as before
+};
+
+// Measures of a step for comparing engines on the same scene
+struct SolverStatistics
+{
+	size_t _particleCount = 0;
+	float _averageStepTime = 0.0f; // Milliseconds of wall time per step; zero if the engine does not time its steps
+	uint32_t _divergenceIterations = 0; // Iterations of the last pressure solve, for the iterative solvers
+	uint32_t _densityIterations = 0;
+	uint32_t _viscosityIterations = 0; // Iterations of the last implicit viscosity solve
+	size_t _sleepingParticleCount = 0;
+	size_t _mergedParticleCount = 0; // Particles that stand for more than one particle of the base mass
+};
+
+// Interface of the simulation engines, which are created by name through SimulatedSceneRegistry.
+// An engine is initialized by InitializeLevel and InitializeParticles, and then steps itself on the frame events of VulkanCore.
 class SimulatedSceneBase : public DelegateRegistrable
 {
 protected:
-	glm::uvec3 _gridDimension = glm::uvec3(64, 64, 64);
+	glm::uvec3 _gridDimension = glm::uvec3(64, 64, 64); // Fitted to the domain by UpdateGridDimension when particles are initialized
 	std::unique_ptr<BVH> _bvh = std::make_unique<BVH>();
+	std::unique_ptr<SDF> _sdf = std::make_unique<SDF>();
+	std::unique_ptr<OccupancyGrid> _occupancyGrid = std::make_unique<OccupancyGrid>(_gridDimension);
+	bool _isLevelDirty = false; // Whether any collidable prop has moved since the BVH was last updated
+	bool _isLevelMoving = false; // Whether the props moved before the last update, so that the next one brings their velocities back to zero
+	bool _isOccupancyDirty = false; // Whether the parameters that shape the occupancy grid have changed
+
+	// Collision
+	ColliderMode _colliderMode = ColliderMode::BVH;
+	Delegate<void(ColliderMode)> _onSetColliderMode;
+
+	static const uint32_t MIN_GRID_DIMENSION = 4;
+	static const uint32_t MAX_BUCKET_COUNT = 1 << 22;
+
+	// Stepping
+	uint32_t _substepCount = 1; // Time steps taken per frame
+	Delegate<void(uint32_t)> _onSetSubstepCount;
+	bool _isSimulateOnly = false; // Skip rendering and presentation entirely to maximize the simulation throughput
 
 	// Physical parameters
 	std::shared_ptr<SimulationParameters> _simulationParameters = std::make_shared<SimulationParameters>();
@@ -41,20 +84,67 @@ protected:
 	std::unique_ptr<Billboards> _billboards = nullptr;
 	std::unique_ptr<MarchingCubes> _marchingCubes = nullptr;
 
+	// Count of the rendered particles and the dispatch of the renderer passes over them, for each frame in flight.
+	// Written by SetRenderedParticleCount unless the engine counts its particles on the device and hands its own buffers to the renderers.
+	std::vector<Buffer> _particleDispatchBuffers;
+	size_t _renderedParticleCapacity = 0;
+	size_t _renderedParticleCount = 0;
+
 	// Prop
 	std::vector<std::shared_ptr<MeshModel>> _propModels;
 
+	// Flow
+	// Scenes with emitters reserve room for the particles to come when their particles are initialized.
+	ParticleFlow _particleFlow;
+	Delegate<void(const ParticleFlow &)> _onUpdateParticleFlow;
+	static const size_t EMITTED_PARTICLE_HEADROOM = 1 << 16;
+
 public:
 	Billboards *GetBillboards() { return _billboards.get(); }
 	MarchingCubes *GetMarchingCubes() { return _marchingCubes.get(); }
 
-	virtual void InitializeLevel() { _bvh->Construct(); }
+	virtual const std::string &GetEngineName() const = 0;
+	virtual void InitializeLevel();
 	virtual void InitializeParticles(float particleDistance, glm::vec2 xRange, glm::vec2 yRange, glm::vec2 zRange) = 0;
+	virtual size_t GetParticleCount() const = 0;
+	virtual SolverStatistics GetSolverStatistics() const = 0;
 	void SetParticleRenderingMode(ParticleRenderingMode particleRenderingMode);
+	void SetColliderMode(ColliderMode colliderMode);
+	void SetSubstepCount(uint32_t substepCount);
+	void SetSimulateOnly(bool isSimulateOnly);
+	uint32_t GetSubstepCount() const { return _substepCount; }
+	bool IsSimulateOnly() const { return _isSimulateOnly; }
+	ColliderMode GetColliderMode() const { return _colliderMode; }
+	ParticleRenderingMode GetParticleRenderingMode() const { return _particleRenderingMode; }
 	void UpdateSimulationParameters(const SimulationParameters &simulationParameters);
+	const SimulationParameters &GetSimulationParameters() const { return *_simulationParameters; }
 	virtual void AddProp(const std::string &OBJPath, const std::string &texturePath = "", bool isVisible = true, bool isCollidable = true, RenderMode renderMode = RenderMode::Triangle);
 
+	// Emitters added after the particles are initialized only refill the room that the sinks have made
+	void AddEmitter(const Emitter &emitter);
+	void AddSink(const Sink &sink);
+	void ClearParticleFlow();
+	void SetParticleFlow(const ParticleFlow &particleFlow);
+	const ParticleFlow &GetParticleFlow() const { return _particleFlow; }
+	size_t GetParticleCapacity(size_t particleCount) const { return _particleFlow.HasEmitters() ? particleCount + EMITTED_PARTICLE_HEADROOM : particleCount; }
+
+	// Refit the colliders to props that have moved over elapsedSecond
+	LevelUpdate UpdateLevel(float elapsedSecond);
+
+	// Fit the grid to the region particles can reach
+	void UpdateGridDimension(glm::vec3 particleLowerBound, glm::vec3 particleUpperBound);
+
+	// Union of the level and the initial block of particles
+	std::pair<glm::vec3, glm::vec3> GetDomainBounds(glm::vec3 particleLowerBound, glm::vec3 particleUpperBound) const;
+
+	// Move a particle that has penetrated a collider back onto its surface and reflect its velocity off the surface
+	static void ResolveContact(const SimulationParameters &simulationParameters, const Intersection &intersection, glm::vec3 &nextPosition, glm::vec3 &nextVelocity);
+
+	// Statistics of the neighbor search, if the scene keeps them on the host
+	virtual std::optional<HashGrid::Statistics> GetGridStatistics() const { return std::nullopt; } // A copy, since the solver may be updating the grid
+
 	// Reflect the particle status to the render system
-	virtual void InitializeRenderers(const std::vector<Buffer> &inputBuffers, size_t particleCount);
+	virtual void InitializeRenderers(const std::vector<Buffer> &inputBuffers, size_t particleCount, const std::vector<Buffer> &particleDispatchBuffers = {});
+	void SetRenderedParticleCount(size_t particleCount); // For engines whose particles come and go on the host; at most the count the renderers were initialized with. Call every frame before the renderers record
 	virtual void ApplyRenderMode(ParticleRenderingMode particleRenderingMode);
 };
\ No newline at end of file
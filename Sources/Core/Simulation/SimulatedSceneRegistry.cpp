@@ -0,0 +1,46 @@
+#include "SimulatedSceneRegistry.h"
+
+#include "CPUSimulatedScene.h"
+#include "GPUSimulatedScene.h"
+#include "FLIPSimulatedScene.h"
+
+const std::string SimulatedSceneRegistry::DEFAULT_ENGINE = "gpu";
+
+void SimulatedSceneRegistry::Register(const std::string &engineName, Factory factory)
+{
+	GetFactories()[engineName] = std::move(factory);
+}
+
+std::shared_ptr<SimulatedSceneBase> SimulatedSceneRegistry::Create(const std::string &engineName)
+{
+	auto &factories = GetFactories();
+	auto it = factories.find(engineName);
+	if (it == factories.end()) throw std::runtime_error(std::format("Unknown simulation engine {}.", engineName));
+
+	return it->second();
+}
+
+bool SimulatedSceneRegistry::Contains(const std::string &engineName)
+{
+	return GetFactories().contains(engineName);
+}
+
+std::vector<std::string> SimulatedSceneRegistry::GetEngineNames()
+{
+	std::vector<std::string> engineNames;
+	for (const auto &[engineName, factory] : GetFactories()) engineNames.push_back(engineName);
+
+	return engineNames;
+}
+
+std::map<std::string, SimulatedSceneRegistry::Factory> &SimulatedSceneRegistry::GetFactories()
+{
+	static std::map<std::string, Factory> factories
+	{
+		{ CPUSimulatedScene::ENGINE_NAME, []() { return CPUSimulatedScene::Instantiate<CPUSimulatedScene>(); } },
+		{ GPUSimulatedScene::ENGINE_NAME, []() { return GPUSimulatedScene::Instantiate<GPUSimulatedScene>(); } },
+		{ FLIPSimulatedScene::ENGINE_NAME, []() { return FLIPSimulatedScene::Instantiate<FLIPSimulatedScene>(); } }
+	};
+
+	return factories;
+}
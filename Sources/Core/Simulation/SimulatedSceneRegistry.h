@@ -0,0 +1,29 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+#include <format>
+
+#include "SimulatedSceneBase.h"
+
+// Simulation engines by name, so that the application can pick one on the command line or switch at runtime.
+// The engines of this project are registered on first use; others can be added with Register before the scene is created.
+class SimulatedSceneRegistry
+{
+public:
+	using Factory = std::function<std::shared_ptr<SimulatedSceneBase>()>;
+
+	static const std::string DEFAULT_ENGINE;
+
+	static void Register(const std::string &engineName, Factory factory);
+	static std::shared_ptr<SimulatedSceneBase> Create(const std::string &engineName);
+	static bool Contains(const std::string &engineName);
+	static std::vector<std::string> GetEngineNames();
+
+private:
+	static std::map<std::string, Factory> &GetFactories();
+};
@@ -2,15 +2,11 @@
 
 SimulationCompute::SimulationCompute(glm::uvec3 gridDimension)
 {	
+	_isAsync = true; // The renderers read the snapshots, so the solver of the next frame can run alongside them
+
 	// Prepare setups
 	CreateSetupBuffers(); // Create setup buffers in the constructor since their size does not count on the number of particles.
 	CreateGridBuffers(gridDimension);
-
-	_gridSetup->_dimension = glm::uvec4(gridDimension, 0);
-	_gridSetupBuffer->CopyFrom(_gridSetup.get());
-
-	uint32_t bucketCount = _gridSetup->_dimension.x * _gridSetup->_dimension.y * _gridSetup->_dimension.z;
-	_prefixSumIterCount = Log(bucketCount); // log(2, n) - 1
 }
 
 void SimulationCompute::Register()
@@ -29,34 +25,228 @@ SimulationCompute::~SimulationCompute()
 
 void SimulationCompute::UpdateSimulationParameters(const SimulationParameters &simulationParameters)
 {
-	_simulationParametersBuffer->CopyFrom(&simulationParameters);
+	_simulationParameters = simulationParameters;
+
+	// The shaders interpolate the kernel of the compile-time family from this table
+	Kernel kernel(simulationParameters._particleRadius * simulationParameters._kernelRadiusFactor, true);
+	_kernelTable = kernel.GetTable();
+
+	// Steps may be in flight on the async compute queue, so the upload is deferred to the next compute command.
+	// The staging buffers of its frame are written only when it is recorded, after the last use of the slot has finished.
+	_isParameterUploadPending = true;
 }
 
-void SimulationCompute::InitializeLevel(const std::vector<BVH::Node> &BVHNodes)
+// Resize the grid buffers if the dimension has changed and upload the occupancy grid of the dimension
+void SimulationCompute::InitializeGrid(glm::uvec3 gridDimension, const OccupancyGrid &occupancyGrid)
 {
-	auto maxLevelIter = std::max_element(BVHNodes.cbegin(), BVHNodes.cend(), [](const BVH::Node &node1, const BVH::Node &node2) { return node1._level < node2._level; });
-	_BVHMaxLevel = maxLevelIter->_level;
+	if (gridDimension != glm::uvec3(_gridSetup->_dimension))
+	{
+		CreateGridBuffers(gridDimension);
+	}
+
+	Upload(_occupancyBuffer, occupancyGrid.GetCells().data());
+	_isOccupancyUploadPending = false;
+}
+
+void SimulationCompute::InitializeLevel(const BVH &bvh, const SDF &sdf, const OccupancyGrid &occupancyGrid)
+{
+	_BVHMaxLevel = bvh.GetMaxLevel();
+	_SDFInstanceCount = static_cast<uint32_t>(sdf.GetInstances().size());
+
+	CreateLevelBuffers(bvh, sdf);
+	Upload(_occupancyBuffer, occupancyGrid.GetCells().data());
+	_isOccupancyUploadPending = false;
+}
+
+void SimulationCompute::UpdateLevel(const BVH &bvh, const SDF &sdf, const OccupancyGrid &occupancyGrid, bool isRebuilt)
+{
+	if (_BVHNodeBuffer == nullptr) return;
+
+	const auto &nodes = bvh.GetNodes();
+	const auto &instances = bvh.GetInstances();
+	const auto &meshNodes = bvh.GetMeshNodes();
+
+	bool isResized = (sizeof(BVH::Node) * nodes.size() != _BVHNodeBuffer->Size()) || (sizeof(BVH::Instance) * instances.size() != _BVHInstanceBuffer->Size()) || (sizeof(BVH::Node) * meshNodes.size() != _BVHMeshNodeBuffer->Size());
+	isResized |= (sizeof(SDF::Instance) * sdf.GetInstances().size() != _SDFInstanceBuffer->Size()) || (sizeof(float) * sdf.GetSamples().size() != _SDFSampleBuffer->Size());
+	if (isRebuilt || isResized || bvh.GetMaxLevel() > _BVHMaxLevel)
+	{
+		// The colliders have been rebuilt, so the bottom-level trees and the fields may differ even where the sizes match.
+		// Every level buffer is uploaded again and rebound, which must not overlap the frames in flight that read them.
+		VulkanCore::Get()->WaitIdle();
+
+		InitializeLevel(bvh, sdf, occupancyGrid);
+		if (_particleCapacity > 0)
+		{
+			CreateBVHStackBuffer(_particleCapacity, _BVHMaxLevel);
+			CreateResolveCollisionPipeline();
+		}
+	}
+	else
+	{
+		// Only the top level follows the props; bottom-level trees are in the model space.
+		// Defer the copy to the compute command so that it is ordered before the collision pass of this frame.
+		size_t currentFrame = VulkanCore::Get()->GetCurrentFrame();
+		_BVHNodeStagingBuffers[currentFrame]->CopyFrom(nodes.data());
+		_BVHInstanceStagingBuffers[currentFrame]->CopyFrom(instances.data());
+		_SDFInstanceStagingBuffers[currentFrame]->CopyFrom(sdf.GetInstances().data());
+		_occupancyStagingBuffers[currentFrame]->CopyFrom(occupancyGrid.GetCells().data());
+		_isBVHNodeUploadPending = true;
+		_isOccupancyUploadPending = true;
+	}
+}
+
+void SimulationCompute::SetColliderMode(ColliderMode colliderMode)
+{
+	_colliderMode = colliderMode;
+}
 
-	CreateLevelBuffers(BVHNodes);
+void SimulationCompute::SetSubstepCount(uint32_t substepCount)
+{
+	_substepCount = std::max(substepCount, 1u);
 }
 
-void SimulationCompute::InitializeParticles(const std::vector<glm::vec3> &positions)
+// Buffers are sized to the capacity, and the particles past the count are free slots for the emitters
+void SimulationCompute::InitializeParticles(const std::vector<glm::vec3> &positions, size_t particleCapacity)
 {
 	// Populate setups
 	_simulationSetup->_particleCount = static_cast<uint32_t>(positions.size());
+	_particleCapacity = static_cast<uint32_t>(std::max(particleCapacity, positions.size()));
+	_particleCount = _simulationSetup->_particleCount;
+	_flowSetup->_particleCapacity = _particleCapacity;
 
 	// Create resources
-	CreateSimulationBuffers(_simulationSetup->_particleCount, _BVHMaxLevel);
-	CreatePipelines(_simulationSetup->_particleCount, _gridSetup->_dimension);
+	CreateSimulationBuffers(_particleCapacity, _BVHMaxLevel);
+	CreateFlowBuffers(_particleCapacity);
+	CreateSnapshotBuffers(_particleCapacity);
+	CreatePipelines(_particleCapacity, _gridSetup->_dimension);
 
 	// Transfer simulation setup
-	_simulationSetupBuffer->CopyFrom(_simulationSetup.get());
+	// The dispatches are prepared on the device from then on, first after the flow of the first frame, whose passes take them from here.
+	Upload(_simulationSetupBuffer, _simulationSetup.get());
+	for (const auto &buffer : _particleCountStatisticsBuffers) buffer->CopyFrom(&_particleCount);
+
+	uint32_t endTimeStepCount = std::max({ _particleCount, _gridSetup->_dimension.w, 2 * MAX_SOLVER_ITERATIONS });
+	std::array<ParticleDispatch, DISPATCH_COUNT> particleDispatches{ ParticleDispatch::Create(_particleCount), ParticleDispatch::Create(endTimeStepCount) };
+	Upload(_particleDispatchBuffer, particleDispatches.data());
+	for (const auto &buffer : _particleDispatchSnapshotBuffers) buffer->CopyFrom(&particleDispatches[PARTICLE_DISPATCH]);
 
 	// Finally copy the particle positions
-	_positionBuffer->CopyFrom(positions.data());
+	Upload(_positionBuffer, positions.data(), sizeof(glm::vec3) * positions.size());
+	for (const auto &buffer : _positionSnapshotBuffers) buffer->CopyFrom(positions.data(), 0, sizeof(glm::vec3) * positions.size());
+}
+
+void SimulationCompute::UpdateParticleFlow(const ParticleFlow &particleFlow, float particleDistance)
+{
+	_particleFlow = particleFlow;
+	_particleDistance = particleDistance;
 }
 
 void SimulationCompute::RecordCommand(VkCommandBuffer computeCommandBuffer, size_t currentFrame)
+{
+	UpdateTimeStep(currentFrame);
+	UpdateFlow(currentFrame);
+
+	// 0. Upload the refitted colliders and the changed parameters
+	if (_isBVHNodeUploadPending || _isOccupancyUploadPending || _isParameterUploadPending)
+	{
+		if (_isParameterUploadPending)
+		{
+			_simulationParametersStagingBuffers[currentFrame]->CopyFrom(&_simulationParameters);
+			_kernelTableStagingBuffers[currentFrame]->CopyFrom(_kernelTable.data());
+
+			VkBufferCopy parameterCopyRegion
+			{
+				.srcOffset = 0,
+				.dstOffset = 0,
+				.size = _simulationParametersBuffer->Size()
+			};
+			vkCmdCopyBuffer(computeCommandBuffer, _simulationParametersStagingBuffers[currentFrame]->GetBufferHandle(), _simulationParametersBuffer->GetBufferHandle(), 1, &parameterCopyRegion);
+
+			VkBufferCopy kernelTableCopyRegion
+			{
+				.srcOffset = 0,
+				.dstOffset = 0,
+				.size = _kernelTableBuffer->Size()
+			};
+			vkCmdCopyBuffer(computeCommandBuffer, _kernelTableStagingBuffers[currentFrame]->GetBufferHandle(), _kernelTableBuffer->GetBufferHandle(), 1, &kernelTableCopyRegion);
+
+			_isParameterUploadPending = false;
+		}
+
+		if (_isBVHNodeUploadPending)
+		{
+			VkBufferCopy nodeCopyRegion
+			{
+				.srcOffset = 0,
+				.dstOffset = 0,
+				.size = _BVHNodeBuffer->Size()
+			};
+			vkCmdCopyBuffer(computeCommandBuffer, _BVHNodeStagingBuffers[currentFrame]->GetBufferHandle(), _BVHNodeBuffer->GetBufferHandle(), 1, &nodeCopyRegion);
+
+			VkBufferCopy instanceCopyRegion
+			{
+				.srcOffset = 0,
+				.dstOffset = 0,
+				.size = _BVHInstanceBuffer->Size()
+			};
+			vkCmdCopyBuffer(computeCommandBuffer, _BVHInstanceStagingBuffers[currentFrame]->GetBufferHandle(), _BVHInstanceBuffer->GetBufferHandle(), 1, &instanceCopyRegion);
+
+			VkBufferCopy SDFInstanceCopyRegion
+			{
+				.srcOffset = 0,
+				.dstOffset = 0,
+				.size = _SDFInstanceBuffer->Size()
+			};
+			vkCmdCopyBuffer(computeCommandBuffer, _SDFInstanceStagingBuffers[currentFrame]->GetBufferHandle(), _SDFInstanceBuffer->GetBufferHandle(), 1, &SDFInstanceCopyRegion);
+
+			_isBVHNodeUploadPending = false;
+		}
+
+		if (_isOccupancyUploadPending)
+		{
+			VkBufferCopy occupancyCopyRegion
+			{
+				.srcOffset = 0,
+				.dstOffset = 0,
+				.size = _occupancyBuffer->Size()
+			};
+			vkCmdCopyBuffer(computeCommandBuffer, _occupancyStagingBuffers[currentFrame]->GetBufferHandle(), _occupancyBuffer->GetBufferHandle(), 1, &occupancyCopyRegion);
+
+			_isOccupancyUploadPending = false;
+		}
+
+		VkMemoryBarrier uploadBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT
+		};
+		vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &uploadBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	// Particles enter and leave before the steps of the frame
+	RecordFlow(computeCommandBuffer, currentFrame);
+
+	// Every step reuses the same buffers and descriptor sets; only the state after the last one is seen by the renderers recorded after us.
+	for (uint32_t step = 0; step < _frameStepCount; ++step)
+	{
+		RecordTimeStep(computeCommandBuffer, currentFrame);
+	}
+
+	RecordSnapshot(computeCommandBuffer, currentFrame);
+}
+
+// Recorded first on the compute queue; pairs with the release at the end of RecordSnapshot
+void SimulationCompute::RecordAcquireCommand(VkCommandBuffer computeCommandBuffer, size_t currentFrame)
+{
+	if (VulkanCore::Get()->GetAsyncComputeFamily() == VulkanCore::Get()->GetComputeFamily()) return;
+
+	auto acquireBarriers = CreateSnapshotOwnershipBarriers(currentFrame, 0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+	VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT; // Same as the wait on the async compute
+	vkCmdPipelineBarrier(computeCommandBuffer, stageMask, stageMask, 0, 0, nullptr, static_cast<uint32_t>(acquireBarriers.size()), acquireBarriers.data(), 0, nullptr);
+}
+
+void SimulationCompute::RecordTimeStep(VkCommandBuffer computeCommandBuffer, size_t currentFrame)
 {
 	VkMemoryBarrier memoryBarrier
 	{
@@ -68,13 +258,13 @@ void SimulationCompute::RecordCommand(VkCommandBuffer computeCommandBuffer, size
 	// 1. Hash particle positions and yield counts for each bucket
 	vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _hashingPipeline->GetPipeline());
 	vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _hashingPipeline->GetPipelineLayout(), 0, 1, &_hashingDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
-	vkCmdDispatch(computeCommandBuffer, DivisionCeil(_simulationSetup->_particleCount, 1024), 1, 1);
+	DispatchParticles(computeCommandBuffer);
 
 	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
 	// 2. Prefix sum of bucket counts
 	// Up-sweep phase
-	uint32_t bucketCount = _gridSetup->_dimension.x * _gridSetup->_dimension.y * _gridSetup->_dimension.z;
+	uint32_t bucketCount = _gridSetup->_dimension.w;
 
 	for (uint32_t step = 0; step < _prefixSumIterCount; ++step)
 	{
@@ -117,85 +307,515 @@ void SimulationCompute::RecordCommand(VkCommandBuffer computeCommandBuffer, size
 	// 3. Counting sort of particles with their hash keys
 	vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _countingSortPipeline->GetPipeline());
 	vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _countingSortPipeline->GetPipelineLayout(), 0, 1, &_countingSortDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
-	vkCmdDispatch(computeCommandBuffer, DivisionCeil(_simulationSetup->_particleCount, 1024), 1, 1);
+	DispatchParticles(computeCommandBuffer);
 
 	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
 	// 4. Update densities
 	vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _densityPipeline->GetPipeline());
 	vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _densityPipeline->GetPipelineLayout(), 0, 1, &_densityDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
-	vkCmdDispatch(computeCommandBuffer, DivisionCeil(_simulationSetup->_particleCount, 1024), 1, 1);
+	DispatchParticles(computeCommandBuffer);
 
 	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
+	// Divergence-free SPH solves for pressure instead of deriving it from the density
+	PressureSolver pressureSolver = static_cast<PressureSolver>(_simulationParameters._pressureSolver);
+	if (pressureSolver == PressureSolver::DFSPH)
+	{
+		vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _dfsphFactorPipeline->GetPipeline());
+		vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _dfsphFactorPipeline->GetPipelineLayout(), 0, 1, &_dfsphFactorDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
+		DispatchParticles(computeCommandBuffer);
+
+		vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		// Remove the compression rate left by the last step before the forces act on the velocities
+		RecordPressureSolve(computeCommandBuffer, currentFrame, 0);
+	}
+
 	// 5. Accumulate external forces
 	vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _externalForcesPipeline->GetPipeline());
 	vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _externalForcesPipeline->GetPipelineLayout(), 0, 1, &_externalForcesDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
-	vkCmdDispatch(computeCommandBuffer, DivisionCeil(_simulationSetup->_particleCount, 1024), 1, 1);
+	DispatchParticles(computeCommandBuffer);
 
 	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
 	// 6. Compute pressures
-	vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _computePressurePipeline->GetPipeline());
-	vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _computePressurePipeline->GetPipelineLayout(), 0, 1, &_computePressureDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
-	vkCmdDispatch(computeCommandBuffer, DivisionCeil(_simulationSetup->_particleCount, 1024), 1, 1);
+	// Pressures stay zero under DFSPH, so the next pass accumulates viscosity alone.
+	if (pressureSolver == PressureSolver::EOS)
+	{
+		vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _computePressurePipeline->GetPipeline());
+		vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _computePressurePipeline->GetPipelineLayout(), 0, 1, &_computePressureDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
+		DispatchParticles(computeCommandBuffer);
 
-	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
 
 	// 7. Accumulate pressure forces
-	vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pressureAndViscosityPipeline->GetPipeline());
-	vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pressureAndViscosityPipeline->GetPipelineLayout(), 0, 1, &_pressureAndViscosityDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
-	vkCmdDispatch(computeCommandBuffer, DivisionCeil(_simulationSetup->_particleCount, 1024), 1, 1);
+	// Position based fluids take neither, with XSPH in place of viscosity, and DFSPH needs nothing from the pass when viscosity is implicit.
+	bool isViscosityImplicit = (static_cast<ViscositySolver>(_simulationParameters._viscositySolver) == ViscositySolver::Implicit) && _simulationParameters._viscosityCoefficient > 0.0f;
+	if (pressureSolver == PressureSolver::EOS || (pressureSolver == PressureSolver::DFSPH && !isViscosityImplicit))
+	{
+		vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pressureAndViscosityPipeline->GetPipeline());
+		vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pressureAndViscosityPipeline->GetPipelineLayout(), 0, 1, &_pressureAndViscosityDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
+		DispatchParticles(computeCommandBuffer);
 
-	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	// Measure the limits for a later time step; nothing waits on this.
+	vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _measureTimeStepLimitsPipeline->GetPipeline());
+	vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _measureTimeStepLimitsPipeline->GetPipelineLayout(), 0, 1, &_measureTimeStepLimitsDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
+	DispatchParticles(computeCommandBuffer);
 
 	// 8. Time integration
 	vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _timeIntegrationPipeline->GetPipeline());
 	vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _timeIntegrationPipeline->GetPipelineLayout(), 0, 1, &_timeIntegrationDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
-	vkCmdDispatch(computeCommandBuffer, DivisionCeil(_simulationSetup->_particleCount, 1024), 1, 1);
+	DispatchParticles(computeCommandBuffer);
 
 	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
+	// Implicit viscosity acts on the integrated velocities and moves the particles with the solved ones
+	if (isViscosityImplicit && pressureSolver != PressureSolver::PBF) RecordViscositySolve(computeCommandBuffer, currentFrame);
+
+	if (pressureSolver == PressureSolver::DFSPH)
+	{
+		// Remove the compression the step would cause from the integrated velocities, and move the particles with the corrected ones
+		RecordPressureSolve(computeCommandBuffer, currentFrame, 1);
+
+		vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _solveAdvectPipeline->GetPipeline());
+		vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _solveAdvectPipeline->GetPipelineLayout(), 0, 1, &_densitySolveDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
+		DispatchParticles(computeCommandBuffer);
+
+		vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+	else if (pressureSolver == PressureSolver::PBF)
+	{
+		// Project the integrated positions onto the density constraints, then derive the velocities from them
+		RecordConstraintProjection(computeCommandBuffer, currentFrame);
+	}
+
 	// 9. Resolve collision
-	vkCmdPushConstants(computeCommandBuffer, _resolveCollisionPipeline->GetPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &_BVHMaxLevel);
+	if (_colliderMode == ColliderMode::SDF)
+	{
+		vkCmdPushConstants(computeCommandBuffer, _resolveSDFCollisionPipeline->GetPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &_SDFInstanceCount);
+
+		vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _resolveSDFCollisionPipeline->GetPipeline());
+		vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _resolveSDFCollisionPipeline->GetPipelineLayout(), 0, 1, &_resolveSDFCollisionDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
+		DispatchParticles(computeCommandBuffer);
+	}
+	else
+	{
+		vkCmdPushConstants(computeCommandBuffer, _resolveCollisionPipeline->GetPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &_BVHMaxLevel);
 
-	vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _resolveCollisionPipeline->GetPipeline());
-	vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _resolveCollisionPipeline->GetPipelineLayout(), 0, 1, &_resolveCollisionDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
-	vkCmdDispatch(computeCommandBuffer, DivisionCeil(_simulationSetup->_particleCount, 1024), 1, 1);
+		vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _resolveCollisionPipeline->GetPipeline());
+		vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _resolveCollisionPipeline->GetPipelineLayout(), 0, 1, &_resolveCollisionDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
+		DispatchParticles(computeCommandBuffer);
+	}
 
 	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 	
 	// 10. End a time step
 	vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _endTimeStepPipeline->GetPipeline());
 	vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _endTimeStepPipeline->GetPipelineLayout(), 0, 1, &_endTimeStepDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
-	vkCmdDispatch(computeCommandBuffer, DivisionCeil(std::max(_simulationSetup->_particleCount, bucketCount), 1024), 1, 1);
+	DispatchParticles(computeCommandBuffer, END_TIME_STEP_DISPATCH);
 
-	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	// The next substep, if any, rewrites what this one has written as well as reading it.
+	VkMemoryBarrier endBarrier
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+	};
+	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &endBarrier, 0, nullptr, 0, nullptr);
+}
+
+// Record every iteration up to the cap; the passes after convergence return immediately, so the host never reads the errors back.
+// solveMode 0 makes the velocities divergence-free, and 1 keeps the density of the coming step at rest.
+void SimulationCompute::RecordPressureSolve(VkCommandBuffer computeCommandBuffer, size_t currentFrame, uint32_t solveMode)
+{
+	VkMemoryBarrier memoryBarrier
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+	};
+
+	const Descriptor &descriptor = (solveMode == 0) ? _divergenceSolveDescriptor : _densitySolveDescriptor;
+	auto recordPass = [&](const Pipeline &pipeline, uint32_t iteration)
+	{
+		_solverState->_iteration = iteration;
+		_solverState->_solveMode = solveMode;
+		vkCmdPushConstants(computeCommandBuffer, pipeline->GetPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SolverState), _solverState.get());
+
+		vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->GetPipeline());
+		vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->GetPipelineLayout(), 0, 1, &descriptor->GetDescriptorSets()[currentFrame], 0, 0);
+		DispatchParticles(computeCommandBuffer);
+
+		vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	};
+
+	// The warm start is applied as an iteration past the cap, which is never taken as converged
+	recordPass(_solveWarmStartPipeline, MAX_SOLVER_ITERATIONS);
+	recordPass(_solveCorrectVelocitiesPipeline, MAX_SOLVER_ITERATIONS);
+
+	uint32_t maxIterations = std::clamp(_simulationParameters._maxSolverIterations, MIN_SOLVER_ITERATIONS, MAX_SOLVER_ITERATIONS);
+	for (uint32_t iteration = 0; iteration < maxIterations; ++iteration)
+	{
+		recordPass(_solvePredictPipeline, iteration);
+		recordPass(_solveStiffnessPipeline, iteration);
+		recordPass(_solveCorrectVelocitiesPipeline, iteration);
+	}
+}
+
+void SimulationCompute::RecordConstraintProjection(VkCommandBuffer computeCommandBuffer, size_t currentFrame)
+{
+	VkMemoryBarrier memoryBarrier
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+	};
+
+	auto recordPass = [&](const Pipeline &pipeline)
+	{
+		vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->GetPipeline());
+		vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->GetPipelineLayout(), 0, 1, &_pbfSolveDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
+		DispatchParticles(computeCommandBuffer);
+
+		vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	};
+
+	uint32_t iterationCount = std::clamp(_simulationParameters._constraintIterations, 1u, MAX_SOLVER_ITERATIONS);
+	for (uint32_t iteration = 0; iteration < iterationCount; ++iteration)
+	{
+		recordPass(_pbfLambdaPipeline);
+		recordPass(_pbfCorrectPositionsPipeline);
+		recordPass(_pbfApplyCorrectionsPipeline);
+	}
+
+	recordPass(_pbfXSPHPipeline);
+}
+
+// Conjugate gradient on the velocities after the step, recorded up to the iteration cap; the passes after convergence return immediately.
+// Each global sum is taken per workgroup by a particle pass and then by a single workgroup.
+void SimulationCompute::RecordViscositySolve(VkCommandBuffer computeCommandBuffer, size_t currentFrame)
+{
+	VkMemoryBarrier memoryBarrier
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+	};
+
+	// Particle passes are dispatched over the live particles, and the reductions by a single workgroup
+	auto recordPass = [&](const Pipeline &pipeline, bool isReduction)
+	{
+		vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->GetPipeline());
+		vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->GetPipelineLayout(), 0, 1, &_viscositySolveDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
+		if (isReduction) vkCmdDispatch(computeCommandBuffer, 1, 1, 1);
+		else DispatchParticles(computeCommandBuffer);
+
+		vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	};
+
+	recordPass(_viscosityWarmStartPipeline, false);
+	recordPass(_viscosityInitialResidualPipeline, false);
+	recordPass(_viscosityReduceInitialResidualPipeline, true);
+
+	uint32_t maxIterations = std::clamp(_simulationParameters._maxSolverIterations, MIN_SOLVER_ITERATIONS, MAX_SOLVER_ITERATIONS);
+	for (uint32_t iteration = 0; iteration < maxIterations; ++iteration)
+	{
+		recordPass(_viscosityProductPipeline, false);
+		recordPass(_viscosityReduceStepLengthPipeline, true);
+		recordPass(_viscosityUpdatePipeline, false);
+		recordPass(_viscosityReduceDirectionScalePipeline, true);
+		recordPass(_viscosityDirectionPipeline, false);
+	}
+
+	recordPass(_viscosityFinishPipeline, false);
+}
+
+// Choose the time step of this frame from the statistics of the last frame that used the same slot.
+// The fence of the slot has been waited on before recording, so its buffers are free to read and rewrite.
+// Adaptive steps cover the wall time of the frame as the host solvers do: the frame is split into as many equal steps as the stable step requires,
+// so no short tail is left over. Fixed steps are taken once per substep.
+void SimulationCompute::UpdateTimeStep(size_t currentFrame)
+{
+	glm::uvec2 statistics{};
+	_timeStepStatisticsBuffers[currentFrame]->CopyTo(&statistics);
+
+	float maxSpeed = std::bit_cast<float>(statistics.x);
+	float maxAcceleration = std::bit_cast<float>(statistics.y);
+	float timeStep = ComputeAdaptiveTimeStep(_simulationParameters, maxSpeed, maxAcceleration);
+	if (_timeStepState->_timeStep > 0.0f) timeStep = std::min(timeStep, _timeStepState->_timeStep * MAX_TIME_STEP_GROWTH);
+
+	_frameStepCount = _substepCount;
+	if (_simulationParameters._isTimeStepAdaptive)
+	{
+		float frameTime = std::min(_deltaSecond, MAX_FRAME_TIME) * _substepCount;
+		_frameStepCount = std::clamp(static_cast<uint32_t>(std::ceil(frameTime / timeStep)), 1u, MAX_SUBSTEPS * _substepCount);
+		timeStep = std::min(timeStep, std::max(frameTime / _frameStepCount, MIN_TIME_STEP)); // Past the cap on the steps, the frame is simulated in slow motion
+	}
+
+	_timeStepState->_timeStep = timeStep;
+	_timeStepStateBuffers[currentFrame]->CopyFrom(_timeStepState.get());
+
+	glm::uvec2 resetStatistics{};
+	_timeStepStatisticsBuffers[currentFrame]->CopyFrom(&resetStatistics);
+}
+
+// Read back the count of the frame that used the same slot, and lay out the particles that the frame lets in for the device.
+// The frame simulates the time step chosen for it times its steps, over which the emitters advance.
+void SimulationCompute::UpdateFlow(size_t currentFrame)
+{
+	_particleCountStatisticsBuffers[currentFrame]->CopyTo(&_particleCount);
+
+	_emittedPositions.clear();
+	_emittedVelocities.clear();
+	if (_particleFlow.HasEmitters())
+	{
+		_particleFlow.Emit(_timeStepState->_timeStep * _frameStepCount, _particleDistance, _emittedPositions, _emittedVelocities);
+	}
+
+	uint32_t emittedCount = std::min(static_cast<uint32_t>(_emittedPositions.size()), MAX_EMITTED_PARTICLES);
+	_emittedParticles.resize(emittedCount);
+	for (uint32_t emittedIndex = 0; emittedIndex < emittedCount; ++emittedIndex)
+	{
+		_emittedParticles[emittedIndex]._position = glm::vec4(_emittedPositions[emittedIndex], 0.0f);
+		_emittedParticles[emittedIndex]._velocity = glm::vec4(_emittedVelocities[emittedIndex], 0.0f);
+	}
+	if (emittedCount > 0) _emittedParticleBuffers[currentFrame]->CopyFrom(_emittedParticles.data(), 0, sizeof(EmittedParticle) * emittedCount);
+
+	const auto &sinks = _particleFlow.GetSinks();
+	uint32_t sinkCount = std::min(static_cast<uint32_t>(sinks.size()), MAX_SINKS);
+	if (sinkCount > 0) _sinkBuffers[currentFrame]->CopyFrom(sinks.data(), 0, sizeof(Sink) * sinkCount);
+
+	_flowSetup->_emittedCount = emittedCount;
+	_flowSetup->_sinkCount = sinkCount;
+	_flowSetupBuffers[currentFrame]->CopyFrom(_flowSetup.get());
+}
+
+// Without emitters and sinks, only the last pass is recorded, which publishes the count for the host.
+// The passes over the particles run over the count before the flow, and the dispatches are then prepared from the count after it.
+void SimulationCompute::RecordFlow(VkCommandBuffer computeCommandBuffer, size_t currentFrame)
+{
+	VkMemoryBarrier memoryBarrier
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+	};
+
+	// The emission is dispatched over the particles laid out by the host, and the other passes over the particles
+	auto recordPass = [&](const Pipeline &pipeline, bool isEmission)
+	{
+		vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->GetPipeline());
+		vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->GetPipelineLayout(), 0, 1, &_particleFlowDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
+		if (isEmission) vkCmdDispatch(computeCommandBuffer, DivisionCeil(_flowSetup->_emittedCount, 1024), 1, 1);
+		else DispatchParticles(computeCommandBuffer);
+
+		vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	};
+
+	if (_flowSetup->_emittedCount > 0 || _flowSetup->_sinkCount > 0)
+	{
+		recordPass(_flowRemovePipeline, false);
+		if (_flowSetup->_emittedCount > 0) recordPass(_flowEmitPipeline, true);
+		recordPass(_flowCollectPipeline, false);
+		recordPass(_flowMovePipeline, false);
+	}
+
+	vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _flowFinishPipeline->GetPipeline());
+	vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _flowFinishPipeline->GetPipelineLayout(), 0, 1, &_particleFlowDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
+	vkCmdDispatch(computeCommandBuffer, 1, 1, 1);
+
+	// The count is read as a uniform by the passes of the steps
+	VkMemoryBarrier countBarrier
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+	};
+	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &countBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _prepareDispatchPipeline->GetPipeline());
+	vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _prepareDispatchPipeline->GetPipelineLayout(), 0, 1, &_prepareDispatchDescriptor->GetDescriptorSets()[currentFrame], 0, 0);
+	vkCmdDispatch(computeCommandBuffer, 1, 1, 1);
+
+	// The dispatches are read by the indirect commands of the steps and the renderers, and the count by their shaders
+	VkMemoryBarrier dispatchBarrier
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT
+	};
+	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &dispatchBarrier, 0, nullptr, 0, nullptr);
+}
+
+// Copy the state after the last step for the renderers of this frame, and pass the copies to the compute queue that they run on.
+// The copies of the last frame that used the slot are overwritten as a whole, so they are not passed back to this queue.
+void SimulationCompute::RecordSnapshot(VkCommandBuffer computeCommandBuffer, size_t currentFrame)
+{
+	VkMemoryBarrier stepBarrier
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT
+	};
+	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &stepBarrier, 0, nullptr, 0, nullptr);
+
+	VkBufferCopy positionCopyRegion
+	{
+		.srcOffset = 0,
+		.dstOffset = 0,
+		.size = _positionBuffer->Size()
+	};
+	vkCmdCopyBuffer(computeCommandBuffer, _positionBuffer->GetBufferHandle(), _positionSnapshotBuffers[currentFrame]->GetBufferHandle(), 1, &positionCopyRegion);
+
+	VkBufferCopy dispatchCopyRegion
+	{
+		.srcOffset = sizeof(ParticleDispatch) * PARTICLE_DISPATCH,
+		.dstOffset = 0,
+		.size = sizeof(ParticleDispatch)
+	};
+	vkCmdCopyBuffer(computeCommandBuffer, _particleDispatchBuffer->GetBufferHandle(), _particleDispatchSnapshotBuffers[currentFrame]->GetBufferHandle(), 1, &dispatchCopyRegion);
+
+	// The steps of the next frame write the buffers that were just copied
+	VkMemoryBarrier copyBarrier
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+		.dstAccessMask = 0
+	};
+	vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &copyBarrier, 0, nullptr, 0, nullptr);
+
+	VkAccessFlags readAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	if (VulkanCore::Get()->GetAsyncComputeFamily() == VulkanCore::Get()->GetComputeFamily())
+	{
+		// Without an async compute queue, the renderers are recorded after us in the same command buffer
+		VkMemoryBarrier snapshotBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = readAccessMask
+		};
+		vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &snapshotBarrier, 0, nullptr, 0, nullptr);
+	}
+	else
+	{
+		// Release; the destination access is given by the acquire on the compute queue
+		auto releaseBarriers = CreateSnapshotOwnershipBarriers(currentFrame, VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+		vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, static_cast<uint32_t>(releaseBarriers.size()), releaseBarriers.data(), 0, nullptr);
+	}
+}
+
+std::vector<VkBufferMemoryBarrier> SimulationCompute::CreateSnapshotOwnershipBarriers(size_t currentFrame, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask)
+{
+	std::vector<VkBufferMemoryBarrier> barriers;
+	for (const auto &buffer : { _positionSnapshotBuffers[currentFrame], _particleDispatchSnapshotBuffers[currentFrame] })
+	{
+		barriers.push_back
+		(
+			VkBufferMemoryBarrier
+			{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				.srcAccessMask = srcAccessMask,
+				.dstAccessMask = dstAccessMask,
+				.srcQueueFamilyIndex = VulkanCore::Get()->GetAsyncComputeFamily(),
+				.dstQueueFamilyIndex = VulkanCore::Get()->GetComputeFamily(),
+				.buffer = buffer->GetBufferHandle(),
+				.offset = 0,
+				.size = VK_WHOLE_SIZE
+			}
+		);
+	}
+
+	return barriers;
+}
+
+void SimulationCompute::DispatchParticles(VkCommandBuffer computeCommandBuffer, uint32_t dispatchIndex)
+{
+	vkCmdDispatchIndirect(computeCommandBuffer, _particleDispatchBuffer->GetBufferHandle(), sizeof(ParticleDispatch) * dispatchIndex);
 }
 
 void SimulationCompute::CreateSetupBuffers()
 {
 	Memory memory = CreateMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	_simulationSetupBuffer = CreateBuffer(sizeof(SimulationSetup), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+	_simulationSetupBuffer = CreateBuffer(sizeof(SimulationSetup), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT); // The count is written by the flow passes
 	_gridSetupBuffer = CreateBuffer(sizeof(GridSetup), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
 	_simulationParametersBuffer = CreateBuffer(sizeof(SimulationParameters), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
-	memory->Bind({ _simulationSetupBuffer, _gridSetupBuffer, _simulationParametersBuffer });
+	_kernelTableBuffer = CreateBuffer(sizeof(glm::vec4) * Kernel::TABLE_SIZE, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_particleDispatchBuffer = CreateBuffer(sizeof(ParticleDispatch) * DISPATCH_COUNT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+	memory->Bind({ _simulationSetupBuffer, _gridSetupBuffer, _simulationParametersBuffer, _kernelTableBuffer, _particleDispatchBuffer });
+
+	_simulationParametersStagingBuffers = CreateBuffers(sizeof(SimulationParameters), VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	_kernelTableStagingBuffers = CreateBuffers(sizeof(glm::vec4) * Kernel::TABLE_SIZE, VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	_timeStepStatisticsBuffers = CreateBuffers(sizeof(glm::uvec2), VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	_timeStepStateBuffers = CreateBuffers(sizeof(TimeStepState), VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	for (const auto &buffer : _timeStepStatisticsBuffers)
+	{
+		glm::uvec2 statistics{};
+		buffer->CopyFrom(&statistics);
+	}
+
+	_flowSetupBuffers = CreateBuffers(sizeof(FlowSetup), VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	_emittedParticleBuffers = CreateBuffers(sizeof(EmittedParticle) * MAX_EMITTED_PARTICLES, VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	_sinkBuffers = CreateBuffers(sizeof(Sink) * MAX_SINKS, VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	_particleCountStatisticsBuffers = CreateBuffers(sizeof(uint32_t), VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 }
 
 void SimulationCompute::CreateGridBuffers(glm::uvec3 gridDimension)
 {
+	// Blelloch's scan works on a power-of-two number of elements, so buckets are padded with empty ones.
+	uint32_t bucketCount = gridDimension.x * gridDimension.y * gridDimension.z;
+	uint32_t paddedBucketCount = std::bit_ceil(bucketCount);
+
+	_gridSetup->_dimension = glm::uvec4(gridDimension, paddedBucketCount);
+	Upload(_gridSetupBuffer, _gridSetup.get());
+	_prefixSumIterCount = Log(paddedBucketCount); // log(2, n)
+
 	Memory memory = CreateMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	_accumulationBuffer = CreateBuffer(sizeof(uint32_t) * gridDimension.x * gridDimension.y * gridDimension.z, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-	memory->Bind({ _accumulationBuffer });
+	_accumulationBuffer = CreateBuffer(sizeof(uint32_t) * paddedBucketCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_occupancyBuffer = CreateBuffer(sizeof(uint32_t) * DivisionCeil(bucketCount, 32), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	memory->Bind({ _accumulationBuffer, _occupancyBuffer });
+
+	_occupancyStagingBuffers = CreateBuffers(_occupancyBuffer->Size(), VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 }
 
-void SimulationCompute::CreateLevelBuffers(const std::vector<BVH::Node> &BVHNodes)
+void SimulationCompute::CreateLevelBuffers(const BVH &bvh, const SDF &sdf)
 {
+	const auto &nodes = bvh.GetNodes();
+	const auto &instances = bvh.GetInstances();
+	const auto &meshNodes = bvh.GetMeshNodes();
+
 	Memory memory = CreateMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	_BVHNodeBuffer = CreateBuffer(sizeof(BVH::Node) * BVHNodes.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-	memory->Bind({ _BVHNodeBuffer });
+	_BVHNodeBuffer = CreateBuffer(sizeof(BVH::Node) * nodes.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_BVHInstanceBuffer = CreateBuffer(sizeof(BVH::Instance) * instances.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_BVHMeshNodeBuffer = CreateBuffer(sizeof(BVH::Node) * meshNodes.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_SDFGridBuffer = CreateBuffer(sizeof(SDF::Grid) * sdf.GetGrids().size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_SDFInstanceBuffer = CreateBuffer(sizeof(SDF::Instance) * sdf.GetInstances().size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_SDFSampleBuffer = CreateBuffer(sizeof(float) * sdf.GetSamples().size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	memory->Bind({ _BVHNodeBuffer, _BVHInstanceBuffer, _BVHMeshNodeBuffer, _SDFGridBuffer, _SDFInstanceBuffer, _SDFSampleBuffer });
+
+	Upload(_BVHNodeBuffer, nodes.data());
+	Upload(_BVHInstanceBuffer, instances.data());
+	Upload(_BVHMeshNodeBuffer, meshNodes.data());
+	Upload(_SDFGridBuffer, sdf.GetGrids().data());
+	Upload(_SDFInstanceBuffer, sdf.GetInstances().data());
+	Upload(_SDFSampleBuffer, sdf.GetSamples().data());
+
+	_BVHNodeStagingBuffers = CreateBuffers(sizeof(BVH::Node) * nodes.size(), VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	_BVHInstanceStagingBuffers = CreateBuffers(sizeof(BVH::Instance) * instances.size(), VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	_SDFInstanceStagingBuffers = CreateBuffers(sizeof(SDF::Instance) * sdf.GetInstances().size(), VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	_isBVHNodeUploadPending = false;
+}
 
-	_BVHNodeBuffer->CopyFrom(BVHNodes.data());
+void SimulationCompute::CreateBVHStackBuffer(uint32_t particleCount, uint32_t BVHMaxLevel)
+{
+	Memory memory = CreateMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	_BVHStackBuffer = CreateBuffer(sizeof(uint32_t) * particleCount * BVHMaxLevel, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	memory->Bind({ _BVHStackBuffer });
 }
 
 void SimulationCompute::CreateSimulationBuffers(uint32_t particleCount, uint32_t BVHMaxLevel)
@@ -204,15 +824,88 @@ void SimulationCompute::CreateSimulationBuffers(uint32_t particleCount, uint32_t
 	_hashResultBuffer = CreateBuffer(sizeof(uint32_t) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 	_adjacentBucketBuffer = CreateBuffer(sizeof(uint32_t) * particleCount * OVERLAPPING_BUCKETS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 	_bucketBuffer = CreateBuffer(sizeof(uint32_t) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-	_positionBuffer = CreateBuffer(sizeof(glm::vec3) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	_positionBuffer = CreateBuffer(sizeof(glm::vec3) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
 	_densityBuffer = CreateBuffer(sizeof(float) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 	_velocityBuffer = CreateBuffer(sizeof(glm::vec3) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 	_forceBuffer = CreateBuffer(sizeof(glm::vec3) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 	_pressureBuffer = CreateBuffer(sizeof(glm::vec3) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-	_BVHStackBuffer = CreateBuffer(sizeof(uint32_t) * particleCount * BVHMaxLevel, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 	_nextPositionBuffer = CreateBuffer(sizeof(glm::vec3) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 	_nextVelocityBuffer = CreateBuffer(sizeof(glm::vec3) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-	memory->Bind({ _hashResultBuffer, _adjacentBucketBuffer, _bucketBuffer, _positionBuffer, _densityBuffer, _velocityBuffer, _forceBuffer, _pressureBuffer, _BVHStackBuffer, _nextPositionBuffer, _nextVelocityBuffer });
+	_dfsphFactorBuffer = CreateBuffer(sizeof(float) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_densityErrorBuffer = CreateBuffer(sizeof(float) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_stiffnessBuffer = CreateBuffer(sizeof(float) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_divergenceStiffnessBuffer = CreateBuffer(sizeof(float) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	_densityStiffnessBuffer = CreateBuffer(sizeof(float) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	_solverErrorBuffer = CreateBuffer(sizeof(uint32_t) * 2 * MAX_SOLVER_ITERATIONS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	_lambdaBuffer = CreateBuffer(sizeof(float) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_positionCorrectionBuffer = CreateBuffer(sizeof(glm::vec3) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_viscosityDiagonalBuffer = CreateBuffer(sizeof(float) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_viscosityResidualBuffer = CreateBuffer(sizeof(glm::vec3) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_viscosityDirectionBuffer = CreateBuffer(sizeof(glm::vec3) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_viscosityProductBuffer = CreateBuffer(sizeof(glm::vec3) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_viscosityCorrectionBuffer = CreateBuffer(sizeof(glm::vec3) * particleCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	_viscosityPartialSumBuffer = CreateBuffer(sizeof(glm::vec3) * DivisionCeil(particleCount, 1024), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_viscositySolverStateBuffer = CreateBuffer(sizeof(ViscositySolverState), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	memory->Bind({ _hashResultBuffer, _adjacentBucketBuffer, _bucketBuffer, _positionBuffer, _densityBuffer, _velocityBuffer, _forceBuffer, _pressureBuffer, _nextPositionBuffer, _nextVelocityBuffer, _dfsphFactorBuffer, _densityErrorBuffer, _stiffnessBuffer, _divergenceStiffnessBuffer, _densityStiffnessBuffer, _solverErrorBuffer, _lambdaBuffer, _positionCorrectionBuffer, _viscosityDiagonalBuffer, _viscosityResidualBuffer, _viscosityDirectionBuffer, _viscosityProductBuffer, _viscosityCorrectionBuffer, _viscosityPartialSumBuffer, _viscositySolverStateBuffer });
+
+	// Warm starts begin from nothing, and the errors are cleared at the end of each step after this
+	std::vector<float> zeroStiffnesses(particleCount, 0.0f);
+	Upload(_divergenceStiffnessBuffer, zeroStiffnesses.data());
+	Upload(_densityStiffnessBuffer, zeroStiffnesses.data());
+	std::vector<uint32_t> zeroErrors(2 * MAX_SOLVER_ITERATIONS, 0);
+	Upload(_solverErrorBuffer, zeroErrors.data());
+	std::vector<glm::vec3> zeroCorrections(particleCount, glm::vec3{});
+	Upload(_viscosityCorrectionBuffer, zeroCorrections.data());
+
+	CreateBVHStackBuffer(particleCount, BVHMaxLevel);
+}
+
+void SimulationCompute::CreateFlowBuffers(uint32_t particleCapacity)
+{
+	Memory memory = CreateMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	_flowStateBuffer = CreateBuffer(sizeof(FlowState), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	_aliveMaskBuffer = CreateBuffer(sizeof(uint32_t) * particleCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_freeSlotBuffer = CreateBuffer(sizeof(uint32_t) * particleCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_moveSourceBuffer = CreateBuffer(sizeof(uint32_t) * particleCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_moveTargetBuffer = CreateBuffer(sizeof(uint32_t) * particleCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	memory->Bind({ _flowStateBuffer, _aliveMaskBuffer, _freeSlotBuffer, _moveSourceBuffer, _moveTargetBuffer });
+
+	// The counters are cleared by the last pass of each frame after this
+	FlowState flowState{};
+	Upload(_flowStateBuffer, &flowState);
+}
+
+void SimulationCompute::CreateSnapshotBuffers(uint32_t particleCapacity)
+{
+	_positionSnapshotBuffers = CreateBuffers(sizeof(glm::vec3) * particleCapacity, VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	_particleDispatchSnapshotBuffers = CreateBuffers(sizeof(ParticleDispatch), VulkanCore::Get()->GetMaxFramesInFlight(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+// Device-local buffers of the solver are uploaded through the queue it runs on, so that their contents are owned by the family that reads them.
+// Only for setups outside the frames; the queue is drained first so that no step in flight reads a buffer while it is written.
+void SimulationCompute::Upload(const Buffer &buffer, const void *source, VkDeviceSize copySize)
+{
+	if (copySize == VK_WHOLE_SIZE) copySize = buffer->Size();
+	if (copySize == 0) return;
+
+	Buffer stagingBuffer = CreateBuffer(copySize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+	Memory stagingMemory = CreateMemory(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	stagingMemory->Bind({ stagingBuffer });
+	stagingBuffer->CopyFrom(source);
+
+	VkQueue queue = VulkanCore::Get()->GetAsyncComputeQueue();
+	VkCommandPool commandPool = VulkanCore::Get()->GetAsyncComputeCommandPool();
+	vkQueueWaitIdle(queue);
+
+	VkCommandBuffer commandBuffer = VulkanCore::Get()->BeginSingleTimeCommands(commandPool);
+	VkBufferCopy copyRegion
+	{
+		.srcOffset = 0,
+		.dstOffset = 0,
+		.size = copySize
+	};
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer->GetBufferHandle(), buffer->GetBufferHandle(), 1, &copyRegion);
+	VulkanCore::Get()->EndSingleTimeCommands(commandPool, commandBuffer, queue);
 }
 
 void SimulationCompute::CreatePipelines(uint32_t particleCount, glm::uvec3 bucketDimension)
@@ -256,22 +949,106 @@ void SimulationCompute::CreatePipelines(uint32_t particleCount, glm::uvec3 bucke
 	_pressureAndViscosityDescriptor = CreatePressureViscosityForceDescriptors(pressureAndViscosityShader);
 	_pressureAndViscosityPipeline = CreateComputePipeline(pressureAndViscosityShader->GetShaderModule(), _pressureAndViscosityDescriptor->GetDescriptorSetLayout());
 
+	Shader dfsphFactorShader = ShaderManager::Get()->GetShaderAsset("ComputeDFSPHFactors");
+	_dfsphFactorDescriptor = CreateDFSPHFactorDescriptors(dfsphFactorShader);
+	_dfsphFactorPipeline = CreateComputePipeline(dfsphFactorShader->GetShaderModule(), _dfsphFactorDescriptor->GetDescriptorSetLayout());
+
+	// Configure a push constant for the pressure solves
+	_solverStatePushConstant.offset = 0;
+	_solverStatePushConstant.size = sizeof(SolverState);
+	_solverStatePushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	Shader solveWarmStartShader = ShaderManager::Get()->GetShaderAsset("DFSPHSolve", "mainWarmStart");
+	_divergenceSolveDescriptor = CreateDFSPHSolveDescriptors(solveWarmStartShader, _velocityBuffer, _divergenceStiffnessBuffer);
+	_densitySolveDescriptor = CreateDFSPHSolveDescriptors(solveWarmStartShader, _nextVelocityBuffer, _densityStiffnessBuffer);
+	_solveWarmStartPipeline = CreateComputePipeline(solveWarmStartShader->GetShaderModule(), _divergenceSolveDescriptor->GetDescriptorSetLayout(), { _solverStatePushConstant });
+
+	Shader solvePredictShader = ShaderManager::Get()->GetShaderAsset("DFSPHSolve", "mainPredict");
+	_solvePredictPipeline = CreateComputePipeline(solvePredictShader->GetShaderModule(), _divergenceSolveDescriptor->GetDescriptorSetLayout(), { _solverStatePushConstant });
+
+	Shader solveStiffnessShader = ShaderManager::Get()->GetShaderAsset("DFSPHSolve", "mainStiffness");
+	_solveStiffnessPipeline = CreateComputePipeline(solveStiffnessShader->GetShaderModule(), _divergenceSolveDescriptor->GetDescriptorSetLayout(), { _solverStatePushConstant });
+
+	Shader solveCorrectVelocitiesShader = ShaderManager::Get()->GetShaderAsset("DFSPHSolve", "mainCorrectVelocities");
+	_solveCorrectVelocitiesPipeline = CreateComputePipeline(solveCorrectVelocitiesShader->GetShaderModule(), _divergenceSolveDescriptor->GetDescriptorSetLayout(), { _solverStatePushConstant });
+
+	Shader solveAdvectShader = ShaderManager::Get()->GetShaderAsset("DFSPHSolve", "mainAdvect");
+	_solveAdvectPipeline = CreateComputePipeline(solveAdvectShader->GetShaderModule(), _densitySolveDescriptor->GetDescriptorSetLayout(), { _solverStatePushConstant });
+
+	Shader pbfLambdaShader = ShaderManager::Get()->GetShaderAsset("PBFSolve", "mainLambda");
+	_pbfSolveDescriptor = CreatePBFSolveDescriptors(pbfLambdaShader);
+	_pbfLambdaPipeline = CreateComputePipeline(pbfLambdaShader->GetShaderModule(), _pbfSolveDescriptor->GetDescriptorSetLayout());
+
+	Shader pbfCorrectPositionsShader = ShaderManager::Get()->GetShaderAsset("PBFSolve", "mainCorrectPositions");
+	_pbfCorrectPositionsPipeline = CreateComputePipeline(pbfCorrectPositionsShader->GetShaderModule(), _pbfSolveDescriptor->GetDescriptorSetLayout());
+
+	Shader pbfApplyCorrectionsShader = ShaderManager::Get()->GetShaderAsset("PBFSolve", "mainApplyCorrections");
+	_pbfApplyCorrectionsPipeline = CreateComputePipeline(pbfApplyCorrectionsShader->GetShaderModule(), _pbfSolveDescriptor->GetDescriptorSetLayout());
+
+	Shader pbfXSPHShader = ShaderManager::Get()->GetShaderAsset("PBFSolve", "mainXSPH");
+	_pbfXSPHPipeline = CreateComputePipeline(pbfXSPHShader->GetShaderModule(), _pbfSolveDescriptor->GetDescriptorSetLayout());
+
+	Shader viscosityWarmStartShader = ShaderManager::Get()->GetShaderAsset("ViscositySolve", "mainWarmStart");
+	_viscositySolveDescriptor = CreateViscositySolveDescriptors(viscosityWarmStartShader);
+	_viscosityWarmStartPipeline = CreateComputePipeline(viscosityWarmStartShader->GetShaderModule(), _viscositySolveDescriptor->GetDescriptorSetLayout());
+
+	Shader viscosityInitialResidualShader = ShaderManager::Get()->GetShaderAsset("ViscositySolve", "mainInitialResidual");
+	_viscosityInitialResidualPipeline = CreateComputePipeline(viscosityInitialResidualShader->GetShaderModule(), _viscositySolveDescriptor->GetDescriptorSetLayout());
+
+	Shader viscosityReduceInitialResidualShader = ShaderManager::Get()->GetShaderAsset("ViscositySolve", "mainReduceInitialResidual");
+	_viscosityReduceInitialResidualPipeline = CreateComputePipeline(viscosityReduceInitialResidualShader->GetShaderModule(), _viscositySolveDescriptor->GetDescriptorSetLayout());
+
+	Shader viscosityProductShader = ShaderManager::Get()->GetShaderAsset("ViscositySolve", "mainProduct");
+	_viscosityProductPipeline = CreateComputePipeline(viscosityProductShader->GetShaderModule(), _viscositySolveDescriptor->GetDescriptorSetLayout());
+
+	Shader viscosityReduceStepLengthShader = ShaderManager::Get()->GetShaderAsset("ViscositySolve", "mainReduceStepLength");
+	_viscosityReduceStepLengthPipeline = CreateComputePipeline(viscosityReduceStepLengthShader->GetShaderModule(), _viscositySolveDescriptor->GetDescriptorSetLayout());
+
+	Shader viscosityUpdateShader = ShaderManager::Get()->GetShaderAsset("ViscositySolve", "mainUpdate");
+	_viscosityUpdatePipeline = CreateComputePipeline(viscosityUpdateShader->GetShaderModule(), _viscositySolveDescriptor->GetDescriptorSetLayout());
+
+	Shader viscosityReduceDirectionScaleShader = ShaderManager::Get()->GetShaderAsset("ViscositySolve", "mainReduceDirectionScale");
+	_viscosityReduceDirectionScalePipeline = CreateComputePipeline(viscosityReduceDirectionScaleShader->GetShaderModule(), _viscositySolveDescriptor->GetDescriptorSetLayout());
+
+	Shader viscosityDirectionShader = ShaderManager::Get()->GetShaderAsset("ViscositySolve", "mainDirection");
+	_viscosityDirectionPipeline = CreateComputePipeline(viscosityDirectionShader->GetShaderModule(), _viscositySolveDescriptor->GetDescriptorSetLayout());
+
+	Shader viscosityFinishShader = ShaderManager::Get()->GetShaderAsset("ViscositySolve", "mainFinish");
+	_viscosityFinishPipeline = CreateComputePipeline(viscosityFinishShader->GetShaderModule(), _viscositySolveDescriptor->GetDescriptorSetLayout());
+
+	Shader measureTimeStepLimitsShader = ShaderManager::Get()->GetShaderAsset("MeasureTimeStepLimits");
+	_measureTimeStepLimitsDescriptor = CreateMeasureTimeStepLimitsDescriptors(measureTimeStepLimitsShader);
+	_measureTimeStepLimitsPipeline = CreateComputePipeline(measureTimeStepLimitsShader->GetShaderModule(), _measureTimeStepLimitsDescriptor->GetDescriptorSetLayout());
+
 	Shader timeIntegrationShader = ShaderManager::Get()->GetShaderAsset("TimeIntegration");
 	_timeIntegrationDescriptor = CreateTimeIntegrationDescriptors(timeIntegrationShader);
 	_timeIntegrationPipeline = CreateComputePipeline(timeIntegrationShader->GetShaderModule(), _timeIntegrationDescriptor->GetDescriptorSetLayout());
 
-	// Configure a push constant for prefix sum
-	_BVHStatePushConstant.offset = 0;
-	_BVHStatePushConstant.size = sizeof(uint32_t);
-	_BVHStatePushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-
-	Shader resolveCollisionShader = ShaderManager::Get()->GetShaderAsset("ResolveCollision");
-	_resolveCollisionDescriptor = CreateResolveCollisionDescriptors(resolveCollisionShader);
-	_resolveCollisionPipeline = CreateComputePipeline(resolveCollisionShader->GetShaderModule(), _resolveCollisionDescriptor->GetDescriptorSetLayout(), {_BVHStatePushConstant});
+	CreateResolveCollisionPipeline();
 
 	Shader endTimeStepShader = ShaderManager::Get()->GetShaderAsset("EndTimeStep");
 	_endTimeStepDescriptor = CreateEndTimeStepDescriptors(endTimeStepShader);
 	_endTimeStepPipeline = CreateComputePipeline(endTimeStepShader->GetShaderModule(), _endTimeStepDescriptor->GetDescriptorSetLayout());
+
+	Shader flowRemoveShader = ShaderManager::Get()->GetShaderAsset("ParticleFlow", "mainRemove");
+	_particleFlowDescriptor = CreateParticleFlowDescriptors(flowRemoveShader);
+	_flowRemovePipeline = CreateComputePipeline(flowRemoveShader->GetShaderModule(), _particleFlowDescriptor->GetDescriptorSetLayout());
+
+	Shader flowEmitShader = ShaderManager::Get()->GetShaderAsset("ParticleFlow", "mainEmit");
+	_flowEmitPipeline = CreateComputePipeline(flowEmitShader->GetShaderModule(), _particleFlowDescriptor->GetDescriptorSetLayout());
+
+	Shader flowCollectShader = ShaderManager::Get()->GetShaderAsset("ParticleFlow", "mainCollect");
+	_flowCollectPipeline = CreateComputePipeline(flowCollectShader->GetShaderModule(), _particleFlowDescriptor->GetDescriptorSetLayout());
+
+	Shader flowMoveShader = ShaderManager::Get()->GetShaderAsset("ParticleFlow", "mainMove");
+	_flowMovePipeline = CreateComputePipeline(flowMoveShader->GetShaderModule(), _particleFlowDescriptor->GetDescriptorSetLayout());
+
+	Shader flowFinishShader = ShaderManager::Get()->GetShaderAsset("ParticleFlow", "mainFinish");
+	_flowFinishPipeline = CreateComputePipeline(flowFinishShader->GetShaderModule(), _particleFlowDescriptor->GetDescriptorSetLayout());
+
+	Shader prepareDispatchShader = ShaderManager::Get()->GetShaderAsset("PrepareDispatch");
+	_prepareDispatchDescriptor = CreatePrepareDispatchDescriptors(prepareDispatchShader);
+	_prepareDispatchPipeline = CreateComputePipeline(prepareDispatchShader->GetShaderModule(), _prepareDispatchDescriptor->GetDescriptorSetLayout());
 }
 
 Descriptor SimulationCompute::CreateHashingDescriptors(const Shader &shader)
@@ -325,6 +1102,7 @@ Descriptor SimulationCompute::CreateDensityDescriptors(const Shader &shader)
 	descriptor->BindBuffer("buckets", _bucketBuffer);
 	descriptor->BindBuffer("adjacentBuckets", _adjacentBucketBuffer);
 	descriptor->BindBuffer("densities", _densityBuffer);
+	descriptor->BindBuffer("kernelTable", _kernelTableBuffer);
 
 	return descriptor;
 }
@@ -372,6 +1150,114 @@ Descriptor SimulationCompute::CreatePressureViscosityForceDescriptors(const Shad
 	descriptor->BindBuffer("densities", _densityBuffer);
 	descriptor->BindBuffer("pressures", _pressureBuffer);
 	descriptor->BindBuffer("forces", _forceBuffer);
+	descriptor->BindBuffer("kernelTable", _kernelTableBuffer);
+
+	return descriptor;
+}
+
+Descriptor SimulationCompute::CreateDFSPHFactorDescriptors(const Shader &shader)
+{
+	auto descriptor = CreateDescriptor(shader);
+
+	descriptor->BindBuffer("simulationSetup", _simulationSetupBuffer);
+	descriptor->BindBuffer("gridSetup", _gridSetupBuffer);
+	descriptor->BindBuffer("simulationParameters", _simulationParametersBuffer);
+	descriptor->BindBuffer("positions", _positionBuffer);
+	descriptor->BindBuffer("hashResults", _hashResultBuffer);
+	descriptor->BindBuffer("accumulations", _accumulationBuffer);
+	descriptor->BindBuffer("buckets", _bucketBuffer);
+	descriptor->BindBuffer("adjacentBuckets", _adjacentBucketBuffer);
+	descriptor->BindBuffer("densities", _densityBuffer);
+	descriptor->BindBuffer("dfsphFactors", _dfsphFactorBuffer);
+	descriptor->BindBuffer("kernelTable", _kernelTableBuffer);
+
+	return descriptor;
+}
+
+Descriptor SimulationCompute::CreateDFSPHSolveDescriptors(const Shader &shader, const Buffer &targetVelocityBuffer, const Buffer &warmStartStiffnessBuffer)
+{
+	auto descriptor = CreateDescriptor(shader);
+
+	descriptor->BindBuffer("simulationSetup", _simulationSetupBuffer);
+	descriptor->BindBuffer("gridSetup", _gridSetupBuffer);
+	descriptor->BindBuffer("simulationParameters", _simulationParametersBuffer);
+	descriptor->BindBuffers("timeStepState", _timeStepStateBuffers);
+	descriptor->BindBuffer("positions", _positionBuffer);
+	descriptor->BindBuffer("hashResults", _hashResultBuffer);
+	descriptor->BindBuffer("accumulations", _accumulationBuffer);
+	descriptor->BindBuffer("buckets", _bucketBuffer);
+	descriptor->BindBuffer("adjacentBuckets", _adjacentBucketBuffer);
+	descriptor->BindBuffer("densities", _densityBuffer);
+	descriptor->BindBuffer("dfsphFactors", _dfsphFactorBuffer);
+	descriptor->BindBuffer("densityErrors", _densityErrorBuffer);
+	descriptor->BindBuffer("stiffnesses", _stiffnessBuffer);
+	descriptor->BindBuffer("warmStartStiffnesses", warmStartStiffnessBuffer);
+	descriptor->BindBuffer("targetVelocities", targetVelocityBuffer);
+	descriptor->BindBuffer("nextPositions", _nextPositionBuffer);
+	descriptor->BindBuffer("kernelTable", _kernelTableBuffer);
+	descriptor->BindBuffer("solverErrors", _solverErrorBuffer);
+
+	return descriptor;
+}
+
+Descriptor SimulationCompute::CreatePBFSolveDescriptors(const Shader &shader)
+{
+	auto descriptor = CreateDescriptor(shader);
+
+	descriptor->BindBuffer("simulationSetup", _simulationSetupBuffer);
+	descriptor->BindBuffer("gridSetup", _gridSetupBuffer);
+	descriptor->BindBuffer("simulationParameters", _simulationParametersBuffer);
+	descriptor->BindBuffers("timeStepState", _timeStepStateBuffers);
+	descriptor->BindBuffer("positions", _positionBuffer);
+	descriptor->BindBuffer("hashResults", _hashResultBuffer);
+	descriptor->BindBuffer("accumulations", _accumulationBuffer);
+	descriptor->BindBuffer("buckets", _bucketBuffer);
+	descriptor->BindBuffer("adjacentBuckets", _adjacentBucketBuffer);
+	descriptor->BindBuffer("densities", _densityBuffer);
+	descriptor->BindBuffer("lambdas", _lambdaBuffer);
+	descriptor->BindBuffer("positionCorrections", _positionCorrectionBuffer);
+	descriptor->BindBuffer("nextVelocities", _nextVelocityBuffer);
+	descriptor->BindBuffer("nextPositions", _nextPositionBuffer);
+	descriptor->BindBuffer("kernelTable", _kernelTableBuffer);
+
+	return descriptor;
+}
+
+Descriptor SimulationCompute::CreateViscositySolveDescriptors(const Shader &shader)
+{
+	auto descriptor = CreateDescriptor(shader);
+
+	descriptor->BindBuffer("simulationSetup", _simulationSetupBuffer);
+	descriptor->BindBuffer("simulationParameters", _simulationParametersBuffer);
+	descriptor->BindBuffers("timeStepState", _timeStepStateBuffers);
+	descriptor->BindBuffer("positions", _positionBuffer);
+	descriptor->BindBuffer("accumulations", _accumulationBuffer);
+	descriptor->BindBuffer("buckets", _bucketBuffer);
+	descriptor->BindBuffer("adjacentBuckets", _adjacentBucketBuffer);
+	descriptor->BindBuffer("densities", _densityBuffer);
+	descriptor->BindBuffer("nextVelocities", _nextVelocityBuffer);
+	descriptor->BindBuffer("nextPositions", _nextPositionBuffer);
+	descriptor->BindBuffer("kernelTable", _kernelTableBuffer);
+	descriptor->BindBuffer("viscosityDiagonals", _viscosityDiagonalBuffer);
+	descriptor->BindBuffer("viscosityResiduals", _viscosityResidualBuffer);
+	descriptor->BindBuffer("viscosityDirections", _viscosityDirectionBuffer);
+	descriptor->BindBuffer("viscosityProducts", _viscosityProductBuffer);
+	descriptor->BindBuffer("viscosityCorrections", _viscosityCorrectionBuffer);
+	descriptor->BindBuffer("partialSums", _viscosityPartialSumBuffer);
+	descriptor->BindBuffer("viscositySolverState", _viscositySolverStateBuffer);
+
+	return descriptor;
+}
+
+Descriptor SimulationCompute::CreateMeasureTimeStepLimitsDescriptors(const Shader &shader)
+{
+	auto descriptor = CreateDescriptor(shader);
+
+	descriptor->BindBuffer("simulationSetup", _simulationSetupBuffer);
+	descriptor->BindBuffer("simulationParameters", _simulationParametersBuffer);
+	descriptor->BindBuffer("velocities", _velocityBuffer);
+	descriptor->BindBuffer("forces", _forceBuffer);
+	descriptor->BindBuffers("timeStepStatistics", _timeStepStatisticsBuffers);
 
 	return descriptor;
 }
@@ -383,6 +1269,7 @@ Descriptor SimulationCompute::CreateTimeIntegrationDescriptors(const Shader &sha
 	// Create descriptor sets
 	descriptor->BindBuffer("simulationSetup", _simulationSetupBuffer);
 	descriptor->BindBuffer("simulationParameters", _simulationParametersBuffer);
+	descriptor->BindBuffers("timeStepState", _timeStepStateBuffers);
 	descriptor->BindBuffer("positions", _positionBuffer);
 	descriptor->BindBuffer("velocities", _velocityBuffer);
 	descriptor->BindBuffer("forces", _forceBuffer);
@@ -397,8 +1284,12 @@ Descriptor SimulationCompute::CreateResolveCollisionDescriptors(const Shader &sh
 	auto descriptor = CreateDescriptor(shader);
 
 	descriptor->BindBuffer("simulationSetup", _simulationSetupBuffer);
+	descriptor->BindBuffer("gridSetup", _gridSetupBuffer);
 	descriptor->BindBuffer("simulationParameters", _simulationParametersBuffer);
+	descriptor->BindBuffer("occupancy", _occupancyBuffer);
 	descriptor->BindBuffer("nodes", _BVHNodeBuffer);
+	descriptor->BindBuffer("instances", _BVHInstanceBuffer);
+	descriptor->BindBuffer("meshNodes", _BVHMeshNodeBuffer);
 	descriptor->BindBuffer("positions", _positionBuffer);
 	descriptor->BindBuffer("velocities", _velocityBuffer);
 	descriptor->BindBuffer("nodeStack", _BVHStackBuffer);
@@ -408,6 +1299,76 @@ Descriptor SimulationCompute::CreateResolveCollisionDescriptors(const Shader &sh
 	return descriptor;
 }
 
+void SimulationCompute::CreateResolveCollisionPipeline()
+{
+	// Configure a push constant for the BVH traversal
+	_BVHStatePushConstant.offset = 0;
+	_BVHStatePushConstant.size = sizeof(uint32_t);
+	_BVHStatePushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	Shader resolveCollisionShader = ShaderManager::Get()->GetShaderAsset("ResolveCollision");
+	_resolveCollisionDescriptor = CreateResolveCollisionDescriptors(resolveCollisionShader);
+	_resolveCollisionPipeline = CreateComputePipeline(resolveCollisionShader->GetShaderModule(), _resolveCollisionDescriptor->GetDescriptorSetLayout(), { _BVHStatePushConstant });
+
+	// Configure a push constant for the SDF lookup
+	_SDFStatePushConstant.offset = 0;
+	_SDFStatePushConstant.size = sizeof(uint32_t);
+	_SDFStatePushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	Shader resolveSDFCollisionShader = ShaderManager::Get()->GetShaderAsset("ResolveSDFCollision");
+	_resolveSDFCollisionDescriptor = CreateResolveSDFCollisionDescriptors(resolveSDFCollisionShader);
+	_resolveSDFCollisionPipeline = CreateComputePipeline(resolveSDFCollisionShader->GetShaderModule(), _resolveSDFCollisionDescriptor->GetDescriptorSetLayout(), { _SDFStatePushConstant });
+}
+
+Descriptor SimulationCompute::CreateResolveSDFCollisionDescriptors(const Shader &shader)
+{
+	auto descriptor = CreateDescriptor(shader);
+
+	descriptor->BindBuffer("simulationSetup", _simulationSetupBuffer);
+	descriptor->BindBuffer("simulationParameters", _simulationParametersBuffer);
+	descriptor->BindBuffer("grids", _SDFGridBuffer);
+	descriptor->BindBuffer("instances", _SDFInstanceBuffer);
+	descriptor->BindBuffer("samples", _SDFSampleBuffer);
+	descriptor->BindBuffer("nextVelocities", _nextVelocityBuffer);
+	descriptor->BindBuffer("nextPositions", _nextPositionBuffer);
+
+	return descriptor;
+}
+
+Descriptor SimulationCompute::CreateParticleFlowDescriptors(const Shader &shader)
+{
+	auto descriptor = CreateDescriptor(shader);
+
+	descriptor->BindBuffer("simulationSetup", _simulationSetupBuffer);
+	descriptor->BindBuffers("flowSetup", _flowSetupBuffers);
+	descriptor->BindBuffers("emittedParticles", _emittedParticleBuffers);
+	descriptor->BindBuffers("sinks", _sinkBuffers);
+	descriptor->BindBuffer("flowState", _flowStateBuffer);
+	descriptor->BindBuffers("particleCountStatistics", _particleCountStatisticsBuffers);
+	descriptor->BindBuffer("aliveMask", _aliveMaskBuffer);
+	descriptor->BindBuffer("freeSlots", _freeSlotBuffer);
+	descriptor->BindBuffer("moveSources", _moveSourceBuffer);
+	descriptor->BindBuffer("moveTargets", _moveTargetBuffer);
+	descriptor->BindBuffer("positions", _positionBuffer);
+	descriptor->BindBuffer("velocities", _velocityBuffer);
+	descriptor->BindBuffer("divergenceStiffnesses", _divergenceStiffnessBuffer);
+	descriptor->BindBuffer("densityStiffnesses", _densityStiffnessBuffer);
+	descriptor->BindBuffer("viscosityCorrections", _viscosityCorrectionBuffer);
+
+	return descriptor;
+}
+
+Descriptor SimulationCompute::CreatePrepareDispatchDescriptors(const Shader &shader)
+{
+	auto descriptor = CreateDescriptor(shader);
+
+	descriptor->BindBuffer("simulationSetup", _simulationSetupBuffer);
+	descriptor->BindBuffer("gridSetup", _gridSetupBuffer);
+	descriptor->BindBuffer("particleDispatches", _particleDispatchBuffer);
+
+	return descriptor;
+}
+
 Descriptor SimulationCompute::CreateEndTimeStepDescriptors(const Shader &shader)
 {
 	auto descriptor = CreateDescriptor(shader);
@@ -422,6 +1383,7 @@ Descriptor SimulationCompute::CreateEndTimeStepDescriptors(const Shader &shader)
 	descriptor->BindBuffer("densities", _densityBuffer);
 	descriptor->BindBuffer("pressures", _pressureBuffer);
 	descriptor->BindBuffer("accumulations", _accumulationBuffer);
+	descriptor->BindBuffer("solverErrors", _solverErrorBuffer);
 
 	return descriptor;
 }
@@ -1,12 +1,17 @@
 #pragma once
 
 #include <algorithm>
+#include <bit>
 
 #include "ComputeBase.h"
 #include "Descriptor.h"
 #include "SimulationParameters.h"
 #include "MathUtil.h"
 #include "BVH.h"
+#include "SDF.h"
+#include "OccupancyGrid.h"
+#include "Kernel.h"
+#include "ParticleFlow.h"
 
 class SimulationCompute : public ComputeBase
 {
@@ -19,6 +24,7 @@ private:
 	struct GridSetup
 	{
 		// _gridSpacing is equal to 2.0f * _particleRadius * _kernelRadiusFactor
+		// w holds the bucket count padded to a power of two, over which the prefix sum runs.
 		alignas(16) glm::uvec4 _dimension{};
 	};
 
@@ -27,6 +33,50 @@ private:
 		alignas(4) uint32_t _step = 0;
 	};
 
+	struct TimeStepState
+	{
+		alignas(4) float _timeStep = 0.0f;
+	};
+
+	struct SolverState
+	{
+		alignas(4) uint32_t _iteration = 0;
+		alignas(4) uint32_t _solveMode = 0; // 0 for the divergence solve, 1 for the density solve
+	};
+
+	// Scalars of the conjugate gradient of the implicit viscosity solve, which stay on the device
+	struct ViscositySolverState
+	{
+		alignas(4) float _residualDotPreconditioned = 0.0f;
+		alignas(4) float _squaredResidualNorm = 0.0f;
+		alignas(4) float _squaredRightHandSideNorm = 0.0f;
+		alignas(4) float _stepLength = 0.0f;
+		alignas(4) float _directionScale = 0.0f;
+		alignas(4) uint32_t _isConverged = 0;
+		alignas(4) uint32_t _iterationCount = 0;
+	};
+
+	struct FlowSetup
+	{
+		alignas(4) uint32_t _emittedCount = 0;
+		alignas(4) uint32_t _sinkCount = 0;
+		alignas(4) uint32_t _particleCapacity = 0;
+	};
+
+	struct EmittedParticle
+	{
+		alignas(16) glm::vec4 _position{};
+		alignas(16) glm::vec4 _velocity{};
+	};
+
+	// Counters of the flow passes, which stay on the device
+	struct FlowState
+	{
+		alignas(4) uint32_t _removedCount = 0;
+		alignas(4) uint32_t _movedCount = 0;
+		alignas(4) uint32_t _holeCount = 0;
+	};
+
 private:
 	uint32_t _prefixSumIterCount = 0;
 	static const size_t OVERLAPPING_BUCKETS = 8;
@@ -34,16 +84,76 @@ private:
 	std::unique_ptr<SimulationSetup> _simulationSetup = std::make_unique<SimulationSetup>();
 	std::unique_ptr<GridSetup> _gridSetup = std::make_unique<GridSetup>();
 	std::unique_ptr<PrefixSumState> _prefixSumState = std::make_unique<PrefixSumState>();
+	std::unique_ptr<TimeStepState> _timeStepState = std::make_unique<TimeStepState>();
+	std::unique_ptr<SolverState> _solverState = std::make_unique<SolverState>();
+	SimulationParameters _simulationParameters{}; // Host copy for choosing time steps
 	uint32_t _BVHMaxLevel = 0;
+	uint32_t _SDFInstanceCount = 0;
+	ColliderMode _colliderMode = ColliderMode::BVH;
+	uint32_t _substepCount = 1; // Multiplies the simulated time per frame
+	uint32_t _particleCapacity = 0; // Particles that the buffers have room for; passes over particles are dispatched over all of it
 
 	// Setup buffer
 	Buffer _simulationSetupBuffer = nullptr;
 	Buffer _gridSetupBuffer = nullptr;
 	Buffer _simulationParametersBuffer = nullptr;
+	Buffer _kernelTableBuffer = nullptr;
+	std::vector<glm::vec4> _kernelTable;
+	std::vector<Buffer> _simulationParametersStagingBuffers; // Changed parameters are copied through these buffers within the compute command
+	std::vector<Buffer> _kernelTableStagingBuffers;
+	bool _isParameterUploadPending = false;
+
+	// Adaptive time stepping
+	// The statistics of a frame are read back when its slot comes around again, so the step lags behind by the frames in flight.
+	std::vector<Buffer> _timeStepStatisticsBuffers;
+	std::vector<Buffer> _timeStepStateBuffers;
+	static constexpr float MAX_TIME_STEP_GROWTH = 1.2f; // Make up for the lag by growing the step gradually
+	float _deltaSecond = 0.0f; // Wall time of the last frame, which adaptive steps cover
+	uint32_t _frameStepCount = 1; // Time steps recorded into the command buffer of this frame
+	static constexpr float MAX_FRAME_TIME = 1.0f / 30.0f; // Frames longer than this are simulated in slow motion rather than spiraling
+	static const uint32_t MAX_SUBSTEPS = 16;
+
+	// Flow
+	// Particles enter and leave once per frame, before its steps. The device keeps the count of live particles,
+	// which is read back when the slot of the frame comes around again, so the host follows it a few frames late.
+	ParticleFlow _particleFlow;
+	float _particleDistance = 0.0f; // Spacing of the initial block, at which particles are emitted
+	uint32_t _particleCount = 0; // As of the last count read back
+	std::unique_ptr<FlowSetup> _flowSetup = std::make_unique<FlowSetup>();
+	std::vector<EmittedParticle> _emittedParticles;
+	std::vector<glm::vec3> _emittedPositions;
+	std::vector<glm::vec3> _emittedVelocities;
+	std::vector<Buffer> _flowSetupBuffers;
+	std::vector<Buffer> _emittedParticleBuffers;
+	std::vector<Buffer> _sinkBuffers;
+	std::vector<Buffer> _particleCountStatisticsBuffers;
+	Buffer _flowStateBuffer = nullptr;
+	Buffer _aliveMaskBuffer = nullptr;
+	Buffer _freeSlotBuffer = nullptr;
+	Buffer _moveSourceBuffer = nullptr;
+	Buffer _moveTargetBuffer = nullptr;
+	static constexpr uint32_t MAX_EMITTED_PARTICLES = 1 << 14; // Per frame
+	static constexpr uint32_t MAX_SINKS = 16;
+
+	// Indirect dispatch
+	// Prepared on the device from the count after the flow of each frame, so the passes recorded over the particles cover the live ones
+	// without the host knowing the count. The renderers dispatch with its snapshot.
+	Buffer _particleDispatchBuffer = nullptr; // [DISPATCH_COUNT]
+	static const uint32_t PARTICLE_DISPATCH = 0; // Passes over the particles
+	static const uint32_t END_TIME_STEP_DISPATCH = 1; // Over the particles, the buckets and the errors of the solver
+	static const uint32_t DISPATCH_COUNT = 2;
+
+	// Snapshots of the positions and the particle dispatch after the last step of each frame, which the renderers of the frame read.
+	// The solver runs on the async compute queue and moves on to the next frame while they run, so each frame in flight has its own.
+	std::vector<Buffer> _positionSnapshotBuffers;
+	std::vector<Buffer> _particleDispatchSnapshotBuffers; // [1], the particle dispatch
 
 	// Hashed grid buffer
 	Buffer _hashResultBuffer = nullptr;
 	Buffer _accumulationBuffer = nullptr;
+	Buffer _occupancyBuffer = nullptr;
+	std::vector<Buffer> _occupancyStagingBuffers;
+	bool _isOccupancyUploadPending = false;
 	Buffer _bucketBuffer = nullptr;
 	Buffer _adjacentBucketBuffer = nullptr;
 
@@ -55,12 +165,38 @@ private:
 	Buffer _pressureBuffer = nullptr;
 	Buffer _nextPositionBuffer = nullptr;
 	Buffer _nextVelocityBuffer = nullptr;
+	Buffer _dfsphFactorBuffer = nullptr;
+	Buffer _densityErrorBuffer = nullptr;
+	Buffer _stiffnessBuffer = nullptr;
+	Buffer _divergenceStiffnessBuffer = nullptr; // Warm start of the divergence solve
+	Buffer _densityStiffnessBuffer = nullptr; // Warm start of the density solve
+	Buffer _solverErrorBuffer = nullptr; // Sums of the errors of each iteration of both solves
+	Buffer _lambdaBuffer = nullptr;
+	Buffer _positionCorrectionBuffer = nullptr;
+	Buffer _viscosityDiagonalBuffer = nullptr;
+	Buffer _viscosityResidualBuffer = nullptr;
+	Buffer _viscosityDirectionBuffer = nullptr;
+	Buffer _viscosityProductBuffer = nullptr;
+	Buffer _viscosityCorrectionBuffer = nullptr; // Warm start of the viscosity solve
+	Buffer _viscosityPartialSumBuffer = nullptr; // Sums of each workgroup for the dot products
+	Buffer _viscositySolverStateBuffer = nullptr;
 	Buffer _BVHStackBuffer = nullptr;
-	Buffer _BVHNodeBuffer = nullptr;
+	Buffer _BVHNodeBuffer = nullptr; // Top-level nodes
+	Buffer _BVHInstanceBuffer = nullptr;
+	Buffer _BVHMeshNodeBuffer = nullptr; // Bottom-level nodes of all meshes
+	std::vector<Buffer> _BVHNodeStagingBuffers; // Refitted nodes are copied through these buffers within the compute command
+	std::vector<Buffer> _BVHInstanceStagingBuffers;
+	Buffer _SDFGridBuffer = nullptr;
+	Buffer _SDFInstanceBuffer = nullptr;
+	Buffer _SDFSampleBuffer = nullptr;
+	std::vector<Buffer> _SDFInstanceStagingBuffers;
+	bool _isBVHNodeUploadPending = false;
 	
 	// Push constants
 	VkPushConstantRange _prefixSumStatePushConstant{};
 	VkPushConstantRange _BVHStatePushConstant{};
+	VkPushConstantRange _SDFStatePushConstant{};
+	VkPushConstantRange _solverStatePushConstant{};
 	
 	Descriptor _hashingDescriptor = nullptr;
 	Pipeline _hashingPipeline = nullptr;
@@ -85,34 +221,92 @@ private:
 	Descriptor _pressureAndViscosityDescriptor = nullptr;
 	Pipeline _pressureAndViscosityPipeline = nullptr;
 
+	Descriptor _dfsphFactorDescriptor = nullptr;
+	Pipeline _dfsphFactorPipeline = nullptr;
+
+	// The solves share the passes and differ in the velocities they correct and their warm starts
+	Descriptor _divergenceSolveDescriptor = nullptr;
+	Descriptor _densitySolveDescriptor = nullptr;
+	Pipeline _solveWarmStartPipeline = nullptr;
+	Pipeline _solvePredictPipeline = nullptr;
+	Pipeline _solveStiffnessPipeline = nullptr;
+	Pipeline _solveCorrectVelocitiesPipeline = nullptr;
+	Pipeline _solveAdvectPipeline = nullptr;
+
+	Descriptor _pbfSolveDescriptor = nullptr;
+	Pipeline _pbfLambdaPipeline = nullptr;
+	Pipeline _pbfCorrectPositionsPipeline = nullptr;
+	Pipeline _pbfApplyCorrectionsPipeline = nullptr;
+	Pipeline _pbfXSPHPipeline = nullptr;
+
+	Descriptor _viscositySolveDescriptor = nullptr;
+	Pipeline _viscosityWarmStartPipeline = nullptr;
+	Pipeline _viscosityInitialResidualPipeline = nullptr;
+	Pipeline _viscosityReduceInitialResidualPipeline = nullptr;
+	Pipeline _viscosityProductPipeline = nullptr;
+	Pipeline _viscosityReduceStepLengthPipeline = nullptr;
+	Pipeline _viscosityUpdatePipeline = nullptr;
+	Pipeline _viscosityReduceDirectionScalePipeline = nullptr;
+	Pipeline _viscosityDirectionPipeline = nullptr;
+	Pipeline _viscosityFinishPipeline = nullptr;
+
+	Descriptor _measureTimeStepLimitsDescriptor = nullptr;
+	Pipeline _measureTimeStepLimitsPipeline = nullptr;
+
 	Descriptor _timeIntegrationDescriptor = nullptr;
 	Pipeline _timeIntegrationPipeline = nullptr;
 
 	Descriptor _resolveCollisionDescriptor = nullptr;
 	Pipeline _resolveCollisionPipeline = nullptr;
 
+	Descriptor _resolveSDFCollisionDescriptor = nullptr;
+	Pipeline _resolveSDFCollisionPipeline = nullptr;
+
 	Descriptor _endTimeStepDescriptor = nullptr;
 	Pipeline _endTimeStepPipeline = nullptr;
 
+	Descriptor _particleFlowDescriptor = nullptr;
+	Pipeline _flowRemovePipeline = nullptr;
+	Pipeline _flowEmitPipeline = nullptr;
+	Pipeline _flowCollectPipeline = nullptr;
+	Pipeline _flowMovePipeline = nullptr;
+	Pipeline _flowFinishPipeline = nullptr;
+
+	Descriptor _prepareDispatchDescriptor = nullptr;
+	Pipeline _prepareDispatchPipeline = nullptr;
+
 public:
 	SimulationCompute(glm::uvec3 gridDimension);
 	virtual void Register() override;
 	virtual ~SimulationCompute();
 
 	void UpdateSimulationParameters(const SimulationParameters &simulationParameters);
-	void InitializeLevel(const std::vector<BVH::Node> &BVHNodes);
-	void InitializeParticles(const std::vector<glm::vec3> &positions);
+	void InitializeGrid(glm::uvec3 gridDimension, const OccupancyGrid &occupancyGrid);
+	void InitializeLevel(const BVH &bvh, const SDF &sdf, const OccupancyGrid &occupancyGrid);
+	void UpdateLevel(const BVH &bvh, const SDF &sdf, const OccupancyGrid &occupancyGrid, bool isRebuilt);
+	void SetColliderMode(ColliderMode colliderMode);
+	void SetSubstepCount(uint32_t substepCount);
+	void SetDeltaSecond(float deltaSecond) { _deltaSecond = deltaSecond; } // Every frame before recording
+	void InitializeParticles(const std::vector<glm::vec3> &positions, size_t particleCapacity);
+	void UpdateParticleFlow(const ParticleFlow &particleFlow, float particleDistance);
 
-	auto GetPositionInputBuffer() { return _positionBuffer; }
+	const auto &GetPositionSnapshotBuffers() { return _positionSnapshotBuffers; }
+	const auto &GetParticleDispatchSnapshotBuffers() { return _particleDispatchSnapshotBuffers; }
+	uint32_t GetParticleCount() const { return _particleCount; }
 
 protected:
 	virtual void RecordCommand(VkCommandBuffer computeCommandBuffer, size_t currentFrame) override;
+	virtual void RecordAcquireCommand(VkCommandBuffer computeCommandBuffer, size_t currentFrame) override;
 
 private:
 	void CreateSetupBuffers();
 	void CreateGridBuffers(glm::uvec3 gridDimension);
-	void CreateLevelBuffers(const std::vector<BVH::Node> &BVHNodes);
+	void CreateLevelBuffers(const BVH &bvh, const SDF &sdf);
+	void CreateBVHStackBuffer(uint32_t particleCount, uint32_t BVHMaxLevel);
 	void CreateSimulationBuffers(uint32_t particleCount, uint32_t BVHMaxLevel);
+	void CreateFlowBuffers(uint32_t particleCapacity);
+	void CreateSnapshotBuffers(uint32_t particleCapacity);
+	void Upload(const Buffer &buffer, const void *source, VkDeviceSize copySize = VK_WHOLE_SIZE);
 
 	void CreatePipelines(uint32_t particleCount, glm::uvec3 bucketDimension);
 
@@ -123,8 +317,27 @@ private:
 	Descriptor CreateExternalForcesDescriptors(const Shader &shader);
 	Descriptor CreateComputePressureDescriptors(const Shader &shader);
 	Descriptor CreatePressureViscosityForceDescriptors(const Shader &shader);
+	Descriptor CreateDFSPHFactorDescriptors(const Shader &shader);
+	Descriptor CreateDFSPHSolveDescriptors(const Shader &shader, const Buffer &targetVelocityBuffer, const Buffer &warmStartStiffnessBuffer);
+	Descriptor CreatePBFSolveDescriptors(const Shader &shader);
+	Descriptor CreateViscositySolveDescriptors(const Shader &shader);
+	Descriptor CreateMeasureTimeStepLimitsDescriptors(const Shader &shader);
 	Descriptor CreateTimeIntegrationDescriptors(const Shader &shader);
+	void UpdateTimeStep(size_t currentFrame);
+	void UpdateFlow(size_t currentFrame);
+	void RecordFlow(VkCommandBuffer computeCommandBuffer, size_t currentFrame);
+	void DispatchParticles(VkCommandBuffer computeCommandBuffer, uint32_t dispatchIndex = PARTICLE_DISPATCH);
+	void RecordTimeStep(VkCommandBuffer computeCommandBuffer, size_t currentFrame);
+	void RecordPressureSolve(VkCommandBuffer computeCommandBuffer, size_t currentFrame, uint32_t solveMode);
+	void RecordConstraintProjection(VkCommandBuffer computeCommandBuffer, size_t currentFrame);
+	void RecordViscositySolve(VkCommandBuffer computeCommandBuffer, size_t currentFrame);
+	void RecordSnapshot(VkCommandBuffer computeCommandBuffer, size_t currentFrame);
+	std::vector<VkBufferMemoryBarrier> CreateSnapshotOwnershipBarriers(size_t currentFrame, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask);
 	Descriptor CreateResolveCollisionDescriptors(const Shader &shader);
+	Descriptor CreateResolveSDFCollisionDescriptors(const Shader &shader);
+	void CreateResolveCollisionPipeline();
 	Descriptor CreateEndTimeStepDescriptors(const Shader &shader);
+	Descriptor CreateParticleFlowDescriptors(const Shader &shader);
+	Descriptor CreatePrepareDispatchDescriptors(const Shader &shader);
 
 };
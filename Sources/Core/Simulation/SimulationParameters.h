@@ -1,5 +1,31 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// How pressure keeps the fluid from compressing
+enum class PressureSolver : uint32_t
+{
+	EOS, // Weakly compressible; the pressure follows from the density by the equation of state
+	DFSPH, // Divergence-free SPH; the pressure is solved for so that the density stays at rest and the velocity field divergence-free
+	PBF // Position based fluids; predicted positions are projected onto density constraints
+};
+
+// How velocities move between particles and the grid of the hybrid engine
+enum class GridTransfer : uint32_t
+{
+	FLIP, // Particles take the change of the grid velocity, blended with the grid velocity itself by _flipRatio
+	APIC // Particles take the grid velocity and its local affine part
+};
+
+// How viscosity is applied to the particle solvers
+enum class ViscositySolver : uint32_t
+{
+	Explicit, // A force from the velocities at the start of the step, which bounds the time step by the viscosity condition
+	Implicit // The velocities after the step are solved for, which is stable for any time step
+};
+
 struct SimulationParameters
 {
 	alignas(4) float _particleRadius = 0.03f;
@@ -18,6 +44,72 @@ struct SimulationParameters
 	alignas(4) float _viscosityCoefficient = 0.005f;
 	alignas(4) float _restitutionCoefficient = 0.5f;
 	alignas(4) float _frictionCoefficient = 0.1f;
+
+	alignas(4) uint32_t _isTimeStepAdaptive = 1; // If set, _timeStep is the largest step taken
+	alignas(4) float _courantFactor = 0.4f;
+
+	alignas(4) uint32_t _pressureSolver = static_cast<uint32_t>(PressureSolver::EOS);
+	alignas(4) uint32_t _maxSolverIterations = 50; // Cap on the iterations of each solve of an iterative pressure solver
+	alignas(4) float _maxDensityError = 0.001f; // Average density error relative to the target density at which a density solve stops
+	alignas(4) float _maxDivergenceError = 0.01f; // Average density change per second relative to the target density at which a divergence solve stops
+
+	alignas(4) uint32_t _constraintIterations = 4; // Projections of the density constraints per step of position based fluids
+	alignas(4) float _constraintRelaxation = 10.0f; // Added to the denominator of each constraint to soften it where neighbors are few
+	alignas(4) float _xsphCoefficient = 0.01f; // Blend of the velocity of each particle toward those of its neighbors, in place of viscosity
+
+	alignas(4) uint32_t _gridTransfer = static_cast<uint32_t>(GridTransfer::FLIP);
+	alignas(4) float _flipRatio = 0.95f; // Share of FLIP in the FLIP/PIC blend; lower values damp the noise of FLIP
+
+	alignas(4) uint32_t _viscositySolver = static_cast<uint32_t>(ViscositySolver::Explicit);
+	alignas(4) float _viscosityTolerance = 0.01f; // Residual relative to the right-hand side at which an implicit viscosity solve stops; it also takes at most _maxSolverIterations
+
+	alignas(4) uint32_t _isSleepingEnabled = 0; // If set, particles in regions at rest are frozen until disturbed
+	alignas(4) float _sleepEnergyThreshold = 1e-4f; // Kinetic energy per unit mass below which a particle is at rest
+	alignas(4) float _sleepDensityThreshold = 0.001f; // Density drift relative to the target density below which a particle is at rest
+	alignas(4) uint32_t _sleepSteps = 30; // Steps a region stays at rest before it falls asleep
+
+	alignas(4) uint32_t _isResolutionAdaptive = 0; // If set, particles merge in the bulk of the fluid and split again near its surface and the colliders
+	alignas(4) uint32_t _maxResolutionLevel = 3; // Merges that a particle can be made of; a particle of level k has 2^k times _particleMass
+	alignas(4) float _splitDensityRatio = 0.9f; // Density relative to the target density below which a merged particle splits, as it does at the surface
+	alignas(4) float _mergeDensityRatio = 0.98f; // Density relative to the target density above which particles may merge
 };
 
+// Bounds of the iterations of an iterative pressure solver
+// Must be kept identical to the constants of the same names in SimulationModule.slang
+static const uint32_t MIN_SOLVER_ITERATIONS = 2;
+static const uint32_t MAX_SOLVER_ITERATIONS = 100;
 
+// Cap on _maxResolutionLevel; merged particles reach at most twice the base radius
+static const uint32_t MAX_RESOLUTION_LEVEL = 3;
+
+constexpr float MIN_TIME_STEP = 1e-5f;
+
+// Largest stable time step for the fastest particle and the largest acceleration
+// It is bounded by the CFL condition with the speed of sound, the force condition and the viscosity condition (Monaghan, 1992).
+// Incompressible solvers do not propagate pressure at the speed of sound, so only the particles themselves bound their CFL condition.
+// Implicit viscosity is unconditionally stable, which lifts the viscosity condition.
+inline float ComputeAdaptiveTimeStep(const SimulationParameters &simulationParameters, float maxSpeed, float maxAcceleration)
+{
+	if (!simulationParameters._isTimeStepAdaptive) return simulationParameters._timeStep;
+
+	constexpr float FORCE_FACTOR = 0.25f;
+	constexpr float VISCOSITY_FACTOR = 0.125f;
+
+	float kernelRadius = simulationParameters._particleRadius * simulationParameters._kernelRadiusFactor;
+
+	float signalSpeed = (simulationParameters._pressureSolver == static_cast<uint32_t>(PressureSolver::EOS)) ? simulationParameters._soundSpeed : 0.0f;
+	float timeStep = simulationParameters._timeStep;
+	if (signalSpeed + maxSpeed > 0.0f) timeStep = std::min(timeStep, simulationParameters._courantFactor * kernelRadius / (signalSpeed + maxSpeed));
+	if (maxAcceleration > 0.0f) timeStep = std::min(timeStep, FORCE_FACTOR * std::sqrt(kernelRadius / maxAcceleration));
+	bool isViscosityExplicit = (simulationParameters._viscositySolver == static_cast<uint32_t>(ViscositySolver::Explicit));
+	if (isViscosityExplicit && simulationParameters._viscosityCoefficient > 0.0f) timeStep = std::min(timeStep, VISCOSITY_FACTOR * kernelRadius * kernelRadius / simulationParameters._viscosityCoefficient);
+
+	return std::max(timeStep, MIN_TIME_STEP);
+}
+
+// Clamp a step to the time left in the frame.
+// A tail shorter than the minimum step is taken in by this step rather than left over, since a step that short would divide by nearly zero in the incompressible solvers.
+inline float ClampToRemainingTime(float timeStep, float remainingTime)
+{
+	return (remainingTime - timeStep < MIN_TIME_STEP) ? remainingTime : timeStep;
+}
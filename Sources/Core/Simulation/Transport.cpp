@@ -0,0 +1,354 @@
+#include "Transport.h"
+
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <random>
+
+#ifdef _WIN32
+#include <afunix.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+std::unique_ptr<Transport> CreateTransport(TransportType transportType, const std::string &name, uint32_t rank, uint32_t rankCount)
+{
+	switch (transportType)
+	{
+	case TransportType::Socket:
+		return std::make_unique<SocketTransport>(name, rank, rankCount);
+	case TransportType::SharedMemory:
+		return std::make_unique<SharedMemoryTransport>(name, rank, rankCount);
+	default:
+		throw std::runtime_error("Unknown transport type.");
+	}
+}
+
+SocketTransport::SocketTransport(const std::string &name, uint32_t rank, uint32_t rankCount) : Transport(rank, rankCount)
+{
+#ifdef _WIN32
+	WSADATA data{};
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0) throw std::runtime_error("Failed to initialize Winsock.");
+#endif
+
+	// Start listening before connecting, so that ranks can start in any order
+	SocketHandle listenSocket = INVALID_SOCKET_HANDLE;
+	if (HasUpperPeer())
+	{
+		_listenPath = GetSocketPath(name, rank);
+		std::filesystem::remove(_listenPath);
+
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		std::string pathString = _listenPath.string();
+		if (pathString.size() >= sizeof(address.sun_path)) throw std::runtime_error("Socket path is too long.");
+		std::memcpy(address.sun_path, pathString.c_str(), pathString.size() + 1);
+
+		listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listenSocket == INVALID_SOCKET_HANDLE) throw std::runtime_error("Failed to create a socket.");
+		if (bind(listenSocket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) throw std::runtime_error("Failed to bind a socket.");
+		if (listen(listenSocket, 1) != 0) throw std::runtime_error("Failed to listen on a socket.");
+	}
+
+	if (HasLowerPeer())
+	{
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		std::string pathString = GetSocketPath(name, rank - 1).string();
+		if (pathString.size() >= sizeof(address.sun_path)) throw std::runtime_error("Socket path is too long.");
+		std::memcpy(address.sun_path, pathString.c_str(), pathString.size() + 1);
+
+		for (uint32_t retry = 0; retry < CONNECT_RETRY_COUNT && _lowerSocket == INVALID_SOCKET_HANDLE; ++retry)
+		{
+			SocketHandle connectSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (connectSocket == INVALID_SOCKET_HANDLE) throw std::runtime_error("Failed to create a socket.");
+
+			if (connect(connectSocket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0)
+			{
+				_lowerSocket = connectSocket;
+			}
+			else
+			{
+				CloseSocket(connectSocket);
+				std::this_thread::sleep_for(std::chrono::milliseconds(CONNECT_RETRY_MILLISECONDS));
+			}
+		}
+
+		if (_lowerSocket == INVALID_SOCKET_HANDLE) throw std::runtime_error("Failed to connect to the lower rank.");
+	}
+
+	if (HasUpperPeer())
+	{
+		_upperSocket = accept(listenSocket, nullptr, nullptr);
+		CloseSocket(listenSocket);
+		if (_upperSocket == INVALID_SOCKET_HANDLE) throw std::runtime_error("Failed to accept the upper rank.");
+	}
+}
+
+SocketTransport::~SocketTransport()
+{
+	CloseSocket(_lowerSocket);
+	CloseSocket(_upperSocket);
+	if (!_listenPath.empty())
+	{
+		std::error_code error;
+		std::filesystem::remove(_listenPath, error);
+	}
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+void SocketTransport::Send(uint32_t peer, const std::vector<std::byte> &message)
+{
+	SocketHandle peerSocket = GetPeerSocket(peer);
+
+	uint64_t size = message.size();
+	SendAll(peerSocket, &size, sizeof(size));
+	SendAll(peerSocket, message.data(), message.size());
+}
+
+std::vector<std::byte> SocketTransport::Receive(uint32_t peer)
+{
+	SocketHandle peerSocket = GetPeerSocket(peer);
+
+	uint64_t size = 0;
+	ReceiveAll(peerSocket, &size, sizeof(size));
+
+	std::vector<std::byte> message(size);
+	ReceiveAll(peerSocket, message.data(), message.size());
+	return message;
+}
+
+std::filesystem::path SocketTransport::GetSocketPath(const std::string &name, uint32_t rank)
+{
+	return std::filesystem::temp_directory_path() / (name + "-" + std::to_string(rank) + ".sock");
+}
+
+SocketTransport::SocketHandle SocketTransport::GetPeerSocket(uint32_t peer) const
+{
+	if (peer + 1 == _rank) return _lowerSocket;
+	if (peer == _rank + 1) return _upperSocket;
+
+	throw std::runtime_error("Only adjacent ranks are connected.");
+}
+
+void SocketTransport::SendAll(SocketHandle socketHandle, const void *data, size_t size)
+{
+	const char *bytes = static_cast<const char *>(data);
+	while (size > 0)
+	{
+		int chunkSize = static_cast<int>(std::min<size_t>(size, 1 << 30));
+		auto sentSize = send(socketHandle, bytes, chunkSize, 0);
+		if (sentSize <= 0) throw std::runtime_error("Failed to send to a peer.");
+
+		bytes += sentSize;
+		size -= static_cast<size_t>(sentSize);
+	}
+}
+
+void SocketTransport::ReceiveAll(SocketHandle socketHandle, void *data, size_t size)
+{
+	char *bytes = static_cast<char *>(data);
+	while (size > 0)
+	{
+		int chunkSize = static_cast<int>(std::min<size_t>(size, 1 << 30));
+		auto receivedSize = recv(socketHandle, bytes, chunkSize, 0);
+		if (receivedSize <= 0) throw std::runtime_error("Failed to receive from a peer.");
+
+		bytes += receivedSize;
+		size -= static_cast<size_t>(receivedSize);
+	}
+}
+
+void SocketTransport::CloseSocket(SocketHandle socketHandle)
+{
+	if (socketHandle == INVALID_SOCKET_HANDLE) return;
+
+#ifdef _WIN32
+	closesocket(socketHandle);
+#else
+	close(socketHandle);
+#endif
+}
+
+SharedMemoryTransport::SharedMemoryTransport(const std::string &name, uint32_t rank, uint32_t rankCount) : Transport(rank, rankCount)
+{
+	// Both ends open each mailbox, which may be left over from an earlier run that did not shut down, and reset it with a handshake.
+	// The upper rank of a pair connects to its incoming mailbox first and the lower rank to its outgoing one,
+	// so each handshake waits only on a rank that has finished the handshakes with its own lower peer.
+	// The sender owns the outgoing mailbox and removes its name on destruction.
+	if (HasLowerPeer())
+	{
+		_outgoing[0] = OpenSegment(GetSegmentName(name, rank, rank - 1));
+		_incoming[0] = OpenSegment(GetSegmentName(name, rank - 1, rank));
+		ConnectAsReceiver(_incoming[0]._mailbox);
+		ConnectAsSender(_outgoing[0]._mailbox);
+	}
+	if (HasUpperPeer())
+	{
+		_outgoing[1] = OpenSegment(GetSegmentName(name, rank, rank + 1));
+		_incoming[1] = OpenSegment(GetSegmentName(name, rank + 1, rank));
+		ConnectAsSender(_outgoing[1]._mailbox);
+		ConnectAsReceiver(_incoming[1]._mailbox);
+	}
+}
+
+SharedMemoryTransport::~SharedMemoryTransport()
+{
+	for (size_t side = 0; side < 2; ++side)
+	{
+		CloseSegment(_outgoing[side], true);
+		CloseSegment(_incoming[side], false);
+	}
+}
+
+void SharedMemoryTransport::Send(uint32_t peer, const std::vector<std::byte> &message)
+{
+	Mailbox *mailbox = _outgoing[GetPeerSide(peer)]._mailbox;
+
+	// An empty message still passes a chunk, so that the receiver knows it has arrived
+	size_t offset = 0;
+	do
+	{
+		// Wait until the receiver has taken the previous chunk
+		uint64_t sentCount = mailbox->_sentCount.load(std::memory_order_relaxed);
+		while (mailbox->_takenCount.load(std::memory_order_acquire) != sentCount) std::this_thread::yield();
+
+		size_t chunkSize = std::min(message.size() - offset, SLOT_SIZE);
+		mailbox->_messageSize = message.size();
+		mailbox->_chunkSize = chunkSize;
+		if (chunkSize > 0) std::memcpy(mailbox->_data, message.data() + offset, chunkSize);
+		offset += chunkSize;
+
+		mailbox->_sentCount.store(sentCount + 1, std::memory_order_release);
+	} while (offset < message.size());
+}
+
+std::vector<std::byte> SharedMemoryTransport::Receive(uint32_t peer)
+{
+	Mailbox *mailbox = _incoming[GetPeerSide(peer)]._mailbox;
+
+	std::vector<std::byte> message;
+	size_t offset = 0;
+	do
+	{
+		uint64_t takenCount = mailbox->_takenCount.load(std::memory_order_relaxed);
+		while (mailbox->_sentCount.load(std::memory_order_acquire) == takenCount) std::this_thread::yield();
+
+		if (offset == 0) message.resize(mailbox->_messageSize);
+		size_t chunkSize = mailbox->_chunkSize;
+		if (chunkSize > 0) std::memcpy(message.data() + offset, mailbox->_data, chunkSize);
+		offset += chunkSize;
+
+		mailbox->_takenCount.store(takenCount + 1, std::memory_order_release);
+	} while (offset < message.size());
+
+	return message;
+}
+
+std::string SharedMemoryTransport::GetSegmentName(const std::string &name, uint32_t from, uint32_t to)
+{
+#ifdef _WIN32
+	return "Local\\" + name + "-" + std::to_string(from) + "-" + std::to_string(to);
+#else
+	return "/" + name + "-" + std::to_string(from) + "-" + std::to_string(to);
+#endif
+}
+
+SharedMemoryTransport::Segment SharedMemoryTransport::OpenSegment(const std::string &segmentName)
+{
+	Segment segment{ ._name = segmentName };
+
+#ifdef _WIN32
+	segment._mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(sizeof(Mailbox)), segmentName.c_str());
+	if (segment._mapping == nullptr) throw std::runtime_error("Failed to create a shared memory segment.");
+
+	void *pointer = MapViewOfFile(segment._mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Mailbox));
+	if (pointer == nullptr) throw std::runtime_error("Failed to map a shared memory segment.");
+#else
+	int descriptor = shm_open(segmentName.c_str(), O_CREAT | O_RDWR, 0600);
+	if (descriptor < 0) throw std::runtime_error("Failed to open a shared memory segment.");
+
+	// Both ends may size the segment; the size is the same, so the order does not matter
+	if (ftruncate(descriptor, sizeof(Mailbox)) != 0)
+	{
+		close(descriptor);
+		throw std::runtime_error("Failed to size a shared memory segment.");
+	}
+
+	void *pointer = mmap(nullptr, sizeof(Mailbox), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+	close(descriptor);
+	if (pointer == MAP_FAILED) throw std::runtime_error("Failed to map a shared memory segment.");
+#endif
+
+	segment._mailbox = static_cast<Mailbox *>(pointer);
+	return segment;
+}
+
+void SharedMemoryTransport::CloseSegment(Segment &segment, bool isOwner)
+{
+	if (segment._mailbox == nullptr) return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(segment._mailbox);
+	CloseHandle(segment._mapping);
+#else
+	munmap(segment._mailbox, sizeof(Mailbox));
+	if (isOwner) shm_unlink(segment._name.c_str());
+#endif
+
+	segment._mailbox = nullptr;
+}
+
+// Publish a nonce and wait for the receiver to echo it, which it can do only once it is running.
+// Then reset the counters, and echo the nonce of the receiver to let it go on.
+void SharedMemoryTransport::ConnectAsSender(Mailbox *mailbox)
+{
+	uint64_t nonce = CreateNonce();
+	mailbox->_senderNonce.store(nonce, std::memory_order_release);
+	while (mailbox->_receiverEcho.load(std::memory_order_acquire) != nonce) std::this_thread::yield();
+
+	mailbox->_sentCount.store(0, std::memory_order_relaxed);
+	mailbox->_takenCount.store(0, std::memory_order_relaxed);
+	mailbox->_senderEcho.store(mailbox->_receiverNonce.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+// Keep echoing whatever nonce the sender has published, stale or not, until the sender echoes the nonce of this run back
+void SharedMemoryTransport::ConnectAsReceiver(Mailbox *mailbox)
+{
+	uint64_t nonce = CreateNonce();
+	mailbox->_receiverNonce.store(nonce, std::memory_order_release);
+	while (mailbox->_senderEcho.load(std::memory_order_acquire) != nonce)
+	{
+		mailbox->_receiverEcho.store(mailbox->_senderNonce.load(std::memory_order_acquire), std::memory_order_release);
+		std::this_thread::yield();
+	}
+}
+
+// Nonzero, since a new segment starts zeroed
+uint64_t SharedMemoryTransport::CreateNonce()
+{
+	std::random_device randomDevice;
+	uint64_t nonce = 0;
+	while (nonce == 0)
+	{
+		uint64_t time = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+		nonce = ((static_cast<uint64_t>(randomDevice()) << 32) | randomDevice()) ^ time;
+	}
+
+	return nonce;
+}
+
+size_t SharedMemoryTransport::GetPeerSide(uint32_t peer) const
+{
+	if (peer + 1 == _rank) return 0;
+	if (peer == _rank + 1) return 1;
+
+	throw std::runtime_error("Only adjacent ranks are connected.");
+}
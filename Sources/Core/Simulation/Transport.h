@@ -0,0 +1,196 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <stdexcept>
+#include <filesystem>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <WinSock2.h>
+#else
+#include <sys/socket.h>
+#endif
+
+enum class TransportType
+{
+	Socket, // Unix domain sockets
+	SharedMemory // Mailboxes in named shared memory
+};
+
+// Messages between the processes of a distributed run on the same host.
+// Only adjacent ranks talk to each other, and the messages between a pair of ranks arrive in the order they have been sent.
+// Send may block until the peer receives, so two ranks must not send to each other at the same time; use Exchange for that.
+class Transport
+{
+protected:
+	uint32_t _rank = 0;
+	uint32_t _rankCount = 1;
+
+public:
+	Transport(uint32_t rank, uint32_t rankCount) : _rank(rank), _rankCount(rankCount) {}
+	Transport(const Transport &other) = delete;
+	Transport &operator=(const Transport &other) = delete;
+	virtual ~Transport() = default;
+
+	virtual void Send(uint32_t peer, const std::vector<std::byte> &message) = 0;
+	virtual std::vector<std::byte> Receive(uint32_t peer) = 0;
+
+	// Swap messages with a peer; the lower rank sends first
+	std::vector<std::byte> Exchange(uint32_t peer, const std::vector<std::byte> &message)
+	{
+		if (_rank < peer)
+		{
+			Send(peer, message);
+			return Receive(peer);
+		}
+		else
+		{
+			std::vector<std::byte> received = Receive(peer);
+			Send(peer, message);
+			return received;
+		}
+	}
+
+	uint32_t GetRank() const { return _rank; }
+	uint32_t GetRankCount() const { return _rankCount; }
+	bool HasLowerPeer() const { return _rank > 0; }
+	bool HasUpperPeer() const { return _rank + 1 < _rankCount; }
+};
+
+// All ranks of a run pass the same name, which keys the sockets or the shared memory segments
+std::unique_ptr<Transport> CreateTransport(TransportType transportType, const std::string &name, uint32_t rank, uint32_t rankCount);
+
+// One stream connection to each adjacent rank.
+// Each rank listens for its upper peer and connects to its lower peer, retrying until the peer has started listening.
+class SocketTransport : public Transport
+{
+private:
+#ifdef _WIN32
+	using SocketHandle = SOCKET;
+	static constexpr SocketHandle INVALID_SOCKET_HANDLE = INVALID_SOCKET;
+#else
+	using SocketHandle = int;
+	static constexpr SocketHandle INVALID_SOCKET_HANDLE = -1;
+#endif
+
+	SocketHandle _lowerSocket = INVALID_SOCKET_HANDLE;
+	SocketHandle _upperSocket = INVALID_SOCKET_HANDLE;
+	std::filesystem::path _listenPath;
+
+	static const uint32_t CONNECT_RETRY_COUNT = 600;
+	static const uint32_t CONNECT_RETRY_MILLISECONDS = 100;
+
+public:
+	SocketTransport(const std::string &name, uint32_t rank, uint32_t rankCount);
+	virtual ~SocketTransport();
+
+	virtual void Send(uint32_t peer, const std::vector<std::byte> &message) override;
+	virtual std::vector<std::byte> Receive(uint32_t peer) override;
+
+private:
+	static std::filesystem::path GetSocketPath(const std::string &name, uint32_t rank);
+	SocketHandle GetPeerSocket(uint32_t peer) const;
+	static void SendAll(SocketHandle socketHandle, const void *data, size_t size);
+	static void ReceiveAll(SocketHandle socketHandle, void *data, size_t size);
+	static void CloseSocket(SocketHandle socketHandle);
+};
+
+// A single-slot mailbox for each direction between adjacent ranks.
+// Messages larger than a slot are passed in chunks; the sender waits for each chunk to be taken before writing the next one.
+class SharedMemoryTransport : public Transport
+{
+private:
+	static const size_t SLOT_SIZE = 1 << 20;
+
+	struct Mailbox
+	{
+		// A segment left behind by an earlier run keeps its counters, so both ends agree on a reset before the first message.
+		// Each end proves that the other is of this run by echoing its nonce back.
+		std::atomic<uint64_t> _senderNonce;
+		std::atomic<uint64_t> _receiverNonce;
+		std::atomic<uint64_t> _senderEcho; // Nonce of the receiver, written by the sender once it has reset the counters
+		std::atomic<uint64_t> _receiverEcho; // Nonce of the sender as the receiver has last seen it
+
+		std::atomic<uint64_t> _sentCount; // Chunks written by the sender
+		std::atomic<uint64_t> _takenCount; // Chunks consumed by the receiver
+		uint64_t _messageSize; // Size of the whole message the chunk belongs to
+		uint64_t _chunkSize;
+		std::byte _data[SLOT_SIZE];
+	};
+
+	struct Segment
+	{
+		std::string _name;
+		Mailbox *_mailbox = nullptr;
+#ifdef _WIN32
+		HANDLE _mapping = nullptr;
+#endif
+	};
+
+	// Indexed by whether the peer is the upper one
+	Segment _outgoing[2];
+	Segment _incoming[2];
+
+public:
+	SharedMemoryTransport(const std::string &name, uint32_t rank, uint32_t rankCount);
+	virtual ~SharedMemoryTransport();
+
+	virtual void Send(uint32_t peer, const std::vector<std::byte> &message) override;
+	virtual std::vector<std::byte> Receive(uint32_t peer) override;
+
+private:
+	static std::string GetSegmentName(const std::string &name, uint32_t from, uint32_t to);
+	static Segment OpenSegment(const std::string &segmentName);
+	static void CloseSegment(Segment &segment, bool isOwner);
+	static void ConnectAsSender(Mailbox *mailbox);
+	static void ConnectAsReceiver(Mailbox *mailbox);
+	static uint64_t CreateNonce();
+	size_t GetPeerSide(uint32_t peer) const;
+};
+
+// Serialization of plain values into messages
+class MessageWriter
+{
+private:
+	std::vector<std::byte> _message;
+
+public:
+	template<typename T>
+	void Write(const T &value)
+	{
+		size_t offset = _message.size();
+		_message.resize(offset + sizeof(T));
+		std::memcpy(_message.data() + offset, &value, sizeof(T));
+	}
+
+	std::vector<std::byte> &GetBytes() { return _message; }
+};
+
+class MessageReader
+{
+private:
+	const std::vector<std::byte> &_message;
+	size_t _offset = 0;
+
+public:
+	MessageReader(const std::vector<std::byte> &message) : _message(message) {}
+
+	template<typename T>
+	T Read()
+	{
+		if (_offset + sizeof(T) > _message.size()) throw std::runtime_error("Read past the end of a message.");
+
+		T value;
+		std::memcpy(&value, _message.data() + _offset, sizeof(T));
+		_offset += sizeof(T);
+		return value;
+	}
+};
@@ -16,4 +16,6 @@ private:
 public:
 	RenderingPanel(const std::shared_ptr<SimulatedSceneBase> &simulatedScene) : _simulatedScene(simulatedScene) {}
 	virtual void Draw() override;
+
+	void SetSimulatedScene(const std::shared_ptr<SimulatedSceneBase> &simulatedScene) { _simulatedScene = simulatedScene; }
 };
\ No newline at end of file
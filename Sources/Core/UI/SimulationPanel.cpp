@@ -1,7 +1,12 @@
 #include "SimulationPanel.h"
 
+const std::string SimulationPanel::BVH_COLLIDER = "BVH";
+const std::string SimulationPanel::SDF_COLLIDER = "Signed Distance Field";
+
+// Start from the parameters the scene has been set up with, such as those given on the command line
 SimulationPanel::SimulationPanel(const std::shared_ptr<SimulatedSceneBase> &simulatedScene) :
-	_simulatedScene(simulatedScene)
+	_simulatedScene(simulatedScene),
+	_simulationParameters(std::make_shared<SimulationParameters>(simulatedScene->GetSimulationParameters()))
 {
 	_simulatedScene->UpdateSimulationParameters(*_simulationParameters);
 }
@@ -10,8 +15,38 @@ void SimulationPanel::Draw()
 {
 	ImGui::Begin("Simulation");
 
+	// The new scene starts empty, so the simulation is started again after switching
+	std::vector<std::string> engineNames = SimulatedSceneRegistry::GetEngineNames();
+	if (ImGui::BeginCombo("Engine", _simulatedScene->GetEngineName().data()))
+	{
+		for (const auto &engineName : engineNames)
+		{
+			bool isSelected = (_simulatedScene->GetEngineName() == engineName);
+
+			if (ImGui::Selectable(engineName.data(), isSelected) && !isSelected)
+			{
+				_onSelectEngine.Invoke(engineName);
+			}
+
+			if (isSelected)
+			{
+				ImGui::SetItemDefaultFocus();
+			}
+		}
+
+		ImGui::EndCombo();
+	}
+
 	bool parametersUpdated = false;
 	parametersUpdated |= ImGui::SliderFloat("Time Step", &_simulationParameters->_timeStep, 0.001f, 0.1f);
+
+	bool isTimeStepAdaptive = _simulationParameters->_isTimeStepAdaptive;
+	if (ImGui::Checkbox("Adaptive Time Step", &isTimeStepAdaptive))
+	{
+		_simulationParameters->_isTimeStepAdaptive = isTimeStepAdaptive;
+		parametersUpdated = true;
+	}
+	parametersUpdated |= ImGui::SliderFloat("Courant Factor", &_simulationParameters->_courantFactor, 0.05f, 1.0f);
 	parametersUpdated |= ImGui::SliderFloat("Particle Mass", &_simulationParameters->_particleMass, 0.001f, 1.0f);
 	parametersUpdated |= ImGui::SliderFloat("Target Density", &_simulationParameters->_targetDensity, 1.0f, 1000.0f);
 	parametersUpdated |= ImGui::SliderFloat("Sound Speed", &_simulationParameters->_soundSpeed, 0.1f, 10.0f);
@@ -22,6 +57,85 @@ void SimulationPanel::Draw()
 	parametersUpdated |= ImGui::SliderFloat("Restitution Coefficient", &_simulationParameters->_restitutionCoefficient, 0.1f, 1.0f);
 	parametersUpdated |= ImGui::SliderFloat("Friction Coefficient", &_simulationParameters->_frictionCoefficient, 0.0f, 1.0f);
 
+	const char *viscositySolvers[] = { "Explicit", "Implicit" };
+	int viscositySolver = static_cast<int>(_simulationParameters->_viscositySolver);
+	if (ImGui::Combo("Viscosity Solver", &viscositySolver, viscositySolvers, IM_ARRAYSIZE(viscositySolvers)))
+	{
+		_simulationParameters->_viscositySolver = static_cast<uint32_t>(viscositySolver);
+		parametersUpdated = true;
+	}
+	parametersUpdated |= ImGui::SliderFloat("Viscosity Tolerance", &_simulationParameters->_viscosityTolerance, 0.0001f, 0.1f, "%.4f");
+
+	// CPU engine with the equation of state only
+	bool isSleepingEnabled = _simulationParameters->_isSleepingEnabled;
+	if (ImGui::Checkbox("Particle Sleeping", &isSleepingEnabled))
+	{
+		_simulationParameters->_isSleepingEnabled = isSleepingEnabled;
+		parametersUpdated = true;
+	}
+	parametersUpdated |= ImGui::SliderFloat("Sleep Energy Threshold", &_simulationParameters->_sleepEnergyThreshold, 0.0f, 0.01f, "%.6f");
+	parametersUpdated |= ImGui::SliderFloat("Sleep Density Threshold", &_simulationParameters->_sleepDensityThreshold, 0.0f, 0.1f, "%.5f");
+	int sleepSteps = static_cast<int>(_simulationParameters->_sleepSteps);
+	if (ImGui::SliderInt("Sleep Steps", &sleepSteps, 1, 200))
+	{
+		_simulationParameters->_sleepSteps = static_cast<uint32_t>(sleepSteps);
+		parametersUpdated = true;
+	}
+
+	// CPU engine with the equation of state only
+	bool isResolutionAdaptive = _simulationParameters->_isResolutionAdaptive;
+	if (ImGui::Checkbox("Adaptive Resolution", &isResolutionAdaptive))
+	{
+		_simulationParameters->_isResolutionAdaptive = isResolutionAdaptive;
+		parametersUpdated = true;
+	}
+	int maxResolutionLevel = static_cast<int>(_simulationParameters->_maxResolutionLevel);
+	if (ImGui::SliderInt("Max Resolution Level", &maxResolutionLevel, 0, MAX_RESOLUTION_LEVEL))
+	{
+		_simulationParameters->_maxResolutionLevel = static_cast<uint32_t>(maxResolutionLevel);
+		parametersUpdated = true;
+	}
+	parametersUpdated |= ImGui::SliderFloat("Split Density Ratio", &_simulationParameters->_splitDensityRatio, 0.5f, 1.0f);
+	parametersUpdated |= ImGui::SliderFloat("Merge Density Ratio", &_simulationParameters->_mergeDensityRatio, 0.5f, 1.2f);
+
+	const char *pressureSolvers[] = { "Equation of State", "DFSPH", "Position Based Fluids" };
+	int pressureSolver = static_cast<int>(_simulationParameters->_pressureSolver);
+	if (ImGui::Combo("Pressure Solver", &pressureSolver, pressureSolvers, IM_ARRAYSIZE(pressureSolvers)))
+	{
+		_simulationParameters->_pressureSolver = static_cast<uint32_t>(pressureSolver);
+		parametersUpdated = true;
+	}
+
+	// Iterative solvers only
+	int maxSolverIterations = static_cast<int>(_simulationParameters->_maxSolverIterations);
+	if (ImGui::SliderInt("Max Solver Iterations", &maxSolverIterations, MIN_SOLVER_ITERATIONS, MAX_SOLVER_ITERATIONS))
+	{
+		_simulationParameters->_maxSolverIterations = static_cast<uint32_t>(maxSolverIterations);
+		parametersUpdated = true;
+	}
+	parametersUpdated |= ImGui::SliderFloat("Max Density Error", &_simulationParameters->_maxDensityError, 0.0001f, 0.01f, "%.4f");
+	parametersUpdated |= ImGui::SliderFloat("Max Divergence Error", &_simulationParameters->_maxDivergenceError, 0.001f, 0.1f);
+
+	// Position based fluids only
+	int constraintIterations = static_cast<int>(_simulationParameters->_constraintIterations);
+	if (ImGui::SliderInt("Constraint Iterations", &constraintIterations, 1, 20))
+	{
+		_simulationParameters->_constraintIterations = static_cast<uint32_t>(constraintIterations);
+		parametersUpdated = true;
+	}
+	parametersUpdated |= ImGui::SliderFloat("Constraint Relaxation", &_simulationParameters->_constraintRelaxation, 0.1f, 100.0f);
+	parametersUpdated |= ImGui::SliderFloat("XSPH Coefficient", &_simulationParameters->_xsphCoefficient, 0.0f, 0.1f);
+
+	// Hybrid engine only
+	const char *gridTransfers[] = { "FLIP", "APIC" };
+	int gridTransfer = static_cast<int>(_simulationParameters->_gridTransfer);
+	if (ImGui::Combo("Grid Transfer", &gridTransfer, gridTransfers, IM_ARRAYSIZE(gridTransfers)))
+	{
+		_simulationParameters->_gridTransfer = static_cast<uint32_t>(gridTransfer);
+		parametersUpdated = true;
+	}
+	parametersUpdated |= ImGui::SliderFloat("FLIP Ratio", &_simulationParameters->_flipRatio, 0.0f, 1.0f);
+
 	if (ImGui::Button("Reset Simulation Parameters"))
 	{
 		_simulationParameters = std::make_shared<SimulationParameters>();
@@ -30,6 +144,76 @@ void SimulationPanel::Draw()
 
 	if (parametersUpdated) _simulatedScene->UpdateSimulationParameters(*_simulationParameters);
 
+	std::vector<std::string> colliders = { BVH_COLLIDER, SDF_COLLIDER };
+	std::string currentCollider = (_simulatedScene->GetColliderMode() == ColliderMode::SDF) ? SDF_COLLIDER : BVH_COLLIDER;
+	if (ImGui::BeginCombo("Collider", currentCollider.data()))
+	{
+		for (const auto &collider : colliders)
+		{
+			bool isSelected = (currentCollider == collider);
+
+			if (ImGui::Selectable(collider.data(), isSelected))
+			{
+				currentCollider = collider;
+				_simulatedScene->SetColliderMode(currentCollider == SDF_COLLIDER ? ColliderMode::SDF : ColliderMode::BVH);
+			}
+
+			if (isSelected)
+			{
+				ImGui::SetItemDefaultFocus();
+			}
+		}
+
+		ImGui::EndCombo();
+	}
+
+	int substepCount = static_cast<int>(_simulatedScene->GetSubstepCount());
+	if (ImGui::SliderInt("Substeps per Frame", &substepCount, 1, 32))
+	{
+		_simulatedScene->SetSubstepCount(static_cast<uint32_t>(substepCount));
+	}
+
+	// The panel is not drawn until presentation resumes, so the application returns from this mode with the escape key.
+	if (ImGui::Button("Simulate Only (Esc to Return)"))
+	{
+		_simulatedScene->SetSimulateOnly(true);
+	}
+
+	// Host solver only; switching back and forth compares the schedulers on the same scene
+	if (auto cpuSimulatedScene = std::dynamic_pointer_cast<CPUSimulatedScene>(_simulatedScene))
+	{
+		bool isTaskGraph = (cpuSimulatedScene->GetSolverScheduler() == SolverScheduler::TaskGraph);
+		if (ImGui::Checkbox("Task Graph Scheduler", &isTaskGraph))
+		{
+			cpuSimulatedScene->SetSolverScheduler(isTaskGraph ? SolverScheduler::TaskGraph : SolverScheduler::OpenMP);
+		}
+		// Placement is applied when the simulation is started
+		bool isNUMAAware = cpuSimulatedScene->IsNUMAAware();
+		if (ImGui::Checkbox("NUMA-Aware Placement", &isNUMAAware)) cpuSimulatedScene->SetNUMAAware(isNUMAAware);
+		bool isHugePagesEnabled = IsHugePagesEnabled();
+		if (ImGui::Checkbox("Huge Pages", &isHugePagesEnabled)) SetHugePagesEnabled(isHugePagesEnabled);
+
+		ImGui::Text("Step Time (OpenMP): %.2f ms", cpuSimulatedScene->GetAverageStepTime(SolverScheduler::OpenMP));
+		ImGui::Text("Step Time (Task Graph): %.2f ms", cpuSimulatedScene->GetAverageStepTime(SolverScheduler::TaskGraph));
+	}
+
+	SolverStatistics solverStatistics = _simulatedScene->GetSolverStatistics();
+	ImGui::Text("Particles: %zu", solverStatistics._particleCount);
+	if (solverStatistics._averageStepTime > 0.0f) ImGui::Text("Step Time: %.2f ms", solverStatistics._averageStepTime);
+	if (solverStatistics._divergenceIterations > 0 || solverStatistics._densityIterations > 0)
+	{
+		ImGui::Text("Solver Iterations (Divergence / Density): %u / %u", solverStatistics._divergenceIterations, solverStatistics._densityIterations);
+	}
+	if (solverStatistics._viscosityIterations > 0) ImGui::Text("Viscosity Iterations: %u", solverStatistics._viscosityIterations);
+	if (solverStatistics._sleepingParticleCount > 0) ImGui::Text("Sleeping Particles: %zu", solverStatistics._sleepingParticleCount);
+	if (solverStatistics._mergedParticleCount > 0) ImGui::Text("Merged Particles: %zu", solverStatistics._mergedParticleCount);
+
+	if (auto gridStatistics = _simulatedScene->GetGridStatistics())
+	{
+		ImGui::Text("Max Bucket Size: %zu", gridStatistics->_maxBucketSize);
+		ImGui::Text("False Neighbor Rate: %.2f%%", gridStatistics->GetFalseNeighborRate() * 100.0f);
+	}
+
 	if (ImGui::Button("Start Simulation"))
 	{
 		// These tasks should be executed only after the command has been submitted and finished,
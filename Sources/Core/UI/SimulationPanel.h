@@ -4,14 +4,24 @@
 
 #include "PanelBase.h"
 #include "CPUSimulatedScene.h"
+#include "SimulatedSceneRegistry.h"
 
 class SimulationPanel : public PanelBase
 {
 private:
+	static const std::string BVH_COLLIDER;
+	static const std::string SDF_COLLIDER;
+
 	std::shared_ptr<SimulatedSceneBase> _simulatedScene;
-	std::shared_ptr<SimulationParameters> _simulationParameters = std::make_shared<SimulationParameters>();
+	std::shared_ptr<SimulationParameters> _simulationParameters = nullptr;
+
+	// The owner of the scene replaces it with an instance of the selected engine
+	Delegate<void(const std::string &)> _onSelectEngine;
 
 public:
 	SimulationPanel(const std::shared_ptr<SimulatedSceneBase> &simulatedScene);
 	virtual void Draw() override;
+
+	void SetSimulatedScene(const std::shared_ptr<SimulatedSceneBase> &simulatedScene) { _simulatedScene = simulatedScene; }
+	auto &OnSelectEngine() { return _onSelectEngine; }
 };
\ No newline at end of file
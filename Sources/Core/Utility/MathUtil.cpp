@@ -28,3 +28,12 @@ int RoundUp(int num, int multiple)
 		return ((num + multiple - 1) / multiple) * multiple;
 	}
 }
+
+// Map a point of a moving body in the world space to its velocity, given the transforms of the body before and after elapsedSecond.
+// The point is carried back to where it was by the previous transform, so (modelToWorld * previousWorldToModel - I) * p is its displacement.
+glm::mat4 GetVelocityTransform(const glm::mat4 &previousWorldToModel, const glm::mat4 &modelToWorld, float elapsedSecond)
+{
+	if (elapsedSecond <= 0.0f) return glm::mat4(0.0f);
+
+	return (modelToWorld * previousWorldToModel - glm::mat4(1.0f)) / elapsedSecond;
+}
@@ -13,6 +13,7 @@
 uint32_t Log(uint32_t n);
 float GetRandomValue(float lowerBound, float upperBound);
 int RoundUp(int num, int multiple);
+glm::mat4 GetVelocityTransform(const glm::mat4 &previousWorldToModel, const glm::mat4 &modelToWorld, float elapsedSecond);
 
 template <typename T>
 void Shuffle(const T &iter1, const T &iter2)
@@ -0,0 +1,126 @@
+#include "NUMAUtil.h"
+
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+	std::atomic<bool> isHugePagesEnabled = false;
+
+	const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+}
+
+void SetHugePagesEnabled(bool isEnabled)
+{
+	isHugePagesEnabled.store(isEnabled);
+}
+
+bool IsHugePagesEnabled()
+{
+	return isHugePagesEnabled.load();
+}
+
+#ifdef _WIN32
+void *AllocatePages(size_t size)
+{
+	if (size == 0) size = 1;
+
+	// Large pages need the lock-pages privilege; fall back to regular pages without it
+	if (isHugePagesEnabled.load())
+	{
+		size_t largePageMinimum = GetLargePageMinimum();
+		if (largePageMinimum > 0)
+		{
+			size_t largeSize = (size + largePageMinimum - 1) / largePageMinimum * largePageMinimum;
+			void *pointer = VirtualAlloc(nullptr, largeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if (pointer != nullptr) return pointer;
+		}
+	}
+
+	// Committed pages get their physical memory on the first write
+	return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void FreePages(void *pointer, size_t size)
+{
+	if (pointer != nullptr) VirtualFree(pointer, 0, MEM_RELEASE);
+}
+
+bool PinThread(uint32_t processorIndex)
+{
+	// Find the group of the processor
+	WORD groupCount = GetActiveProcessorGroupCount();
+	DWORD processorCount = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+	if (processorCount == 0) return false;
+
+	processorIndex %= processorCount;
+	for (WORD group = 0; group < groupCount; ++group)
+	{
+		DWORD groupProcessorCount = GetActiveProcessorCount(group);
+		if (processorIndex < groupProcessorCount)
+		{
+			GROUP_AFFINITY affinity{};
+			affinity.Group = group;
+			affinity.Mask = KAFFINITY(1) << processorIndex;
+			return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+		}
+
+		processorIndex -= groupProcessorCount;
+	}
+
+	return false;
+}
+#else
+// The length depends only on the size, so that FreePages unmaps exactly what has been mapped.
+// Large arrays are mapped in whole huge pages whether or not huge pages are requested.
+static size_t GetMappedSize(size_t size)
+{
+	return size >= HUGE_PAGE_SIZE ? (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE : std::max<size_t>(size, 1);
+}
+
+void *AllocatePages(size_t size)
+{
+	size_t mappedSize = GetMappedSize(size);
+
+	void *pointer = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pointer == MAP_FAILED) return nullptr;
+
+	if (isHugePagesEnabled.load() && mappedSize >= HUGE_PAGE_SIZE) madvise(pointer, mappedSize, MADV_HUGEPAGE);
+	return pointer;
+}
+
+void FreePages(void *pointer, size_t size)
+{
+	if (pointer != nullptr) munmap(pointer, GetMappedSize(size));
+}
+
+bool PinThread(uint32_t processorIndex)
+{
+	uint32_t processorCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	cpu_set_t processorSet;
+	CPU_ZERO(&processorSet);
+	CPU_SET(processorIndex % processorCount, &processorSet);
+	return pthread_setaffinity_np(pthread_self(), sizeof(processorSet), &processorSet) == 0;
+}
+#endif
+
+void PinTeamThreads()
+{
+	#pragma omp parallel
+	{
+		PinThread(static_cast<uint32_t>(omp_get_thread_num()));
+	}
+}
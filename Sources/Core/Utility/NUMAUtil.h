@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <algorithm>
+
+#include <omp.h>
+
+// Page placement and thread affinity for multi-socket machines.
+// Operating systems place a page on the node of the thread that first writes to it, so arrays
+// allocated here are left untouched until the threads that will work on them initialize them.
+
+void *AllocatePages(size_t size);
+void FreePages(void *pointer, size_t size);
+
+// Request huge pages for the allocations that follow; best effort, since the system may refuse them
+void SetHugePagesEnabled(bool isEnabled);
+bool IsHugePagesEnabled();
+
+// Pin the calling thread to a logical processor, wrapping around the processors of all groups
+bool PinThread(uint32_t processorIndex);
+
+// Pin every thread of the OpenMP team of the calling thread to the processor of its thread number.
+// Teams are pinned in the same way, so the same thread number of any team lands on the same node.
+void PinTeamThreads();
+
+// Allocator whose default construction leaves the elements uninitialized, so that no page is touched on allocation
+template<typename T>
+class FirstTouchAllocator
+{
+public:
+	using value_type = T;
+
+	FirstTouchAllocator() = default;
+	template<typename U> FirstTouchAllocator(const FirstTouchAllocator<U> &other) {}
+
+	T *allocate(size_t count)
+	{
+		void *pointer = AllocatePages(count * sizeof(T));
+		if (pointer == nullptr) throw std::bad_alloc();
+
+		return static_cast<T *>(pointer);
+	}
+	void deallocate(T *pointer, size_t count) { FreePages(pointer, count * sizeof(T)); }
+
+	template<typename U>
+	void construct(U *pointer) { ::new (static_cast<void *>(pointer)) U; }
+	template<typename U, typename... TArgs>
+	void construct(U *pointer, TArgs &&...args) { ::new (static_cast<void *>(pointer)) U(std::forward<TArgs>(args)...); }
+
+	template<typename U> bool operator==(const FirstTouchAllocator<U> &other) const { return true; }
+};
+
+template<typename T>
+using FirstTouchVector = std::vector<T, FirstTouchAllocator<T>>;
+
+// Size the array without touching it, then write the value from the team that will process it.
+// The static schedule hands each thread the same contiguous range as the solver loops, which use the default static schedule.
+template<typename T>
+void FirstTouchResize(FirstTouchVector<T> &array, size_t count, const T &value)
+{
+	array = FirstTouchVector<T>(count);
+
+	int64_t signedCount = static_cast<int64_t>(count);
+	#pragma omp parallel for schedule(static)
+	for (int64_t i = 0; i < signedCount; ++i)
+	{
+		array[i] = value;
+	}
+}
+
+// Make room for the count without leaving the placement of FirstTouchResize.
+// A vector that outgrows its capacity copies itself from the calling thread alone, which moves all of its pages to one node,
+// so the array is moved into a larger allocation instead, copied and touched by the team with the schedule of the solver loops.
+// Growing within the capacity afterward writes to pages that are already placed.
+template<typename T>
+void FirstTouchReserve(FirstTouchVector<T> &array, size_t count)
+{
+	if (count <= array.capacity()) return;
+
+	size_t capacity = std::max(count, array.capacity() + array.capacity() / 2);
+	FirstTouchVector<T> grown(capacity);
+
+	int64_t signedSize = static_cast<int64_t>(array.size());
+	int64_t signedCount = static_cast<int64_t>(count);
+	int64_t signedCapacity = static_cast<int64_t>(capacity);
+	#pragma omp parallel for schedule(static)
+	for (int64_t i = 0; i < signedCount; ++i)
+	{
+		grown[i] = (i < signedSize) ? array[i] : T{};
+	}
+
+	// Spread the headroom over the team as well
+	#pragma omp parallel for schedule(static)
+	for (int64_t i = signedCount; i < signedCapacity; ++i)
+	{
+		grown[i] = T{};
+	}
+
+	grown.resize(array.size());
+	array = std::move(grown);
+}
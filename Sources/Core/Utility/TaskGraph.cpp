@@ -0,0 +1,169 @@
+#include "TaskGraph.h"
+
+TaskGraph::TaskID TaskGraph::AddTask(std::function<void()> work, const std::vector<TaskID> &dependencies)
+{
+	TaskID taskID = static_cast<TaskID>(_tasks.size());
+	for (TaskID dependency : dependencies)
+	{
+		_tasks[dependency]._successors.push_back(taskID);
+	}
+
+	_tasks.emplace_back
+	(
+		Task
+		{
+			._work = std::move(work),
+			._successors = {},
+			._dependencyCount = static_cast<uint32_t>(dependencies.size())
+		}
+	);
+	return taskID;
+}
+
+TaskScheduler::TaskScheduler(uint32_t threadCount)
+{
+	threadCount = std::max(threadCount, 1u);
+	for (uint32_t workerIndex = 0; workerIndex < threadCount; ++workerIndex)
+	{
+		_workers.emplace_back(std::make_unique<Worker>());
+	}
+
+	// The caller of Run serves as the last worker
+	for (uint32_t workerIndex = 0; workerIndex + 1 < threadCount; ++workerIndex)
+	{
+		_threads.emplace_back([this, workerIndex]() { WorkerLoop(workerIndex); });
+	}
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(_wakeMutex);
+		_isStopping = true;
+	}
+	_wakeCondition.notify_all();
+
+	_threads.clear(); // Join the workers
+}
+
+void TaskScheduler::Run(TaskGraph &graph)
+{
+	size_t taskCount = graph._tasks.size();
+	if (taskCount == 0) return;
+
+	_graph = &graph;
+	if (_pendingCapacity < taskCount)
+	{
+		_pendingDependencies = std::make_unique<std::atomic<uint32_t>[]>(taskCount);
+		_pendingCapacity = taskCount;
+	}
+
+	for (size_t taskID = 0; taskID < taskCount; ++taskID)
+	{
+		_pendingDependencies[taskID].store(graph._tasks[taskID]._dependencyCount, std::memory_order_relaxed);
+	}
+	_remainingCount.store(taskCount, std::memory_order_release);
+
+	// Deal out the tasks that are ready from the start
+	uint32_t workerIndex = 0;
+	for (size_t taskID = 0; taskID < taskCount; ++taskID)
+	{
+		if (graph._tasks[taskID]._dependencyCount > 0) continue;
+
+		Push(workerIndex, static_cast<TaskGraph::TaskID>(taskID));
+		workerIndex = (workerIndex + 1) % GetWorkerCount();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_wakeMutex);
+		++_runCount;
+	}
+	_wakeCondition.notify_all();
+
+	Execute(GetWorkerCount() - 1);
+	_graph = nullptr;
+}
+
+void TaskScheduler::WorkerLoop(uint32_t workerIndex)
+{
+	uint64_t lastRun = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_wakeMutex);
+			_wakeCondition.wait(lock, [&]() { return _isStopping || _runCount != lastRun; });
+			if (_isStopping) return;
+
+			lastRun = _runCount;
+		}
+
+		Execute(workerIndex);
+	}
+}
+
+// Keep taking tasks until every task of the run has finished
+void TaskScheduler::Execute(uint32_t workerIndex)
+{
+	while (_remainingCount.load(std::memory_order_acquire) > 0)
+	{
+		TaskGraph::TaskID taskID = 0;
+		if (Pop(workerIndex, &taskID) || Steal(workerIndex, &taskID))
+		{
+			RunTask(workerIndex, taskID);
+		}
+		else
+		{
+			std::this_thread::yield(); // Other workers are still busy with tasks that will release more
+		}
+	}
+}
+
+void TaskScheduler::RunTask(uint32_t workerIndex, TaskGraph::TaskID taskID)
+{
+	const auto &task = _graph->_tasks[taskID];
+	if (task._work) task._work();
+
+	for (TaskGraph::TaskID successor : task._successors)
+	{
+		if (_pendingDependencies[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) Push(workerIndex, successor);
+	}
+
+	// Nothing of the graph may be touched after this, since the run can end with it.
+	_remainingCount.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void TaskScheduler::Push(uint32_t workerIndex, TaskGraph::TaskID taskID)
+{
+	Worker &worker = *_workers[workerIndex];
+	std::lock_guard<std::mutex> lock(worker._mutex);
+	worker._tasks.push_back(taskID);
+}
+
+bool TaskScheduler::Pop(uint32_t workerIndex, TaskGraph::TaskID *taskID)
+{
+	Worker &worker = *_workers[workerIndex];
+	std::lock_guard<std::mutex> lock(worker._mutex);
+	if (worker._tasks.empty()) return false;
+
+	*taskID = worker._tasks.back();
+	worker._tasks.pop_back();
+	return true;
+}
+
+// Visit the other workers starting from the next one, so thieves spread over victims
+bool TaskScheduler::Steal(uint32_t workerIndex, TaskGraph::TaskID *taskID)
+{
+	uint32_t workerCount = GetWorkerCount();
+	for (uint32_t offset = 1; offset < workerCount; ++offset)
+	{
+		Worker &victim = *_workers[(workerIndex + offset) % workerCount];
+		std::lock_guard<std::mutex> lock(victim._mutex);
+		if (victim._tasks.empty()) continue;
+
+		*taskID = victim._tasks.front();
+		victim._tasks.pop_front();
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+// Tasks with data dependencies between them.
+// A task becomes ready once all the tasks it depends on have finished, so tasks are added after their dependencies.
+class TaskGraph
+{
+	friend class TaskScheduler;
+
+public:
+	using TaskID = uint32_t;
+
+private:
+	struct Task
+	{
+		std::function<void()> _work; // May be empty for a task that only joins others
+		std::vector<TaskID> _successors;
+		uint32_t _dependencyCount = 0;
+	};
+
+	std::vector<Task> _tasks;
+
+public:
+	TaskID AddTask(std::function<void()> work, const std::vector<TaskID> &dependencies = {});
+	void Clear() { _tasks.clear(); }
+	size_t GetTaskCount() const { return _tasks.size(); }
+};
+
+// Work-stealing executor of task graphs.
+// Each worker pops the newest task from its own deque and steals the oldest one from the others when it runs out.
+// Tasks released by a finished task are pushed to the deque of the worker that finished it,
+// so a chain of tasks over the same data tends to stay on the same core.
+class TaskScheduler
+{
+private:
+	struct Worker
+	{
+		std::deque<TaskGraph::TaskID> _tasks;
+		std::mutex _mutex;
+	};
+
+	std::vector<std::unique_ptr<Worker>> _workers; // The last worker is the thread that calls Run
+	std::vector<std::jthread> _threads;
+
+	// State of the run in progress
+	TaskGraph *_graph = nullptr;
+	std::unique_ptr<std::atomic<uint32_t>[]> _pendingDependencies;
+	size_t _pendingCapacity = 0;
+	std::atomic<size_t> _remainingCount{ 0 };
+
+	// Workers sleep between runs
+	std::mutex _wakeMutex;
+	std::condition_variable _wakeCondition;
+	uint64_t _runCount = 0;
+	bool _isStopping = false;
+
+public:
+	TaskScheduler(uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1u));
+	TaskScheduler(const TaskScheduler &other) = delete;
+	TaskScheduler &operator=(const TaskScheduler &other) = delete;
+	~TaskScheduler();
+
+	// Execute all tasks of the graph and return when they have finished; the calling thread takes part as well.
+	void Run(TaskGraph &graph);
+	uint32_t GetWorkerCount() const { return static_cast<uint32_t>(_workers.size()); }
+
+private:
+	void WorkerLoop(uint32_t workerIndex);
+	void Execute(uint32_t workerIndex);
+	void RunTask(uint32_t workerIndex, TaskGraph::TaskID taskID);
+
+	void Push(uint32_t workerIndex, TaskGraph::TaskID taskID);
+	bool Pop(uint32_t workerIndex, TaskGraph::TaskID *taskID);
+	bool Steal(uint32_t workerIndex, TaskGraph::TaskID *taskID);
+};
@@ -19,7 +19,7 @@ void VulkanCore::InitVulkan(GLFWwindow *window)
 
 	_surface = CreateSurface(_instance, _window); // Must be created right after the instance
 	_physicalDevice = SelectPhysicalDevice(_instance, _surface, DEVICE_EXTENSIONS);
-	std::tie(_logicalDevice, _graphicsQueue, _computeQueue, _presentQueue) = CreateLogicalDevice(_physicalDevice, _surface, ENABLE_VALIDATION_LAYERS, VALIDATION_LAYERS, DEVICE_EXTENSIONS);
+	std::tie(_logicalDevice, _graphicsQueue, _computeQueue, _asyncComputeQueue, _presentQueue) = CreateLogicalDevice(_physicalDevice, _surface, ENABLE_VALIDATION_LAYERS, VALIDATION_LAYERS, DEVICE_EXTENSIONS);
 
 	std::tie(_swapChain, _swapChainImages, _swapChainImageFormat, _swapChainExtent) = CreateSwapChain(_physicalDevice, _logicalDevice, _surface, _window);
 	_renderPass = CreateRenderPass(_swapChainImageFormat);
@@ -31,36 +31,83 @@ void VulkanCore::InitVulkan(GLFWwindow *window)
 	QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(_physicalDevice, _surface);
 	_computeCommandPool = CreateCommandPool(_logicalDevice, queueFamilyIndices.computeFamily.value());
 	_computeCommandBuffers = CreateCommandBuffers(_logicalDevice, _computeCommandPool, MAX_FRAMES_IN_FLIGHT);
+	if (HasAsyncComputeQueue())
+	{
+		_asyncComputeCommandPool = CreateCommandPool(_logicalDevice, queueFamilyIndices.asyncComputeFamily.value());
+		_asyncComputeCommandBuffers = CreateCommandBuffers(_logicalDevice, _asyncComputeCommandPool, MAX_FRAMES_IN_FLIGHT);
+	}
 	_graphicsCommandPool = CreateCommandPool(_logicalDevice, queueFamilyIndices.graphicsFamily.value());
 	_commandBuffers = CreateCommandBuffers(_logicalDevice, _graphicsCommandPool, MAX_FRAMES_IN_FLIGHT);
-	std::tie(_imageAvailableSemaphores, _renderFinishedSemaphores, _computeFinishedSemaphores, _inFlightFences, _computeInFlightFences) = CreateSyncObjects(MAX_FRAMES_IN_FLIGHT);
+	std::tie(_imageAvailableSemaphores, _renderFinishedSemaphores, _computeFinishedSemaphores, _asyncComputeFinishedSemaphores, _inFlightFences, _computeInFlightFences, _asyncComputeInFlightFences) = CreateSyncObjects(MAX_FRAMES_IN_FLIGHT);
 }
 
 void VulkanCore::UpdateFrame(float deltaSecond)
 {
 	// CPU side
+	// The host writes the buffers of the slot, so every queue that last used the slot must be done with them.
+	std::array<VkFence, 3> slotFences = { _inFlightFences[_currentFrame], _computeInFlightFences[_currentFrame], _asyncComputeInFlightFences[_currentFrame] };
+	vkWaitForFences(_logicalDevice, static_cast<uint32_t>(slotFences.size()), slotFences.data(), VK_TRUE, UINT64_MAX);
+
 	_onExecuteHost.Invoke(deltaSecond, _currentFrame);
 
 	// GPU side
 	std::vector<VkSemaphore> waitSemaphores = { _imageAvailableSemaphores[_currentFrame] };
+	bool isPresenting = _isPresentationEnabled && _onRecordDrawCommand.GetListenerCount() > 0;
+
+	// Without an async compute queue, the async compute commands are recorded with the compute commands
+	bool isAsyncComputing = HasAsyncComputeQueue() && _onRecordAsyncComputeCommand.GetListenerCount() > 0;
+	bool isComputing = _onRecordComputeCommand.GetListenerCount() > 0 || (!HasAsyncComputeQueue() && _onRecordAsyncComputeCommand.GetListenerCount() > 0);
+
+	// Submit async compute commands
+	// They only wait on the async compute commands of the last frame, so they run alongside the compute and draw commands of the last frame.
+	if (isAsyncComputing)
+	{
+		// The compute commands that last used the slot read the results that are about to be rewritten
+		std::array<VkFence, 2> fences = { _asyncComputeInFlightFences[_currentFrame], _computeInFlightFences[_currentFrame] };
+		vkWaitForFences(_logicalDevice, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX);
+		vkResetFences(_logicalDevice, 1, &_asyncComputeInFlightFences[_currentFrame]);
+
+		vkResetCommandBuffer(_asyncComputeCommandBuffers[_currentFrame], 0);
+		RecordComputeCommandBuffer(_asyncComputeCommandBuffers[_currentFrame], _currentFrame, true);
+
+		VkSubmitInfo asyncComputeSubmitInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+
+			.commandBufferCount = 1,
+			.pCommandBuffers = &_asyncComputeCommandBuffers[_currentFrame],
+
+			.signalSemaphoreCount = isComputing ? 1u : 0u, // Nobody would wait on the semaphore otherwise
+			.pSignalSemaphores = &_asyncComputeFinishedSemaphores[_currentFrame]
+		};
+
+		if (vkQueueSubmit(_asyncComputeQueue, 1, &asyncComputeSubmitInfo, _asyncComputeInFlightFences[_currentFrame]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit an async compute command buffer.");
+		}
+	}
 
 	// Submit compute commands
-	if (_onRecordComputeCommand.GetListenerCount() > 0)
+	if (isComputing)
 	{
 		vkWaitForFences(_logicalDevice, 1, &_computeInFlightFences[_currentFrame], VK_TRUE, UINT64_MAX);
 		vkResetFences(_logicalDevice, 1, &_computeInFlightFences[_currentFrame]);
 
 		vkResetCommandBuffer(_computeCommandBuffers[_currentFrame], 0);
-		RecordComputeCommandBuffer(_computeCommandBuffers[_currentFrame], _currentFrame);
+		RecordComputeCommandBuffer(_computeCommandBuffers[_currentFrame], _currentFrame, false);
 
+		VkPipelineStageFlags computeWaitStage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT; // Dispatches may be sized by the async compute commands
 		VkSubmitInfo computeSubmitInfo
 		{
 			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.waitSemaphoreCount = isAsyncComputing ? 1u : 0u,
+			.pWaitSemaphores = &_asyncComputeFinishedSemaphores[_currentFrame],
+			.pWaitDstStageMask = &computeWaitStage,
 
 			.commandBufferCount = 1,
 			.pCommandBuffers = &_computeCommandBuffers[_currentFrame],
 
-			.signalSemaphoreCount = 1,
+			.signalSemaphoreCount = isPresenting ? 1u : 0u, // Nobody would wait on the semaphore otherwise
 			.pSignalSemaphores = &_computeFinishedSemaphores[_currentFrame]
 		};
 
@@ -72,7 +119,7 @@ void VulkanCore::UpdateFrame(float deltaSecond)
 		waitSemaphores.push_back(_computeFinishedSemaphores[_currentFrame]);
 	}
 
-	if (_onRecordDrawCommand.GetListenerCount() > 0)
+	if (isPresenting)
 	{
 		// Submit draw commands
 		vkWaitForFences(_logicalDevice, 1, &_inFlightFences[_currentFrame], VK_TRUE, UINT64_MAX); // Wait until the previous frame has finished
@@ -147,7 +194,13 @@ void VulkanCore::UpdateFrame(float deltaSecond)
 
 	// Proceed to the next frame
 	_currentFrame = (_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
-	WaitIdle();
+
+	// Without the draw submission, deferred tasks run once the compute work has finished.
+	if (!isPresenting)
+	{
+		_onSubmitGraphicsQueueFinishedOneShot.Invoke();
+		_onSubmitGraphicsQueueFinishedOneShot.Clear();
+	}
 }
 
 void VulkanCore::SetUpScene()
@@ -248,11 +301,14 @@ void VulkanCore::CleanUp()
 		vkDestroySemaphore(_logicalDevice, _imageAvailableSemaphores[i], nullptr);
 		vkDestroySemaphore(_logicalDevice, _renderFinishedSemaphores[i], nullptr);
 		vkDestroySemaphore(_logicalDevice, _computeFinishedSemaphores[i], nullptr);
+		vkDestroySemaphore(_logicalDevice, _asyncComputeFinishedSemaphores[i], nullptr);
 
 		vkDestroyFence(_logicalDevice, _inFlightFences[i], nullptr);
 		vkDestroyFence(_logicalDevice, _computeInFlightFences[i], nullptr);
+		vkDestroyFence(_logicalDevice, _asyncComputeInFlightFences[i], nullptr);
 	}
 
+	if (HasAsyncComputeQueue()) vkDestroyCommandPool(_logicalDevice, _asyncComputeCommandPool, nullptr);
 	vkDestroyCommandPool(_logicalDevice, _computeCommandPool, nullptr);
 	vkDestroyCommandPool(_logicalDevice, _graphicsCommandPool, nullptr);
 	vkDestroyDevice(_logicalDevice, nullptr);
@@ -447,12 +503,13 @@ bool VulkanCore::IsSuitableDevice(VkPhysicalDevice physicalDevice, VkSurfaceKHR
 }
 
 // Create a logical device as an interface to the physical device
-std::tuple<VkDevice, VkQueue, VkQueue, VkQueue> VulkanCore::CreateLogicalDevice(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, bool enableValidationLayers, const std::vector<const char *> &validationLayers, const std::vector<const char *> &deviceExtensions)
+std::tuple<VkDevice, VkQueue, VkQueue, VkQueue, VkQueue> VulkanCore::CreateLogicalDevice(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, bool enableValidationLayers, const std::vector<const char *> &validationLayers, const std::vector<const char *> &deviceExtensions)
 {
 	QueueFamilyIndices indices = FindQueueFamilies(physicalDevice, surface);
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 	std::set<uint32_t> uniqueQueueFamilies = { indices.computeFamily.value(), indices.graphicsFamily.value(), indices.presentFamily.value() };
+	if (indices.asyncComputeFamily.has_value()) uniqueQueueFamilies.insert(indices.asyncComputeFamily.value());
 
 	float queuePriority = 1.0f;
 	for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -507,13 +564,16 @@ std::tuple<VkDevice, VkQueue, VkQueue, VkQueue> VulkanCore::CreateLogicalDevice(
 	VkQueue computeQueue = VK_NULL_HANDLE;
 	vkGetDeviceQueue(logicalDevice, indices.computeFamily.value(), 0, &computeQueue);
 
+	VkQueue asyncComputeQueue = VK_NULL_HANDLE;
+	if (indices.asyncComputeFamily.has_value()) vkGetDeviceQueue(logicalDevice, indices.asyncComputeFamily.value(), 0, &asyncComputeQueue);
+
 	VkQueue graphicsQueue = VK_NULL_HANDLE;
 	vkGetDeviceQueue(logicalDevice, indices.graphicsFamily.value(), 0, &graphicsQueue);
 
 	VkQueue presentQueue = VK_NULL_HANDLE;
 	vkGetDeviceQueue(logicalDevice, indices.presentFamily.value(), 0, &presentQueue);
 
-	return std::make_tuple(logicalDevice, graphicsQueue, computeQueue, presentQueue);
+	return std::make_tuple(logicalDevice, graphicsQueue, computeQueue, asyncComputeQueue, presentQueue);
 }
 
 // Find queues that support graphics commands
@@ -531,9 +591,12 @@ QueueFamilyIndices VulkanCore::FindQueueFamilies(VkPhysicalDevice physicalDevice
 		// Check if graphics queue is supported
 		const auto &queueFamily = queueFamilies[i];
 
-		if (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) indices.computeFamily = i;
+		bool isCompute = (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+		bool isGraphics = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		if (isCompute && (isGraphics || !indices.computeFamily.has_value())) indices.computeFamily = i;
+		if (isCompute && !isGraphics) indices.asyncComputeFamily = i;
 
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) indices.graphicsFamily = i; 
+		if (isGraphics) indices.graphicsFamily = i; 
 
 		VkBool32 presentSupport = false;
 		vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport); // Check if presentation queue is supported
@@ -989,7 +1052,7 @@ std::vector<VkCommandBuffer> VulkanCore::CreateCommandBuffers(VkDevice logicalDe
 	return commandBuffers;
 }
 
-void VulkanCore::RecordComputeCommandBuffer(VkCommandBuffer computeCommandBuffer, uint32_t currentFrame)
+void VulkanCore::RecordComputeCommandBuffer(VkCommandBuffer computeCommandBuffer, uint32_t currentFrame, bool isAsync)
 {
 	VkCommandBufferBeginInfo beginInfo
 	{
@@ -1001,7 +1064,15 @@ void VulkanCore::RecordComputeCommandBuffer(VkCommandBuffer computeCommandBuffer
 		throw std::runtime_error("failed to begin recording compute command buffer!");
 	}
 
-	_onRecordComputeCommand.Invoke(computeCommandBuffer, currentFrame);
+	if (isAsync)
+	{
+		_onRecordAsyncComputeCommand.Invoke(computeCommandBuffer, currentFrame);
+	}
+	else
+	{
+		if (!HasAsyncComputeQueue()) _onRecordAsyncComputeCommand.Invoke(computeCommandBuffer, currentFrame);
+		_onRecordComputeCommand.Invoke(computeCommandBuffer, currentFrame);
+	}
 
 	if (vkEndCommandBuffer(computeCommandBuffer) != VK_SUCCESS)
 	{
@@ -1085,7 +1156,7 @@ void VulkanCore::RecordCommandBuffer(VkExtent2D swapChainExtent, VkRenderPass re
 	}
 }
 
-std::tuple<std::vector<VkSemaphore>, std::vector<VkSemaphore>, std::vector<VkSemaphore>, std::vector<VkFence>, std::vector<VkFence>> VulkanCore::CreateSyncObjects(uint32_t maxFramesInFlight)
+std::tuple<std::vector<VkSemaphore>, std::vector<VkSemaphore>, std::vector<VkSemaphore>, std::vector<VkSemaphore>, std::vector<VkFence>, std::vector<VkFence>, std::vector<VkFence>> VulkanCore::CreateSyncObjects(uint32_t maxFramesInFlight)
 {
 	// Semaphores are used to add order between queue operations.
 	// enqueue A, signal S when done - starts executing immediately
@@ -1096,6 +1167,7 @@ std::tuple<std::vector<VkSemaphore>, std::vector<VkSemaphore>, std::vector<VkSem
 	std::vector<VkSemaphore> imageAvailableSemaphores(maxFramesInFlight);
 	std::vector<VkSemaphore> renderFinishedSemaphores(maxFramesInFlight);
 	std::vector<VkSemaphore> computeFinishedSemaphores(maxFramesInFlight);
+	std::vector<VkSemaphore> asyncComputeFinishedSemaphores(maxFramesInFlight);
 
 	// Fences are used for ordering the execution on the CPU, otherwise known as the host.
 	// enqueue A, start work immediately, signal F when done
@@ -1103,6 +1175,7 @@ std::tuple<std::vector<VkSemaphore>, std::vector<VkSemaphore>, std::vector<VkSem
 	// vkWaitForFence(F)
 	std::vector<VkFence> inFlightFences(maxFramesInFlight);
 	std::vector<VkFence> computeInFlightFences(maxFramesInFlight);
+	std::vector<VkFence> asyncComputeInFlightFences(maxFramesInFlight);
 
 	VkSemaphoreCreateInfo semaphoreInfo
 	{
@@ -1121,15 +1194,17 @@ std::tuple<std::vector<VkSemaphore>, std::vector<VkSemaphore>, std::vector<VkSem
 			vkCreateSemaphore(_logicalDevice, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
 			vkCreateSemaphore(_logicalDevice, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
 			vkCreateSemaphore(_logicalDevice, &semaphoreInfo, nullptr, &computeFinishedSemaphores[i]) != VK_SUCCESS ||
+			vkCreateSemaphore(_logicalDevice, &semaphoreInfo, nullptr, &asyncComputeFinishedSemaphores[i]) != VK_SUCCESS ||
 			vkCreateFence(_logicalDevice, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS ||
-			vkCreateFence(_logicalDevice, &fenceInfo, nullptr, &computeInFlightFences[i]) != VK_SUCCESS;
+			vkCreateFence(_logicalDevice, &fenceInfo, nullptr, &computeInFlightFences[i]) != VK_SUCCESS ||
+			vkCreateFence(_logicalDevice, &fenceInfo, nullptr, &asyncComputeInFlightFences[i]) != VK_SUCCESS;
 		if (failed)
 		{
 			throw std::runtime_error("Failed to create semaphores.");
 		}
 	}
 
-	return std::make_tuple(imageAvailableSemaphores, renderFinishedSemaphores, computeFinishedSemaphores, inFlightFences, computeInFlightFences);
+	return std::make_tuple(imageAvailableSemaphores, renderFinishedSemaphores, computeFinishedSemaphores, asyncComputeFinishedSemaphores, inFlightFences, computeInFlightFences, asyncComputeInFlightFences);
 }
 
 Image VulkanCore::CreateDepthResources(VkExtent2D swapChainExtent)
@@ -1216,6 +1291,8 @@ void VulkanCore::EndSingleTimeCommands(VkCommandPool commandPool, VkCommandBuffe
 		.pCommandBuffers = &commandBuffer
 	};
 
+	// Frames in flight may still read the resources being written, as nothing waits for the device at the end of a frame.
+	vkDeviceWaitIdle(_logicalDevice);
 	vkQueueSubmit(submitQueue, 1, &submitInfo, VK_NULL_HANDLE); // Submit to the queue
 	vkQueueWaitIdle(submitQueue); // Wait for operations in the command queue to be finished.
 
@@ -46,7 +46,8 @@ struct QueueFamilyIndices
 {
 	// Note that queue families that support drawing commands and presentation can differ.
 	// So they are separated.
-	std::optional<uint32_t> computeFamily;
+	std::optional<uint32_t> computeFamily; // Preferably the one that supports graphics, so that its results are read by the draws at no cost
+	std::optional<uint32_t> asyncComputeFamily; // Compute without graphics, which runs alongside the graphics work; not every device has one
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
 	bool IsComplete()
@@ -85,6 +86,7 @@ private:
 	VkQueue _graphicsQueue = VK_NULL_HANDLE;
 	VkQueue _presentQueue = VK_NULL_HANDLE;
 	VkQueue _computeQueue = VK_NULL_HANDLE;
+	VkQueue _asyncComputeQueue = VK_NULL_HANDLE; // Null if the device has no separate compute family
 
 	// ==================== Window ====================
 	VkSurfaceKHR _surface = VK_NULL_HANDLE; // Abstract type of surface to present rendered images to
@@ -110,15 +112,19 @@ private:
 	// ==================== Command buffers ====================
 	VkCommandPool _graphicsCommandPool = VK_NULL_HANDLE;
 	VkCommandPool _computeCommandPool = VK_NULL_HANDLE;
+	VkCommandPool _asyncComputeCommandPool = VK_NULL_HANDLE;
 	std::vector<VkCommandBuffer> _commandBuffers;
 	std::vector<VkCommandBuffer> _computeCommandBuffers;
+	std::vector<VkCommandBuffer> _asyncComputeCommandBuffers;
 
 	// ==================== Syncronization objects ====================
 	std::vector<VkSemaphore> _imageAvailableSemaphores; // Signal that an image has been aquired from the swap chain
 	std::vector<VkSemaphore> _renderFinishedSemaphores; // Signal that rendering has finished and presentation can happen
 	std::vector<VkSemaphore> _computeFinishedSemaphores; // Signal that compute has finished 
+	std::vector<VkSemaphore> _asyncComputeFinishedSemaphores; // Signal that the async compute has finished, for the compute that reads its results
 	std::vector<VkFence> _inFlightFences; // To make sure that only one frame is rendering at a time
 	std::vector<VkFence> _computeInFlightFences; // Wait until the compute shader command has ended
+	std::vector<VkFence> _asyncComputeInFlightFences;
 
 	// ==================== Frames in flight ====================
 	static const uint32_t MAX_FRAMES_IN_FLIGHT = 2; // Limit to 2 so that the CPU doesn't get ahead of the GPU
@@ -127,6 +133,9 @@ private:
 	// ==================== Window resizing ====================
 	bool _framebufferResized = false;
 
+	// ==================== Presentation ====================
+	bool _isPresentationEnabled = true; // If disabled, only compute commands are submitted
+
 	// ==================== Images ====================
 	Image _colorImage = nullptr;
 
@@ -143,6 +152,7 @@ private:
 	// ==================== Events ====================
 	Delegate<void(float, uint32_t)> _onExecuteHost;
 	Delegate<void(VkCommandBuffer, uint32_t)> _onRecordComputeCommand;
+	Delegate<void(VkCommandBuffer, uint32_t)> _onRecordAsyncComputeCommand; // Recorded ahead of the compute commands into their buffer if there is no async compute queue
 	Delegate<void(VkCommandBuffer, uint32_t)> _onRecordDrawCommand;
 	Delegate<void()> _onRecreateSwapChain;
 	Delegate<void()> _onSubmitGraphicsQueueFinishedOneShot;
@@ -163,6 +173,7 @@ public:
 	void InitVulkan(GLFWwindow *window);
 	void UpdateFrame(float deltaSecond);
 	void Resize() { _framebufferResized = true; }
+	void SetPresentationEnabled(bool isPresentationEnabled) { _isPresentationEnabled = isPresentationEnabled; }
 
 	void SetUpScene(); // Temp
 
@@ -173,23 +184,29 @@ public:
 	auto GetLogicalDevice() const { return _logicalDevice; }
 	auto GetSurface() const { return _surface; }
 	auto GetComputeFamily() const { return FindQueueFamilies(_physicalDevice, _surface).computeFamily.value(); }
+	auto GetAsyncComputeFamily() const { return FindQueueFamilies(_physicalDevice, _surface).asyncComputeFamily.value_or(GetComputeFamily()); }
+	auto HasAsyncComputeQueue() const { return _asyncComputeQueue != VK_NULL_HANDLE; }
 	auto GetGraphicsFamily() const { return FindQueueFamilies(_physicalDevice, _surface).graphicsFamily.value(); }
 	auto GetPresentFamily() const { return FindQueueFamilies(_physicalDevice, _surface).presentFamily.value(); }
 	auto GetGraphicsQueue() const { return _graphicsQueue; }
+	auto GetAsyncComputeQueue() const { return HasAsyncComputeQueue() ? _asyncComputeQueue : _computeQueue; }
 	auto GetMinImageCount() const { return QuerySwapChainSupport(_physicalDevice, _surface).capabilities.minImageCount; }
 	auto GetSwapChainImageCount() const { return _swapChainImages.size(); }
 	auto GetRenderPass() const { return _renderPass; }
 	auto GetExtent() const { return _swapChainExtent; }
 	auto GetGraphicsCommandPool() const { return _graphicsCommandPool; }
 	auto GetComputeCommandPool() const { return _computeCommandPool; }
+	auto GetAsyncComputeCommandPool() const { return HasAsyncComputeQueue() ? _asyncComputeCommandPool : _computeCommandPool; }
 	auto GetMaxFramesInFlight() const { return MAX_FRAMES_IN_FLIGHT; }
 	auto GetCurrentFrame() const { return _currentFrame; }
+	auto IsPresentationEnabled() const { return _isPresentationEnabled; }
 
 	auto &GetMainCamera() const { return _mainCamera; }
 	auto &GetMainLight() const { return _mainLight; }
 
 	auto &OnExecuteHost() { return _onExecuteHost; }
 	auto &OnComputeCommand() { return _onRecordComputeCommand; }
+	auto &OnAsyncComputeCommand() { return _onRecordAsyncComputeCommand; }
 	auto &OnDrawCommand() { return _onRecordDrawCommand; }
 	auto &OnRecreateSwapChain() { return _onRecreateSwapChain; }
 	auto &OnSubmitGraphicsQueueFinishedOneShot() { return _onSubmitGraphicsQueueFinishedOneShot; }
@@ -222,7 +239,7 @@ private:
 	bool IsSuitableDevice(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, const std::vector<const char *> &deviceExtensions, bool discreteGPUOnly);
 
 	// ==================== Logical device and queues ====================
-	std::tuple<VkDevice, VkQueue, VkQueue, VkQueue> CreateLogicalDevice(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, bool enableValidationLayers, const std::vector<const char *> &validationLayers, const std::vector<const char *> &deviceExtensions);
+	std::tuple<VkDevice, VkQueue, VkQueue, VkQueue, VkQueue> CreateLogicalDevice(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, bool enableValidationLayers, const std::vector<const char *> &validationLayers, const std::vector<const char *> &deviceExtensions);
 	// Find queues that support graphics commands
 	QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface) const;
 
@@ -251,11 +268,11 @@ private:
 	VkCommandPool CreateCommandPool(VkDevice logicalDevice, uint32_t queueFamilyIndex);
 	std::vector<VkCommandBuffer> CreateCommandBuffers(VkDevice logicalDevice, VkCommandPool commandPool, uint32_t maxFramesInFlight);
 
-	void RecordComputeCommandBuffer(VkCommandBuffer computeCommandBuffer, uint32_t currentFrame);
+	void RecordComputeCommandBuffer(VkCommandBuffer computeCommandBuffer, uint32_t currentFrame, bool isAsync);
 	void RecordCommandBuffer(VkExtent2D swapChainExtent, VkRenderPass renderPass, VkFramebuffer framebuffer, VkCommandBuffer commandBuffer, uint32_t currentFrame);
 
 	// ==================== Syncronization objects ====================
-	std::tuple<std::vector<VkSemaphore>, std::vector<VkSemaphore>, std::vector<VkSemaphore>, std::vector<VkFence>, std::vector<VkFence>> CreateSyncObjects(uint32_t maxFramesInFlight);
+	std::tuple<std::vector<VkSemaphore>, std::vector<VkSemaphore>, std::vector<VkSemaphore>, std::vector<VkSemaphore>, std::vector<VkFence>, std::vector<VkFence>, std::vector<VkFence>> CreateSyncObjects(uint32_t maxFramesInFlight);
 
 	// ==================== Depth buffering ====================
 	Image CreateDepthResources(VkExtent2D swapChainExtent);
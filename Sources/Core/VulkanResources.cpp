@@ -140,7 +140,10 @@ void BufferResource::CopyFrom(const void *source, VkDeviceSize copyOffset, VkDev
 			vkMapMemory(VulkanCore::Get()->GetLogicalDevice(), _stagingBuffer->GetMemory()->GetMemoryHandle(), 0, _size, 0, &_mappedMemory); // Map data <-> stagingBufferMemory
 		}
 
-		memcpy(_mappedMemory, source, _stagingBuffer->Size());
+		void *offsetData = reinterpret_cast<std::byte *>(_mappedMemory) + copyOffset;
+		const void *offsetSource = reinterpret_cast<const std::byte *>(source) + copyOffset;
+
+		memcpy(offsetData, offsetSource, copySize);
 		CopyFrom(_stagingBuffer, copyOffset, copySize);
 	}
 	else
@@ -182,6 +185,26 @@ void BufferResource::CopyFrom(const Buffer &source, VkDeviceSize copyOffset, VkD
 	VulkanCore::Get()->EndSingleTimeCommands(VulkanCore::Get()->GetGraphicsCommandPool(), commandBuffer, VulkanCore::Get()->GetGraphicsQueue());
 }
 
+void BufferResource::CopyTo(void *destination, VkDeviceSize copyOffset, VkDeviceSize copySize)
+{
+	if (copySize == VK_WHOLE_SIZE) copySize = _size;
+
+	if (_memory->IsDeviceLocal())
+	{
+		throw std::runtime_error("Cannot read back a device-local buffer.");
+	}
+
+	if (_mappedMemory == nullptr)
+	{
+		vkMapMemory(VulkanCore::Get()->GetLogicalDevice(), _memory->GetMemoryHandle(), _offsetWithinMemory, _size, 0, &_mappedMemory);
+	}
+
+	const void *offsetData = reinterpret_cast<const std::byte *>(_mappedMemory) + copyOffset;
+	void *offsetDestination = reinterpret_cast<std::byte *>(destination) + copyOffset;
+
+	memcpy(offsetDestination, offsetData, copySize);
+}
+
 VkDescriptorType BufferResource::GetDescriptorType()
 {
 	if (_bufferUsage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
@@ -70,6 +70,7 @@ public:
 
 	void CopyFrom(const void *source, VkDeviceSize copyOffset = 0, VkDeviceSize copySize = VK_WHOLE_SIZE);
 	void CopyFrom(const Buffer &source, VkDeviceSize copyOffset = 0, VkDeviceSize copySize = VK_WHOLE_SIZE);
+	void CopyTo(void *destination, VkDeviceSize copyOffset = 0, VkDeviceSize copySize = VK_WHOLE_SIZE); // Only for host-visible buffers
 
 	auto Size() const { return _size; }
 	auto GetBufferHandle() const { return _buffer; }
@@ -0,0 +1,120 @@
+#include "HeadlessApplication.h"
+
+const std::string HeadlessApplication::TRANSPORT_NAME = "FluidSimulation";
+
+HeadlessApplication::HeadlessApplication(uint32_t rank, uint32_t rankCount, TransportType transportType, uint32_t frameCount, const SimulationParameters &simulationParameters, const HeadlessScene &scene, HeadlessBenchmark benchmark) :
+	_rank(rank),
+	_rankCount(rankCount),
+	_transportType(transportType),
+	_frameCount(frameCount),
+	_simulationParameters(simulationParameters),
+	_benchmark(benchmark),
+	_scene(scene)
+{
+}
+
+void HeadlessApplication::Run()
+{
+	switch (_benchmark)
+	{
+	case HeadlessBenchmark::None:
+		RunSimulation();
+		break;
+	case HeadlessBenchmark::NUMA:
+		RunNUMABenchmark();
+		break;
+	case HeadlessBenchmark::Scheduler:
+		RunSchedulerBenchmark();
+		break;
+	}
+}
+
+void HeadlessApplication::RunSimulation()
+{
+	_simulatedScene = CreateScene(true);
+
+	auto beginTime = std::chrono::high_resolution_clock::now();
+	for (uint32_t frame = 1; frame <= _frameCount; ++frame)
+	{
+		_simulatedScene->Advance(FRAME_TIME);
+
+		if (frame % REPORT_INTERVAL == 0 || frame == _frameCount)
+		{
+			float elapsedSecond = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - beginTime).count();
+			std::cout << std::format("Rank {}/{}: frame {}, {} particles, {:.2f} s", _rank, _rankCount, frame, _simulatedScene->GetParticleCount(), elapsedSecond) << std::endl;
+		}
+	}
+}
+
+// Without NUMA awareness, every page of the particle arrays lives on the node of the calling thread, and the threads of the other nodes reach for it across the interconnect.
+// The unpinned run goes first, since pinning the team in the second run pins its threads for the rest of the process.
+void HeadlessApplication::RunNUMABenchmark()
+{
+	_simulatedScene = CreateScene(false);
+	float singleNodeFrameTime = MeasureFrameTime(*_simulatedScene);
+	size_t particleCount = _simulatedScene->GetParticleCount();
+
+	_simulatedScene = CreateScene(true);
+	float firstTouchFrameTime = MeasureFrameTime(*_simulatedScene);
+
+	std::cout << std::format("NUMA benchmark: {} particles, {} threads, {} frames after {} warm-up frames", particleCount, omp_get_max_threads(), _frameCount, WARMUP_FRAME_COUNT) << std::endl;
+	std::cout << std::format("Single node: {:.3f} ms per frame", singleNodeFrameTime) << std::endl;
+	std::cout << std::format("First touch: {:.3f} ms per frame ({:.2f}x)", firstTouchFrameTime, singleNodeFrameTime / firstTouchFrameTime) << std::endl;
+}
+
+// Both runs start from the same initial state and take the same steps, which only the task graph needs the equation of state and explicit viscosity for.
+// Besides the wall time per frame, the scene reports its own average time per step, which leaves out the work between steps.
+void HeadlessApplication::RunSchedulerBenchmark()
+{
+	std::array<SolverScheduler, 2> solverSchedulers{ SolverScheduler::OpenMP, SolverScheduler::TaskGraph };
+	std::array<std::string, 2> schedulerNames{ "OpenMP", "Task graph" };
+	std::array<float, 2> frameTimes{};
+	std::array<float, 2> stepTimes{};
+	size_t particleCount = 0;
+
+	for (size_t i = 0; i < solverSchedulers.size(); ++i)
+	{
+		_simulatedScene = CreateScene(true, solverSchedulers[i]);
+		particleCount = _simulatedScene->GetParticleCount();
+		frameTimes[i] = MeasureFrameTime(*_simulatedScene);
+		stepTimes[i] = _simulatedScene->GetAverageStepTime(solverSchedulers[i]);
+	}
+
+	std::cout << std::format("Scheduler benchmark: {} particles, {} threads, {} frames after {} warm-up frames", particleCount, omp_get_max_threads(), _frameCount, WARMUP_FRAME_COUNT) << std::endl;
+	for (size_t i = 0; i < solverSchedulers.size(); ++i)
+	{
+		std::cout << std::format("{}: {:.3f} ms per frame, {:.3f} ms per step ({:.2f}x)", schedulerNames[i], frameTimes[i], stepTimes[i], frameTimes[0] / frameTimes[i]) << std::endl;
+	}
+}
+
+std::shared_ptr<CPUSimulatedScene> HeadlessApplication::CreateScene(bool isNUMAAware, SolverScheduler solverScheduler)
+{
+	auto simulatedScene = CPUSimulatedScene::Instantiate<CPUSimulatedScene>(true);
+	simulatedScene->UpdateSimulationParameters(_simulationParameters);
+	simulatedScene->SetNUMAAware(isNUMAAware);
+	simulatedScene->SetSolverScheduler(solverScheduler);
+
+	// The block of particles is split into slabs along the x-axis
+	if (_rankCount > 1)
+	{
+		auto transport = CreateTransport(_transportType, TRANSPORT_NAME, _rank, _rankCount);
+		simulatedScene->SetDecomposition(std::make_unique<DomainDecomposition>(std::move(transport), 0, _scene._xRange.r, _scene._xRange.g));
+	}
+
+	// Props need Vulkan to be loaded, so the level is empty
+	simulatedScene->InitializeLevel();
+	simulatedScene->InitializeParticles(_scene._particleDistance, _scene._xRange, _scene._yRange, _scene._zRange);
+
+	return simulatedScene;
+}
+
+float HeadlessApplication::MeasureFrameTime(CPUSimulatedScene &simulatedScene)
+{
+	for (uint32_t frame = 0; frame < WARMUP_FRAME_COUNT; ++frame) simulatedScene.Advance(FRAME_TIME);
+
+	auto beginTime = std::chrono::high_resolution_clock::now();
+	for (uint32_t frame = 0; frame < _frameCount; ++frame) simulatedScene.Advance(FRAME_TIME);
+	float elapsedMillisecond = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - beginTime).count();
+
+	return elapsedMillisecond / std::max(_frameCount, 1u);
+}
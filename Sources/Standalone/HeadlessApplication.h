@@ -0,0 +1,60 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <format>
+#include <array>
+
+#include "CPUSimulatedScene.h"
+#include "DomainDecomposition.h"
+#include "Transport.h"
+
+enum class HeadlessBenchmark
+{
+	None,
+	NUMA, // Steps the same scene with its arrays on the node of the calling thread, then placed by first touch
+	Scheduler // Steps the same scene on OpenMP loops, then on the task graph
+};
+
+// Block of particles that a headless run starts from
+struct HeadlessScene
+{
+	float _particleDistance = 0.07f;
+	glm::vec2 _xRange{ -1.0f, 1.0f }; // Split into the slabs of the ranks in a distributed run
+	glm::vec2 _yRange{ 2.0f, 6.0f };
+	glm::vec2 _zRange{ -1.0f, 1.0f };
+};
+
+// Runs the CPU solver without a window or Vulkan for a fixed number of frames.
+// With more than one rank, each process is one rank of a distributed run on the same host; start one process per rank with the same arguments but the rank.
+class HeadlessApplication
+{
+private:
+	std::shared_ptr<CPUSimulatedScene> _simulatedScene;
+
+	uint32_t _rank = 0;
+	uint32_t _rankCount = 1;
+	TransportType _transportType = TransportType::Socket;
+	uint32_t _frameCount = 0;
+	SimulationParameters _simulationParameters{};
+	HeadlessBenchmark _benchmark = HeadlessBenchmark::None;
+	HeadlessScene _scene{};
+
+	static constexpr float FRAME_TIME = 1.0f / 60.0f;
+	static const uint32_t REPORT_INTERVAL = 60; // Frames between progress reports
+	static const uint32_t WARMUP_FRAME_COUNT = 30; // Frames run before a benchmark measures, for the fluid to settle and the pages to be mapped
+	static const std::string TRANSPORT_NAME;
+
+public:
+	HeadlessApplication(uint32_t rank, uint32_t rankCount, TransportType transportType, uint32_t frameCount, const SimulationParameters &simulationParameters, const HeadlessScene &scene, HeadlessBenchmark benchmark = HeadlessBenchmark::None);
+	void Run();
+
+private:
+	void RunSimulation();
+	void RunNUMABenchmark();
+	void RunSchedulerBenchmark();
+	std::shared_ptr<CPUSimulatedScene> CreateScene(bool isNUMAAware, SolverScheduler solverScheduler = SolverScheduler::OpenMP);
+	float MeasureFrameTime(CPUSimulatedScene &simulatedScene); // In milliseconds
+};
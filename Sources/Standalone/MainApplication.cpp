@@ -3,6 +3,12 @@
 const uint32_t WindowApplication::INIT_WIDTH = 1920;
 const uint32_t WindowApplication::INIT_HEIGHT = 1080;
 
+WindowApplication::WindowApplication(const std::string &engineName, const SimulationParameters &initialParameters) :
+	_engineName(engineName),
+	_initialParameters(initialParameters)
+{
+}
+
 void WindowApplication::Run()
 {
 	_window = InitMainWindow(INIT_WIDTH, INIT_HEIGHT, "Fluid Simulation");
@@ -11,19 +17,66 @@ void WindowApplication::Run()
 	_vulkanCore->InitVulkan(_window);
 	_vulkanCore->SetUpScene();
 
-	//_simulatedScene = CPUSimulatedScene::Instantiate<CPUSimulatedScene>();
-	_simulatedScene = GPUSimulatedScene::Instantiate<GPUSimulatedScene>();
+	CreateSimulatedScene(_engineName);
+	_simulatedScene->UpdateSimulationParameters(_initialParameters);
+
+	auto interfaceModel = UIModel::Instantiate<UIModel>();
+	_simulationPanel = interfaceModel->AddPanel<SimulationPanel>(_simulatedScene);
+	_renderingPanel = interfaceModel->AddPanel<RenderingPanel>(_simulatedScene);
+
+	_simulationPanel->OnSelectEngine().AddListener
+	(
+		weak_from_this(),
+		[this](const std::string &engineName)
+		{
+			SwitchEngine(engineName);
+		},
+		PRIORITY_LOWEST,
+		__FUNCTION__,
+		__LINE__
+	);
+
+	MainLoop();
+}
+
+void WindowApplication::CreateSimulatedScene(const std::string &engineName)
+{
+	_simulatedScene = SimulatedSceneRegistry::Create(engineName);
+	_engineName = engineName;
+
 	//_simulatedScene->AddProp("Hemisphere.obj", "", true, true);
 	//_simulatedScene->AddProp("Filter.obj", "", true, true);
 	//_simulatedScene->AddProp("Bath.obj", "", true, true, RenderMode::Wireframe); // Temp
 	//_simulatedScene->AddProp("Obstacle.obj", "", true, true, RenderMode::Wireframe); // Temp
 	_simulatedScene->AddProp("Rocky.obj", "Brown.png", true, true);
 
-	auto interfaceModel = UIModel::Instantiate<UIModel>();
-	interfaceModel->AddPanel<SimulationPanel>(_simulatedScene);
-	interfaceModel->AddPanel<RenderingPanel>(_simulatedScene);
+	//_simulatedScene->AddEmitter(Emitter{ ._center{ 0.0f, 5.0f, 0.0f }, ._velocity{ 0.0f, -2.0f, 0.0f }, ._extent{ 0.1f, 0.1f } }); // Temp
+	//_simulatedScene->AddSink(Sink::CreatePlane(glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f))); // Temp
+}
 
-	MainLoop();
+// The settings of the current scene carry over, so that engines are compared on the same scene
+void WindowApplication::SwitchEngine(const std::string &engineName)
+{
+	// The scene owns buffers bound to commands that have already been recorded, so it is replaced only after they have finished.
+	VulkanCore::Get()->OnSubmitGraphicsQueueFinishedOneShot().AddListener
+	(
+		weak_from_this(),
+		[this, engineName]()
+		{
+			VulkanCore::Get()->WaitIdle();
+
+			std::shared_ptr<SimulatedSceneBase> previousScene = std::move(_simulatedScene);
+			CreateSimulatedScene(engineName);
+			_simulatedScene->UpdateSimulationParameters(previousScene->GetSimulationParameters());
+			_simulatedScene->SetColliderMode(previousScene->GetColliderMode());
+			_simulatedScene->SetSubstepCount(previousScene->GetSubstepCount());
+			_simulatedScene->SetParticleRenderingMode(previousScene->GetParticleRenderingMode());
+			_simulatedScene->SetParticleFlow(previousScene->GetParticleFlow());
+
+			_simulationPanel->SetSimulatedScene(_simulatedScene);
+			_renderingPanel->SetSimulatedScene(_simulatedScene);
+		}
+	);
 }
 
 GLFWwindow *WindowApplication::InitMainWindow(int width, int height, const std::string &title)
@@ -36,6 +89,7 @@ GLFWwindow *WindowApplication::InitMainWindow(int width, int height, const std::
 
 	glfwSetWindowUserPointer(window, this); // Store the pointer 'this' to pass to the callback function
 	glfwSetFramebufferSizeCallback(window, OnFramebufferResized); // Add a callback function to execute when the window is resized
+	glfwSetKeyCallback(window, OnKey);
 
 	return window;
 }
@@ -66,4 +120,14 @@ void WindowApplication::OnFramebufferResized(GLFWwindow *window, int width, int
 {
 	auto app = reinterpret_cast<WindowApplication *>(glfwGetWindowUserPointer(window));
 	app->Resize();
+}
+
+// Key callback
+void WindowApplication::OnKey(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+	auto app = reinterpret_cast<WindowApplication *>(glfwGetWindowUserPointer(window));
+	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS && app->_simulatedScene != nullptr)
+	{
+		app->_simulatedScene->SetSimulateOnly(false); // Resume presentation
+	}
 }
\ No newline at end of file
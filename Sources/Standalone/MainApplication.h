@@ -23,20 +23,24 @@
 #include "VulkanCore.h"
 
 #include "SimulatedSceneBase.h"
-#include "CPUSimulatedScene.h"
-#include "GPUSimulatedScene.h"
+#include "SimulatedSceneRegistry.h"
 
 #include "UIModel.h"
 #include "SimulationPanel.h"
 #include "RenderingPanel.h"
 
-class WindowApplication
+class WindowApplication : public DelegateRegistrable
 {
 private:
 	VulkanCore *_vulkanCore;
+	std::string _engineName;
+	SimulationParameters _initialParameters;
 	std::shared_ptr<SimulatedSceneBase> _simulatedScene;
+	std::shared_ptr<SimulationPanel> _simulationPanel;
+	std::shared_ptr<RenderingPanel> _renderingPanel;
 
 public:
+	WindowApplication(const std::string &engineName, const SimulationParameters &initialParameters);
 	void Run();
 
 private:
@@ -45,8 +49,11 @@ private:
 	static const uint32_t INIT_HEIGHT;
 
 	GLFWwindow *InitMainWindow(int width, int height, const std::string &title);
+	void CreateSimulatedScene(const std::string &engineName);
+	void SwitchEngine(const std::string &engineName);
 	void MainLoop();
 
 	void Resize();
 	static void OnFramebufferResized(GLFWwindow *window, int width, int height);
+	static void OnKey(GLFWwindow *window, int key, int scancode, int action, int mods);
 };
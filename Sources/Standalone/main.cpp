@@ -1,14 +1,116 @@
 #include <iostream>
+#include <string_view>
 
 #include "MainApplication.h"
+#include "HeadlessApplication.h"
 
-int main()
+// Usage: Standalone [--engine cpu|gpu|flip] [--pressure-solver eos|dfsph|pbf] [--viscosity-solver explicit|implicit] [--headless [--frames N] [--rank R --rank-count N] [--transport socket|shm] [--particle-distance D] [--x-range MIN,MAX] [--y-range MIN,MAX] [--z-range MIN,MAX] [--benchmark numa|scheduler]]
+int main(int argc, char *argv[])
 {
-	 std::shared_ptr<WindowApplication> app = std::make_shared<WindowApplication>();;
+	std::string engineName = SimulatedSceneRegistry::DEFAULT_ENGINE;
+	bool isEngineGiven = false;
+	SimulationParameters simulationParameters{};
+	bool isHeadless = false;
+	uint32_t rank = 0;
+	uint32_t rankCount = 1;
+	uint32_t frameCount = 600;
+	TransportType transportType = TransportType::Socket;
+	HeadlessBenchmark benchmark = HeadlessBenchmark::None;
+	HeadlessScene headlessScene{};
 
 	try
 	{
-		app->Run();
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string_view argument = argv[i];
+			auto nextValue = [&]() -> std::string_view
+			{
+				if (i + 1 >= argc) throw std::runtime_error(std::format("Missing a value for {}.", argument));
+				return argv[++i];
+			};
+			auto nextRange = [&]() -> glm::vec2
+			{
+				std::string range(nextValue());
+				size_t separator = range.find(',');
+				if (separator == std::string::npos) throw std::runtime_error(std::format("Expected MIN,MAX for {}.", argument));
+
+				glm::vec2 bounds{ std::stof(range.substr(0, separator)), std::stof(range.substr(separator + 1)) };
+				if (bounds.r >= bounds.g) throw std::runtime_error(std::format("The minimum of {} must be less than its maximum.", argument));
+				return bounds;
+			};
+
+			if (argument == "--engine")
+			{
+				engineName = nextValue();
+				if (!SimulatedSceneRegistry::Contains(engineName)) throw std::runtime_error(std::format("Unknown engine {}.", engineName));
+				isEngineGiven = true;
+			}
+			else if (argument == "--pressure-solver")
+			{
+				std::string_view pressureSolverName = nextValue();
+				PressureSolver pressureSolver = PressureSolver::EOS;
+				if (pressureSolverName == "eos") pressureSolver = PressureSolver::EOS;
+				else if (pressureSolverName == "dfsph") pressureSolver = PressureSolver::DFSPH;
+				else if (pressureSolverName == "pbf") pressureSolver = PressureSolver::PBF;
+				else throw std::runtime_error(std::format("Unknown pressure solver {}.", pressureSolverName));
+				simulationParameters._pressureSolver = static_cast<uint32_t>(pressureSolver);
+			}
+			else if (argument == "--viscosity-solver")
+			{
+				std::string_view viscositySolverName = nextValue();
+				ViscositySolver viscositySolver = ViscositySolver::Explicit;
+				if (viscositySolverName == "explicit") viscositySolver = ViscositySolver::Explicit;
+				else if (viscositySolverName == "implicit") viscositySolver = ViscositySolver::Implicit;
+				else throw std::runtime_error(std::format("Unknown viscosity solver {}.", viscositySolverName));
+				simulationParameters._viscositySolver = static_cast<uint32_t>(viscositySolver);
+			}
+			else if (argument == "--headless") isHeadless = true;
+			else if (argument == "--frames") frameCount = static_cast<uint32_t>(std::stoul(std::string(nextValue())));
+			else if (argument == "--rank") rank = static_cast<uint32_t>(std::stoul(std::string(nextValue())));
+			else if (argument == "--rank-count") rankCount = static_cast<uint32_t>(std::stoul(std::string(nextValue())));
+			else if (argument == "--transport")
+			{
+				std::string_view transportName = nextValue();
+				if (transportName == "socket") transportType = TransportType::Socket;
+				else if (transportName == "shm") transportType = TransportType::SharedMemory;
+				else throw std::runtime_error(std::format("Unknown transport {}.", transportName));
+			}
+			else if (argument == "--particle-distance")
+			{
+				headlessScene._particleDistance = std::stof(std::string(nextValue()));
+				if (headlessScene._particleDistance <= 0.0f) throw std::runtime_error("The particle distance must be positive.");
+			}
+			else if (argument == "--x-range") headlessScene._xRange = nextRange();
+			else if (argument == "--y-range") headlessScene._yRange = nextRange();
+			else if (argument == "--z-range") headlessScene._zRange = nextRange();
+			else if (argument == "--benchmark")
+			{
+				std::string_view benchmarkName = nextValue();
+				if (benchmarkName == "numa") benchmark = HeadlessBenchmark::NUMA;
+				else if (benchmarkName == "scheduler") benchmark = HeadlessBenchmark::Scheduler;
+				else throw std::runtime_error(std::format("Unknown benchmark {}.", benchmarkName));
+			}
+			else throw std::runtime_error(std::format("Unknown argument {}.", argument));
+		}
+
+		if (rankCount == 0 || rank >= rankCount) throw std::runtime_error("The rank must be less than the rank count.");
+		// The GPU engine needs Vulkan, which the headless mode runs without
+		if (isHeadless && isEngineGiven && engineName != CPUSimulatedScene::ENGINE_NAME) throw std::runtime_error("The headless mode runs the cpu engine only.");
+		if (benchmark != HeadlessBenchmark::None && (!isHeadless || rankCount > 1)) throw std::runtime_error("Benchmarks run in the headless mode with a single rank.");
+		// The task graph steps only the equation of state with explicit viscosity; the other solvers fall back to OpenMP loops
+		bool isTaskGraphSupported = (simulationParameters._pressureSolver == static_cast<uint32_t>(PressureSolver::EOS)) && (simulationParameters._viscositySolver == static_cast<uint32_t>(ViscositySolver::Explicit));
+		if (benchmark == HeadlessBenchmark::Scheduler && !isTaskGraphSupported) throw std::runtime_error("The scheduler benchmark runs the eos pressure solver with explicit viscosity only.");
+
+		if (isHeadless)
+		{
+			HeadlessApplication app(rank, rankCount, transportType, frameCount, simulationParameters, headlessScene, benchmark);
+			app.Run();
+		}
+		else
+		{
+			std::shared_ptr<WindowApplication> app = WindowApplication::Instantiate<WindowApplication>(engineName, simulationParameters);
+			app->Run();
+		}
 	}
 	catch (const std::exception &e)
 	{
@@ -17,4 +119,4 @@ int main()
 	}
 
 	return EXIT_SUCCESS;
-}
\ No newline at end of file
+}